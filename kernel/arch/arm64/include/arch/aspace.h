@@ -63,6 +63,9 @@ private:
                          uint index_shift, uint page_size_shift,
                          volatile pte_t* page_table) TA_REQ(lock_);
 
+    zx_status_t SplitLargePage(vaddr_t vaddr, vaddr_t index, uint index_shift,
+                               uint page_size_shift, volatile pte_t* page_table) TA_REQ(lock_);
+
     ssize_t UnmapPageTable(vaddr_t vaddr, vaddr_t vaddr_rel, size_t size,
                            uint index_shift, uint page_size_shift,
                            volatile pte_t* page_table) TA_REQ(lock_);
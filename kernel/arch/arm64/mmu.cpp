@@ -511,6 +511,55 @@ void ArmArchVmAspace::FlushTLBEntry(vaddr_t vaddr, bool terminal) {
     }
 }
 
+// Replace the block descriptor at page_table[index], which maps the block
+// containing vaddr, with a table of the next level down that maps the same
+// memory with the same attributes, so that part of the block can be unmapped
+// or have its permissions changed.
+// NOTE: caller must DSB afterwards to ensure TLB entries are flushed
+zx_status_t ArmArchVmAspace::SplitLargePage(vaddr_t vaddr, vaddr_t index, uint index_shift,
+                                            uint page_size_shift, volatile pte_t* page_table) {
+    pte_t pte = page_table[index];
+    DEBUG_ASSERT(index_shift > page_size_shift);
+    DEBUG_ASSERT((pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK);
+
+    LTRACEF("vaddr %#" PRIxPTR ", index shift %u, pte %#" PRIx64 "\n", vaddr, index_shift, pte);
+
+    paddr_t page_table_paddr;
+    zx_status_t status = AllocPageTable(&page_table_paddr, page_size_shift);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    const uint next_index_shift = index_shift - (page_size_shift - 3);
+    const pte_t attrs = pte & ~(MMU_PTE_OUTPUT_ADDR_MASK | MMU_PTE_DESCRIPTOR_MASK);
+    const pte_t descriptor = (next_index_shift > page_size_shift) ?
+                             MMU_PTE_L012_DESCRIPTOR_BLOCK : MMU_PTE_L3_DESCRIPTOR_PAGE;
+    const paddr_t paddr = pte & MMU_PTE_OUTPUT_ADDR_MASK;
+    volatile pte_t* next_page_table =
+        static_cast<volatile pte_t*>(paddr_to_physmap(page_table_paddr));
+    const size_t count = 1UL << (page_size_shift - 3);
+    for (size_t i = 0; i < count; i++) {
+        next_page_table[i] = (paddr + (i << next_index_shift)) | attrs | descriptor;
+    }
+
+    // ensure that the new table is observable from hardware page table walkers
+    __dmb(ARM_MB_ISHST);
+
+    // break before make: the block entry has to be gone from every TLB before
+    // the table replacing it is installed
+    page_table[index] = MMU_PTE_DESCRIPTOR_INVALID;
+    __dmb(ARM_MB_ISHST);
+    FlushTLBEntry(vaddr, true);
+    __dsb(ARM_MB_ISH);
+
+    pte = page_table_paddr | MMU_PTE_L012_DESCRIPTOR_TABLE;
+    page_table[index] = pte;
+    LTRACEF("pte %p[%#" PRIxPTR "] = %#" PRIx64 " (split)\n", page_table, index, pte);
+    __dmb(ARM_MB_ISHST);
+
+    return ZX_OK;
+}
+
 // NOTE: caller must DSB afterwards to ensure TLB entries are flushed
 ssize_t ArmArchVmAspace::UnmapPageTable(vaddr_t vaddr, vaddr_t vaddr_rel,
                                         size_t size, uint index_shift,
@@ -539,13 +588,27 @@ ssize_t ArmArchVmAspace::UnmapPageTable(vaddr_t vaddr, vaddr_t vaddr_rel,
 
         pte = page_table[index];
 
+        // unmapping part of a block needs it to be broken into smaller pages first
+        if (index_shift > page_size_shift && chunk_size != block_size &&
+            (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK) {
+            zx_status_t status = SplitLargePage(vaddr, index, index_shift, page_size_shift,
+                                                page_table);
+            if (status != ZX_OK) {
+                return status;
+            }
+            pte = page_table[index];
+        }
+
         if (index_shift > page_size_shift &&
             (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_TABLE) {
             page_table_paddr = pte & MMU_PTE_OUTPUT_ADDR_MASK;
             next_page_table = static_cast<volatile pte_t*>(paddr_to_physmap(page_table_paddr));
-            UnmapPageTable(vaddr, vaddr_rem, chunk_size,
-                           index_shift - (page_size_shift - 3),
-                           page_size_shift, next_page_table);
+            ssize_t ret = UnmapPageTable(vaddr, vaddr_rem, chunk_size,
+                                         index_shift - (page_size_shift - 3),
+                                         page_size_shift, next_page_table);
+            if (ret < 0) {
+                return ret;
+            }
             if (chunk_size == block_size ||
                 page_table_is_clear(next_page_table, page_size_shift)) {
                 LTRACEF("pte %p[0x%lx] = 0 (was page table)\n", page_table, index);
@@ -703,6 +766,16 @@ int ArmArchVmAspace::ProtectPageTable(vaddr_t vaddr_in, vaddr_t vaddr_rel_in,
         index = vaddr_rel >> index_shift;
         pte = page_table[index];
 
+        // changing part of a block needs it to be broken into smaller pages first
+        if (index_shift > page_size_shift && chunk_size != block_size &&
+            (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK) {
+            ret = SplitLargePage(vaddr, index, index_shift, page_size_shift, page_table);
+            if (ret != 0) {
+                return ret;
+            }
+            pte = page_table[index];
+        }
+
         if (index_shift > page_size_shift &&
             (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_TABLE) {
             page_table_paddr = pte & MMU_PTE_OUTPUT_ADDR_MASK;
@@ -96,6 +96,16 @@ public:
 
     int active_cpus() { return active_cpus_.load(); }
 
+    // Note that the page tables changed, so that cpus this aspace is not
+    // active on flush the TLB entries tagged with its PCID when they next
+    // switch to it.  Must be called before active_cpus() is read to decide
+    // which cpus to shoot down.
+    void MarkTlbStale() {
+        if (pcid_ != 0) {
+            tlb_stale_cpus_.store(~0);
+        }
+    }
+
     IoBitmap& io_bitmap() { return io_bitmap_; }
 
     static void ContextSwitch(X86ArchVmAspace* from, X86ArchVmAspace* to);
@@ -129,6 +139,14 @@ private:
     // CPUs that are currently executing in this aspace.
     // Actually an mp_cpu_mask_t, but header dependencies.
     fbl::atomic_int active_cpus_{0};
+
+    // PCID tagging this aspace's TLB entries, or 0 if it has none and has
+    // its entries flushed whenever it is switched to.
+    uint16_t pcid_ = 0;
+
+    // CPUs that may hold out of date TLB entries tagged with pcid_.
+    // Actually an mp_cpu_mask_t, but header dependencies.
+    fbl::atomic_int tlb_stale_cpus_{0};
 };
 
 using ArchVmAspace = X86ArchVmAspace;
@@ -16,7 +16,13 @@
 #include <arch/x86/feature.h>
 #include <arch/x86/mmu.h>
 #include <arch/x86/mmu_mem_types.h>
+#include <bitmap/raw-bitmap.h>
+#include <bitmap/storage.h>
+#include <fbl/auto_lock.h>
+#include <kernel/cmdline.h>
 #include <kernel/mp.h>
+#include <kernel/mutex.h>
+#include <lib/counters.h>
 #include <new>
 #include <vm/arch_vm_aspace.h>
 #include <vm/physmap.h>
@@ -26,6 +32,11 @@
 
 #define LOCAL_TRACE 0
 
+KCOUNTER(tlb_shootdowns, "kernel.x86.tlb.shootdowns");
+KCOUNTER(tlb_shootdowns_full, "kernel.x86.tlb.shootdowns_full");
+KCOUNTER(tlb_shootdown_ipis, "kernel.x86.tlb.shootdown_ipis");
+KCOUNTER(tlb_pages_invalidated, "kernel.x86.tlb.pages_invalidated");
+
 /* Default address width including virtual/physical address.
  * newer versions fetched below */
 uint8_t g_vaddr_width = 48;
@@ -34,6 +45,9 @@ uint8_t g_paddr_width = 32;
 /* True if the system supports 1GB pages */
 static bool supports_huge_pages = false;
 
+/* True if user address spaces are tagged with a PCID of their own */
+static bool use_pcid = false;
+
 /* top level kernel page tables, initialized in start.S */
 volatile pt_entry_t pml4[NO_OF_PT_ENTRIES] __ALIGNED(PAGE_SIZE);
 volatile pt_entry_t pdp[NO_OF_PT_ENTRIES] __ALIGNED(PAGE_SIZE); /* temporary */
@@ -65,6 +79,78 @@ static const paddr_t kernel_pt_phys =
 static const uint kValidEptFlags =
     ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE | ARCH_MMU_FLAG_PERM_EXECUTE;
 
+namespace {
+
+// PCID 0 is used by the kernel aspace, and by user aspaces that could not get
+// one of their own.
+constexpr uint16_t kFirstUserPcid = 1;
+constexpr uint16_t kMaxUserPcid = X86_CR3_PCID_MASK;
+
+class PcidAllocator {
+public:
+    PcidAllocator() { bitmap_.Reset(kMaxUserPcid + 1); }
+    ~PcidAllocator() = default;
+
+    zx_status_t Alloc(uint16_t* pcid);
+    zx_status_t Free(uint16_t pcid);
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PcidAllocator);
+
+    fbl::Mutex lock_;
+    uint16_t last_ TA_GUARDED(lock_) = kFirstUserPcid - 1;
+
+    bitmap::RawBitmapGeneric<bitmap::FixedStorage<kMaxUserPcid + 1>> bitmap_ TA_GUARDED(lock_);
+};
+
+zx_status_t PcidAllocator::Alloc(uint16_t* pcid) {
+    uint16_t new_pcid;
+
+    // use the bitmap allocator to allocate ids in the range of
+    // [kFirstUserPcid, kMaxUserPcid]
+    // start the search from the last found id + 1 and wrap when hitting the end of the range
+    {
+        fbl::AutoLock al(&lock_);
+
+        size_t val;
+        bool notfound = bitmap_.Get(last_ + 1, kMaxUserPcid + 1, &val);
+        if (unlikely(notfound)) {
+            // search again from the start
+            notfound = bitmap_.Get(kFirstUserPcid, kMaxUserPcid + 1, &val);
+            if (unlikely(notfound)) {
+                LTRACEF("out of PCIDs\n");
+                return ZX_ERR_NO_MEMORY;
+            }
+        }
+        bitmap_.SetOne(val);
+
+        DEBUG_ASSERT(val <= kMaxUserPcid);
+
+        new_pcid = (uint16_t)val;
+        last_ = new_pcid;
+    }
+
+    LTRACEF("new pcid %#x\n", new_pcid);
+
+    *pcid = new_pcid;
+
+    return ZX_OK;
+}
+
+zx_status_t PcidAllocator::Free(uint16_t pcid) {
+    LTRACEF("free pcid %#x\n", pcid);
+
+    fbl::AutoLock al(&lock_);
+
+    bitmap_.ClearOne(pcid);
+
+    return ZX_OK;
+}
+
+PcidAllocator pcid_allocator;
+
+} // namespace
+
 paddr_t x86_kernel_cr3(void) {
     return kernel_pt_phys;
 }
@@ -146,13 +232,26 @@ static void TlbInvalidatePage_task(void* raw_context) {
     DEBUG_ASSERT(arch_ints_disabled());
     TlbInvalidatePage_context* context = (TlbInvalidatePage_context*)raw_context;
 
-    ulong cr3 = x86_get_cr3();
+    ulong cr3 = x86_get_cr3() & X86_CR3_BASE_MASK;
     if (context->target_cr3 != cr3 && !context->pending->contains_global) {
         /* This invalidation doesn't apply to this CPU, ignore it */
         return;
     }
 
-    if (context->pending->full_shootdown) {
+    bool full_shootdown = context->pending->full_shootdown;
+    if (use_pcid && context->pending->contains_global && !full_shootdown) {
+        /* invlpg only drops the paging-structure caches of the current PCID,
+         * but those of any other PCID may be caching the kernel's page tables
+         * as well */
+        for (uint i = 0; i < context->pending->count; ++i) {
+            if (!context->pending->item[i].is_terminal()) {
+                full_shootdown = true;
+                break;
+            }
+        }
+    }
+
+    if (full_shootdown) {
         if (context->pending->contains_global) {
             x86_tlb_global_invalidate();
         } else {
@@ -182,11 +281,11 @@ static void TlbInvalidatePage_task(void* raw_context) {
  * @param pending The planned invalidation
  */
 static void x86_tlb_invalidate_page(const X86PageTableBase* pt, PendingTlbInvalidation* pending) {
-    if (pending->count == 0) {
+    if (pending->count == 0 && !pending->full_shootdown) {
         return;
     }
 
-    ulong cr3 = pt ? pt->phys() : x86_get_cr3();
+    ulong cr3 = pt ? pt->phys() : (x86_get_cr3() & X86_CR3_BASE_MASK);
     struct TlbInvalidatePage_context task_context = {
         .target_cr3 = cr3, .pending = pending,
     };
@@ -195,17 +294,33 @@ static void x86_tlb_invalidate_page(const X86PageTableBase* pt, PendingTlbInvali
      * other CPU will become active in it after this load, or will have left it
      * just before this load.  In the former case, it is becoming active after
      * the write to the page table, so it will see the change.  In the latter
-     * case, it will get a spurious request to flush. */
-    mp_ipi_target_t target;
-    cpu_mask_t target_mask = 0;
+     * case, it will get a spurious request to flush.
+     *
+     * If the aspace has a PCID, CPUs it is not active on may still hold TLB
+     * entries for it from when it last ran there.  Those are flushed when it
+     * next becomes active on them, see ContextSwitch(). */
+    cpu_mask_t target_mask;
     if (pending->contains_global || pt == nullptr) {
-        target = MP_IPI_TARGET_ALL;
+        target_mask = mp_get_online_mask();
     } else {
-        target = MP_IPI_TARGET_MASK;
-        target_mask = static_cast<X86ArchVmAspace*>(pt->ctx())->active_cpus();
+        auto aspace = static_cast<X86ArchVmAspace*>(pt->ctx());
+        aspace->MarkTlbStale();
+        target_mask = aspace->active_cpus() & mp_get_online_mask();
     }
 
-    mp_sync_exec(target, target_mask, TlbInvalidatePage_task, &task_context);
+    kcounter_add(tlb_shootdowns, 1);
+    if (pending->full_shootdown) {
+        kcounter_add(tlb_shootdowns_full, 1);
+    } else {
+        kcounter_add(tlb_pages_invalidated, pending->count);
+    }
+    /* The local CPU runs the task directly rather than being sent an IPI.
+     * This may have migrated by the time mp_sync_exec() runs, so the count
+     * is approximate. */
+    kcounter_add(tlb_shootdown_ipis,
+                 __builtin_popcount(target_mask & ~cpu_num_to_mask(arch_curr_cpu_num())));
+
+    mp_sync_exec(MP_IPI_TARGET_MASK, target_mask, TlbInvalidatePage_task, &task_context);
     pending->clear();
 }
 
@@ -494,7 +609,17 @@ void x86_mmu_early_init() {
     LTRACEF("paddr_width %u vaddr_width %u\n", g_paddr_width, g_vaddr_width);
 }
 
-void x86_mmu_init(void) {}
+void x86_mmu_init(void) {
+    // the cmdline is not available yet in x86_mmu_early_init()
+    use_pcid = x86_feature_test(X86_FEATURE_PCID) &&
+               cmdline_get_bool("kernel.x86.pcid", true);
+    if (use_pcid) {
+        // the secondary cpus pick this up in x86_mmu_percpu_init()
+        DEBUG_ASSERT((x86_get_cr3() & X86_CR3_PCID_MASK) == 0);
+        x86_set_cr4(x86_get_cr4() | X86_CR4_PCIDE);
+    }
+    dprintf(INFO, "x86: PCIDs %s\n", use_pcid ? "enabled" : "disabled");
+}
 
 X86PageTableBase::X86PageTableBase() {
 }
@@ -592,9 +717,17 @@ zx_status_t X86ArchVmAspace::Init(vaddr_t base, size_t size, uint mmu_flags) {
             return status;
         }
 
+        // without a PCID of its own the aspace simply has its TLB entries
+        // flushed every time it is switched to
+        if (use_pcid && pcid_allocator.Alloc(&pcid_) != ZX_OK) {
+            pcid_ = 0;
+        }
+
         LTRACEF("user aspace: pt phys %#" PRIxPTR ", virt %p\n", pt_->phys(), pt_->virt());
     }
     fbl::atomic_init(&active_cpus_, 0);
+    // a recycled PCID may have entries of its previous owner in any TLB
+    fbl::atomic_init(&tlb_stale_cpus_, ~0);
 
     return ZX_OK;
 }
@@ -608,6 +741,10 @@ zx_status_t X86ArchVmAspace::Destroy() {
     } else {
         static_cast<X86PageTableMmu*>(pt_)->Destroy(base_, size_);
     }
+    if (pcid_ != 0) {
+        pcid_allocator.Free(pcid_);
+        pcid_ = 0;
+    }
     return ZX_OK;
 }
 
@@ -646,13 +783,29 @@ void X86ArchVmAspace::ContextSwitch(X86ArchVmAspace* old_aspace, X86ArchVmAspace
     if (aspace != nullptr) {
         aspace->canary_.Assert();
         paddr_t phys = aspace->pt_phys();
-        LTRACEF_LEVEL(3, "switching to aspace %p, pt %#" PRIXPTR "\n", aspace, phys);
-        x86_set_cr3(phys);
+        LTRACEF_LEVEL(3, "switching to aspace %p, pt %#" PRIXPTR ", pcid %#x\n", aspace, phys,
+                      aspace->pcid_);
 
         if (old_aspace != nullptr) {
             old_aspace->active_cpus_.fetch_and(~cpu_bit);
         }
         aspace->active_cpus_.fetch_or(cpu_bit);
+
+        // Becoming active before checking for stale entries pairs with
+        // MarkTlbStale() being called before the active cpus are read in
+        // x86_tlb_invalidate_page(): either this cpu is sent the shootdown
+        // (which waits for interrupts to be enabled again, after the switch),
+        // or it sees its bit set here and flushes the PCID's entries itself.
+        ulong cr3 = phys;
+        if (aspace->pcid_ != 0) {
+            cr3 |= aspace->pcid_;
+            if (aspace->tlb_stale_cpus_.load() & cpu_bit) {
+                aspace->tlb_stale_cpus_.fetch_and(~cpu_bit);
+            } else {
+                cr3 |= X86_CR3_NOFLUSH;
+            }
+        }
+        x86_set_cr3(cr3);
     } else {
         LTRACEF_LEVEL(3, "switching to kernel aspace, pt %#" PRIxPTR "\n", kernel_pt_phys);
         x86_set_cr3(kernel_pt_phys);
@@ -691,6 +844,8 @@ void x86_mmu_percpu_init(void) {
         cr4 |= X86_CR4_SMEP;
     if (x86_feature_test(X86_FEATURE_SMAP))
         cr4 |= X86_CR4_SMAP;
+    if (use_pcid)
+        cr4 |= X86_CR4_PCIDE;
     x86_set_cr4(cr4);
 
     // Set NXE bit in X86_MSR_IA32_EFER.
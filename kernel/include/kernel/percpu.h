@@ -31,6 +31,21 @@ struct percpu {
     struct list_node run_queue[NUM_PRIORITIES];
     uint32_t run_queue_bitmap;
 
+    // fair scheduler deadline run queue, sorted by absolute deadline, the monotonic floor
+    // of the virtual runtimes on this cpu, and the summed weights of the threads in its
+    // fair run queue, which lives in the scheduler since it is a c++ container.
+    struct list_node deadline_run_queue;
+    zx_duration_t fair_min_vruntime;
+    uint64_t fair_weight_sum;
+
+    // the sum of the densities of the deadline threads admitted to this cpu
+    uint32_t deadline_density;
+
+    // number of threads, not counting the idle thread, waiting in the run queues above,
+    // and the next time this cpu looks for a less loaded cpu to hand work to
+    uint32_t run_queue_len;
+    zx_time_t next_balance;
+
 #if WITH_LOCK_DEP
     // state for runtime lock validation when in irq context
     lockdep_state_t lock_state;
@@ -41,6 +41,18 @@ bool sched_unblock_list(struct list_node* list) __WARN_UNUSED_RESULT TA_REQ(thre
 
 void sched_transition_off_cpu(cpu_num_t old_cpu) TA_REQ(thread_lock);
 
+// return true if the fair/deadline scheduler was selected with kernel.scheduler=fair
+bool sched_fair_enabled(void);
+
+// set the deadline parameters of a thread. a zero period turns the thread back into a
+// regular fair thread. only meaningful when the fair scheduler is enabled. returns
+// ZX_ERR_NO_RESOURCES if no cpu the thread may run on has room for its reservation.
+zx_status_t sched_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t deadline,
+                               zx_duration_t period) TA_REQ(thread_lock);
+
+// give up the reservation of a deadline thread which is exiting.
+void sched_release_deadline(thread_t* t) TA_REQ(thread_lock);
+
 // sched_preempt_timer_tick is called when the preemption timer for a CPU has fired.
 //
 // This function is logically private and should only be called by timer.cpp.
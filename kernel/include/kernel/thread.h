@@ -86,6 +86,17 @@ typedef struct lockdep_state {
     uint8_t last_result;
 } lockdep_state_t;
 
+// This is a parallel structure to fbl::WAVLTreeNodeState<thread_t*> to work around
+// the fact that this header is included by C code and cannot reference C++ types
+// directly. This structure MUST NOT be touched by code outside of the scheduler
+// and MUST be kept in sync with the C++ counterpart.
+typedef struct sched_fair_node {
+    uintptr_t parent;
+    uintptr_t left;
+    uintptr_t right;
+    bool rank;
+} sched_fair_node_t;
+
 typedef struct thread {
     int magic;
     struct list_node thread_list_node;
@@ -115,6 +126,29 @@ typedef struct thread {
     int priority_boost;
     int inherited_priority;
 
+    // fair scheduler state, unused by the priority scheduler.
+    // vruntime is the thread's runtime scaled by the weight of its effective priority,
+    // brought up to date at last_accounted.
+    zx_duration_t vruntime;
+    zx_time_t last_accounted;
+    // fair_node links the thread into its cpu's fair run queue, which is ordered by the
+    // key it was queued with and then by fair_seq, so equal keys run in the order queued.
+    sched_fair_node_t fair_node;
+    zx_duration_t fair_key;
+    uint64_t fair_seq;
+
+    // deadline scheduler parameters. a thread with a non-zero deadline_period is guaranteed
+    // deadline_capacity of runtime within deadline_relative of the start of every period,
+    // and is scheduled earliest deadline first ahead of all fair threads. deadline_abs and
+    // deadline_budget track the current period.
+    zx_duration_t deadline_capacity;
+    zx_duration_t deadline_relative;
+    zx_duration_t deadline_period;
+    zx_time_t deadline_abs;
+    zx_duration_t deadline_budget;
+    // the cpu the thread was admitted to, which it runs on whenever its affinity allows
+    cpu_num_t deadline_cpu;
+
     // current cpu the thread is either running on or in the ready queue, undefined otherwise
     cpu_num_t curr_cpu;
     cpu_num_t last_cpu;      // last cpu the thread ran on, INVALID_CPU if it's never run
@@ -240,6 +274,8 @@ void thread_construct_first(thread_t* t, const char* name);
 thread_t* thread_create_idle_thread(uint cpu_num);
 void thread_set_name(const char* name);
 void thread_set_priority(thread_t* t, int priority);
+zx_status_t thread_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t deadline,
+                                zx_duration_t period);
 void thread_set_user_callback(thread_t* t, thread_user_callback_t cb);
 thread_t* thread_create(const char* name, thread_start_routine entry, void* arg, int priority);
 thread_t* thread_create_etc(thread_t* t, const char* name, thread_start_routine entry, void* arg,
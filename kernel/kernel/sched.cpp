@@ -9,12 +9,18 @@
 #include <assert.h>
 #include <debug.h>
 #include <err.h>
+#include <fbl/intrusive_wavl_tree.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
 #include <kernel/mp.h>
 #include <kernel/percpu.h>
 #include <kernel/thread.h>
+#include <kernel/thread_lock.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
+#include <lib/system-topology.h>
 #include <list.h>
+#include <lk/init.h>
 #include <platform.h>
 #include <printf.h>
 #include <string.h>
@@ -53,8 +59,128 @@
 // threads get 10ms to run before they use up their time slice and the scheduler is invoked
 #define THREAD_INITIAL_TIME_SLICE ZX_MSEC(10)
 
+// fair scheduler tunables.
+// the period over which every runnable thread on a cpu should get to run once
+#define FAIR_TARGET_LATENCY ZX_MSEC(12)
+// the shortest time slice handed out, regardless of how many threads are runnable
+#define FAIR_MIN_GRANULARITY ZX_USEC(750)
+// how far a running thread's virtual runtime may lead a woken thread's before it is preempted
+#define FAIR_WAKEUP_GRANULARITY ZX_MSEC(1)
+// how far behind the runnable threads a thread that slept may be placed
+#define FAIR_SLEEPER_CREDIT (FAIR_TARGET_LATENCY / 2)
+// the weight of a DEFAULT_PRIORITY thread, whose virtual runtime advances at wall clock rate
+#define FAIR_NOMINAL_WEIGHT 1024
+
+// deadline threads are admitted to a cpu only while the densities (capacity over relative
+// deadline) of those on it add up to no more than this fraction of SCHED_DEADLINE_SCALE,
+// which keeps their reservations feasible and leaves some of the cpu to fair threads
+#define SCHED_DEADLINE_SCALE (1u << 20)
+#define SCHED_DEADLINE_MAX_DENSITY (SCHED_DEADLINE_SCALE / 10 * 9)
+
+// how often a busy cpu checks whether a less loaded cpu nearby could take some of its threads
+#define SCHED_BALANCE_INTERVAL ZX_MSEC(20)
+
+// the most levels of cpu grouping tracked, from smt siblings up to the whole system
+#define SCHED_MAX_DOMAIN_LEVELS 6
+
+// threads pulled by a cpu that ran out of work
+KCOUNTER(sched_steal_count, "kernel.sched.steal");
+// threads pushed by the periodic load balancer
+KCOUNTER(sched_balance_count, "kernel.sched.balance");
+// threads queued on a different cpu than the one they last ran on, for any reason
+KCOUNTER(sched_migrate_count, "kernel.sched.migrate");
+
+// the groups of cpus that share progressively less with a cpu, nearest first: its smt
+// siblings, then each enclosing cache, cluster or numa region from the system topology.
+// the last level always covers every cpu. protected by thread_lock once the secondary
+// cpus are running.
+struct sched_domains {
+    cpu_mask_t level[SCHED_MAX_DOMAIN_LEVELS];
+    uint count;
+
+    // the cpus sharing a core with this one, including itself, and the cpus sharing its
+    // last level cache
+    cpu_mask_t smt;
+    cpu_mask_t llc;
+};
+static sched_domains cpu_domains[SMP_MAX_CPUS];
+
+// selected at boot with kernel.scheduler=fair, and never changed afterwards
+static bool fair_sched = false;
+
+// the weight of a thread at each priority. each level is worth ~1.25x the one below it,
+// so two cpu bound threads a level apart split a cpu roughly 55/45.
+static const uint32_t fair_weights[NUM_PRIORITIES] = {
+    29, 36, 45, 56, 70, 88, 110, 137,
+    172, 215, 268, 336, 419, 524, 655, 819,
+    1024, 1280, 1600, 2000, 2500, 3125, 3906, 4883,
+    6104, 7629, 9537, 11921, 14901, 18626, 23283, 29104,
+};
+static_assert(fair_weights[DEFAULT_PRIORITY] == FAIR_NOMINAL_WEIGHT, "");
+
+// the fair run queue of each cpu, a tree ordered by the key a thread was queued with and
+// then by the order threads were queued in, so that threads with equal keys stay fifo.
+struct FairKey {
+    zx_duration_t key;
+    uint64_t seq;
+};
+
+struct FairKeyTraits {
+    static FairKey GetKey(const thread_t& t) { return {t.fair_key, t.fair_seq}; }
+    static bool LessThan(const FairKey& a, const FairKey& b) {
+        return a.key < b.key || (a.key == b.key && a.seq < b.seq);
+    }
+    static bool EqualTo(const FairKey& a, const FairKey& b) {
+        return a.key == b.key && a.seq == b.seq;
+    }
+};
+
+using FairNodeState = fbl::WAVLTreeNodeState<thread_t*>;
+static_assert(sizeof(sched_fair_node_t) == sizeof(FairNodeState) &&
+                  alignof(sched_fair_node_t) == alignof(FairNodeState),
+              "sched_fair_node_t and fbl::WAVLTreeNodeState out of sync!");
+
+struct FairNodeTraits {
+    // a zeroed sched_fair_node_t is a node in no tree, so a freshly created thread is ready
+    static FairNodeState& node_state(thread_t& t) {
+        return *reinterpret_cast<FairNodeState*>(&t.fair_node);
+    }
+};
+
+using FairRunQueue = fbl::WAVLTree<FairKey, thread_t*, FairKeyTraits, FairNodeTraits>;
+static FairRunQueue fair_run_queues[SMP_MAX_CPUS];
+
+// hands out fair_seq values. protected by thread_lock.
+static uint64_t fair_next_seq;
+
 static bool local_migrate_if_needed(thread_t* curr_thread);
 
+bool sched_fair_enabled() {
+    return fair_sched;
+}
+
+static inline bool thread_is_deadline(const thread_t* t) {
+    return t->deadline_period != 0;
+}
+
+static inline bool thread_in_fair_queue(thread_t* t) {
+    return FairNodeTraits::node_state(*t).InContainer();
+}
+
+// whether a thread is sitting in any of the run queues
+static inline bool thread_queued(thread_t* t) {
+    return list_in_list(&t->queue_node) || thread_in_fair_queue(t);
+}
+
+// deadline threads are only ever moved to the cpu they were admitted to
+static inline bool thread_may_move_to(const thread_t* t, cpu_num_t cpu) {
+    return !thread_is_deadline(t) || t->deadline_cpu == cpu;
+}
+
+static uint32_t deadline_density(zx_duration_t capacity, zx_duration_t deadline) {
+    return static_cast<uint32_t>(capacity * SCHED_DEADLINE_SCALE / deadline);
+}
+
 // compute the effective priority of a thread
 static void compute_effec_priority(thread_t* t) {
     int ep = t->base_priority + t->priority_boost;
@@ -69,7 +195,7 @@ static void compute_effec_priority(thread_t* t) {
 
 // boost the priority of the thread by +1
 static void boost_thread(thread_t* t) {
-    if (NO_BOOST) {
+    if (NO_BOOST || fair_sched) {
         return;
     }
 
@@ -88,7 +214,7 @@ static void boost_thread(thread_t* t) {
 // If deboosting because the thread is using up all of its time slice,
 // then allow the boost to go negative, otherwise only deboost to 0.
 static void deboost_thread(thread_t* t, bool quantum_expiration) {
-    if (NO_BOOST) {
+    if (NO_BOOST || fair_sched) {
         return;
     }
 
@@ -152,8 +278,52 @@ static cpu_mask_t rand_cpu(cpu_mask_t mask) {
     }
 }
 
+// pick a cpu out of |idle_mask| for a thread being woken up by the current cpu.
+//
+// stay as close to the waker as possible, starting with the cpus sharing its last level
+// cache, so whatever it just handed the thread is still nearby. within that, prefer the
+// cpu the thread last ran on, then cpus whose smt siblings are idle too so the thread
+// gets a core to itself while there are whole cores sitting unused.
+static cpu_mask_t pick_idle_cpu(const thread_t* t, cpu_mask_t idle_mask) TA_REQ(thread_lock) {
+    const sched_domains& waker = cpu_domains[arch_curr_cpu_num()];
+    cpu_mask_t last_ran_cpu_mask = cpu_num_to_mask(t->last_cpu);
+    cpu_mask_t busy_mask = mp_get_active_mask() & ~idle_mask;
+
+    for (uint level = 0; level <= waker.count; level++) {
+        // the llc goes first, then the domains, the last of which covers every cpu
+        cpu_mask_t candidates = idle_mask & (level == 0 ? waker.llc : waker.level[level - 1]);
+        if (candidates == 0) {
+            continue;
+        }
+
+        if (last_ran_cpu_mask & candidates) {
+            return last_ran_cpu_mask;
+        }
+
+        cpu_mask_t idle_cores = 0;
+        for (cpu_mask_t m = candidates; m; m &= m - 1) {
+            cpu_num_t cpu = lowest_cpu_set(m);
+            if ((cpu_domains[cpu].smt & busy_mask) == 0) {
+                idle_cores |= cpu_num_to_mask(cpu);
+            }
+        }
+        return rand_cpu(idle_cores ? idle_cores : candidates);
+    }
+
+    return rand_cpu(idle_mask);
+}
+
 // find a cpu to wake up
 static cpu_mask_t find_cpu_mask(thread_t* t) TA_REQ(thread_lock) {
+    // a deadline thread goes back to the cpu which accounts for its reservation
+    if (thread_is_deadline(t)) {
+        cpu_mask_t home = cpu_num_to_mask(t->deadline_cpu) & t->cpu_affinity &
+                          mp_get_active_mask();
+        if (home) {
+            return home;
+        }
+    }
+
     // get the last cpu the thread ran on
     cpu_mask_t last_ran_cpu_mask = cpu_num_to_mask(t->last_cpu);
 
@@ -176,15 +346,9 @@ static cpu_mask_t find_cpu_mask(thread_t* t) TA_REQ(thread_lock) {
             return curr_cpu_mask;
         }
 
-        if (last_ran_cpu_mask & idle_cpu_mask) {
-            DEBUG_ASSERT(last_ran_cpu_mask & mp_get_active_mask());
-            // the last core it ran on is idle and isn't the current cpu
-            return last_ran_cpu_mask;
-        }
-
         // pick an idle_cpu
         DEBUG_ASSERT((idle_cpu_mask & mp_get_active_mask()) == idle_cpu_mask);
-        return rand_cpu(idle_cpu_mask);
+        return pick_idle_cpu(t, idle_cpu_mask);
     }
 
     // no idle cpus in our affinity mask
@@ -212,22 +376,139 @@ static cpu_mask_t find_cpu_mask(thread_t* t) TA_REQ(thread_lock) {
     return mask;
 }
 
+// fair scheduler run queue manipulation
+
+// bring the virtual runtime and deadline budget of a thread that has been running
+// up to date
+static void fair_account(thread_t* t, zx_time_t now) TA_REQ(thread_lock) {
+    zx_duration_t delta = zx_time_sub_time(now, t->last_accounted);
+    if (delta <= 0) {
+        return;
+    }
+
+    t->vruntime += delta * FAIR_NOMINAL_WEIGHT / fair_weights[t->effec_priority];
+    if (thread_is_deadline(t)) {
+        t->deadline_budget -= delta;
+    }
+    t->last_accounted = now;
+}
+
+// start a new period for a deadline thread if the current one is over. returns true if
+// the thread still has budget left before its deadline; if not, it runs as a regular
+// fair thread until its next period starts.
+static bool deadline_replenish(thread_t* t, zx_time_t now) TA_REQ(thread_lock) {
+    zx_time_t next_period = t->deadline_abs - t->deadline_relative + t->deadline_period;
+    if (now >= next_period) {
+        t->deadline_abs = zx_time_add_duration(now, t->deadline_relative);
+        t->deadline_budget = t->deadline_capacity;
+    }
+    return t->deadline_budget > 0 && now < t->deadline_abs;
+}
+
+// insert a thread into a run queue sorted by |key|, behind any threads with the same key
+template <typename KeyFn>
+static void insert_sorted(struct list_node* queue, thread_t* t, zx_time_t key, KeyFn key_of) {
+    thread_t* entry;
+    list_for_every_entry (queue, entry, thread_t, queue_node) {
+        if (key < key_of(entry)) {
+            list_add_before(&entry->queue_node, &t->queue_node);
+            return;
+        }
+    }
+    list_add_tail(queue, &t->queue_node);
+}
+
+// place a thread that is waking up or moving between cpus among the runnable threads
+// on |cpu|: keep a long sleeper from monopolizing the cpu and a thread from another
+// cpu from starving here.
+static void fair_place(cpu_num_t cpu, thread_t* t) TA_REQ(thread_lock) {
+    const struct percpu* c = &percpu[cpu];
+    zx_duration_t floor = c->fair_min_vruntime - FAIR_SLEEPER_CREDIT;
+    zx_duration_t ceiling = c->fair_min_vruntime + FAIR_TARGET_LATENCY;
+    t->vruntime = MAX(MIN(t->vruntime, ceiling), floor);
+}
+
+static void fair_insert(cpu_num_t cpu, thread_t* t, bool has_slice) TA_REQ(thread_lock) {
+    struct percpu* c = &percpu[cpu];
+    zx_time_t now = current_time();
+    bool is_current = (t == get_current_thread());
+
+    if (is_current) {
+        fair_account(t, now);
+    }
+    if (!is_current || cpu != arch_curr_cpu_num()) {
+        fair_place(cpu, t);
+    }
+
+    if (thread_is_deadline(t) && deadline_replenish(t, now)) {
+        insert_sorted(&c->deadline_run_queue, t, t->deadline_abs,
+                      [](const thread_t* e) { return e->deadline_abs; });
+        return;
+    }
+
+    // let a preempted thread that still has time left lead a woken one by a little
+    // before it is switched out.
+    zx_duration_t key = t->vruntime;
+    if (is_current && has_slice) {
+        key -= FAIR_WAKEUP_GRANULARITY;
+    }
+    t->fair_key = key;
+    t->fair_seq = fair_next_seq++;
+    c->fair_weight_sum += fair_weights[t->effec_priority];
+    fair_run_queues[cpu].insert(t);
+}
+
+// the time slice for a thread that was just picked to run on |cpu|
+static zx_duration_t fair_time_slice(cpu_num_t cpu, const thread_t* t) TA_REQ(thread_lock) {
+    if (thread_is_deadline(t) && t->deadline_budget > 0) {
+        return t->deadline_budget;
+    }
+
+    // every runnable thread, including this one, should get a turn within the target
+    // latency, stretched once that would drop below the minimum granularity, and each
+    // gets a share of it in proportion to its weight. a heavy thread's share is capped at
+    // the target latency; its slow moving virtual runtime gets it picked again soon enough.
+    const struct percpu* c = &percpu[cpu];
+    zx_duration_t runnable = c->run_queue_len + 1;
+    zx_duration_t period = MAX(FAIR_TARGET_LATENCY, runnable * FAIR_MIN_GRANULARITY);
+    uint64_t weight = fair_weights[t->effec_priority];
+    zx_duration_t slice = static_cast<zx_duration_t>(
+        period * weight / (c->fair_weight_sum + weight));
+    return MIN(MAX(slice, FAIR_MIN_GRANULARITY), FAIR_TARGET_LATENCY);
+}
+
 // run queue manipulation
 static void insert_in_run_queue_head(cpu_num_t cpu, thread_t* t) TA_REQ(thread_lock) {
-    DEBUG_ASSERT(!list_in_list(&t->queue_node));
+    DEBUG_ASSERT(!thread_queued(t));
 
-    list_add_head(&percpu[cpu].run_queue[t->effec_priority], &t->queue_node);
-    percpu[cpu].run_queue_bitmap |= (1u << t->effec_priority);
+    if (!thread_is_idle(t)) {
+        percpu[cpu].run_queue_len++;
+    }
+
+    if (fair_sched && !thread_is_idle(t)) {
+        fair_insert(cpu, t, true);
+    } else {
+        list_add_head(&percpu[cpu].run_queue[t->effec_priority], &t->queue_node);
+        percpu[cpu].run_queue_bitmap |= (1u << t->effec_priority);
+    }
 
     // mark the cpu as busy since the run queue now has at least one item in it
     mp_set_cpu_busy(cpu);
 }
 
 static void insert_in_run_queue_tail(cpu_num_t cpu, thread_t* t) TA_REQ(thread_lock) {
-    DEBUG_ASSERT(!list_in_list(&t->queue_node));
+    DEBUG_ASSERT(!thread_queued(t));
 
-    list_add_tail(&percpu[cpu].run_queue[t->effec_priority], &t->queue_node);
-    percpu[cpu].run_queue_bitmap |= (1u << t->effec_priority);
+    if (!thread_is_idle(t)) {
+        percpu[cpu].run_queue_len++;
+    }
+
+    if (fair_sched && !thread_is_idle(t)) {
+        fair_insert(cpu, t, false);
+    } else {
+        list_add_tail(&percpu[cpu].run_queue[t->effec_priority], &t->queue_node);
+        percpu[cpu].run_queue_bitmap |= (1u << t->effec_priority);
+    }
 
     // mark the cpu as busy since the run queue now has at least one item in it
     mp_set_cpu_busy(cpu);
@@ -238,10 +519,25 @@ static void remove_from_run_queue(thread_t* t, int prio_queue) TA_REQ(thread_loc
     DEBUG_ASSERT(t->state == THREAD_READY);
     DEBUG_ASSERT(is_valid_cpu_num(t->curr_cpu));
 
-    list_delete(&t->queue_node);
+    struct percpu* c = &percpu[t->curr_cpu];
+    if (thread_in_fair_queue(t)) {
+        fair_run_queues[t->curr_cpu].erase(*t);
+        c->fair_weight_sum -= fair_weights[prio_queue];
+    } else {
+        list_delete(&t->queue_node);
+    }
+
+    if (!thread_is_idle(t)) {
+        DEBUG_ASSERT(c->run_queue_len > 0);
+        c->run_queue_len--;
+    }
+
+    // the fair and deadline queues have no bitmap to maintain
+    if (fair_sched && !thread_is_idle(t)) {
+        return;
+    }
 
     // clear the old cpu's queue bitmap if that was the last entry
-    struct percpu* c = &percpu[t->curr_cpu];
     if (list_is_empty(&c->run_queue[prio_queue])) {
         c->run_queue_bitmap &= ~(1u << prio_queue);
     }
@@ -253,11 +549,205 @@ static uint highest_run_queue(const struct percpu* c) TA_REQ(thread_lock) {
            (sizeof(c->run_queue_bitmap) * CHAR_BIT - NUM_PRIORITIES);
 }
 
+// pop the earliest deadline thread, or failing that the thread with the least
+// virtual runtime, off the passed in cpu's fair run queues.
+static thread_t* fair_get_top_thread(cpu_num_t cpu) TA_REQ(thread_lock) {
+    struct percpu* c = &percpu[cpu];
+
+    thread_t* newthread = list_remove_head_type(&c->deadline_run_queue, thread_t, queue_node);
+    if (newthread) {
+        return newthread;
+    }
+
+    FairRunQueue& queue = fair_run_queues[cpu];
+    newthread = queue.pop_front();
+    if (newthread) {
+        c->fair_weight_sum -= fair_weights[newthread->effec_priority];
+
+        // the queue is sorted, so the lesser of the picked thread and the next one in line
+        // is the smallest virtual runtime on this cpu
+        zx_duration_t vruntime = newthread->vruntime;
+        if (!queue.is_empty() && queue.front().vruntime < vruntime) {
+            vruntime = queue.front().vruntime;
+        }
+        c->fair_min_vruntime = MAX(c->fair_min_vruntime, vruntime);
+    }
+
+    return newthread;
+}
+
+// the number of threads running or waiting to run on a cpu
+static uint32_t cpu_load(cpu_num_t cpu) TA_REQ(thread_lock) {
+    // a cpu is only marked idle when it is running its idle thread with nothing queued
+    return percpu[cpu].run_queue_len + (mp_is_cpu_idle(cpu) ? 0 : 1);
+}
+
+// find a thread waiting on |victim| that is allowed to run on |cpu|, preferring the
+// ones that would have run soonest on |victim|.
+static thread_t* find_movable_thread(cpu_num_t victim, cpu_num_t cpu) TA_REQ(thread_lock) {
+    struct percpu* c = &percpu[victim];
+    cpu_mask_t cpu_mask = cpu_num_to_mask(cpu);
+    thread_t* t;
+
+    if (fair_sched) {
+        list_for_every_entry (&c->deadline_run_queue, t, thread_t, queue_node) {
+            if ((t->cpu_affinity & cpu_mask) && thread_may_move_to(t, cpu)) {
+                return t;
+            }
+        }
+        for (thread_t& queued : fair_run_queues[victim]) {
+            if ((queued.cpu_affinity & cpu_mask) && thread_may_move_to(&queued, cpu)) {
+                return &queued;
+            }
+        }
+        // only the idle thread lives in the priority queues in fair mode
+        return nullptr;
+    }
+
+    uint32_t bitmap = c->run_queue_bitmap;
+    while (bitmap) {
+        uint queue = static_cast<uint>(sizeof(bitmap) * CHAR_BIT - 1 - __builtin_clz(bitmap));
+        list_for_every_entry (&c->run_queue[queue], t, thread_t, queue_node) {
+            if (!thread_is_idle(t) && (t->cpu_affinity & cpu_mask)) {
+                return t;
+            }
+        }
+        bitmap &= ~(1u << queue);
+    }
+    return nullptr;
+}
+
+// move a thread waiting on another cpu over to |cpu|. the caller decides whether it
+// goes into the run queue or straight to running.
+static void move_thread(thread_t* t, cpu_num_t cpu) TA_REQ(thread_lock) {
+    DEBUG_ASSERT(t->cpu_affinity & cpu_num_to_mask(cpu));
+
+    remove_from_run_queue(t, t->effec_priority);
+    t->curr_cpu = cpu;
+    kcounter_add(sched_migrate_count, 1);
+}
+
+// |cpu| has run out of threads: pull the next thread in line off the busiest cpu that
+// has one that may run here, looking at the cpus that share the most with this one first.
+static thread_t* steal_thread(cpu_num_t cpu) TA_REQ(thread_lock) {
+    // a cpu on its way offline is draining its own queue, not taking on more
+    if (!mp_is_cpu_active(cpu)) {
+        return nullptr;
+    }
+
+    const sched_domains& domains = cpu_domains[cpu];
+    cpu_mask_t searched = cpu_num_to_mask(cpu);
+    for (uint level = 0; level < domains.count; level++) {
+        cpu_mask_t candidates = domains.level[level] & mp_get_active_mask() & ~searched;
+        searched |= candidates;
+
+        while (candidates) {
+            cpu_num_t victim = INVALID_CPU;
+            uint32_t most = 0;
+            for (cpu_mask_t m = candidates; m; m &= m - 1) {
+                cpu_num_t i = lowest_cpu_set(m);
+                if (percpu[i].run_queue_len > most) {
+                    most = percpu[i].run_queue_len;
+                    victim = i;
+                }
+            }
+            if (victim == INVALID_CPU) {
+                break;
+            }
+            candidates &= ~cpu_num_to_mask(victim);
+
+            thread_t* t = find_movable_thread(victim, cpu);
+            if (t) {
+                LOCAL_KTRACE2("sched_steal", victim, cpu);
+                move_thread(t, cpu);
+                if (fair_sched) {
+                    fair_place(cpu, t);
+                }
+                kcounter_add(sched_steal_count, 1);
+                return t;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// called periodically on a busy |cpu|: hand one waiting thread to the least loaded cpu
+// nearby if it has at least two fewer threads to run than this one, looking at the cpus
+// that share the most with this one first.
+static void balance_cpu(cpu_num_t cpu, zx_time_t now) TA_REQ(thread_lock) {
+    struct percpu* c = &percpu[cpu];
+    if (now < c->next_balance) {
+        return;
+    }
+    c->next_balance = zx_time_add_duration(now, SCHED_BALANCE_INTERVAL);
+
+    if (c->run_queue_len == 0) {
+        return;
+    }
+
+    uint32_t load = cpu_load(cpu);
+    const sched_domains& domains = cpu_domains[cpu];
+    for (uint level = 0; level < domains.count; level++) {
+        cpu_mask_t candidates = domains.level[level] & mp_get_active_mask() &
+                                ~cpu_num_to_mask(cpu);
+
+        cpu_num_t target = INVALID_CPU;
+        uint32_t least = load;
+        for (cpu_mask_t m = candidates; m; m &= m - 1) {
+            cpu_num_t i = lowest_cpu_set(m);
+            uint32_t l = cpu_load(i);
+            if (l < least) {
+                least = l;
+                target = i;
+            }
+        }
+        if (target == INVALID_CPU || load < least + 2) {
+            continue;
+        }
+
+        thread_t* t = find_movable_thread(cpu, target);
+        if (!t) {
+            continue;
+        }
+
+        LOCAL_KTRACE2("sched_balance", cpu, target);
+        move_thread(t, target);
+        insert_in_run_queue_tail(target, t);
+        kcounter_add(sched_balance_count, 1);
+        mp_reschedule(cpu_num_to_mask(target), 0);
+        return;
+    }
+}
+
 static thread_t* sched_get_top_thread(cpu_num_t cpu) TA_REQ(thread_lock) {
     // pop the head of the highest priority queue with any threads
     // queued up on the passed in cpu.
 
     struct percpu* c = &percpu[cpu];
+
+    // with nothing of our own to run, look for work queued up on other cpus
+    if (c->run_queue_len == 0) {
+        thread_t* newthread = steal_thread(cpu);
+        if (newthread) {
+            return newthread;
+        }
+    }
+
+    if (fair_sched) {
+        thread_t* newthread = fair_get_top_thread(cpu);
+        if (newthread) {
+            c->run_queue_len--;
+            DEBUG_ASSERT_MSG(newthread->cpu_affinity & cpu_num_to_mask(cpu),
+                             "thread %p name %s, aff %#x cpu %u\n", newthread, newthread->name,
+                             newthread->cpu_affinity, cpu);
+            DEBUG_ASSERT(newthread->curr_cpu == cpu);
+
+            LOCAL_KTRACE2("sched_get_top", (uint32_t)newthread->vruntime, newthread->base_priority);
+
+            return newthread;
+        }
+    }
+
     if (likely(c->run_queue_bitmap)) {
         uint highest_queue = highest_run_queue(c);
 
@@ -272,6 +762,9 @@ static thread_t* sched_get_top_thread(cpu_num_t cpu) TA_REQ(thread_lock) {
         if (list_is_empty(&c->run_queue[highest_queue])) {
             c->run_queue_bitmap &= ~(1u << highest_queue);
         }
+        if (!thread_is_idle(newthread)) {
+            c->run_queue_len--;
+        }
 
         LOCAL_KTRACE2("sched_get_top", newthread->priority_boost, newthread->base_priority);
 
@@ -289,6 +782,97 @@ void sched_init_thread(thread_t* t, int priority) {
     compute_effec_priority(t);
 }
 
+void sched_release_deadline(thread_t* t) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    if (thread_is_deadline(t)) {
+        percpu[t->deadline_cpu].deadline_density -=
+            deadline_density(t->deadline_capacity, t->deadline_relative);
+        t->deadline_period = 0;
+    }
+}
+
+zx_status_t sched_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t deadline,
+                               zx_duration_t period) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(period == 0 || (capacity > 0 && capacity < deadline && deadline <= period));
+
+    if (unlikely(t->state == THREAD_DEATH)) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    // admit the thread to the least reserved cpu it may run on which has room for it,
+    // counting its current reservation as given up
+    cpu_num_t home = INVALID_CPU;
+    uint32_t density = 0;
+    if (period != 0) {
+        density = deadline_density(capacity, deadline);
+        if (density > SCHED_DEADLINE_MAX_DENSITY) {
+            return ZX_ERR_NO_RESOURCES;
+        }
+        uint32_t least = SCHED_DEADLINE_MAX_DENSITY - density;
+        for (cpu_mask_t m = t->cpu_affinity & mp_get_active_mask(); m; m &= m - 1) {
+            cpu_num_t cpu = lowest_cpu_set(m);
+            uint32_t reserved = percpu[cpu].deadline_density;
+            if (thread_is_deadline(t) && t->deadline_cpu == cpu) {
+                reserved -= deadline_density(t->deadline_capacity, t->deadline_relative);
+            }
+            if (reserved <= least) {
+                least = reserved;
+                home = cpu;
+            }
+        }
+        if (home == INVALID_CPU) {
+            return ZX_ERR_NO_RESOURCES;
+        }
+    }
+
+    // pull a queued thread out while its parameters change, since they decide which
+    // queue it lives in
+    bool requeue = (t->state == THREAD_READY && thread_queued(t));
+    if (requeue) {
+        remove_from_run_queue(t, t->effec_priority);
+    }
+
+    sched_release_deadline(t);
+    t->deadline_capacity = capacity;
+    t->deadline_relative = deadline;
+    t->deadline_period = period;
+    if (period != 0) {
+        percpu[home].deadline_density += density;
+        t->deadline_cpu = home;
+    }
+
+    // start a fresh period the next time the thread is queued
+    t->deadline_abs = 0;
+    t->deadline_budget = 0;
+
+    cpu_mask_t accum_cpu_mask = 0;
+    bool local_resched = false;
+    if (requeue) {
+        if (period != 0 && t->curr_cpu != home) {
+            t->curr_cpu = home;
+            kcounter_add(sched_migrate_count, 1);
+        }
+        insert_in_run_queue_head(t->curr_cpu, t);
+    }
+    if (t->state == THREAD_READY || t->state == THREAD_RUNNING) {
+        if (t->curr_cpu == arch_curr_cpu_num()) {
+            local_resched = true;
+        } else {
+            accum_cpu_mask = cpu_num_to_mask(t->curr_cpu);
+        }
+    }
+
+    if (accum_cpu_mask) {
+        mp_reschedule(accum_cpu_mask, 0);
+    }
+    if (local_resched) {
+        sched_reschedule();
+    }
+    return ZX_OK;
+}
+
 void sched_block() {
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
@@ -320,6 +904,10 @@ static void find_cpu_and_insert(thread_t* t, bool* local_resched,
         *accum_cpu_mask |= cpu_num_to_mask(cpu_num);
     }
 
+    if (t->last_cpu != INVALID_CPU && t->last_cpu != cpu_num) {
+        kcounter_add(sched_migrate_count, 1);
+    }
+
     t->curr_cpu = cpu_num;
     if (t->remaining_time_slice > 0) {
         insert_in_run_queue_head(cpu_num, t);
@@ -408,6 +996,17 @@ void sched_yield() {
     current_thread->remaining_time_slice = 0;
     deboost_thread(current_thread, false);
 
+    if (fair_sched) {
+        // the fair queue is ordered by virtual runtime, so catch up with the last thread
+        // in line to go behind it
+        cpu_num_t cpu = arch_curr_cpu_num();
+        fair_account(current_thread, current_time());
+        const FairRunQueue& queue = fair_run_queues[cpu];
+        if (!queue.is_empty() && queue.back().vruntime > current_thread->vruntime) {
+            current_thread->vruntime = queue.back().vruntime;
+        }
+    }
+
     current_thread->state = THREAD_READY;
 
     if (local_migrate_if_needed(current_thread)) {
@@ -442,6 +1041,9 @@ void sched_preempt() {
             return;
         }
 
+        // the current thread is not queued yet, so it stays put
+        balance_cpu(curr_cpu, current_time());
+
         if (current_thread->remaining_time_slice > 0) {
             insert_in_run_queue_head(curr_cpu, current_thread);
         } else {
@@ -589,7 +1191,7 @@ void sched_migrate(thread_t* t) {
         }
 
         // it's sitting in a run queue somewhere, so pull it out of that one and find a new home
-        DEBUG_ASSERT_MSG(list_in_list(&t->queue_node), "thread %p name %s curr_cpu %u\n", t, t->name, t->curr_cpu);
+        DEBUG_ASSERT_MSG(thread_queued(t), "thread %p name %s curr_cpu %u\n", t, t->name, t->curr_cpu);
         remove_from_run_queue(t, t->effec_priority);
 
         find_cpu_and_insert(t, &local_resched, &accum_cpu_mask);
@@ -626,7 +1228,7 @@ static void sched_priority_changed(thread_t* t, int old_prio,
         break;
     case THREAD_READY:
         // it's sitting in a run queue somewhere, remove and add back to the proper queue on that cpu
-        DEBUG_ASSERT_MSG(list_in_list(&t->queue_node), "thread %p name %s curr_cpu %u\n", t, t->name, t->curr_cpu);
+        DEBUG_ASSERT_MSG(thread_queued(t), "thread %p name %s curr_cpu %u\n", t, t->name, t->curr_cpu);
         remove_from_run_queue(t, old_prio);
 
         // insert ourself into the new queue
@@ -819,8 +1421,20 @@ void sched_resched_internal() {
     oldthread->remaining_time_slice = zx_duration_sub_duration(
         oldthread->remaining_time_slice, MIN(old_runtime, oldthread->remaining_time_slice));
 
-    // set up quantum for the new thread if it was consumed
-    if (newthread->remaining_time_slice == 0) {
+    if (fair_sched) {
+        // the old thread is blocking or was already accounted for when it was queued
+        if (!thread_is_idle(oldthread)) {
+            fair_account(oldthread, now);
+        }
+
+        // the slice only bounds how long a thread runs before fairness is reevaluated,
+        // so hand out a fresh one every time
+        if (!thread_is_idle(newthread)) {
+            newthread->remaining_time_slice = fair_time_slice(cpu, newthread);
+        }
+        newthread->last_accounted = now;
+    } else if (newthread->remaining_time_slice == 0) {
+        // set up quantum for the new thread if it was consumed
         newthread->remaining_time_slice = THREAD_INITIAL_TIME_SLICE;
     }
 
@@ -901,8 +1515,105 @@ void sched_resched_internal() {
 
 void sched_init_early() {
     // initialize the run queues
-    for (unsigned int cpu = 0; cpu < SMP_MAX_CPUS; cpu++)
+    for (unsigned int cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
         for (unsigned int i = 0; i < NUM_PRIORITIES; i++) {
             list_initialize(&percpu[cpu].run_queue[i]);
         }
+        list_initialize(&percpu[cpu].deadline_run_queue);
+        percpu[cpu].fair_min_vruntime = 0;
+        percpu[cpu].fair_weight_sum = 0;
+        percpu[cpu].run_queue_len = 0;
+        percpu[cpu].next_balance = 0;
+
+        // until the topology is known every cpu is in one big domain
+        cpu_domains[cpu].level[0] = ~static_cast<cpu_mask_t>(0);
+        cpu_domains[cpu].count = 1;
+        cpu_domains[cpu].smt = cpu_num_to_mask(cpu);
+        cpu_domains[cpu].llc = ~static_cast<cpu_mask_t>(0);
+    }
+}
+
+// the logical ids of every processor at or below |node| in the topology
+static cpu_mask_t topology_node_cpus(const system_topology::Node* node) {
+    cpu_mask_t mask = 0;
+    if (node->entity_type == ZBI_TOPOLOGY_ENTITY_PROCESSOR) {
+        const zbi_topology_processor_t& processor = node->entity.processor;
+        for (uint i = 0; i < processor.logical_id_count; i++) {
+            mask |= cpu_num_to_mask(processor.logical_ids[i]);
+        }
+        return mask;
+    }
+    for (const system_topology::Node* child : node->children) {
+        mask |= topology_node_cpus(child);
+    }
+    return mask;
+}
+
+// build the scheduling domains from the system topology, which the platform sets up in
+// platform_init. the secondary cpus may already be scheduling by then, so the domains
+// are swapped in under the thread lock.
+static void sched_init_domains(uint level) {
+    const system_topology::Graph& topology = system_topology::GetSystemTopology();
+    if (topology.processor_count() == 0) {
+        // not every platform describes its topology, keep the one system wide domain
+        return;
+    }
+
+    static sched_domains domains[SMP_MAX_CPUS];
+    for (cpu_num_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        domains[cpu].level[0] = ~static_cast<cpu_mask_t>(0);
+        domains[cpu].count = 1;
+        domains[cpu].smt = cpu_num_to_mask(cpu);
+        domains[cpu].llc = ~static_cast<cpu_mask_t>(0);
+    }
+
+    for (const system_topology::Node* processor : topology.processors()) {
+        sched_domains d = {};
+        d.level[d.count++] = topology_node_cpus(processor);
+        for (const system_topology::Node* node = processor->parent;
+             node && d.count < SCHED_MAX_DOMAIN_LEVELS - 1; node = node->parent) {
+            cpu_mask_t mask = topology_node_cpus(node);
+            if (mask != d.level[d.count - 1]) {
+                d.level[d.count++] = mask;
+            }
+        }
+        d.level[d.count++] = ~static_cast<cpu_mask_t>(0);
+
+        // the last level cache is the outermost cache node above the processor. lacking
+        // any, assume the innermost cluster shares one, as is usual on arm.
+        d.smt = d.level[0];
+        cpu_mask_t cluster = 0;
+        for (const system_topology::Node* node = processor->parent; node; node = node->parent) {
+            if (node->entity_type == ZBI_TOPOLOGY_ENTITY_CACHE) {
+                d.llc = topology_node_cpus(node);
+            } else if (node->entity_type == ZBI_TOPOLOGY_ENTITY_CLUSTER && !cluster) {
+                cluster = topology_node_cpus(node);
+            }
+        }
+        if (!d.llc) {
+            d.llc = cluster ? cluster : ~static_cast<cpu_mask_t>(0);
+        }
+
+        const zbi_topology_processor_t& info = processor->entity.processor;
+        for (uint i = 0; i < info.logical_id_count; i++) {
+            if (info.logical_ids[i] < SMP_MAX_CPUS) {
+                domains[info.logical_ids[i]] = d;
+            }
+        }
+    }
+
+    Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+    memcpy(cpu_domains, domains, sizeof(cpu_domains));
+}
+LK_INIT_HOOK(sched_domains, &sched_init_domains, LK_INIT_LEVEL_PLATFORM);
+
+// the command line is not available when the run queues are set up, but no thread
+// has been queued yet by the time this runs.
+static void sched_init_mode(uint level) {
+    const char* mode = cmdline_get("kernel.scheduler");
+    if (mode && !strcmp(mode, "fair")) {
+        fair_sched = true;
+        dprintf(INFO, "sched: using the fair/deadline scheduler\n");
+    }
 }
+LK_INIT_HOOK(sched_mode, &sched_init_mode, LK_INIT_LEVEL_PLATFORM_EARLY);
@@ -488,6 +488,9 @@ __NO_RETURN static void thread_exit_locked(thread_t* current_thread,
     // reusing the stack before the function exits
     dpc_t free_dpc = DPC_INITIAL_VALUE;
 
+    // let another thread have this one's deadline reservation
+    sched_release_deadline(current_thread);
+
     // enter the dead state
     current_thread->state = THREAD_DEATH;
     current_thread->retcode = retcode;
@@ -1049,6 +1052,31 @@ void thread_set_priority(thread_t* t, int priority) {
     sched_change_priority(t, priority);
 }
 
+/**
+ * @brief Give a thread deadline scheduling parameters
+ *
+ * The thread is guaranteed |capacity| of runtime within |deadline| of the
+ * start of every |period|. A zero |period| turns it back into a regular
+ * thread. Only supported by the fair scheduler, which fails with
+ * ZX_ERR_NO_RESOURCES if no cpu the thread may run on has room for it.
+ */
+zx_status_t thread_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t deadline,
+                                zx_duration_t period) {
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+
+    if (!sched_fair_enabled()) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (period != 0 &&
+        (capacity <= 0 || capacity >= deadline || deadline > period || period >= ZX_SEC(1))) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+
+    return sched_set_deadline(t, capacity, deadline, period);
+}
+
 /**
  * @brief  Become an idle thread
  *
@@ -6,6 +6,12 @@
 
 #include <object/buffer_chain.h>
 
+#include <lib/counters.h>
+
+// Pages taken from and returned to the pmm for channel message buffers.
+KCOUNTER(buffer_chain_alloc_count, "kernel.channel.buffer.alloc");
+KCOUNTER(buffer_chain_free_count, "kernel.channel.buffer.free");
+
 // Makes a const void* look like a user_in_ptr<const void>.
 //
 // Sometimes we need to copy data from kernel space. KernelPtrAdapter allows us to implement the
@@ -32,3 +38,27 @@ zx_status_t BufferChain::CopyInKernel(const void* src, size_t dst_offset, size_t
 
 template zx_status_t BufferChain::CopyInCommon(user_in_ptr<const void> src, size_t dst_offset,
                                                size_t size);
+
+// static
+zx_status_t BufferChain::AllocPages(size_t count, list_node* pages) {
+    for (size_t i = 0; i < count; i++) {
+        vm_page_t* page;
+        zx_status_t status = pmm_alloc_page(0, &page);
+        if (unlikely(status != ZX_OK)) {
+            FreePages(pages);
+            return status;
+        }
+        list_add_tail(pages, &page->queue_node);
+        kcounter_add(buffer_chain_alloc_count, 1);
+    }
+    return ZX_OK;
+}
+
+// static
+void BufferChain::FreePages(list_node* pages) {
+    vm_page_t* page;
+    while ((page = list_remove_head_type(pages, vm_page_t, queue_node)) != nullptr) {
+        pmm_free_page(page);
+        kcounter_add(buffer_chain_free_count, 1);
+    }
+}
@@ -201,6 +201,51 @@ zx_status_t ChannelDispatcher::Read(zx_koid_t owner,
     return rv;
 }
 
+zx_status_t ChannelDispatcher::ReadMany(zx_koid_t owner,
+                                        uint32_t* msg_sizes,
+                                        uint32_t* msg_handle_counts,
+                                        MessagePacketPtr* msgs,
+                                        size_t max_msgs,
+                                        size_t* actual_msgs) {
+    canary_.Assert();
+
+    DEBUG_ASSERT(max_msgs > 0u);
+    *actual_msgs = 0u;
+
+    Guard<fbl::Mutex> guard{get_lock()};
+
+    if (owner != owner_)
+        return ZX_ERR_BAD_HANDLE;
+
+    if (messages_.is_empty())
+        return peer_ ? ZX_ERR_SHOULD_WAIT : ZX_ERR_PEER_CLOSED;
+
+    size_t count = 0u;
+    while (count < max_msgs && !messages_.is_empty()) {
+        uint32_t size = messages_.front().data_size();
+        uint32_t handle_count = messages_.front().num_handles();
+        if (size > msg_sizes[count] || handle_count > msg_handle_counts[count]) {
+            if (count == 0u) {
+                msg_sizes[0] = size;
+                msg_handle_counts[0] = handle_count;
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            }
+            break;
+        }
+        msg_sizes[count] = size;
+        msg_handle_counts[count] = handle_count;
+        msgs[count] = messages_.pop_front();
+        message_count_--;
+        count++;
+    }
+
+    if (messages_.is_empty())
+        UpdateStateLocked(ZX_CHANNEL_READABLE, 0u);
+
+    *actual_msgs = count;
+    return ZX_OK;
+}
+
 zx_status_t ChannelDispatcher::Write(zx_koid_t owner, MessagePacketPtr msg) {
     canary_.Assert();
 
@@ -222,6 +267,30 @@ zx_status_t ChannelDispatcher::Write(zx_koid_t owner, MessagePacketPtr msg) {
     return ZX_OK;
 }
 
+zx_status_t ChannelDispatcher::WriteMany(zx_koid_t owner, MessagePacketPtr* msgs,
+                                         size_t count) {
+    canary_.Assert();
+
+    AutoReschedDisable resched_disable; // Must come before the lock guard.
+    resched_disable.Disable();
+    Guard<fbl::Mutex> guard{get_lock()};
+
+    // See Write() for an explanation of this test.
+    if (owner != owner_)
+        return ZX_ERR_BAD_HANDLE;
+
+    if (!peer_)
+        return ZX_ERR_PEER_CLOSED;
+
+    // Only the first message changes the peer's signals, so any waiter is woken
+    // once for the whole batch.
+    for (size_t i = 0; i < count; i++) {
+        peer_->WriteSelf(ktl::move(msgs[i]));
+    }
+
+    return ZX_OK;
+}
+
 zx_status_t ChannelDispatcher::Call(zx_koid_t owner,
                                     MessagePacketPtr msg,
                                     zx_time_t deadline, MessagePacketPtr* reply) {
@@ -218,7 +218,7 @@ static const char* VmoRightsToString(uint32_t rights, char str[kRightsStrLen]) {
 // If |handles| is true, the dumped objects are expected to have handle info.
 static void PrintVmoDumpHeader(bool handles) {
     printf(
-        "%s koid parent #chld #map #shr    size   alloc name\n",
+        "%s koid parent dpth #chld #map #shr    size   alloc name\n",
         handles ? "      handle rights " : "           -      - ");
 }
 
@@ -274,6 +274,7 @@ static void DumpVmObject(
            "%6s " // rights
            "%5" PRIu64 " " // koid
            "%6s " // clone parent koid
+           "%4" PRIu32 " " // clone chain depth
            "%5" PRIu32 " " // number of children
            "%4" PRIu32 " " // map count
            "%4" PRIu32 " " // share count
@@ -284,6 +285,7 @@ static void DumpVmObject(
            rights_str,
            koid,
            clone_str,
+           vmo.clone_depth(),
            vmo.num_children(),
            vmo.num_mappings(),
            vmo.share_count(),
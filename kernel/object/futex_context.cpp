@@ -23,7 +23,19 @@ FutexContext::~FutexContext() {
 
     // All of the threads should have removed themselves from wait queues
     // by the time the process has exited.
-    DEBUG_ASSERT(futex_table_.is_empty());
+#if LK_DEBUGLEVEL > 0
+    for (auto& bucket : buckets_) {
+        Guard<fbl::Mutex> guard{&bucket.lock};
+        DEBUG_ASSERT(bucket.futex_table.is_empty());
+    }
+#endif
+}
+
+FutexContext::Bucket* FutexContext::GetBucket(uintptr_t futex_key) {
+    // Futexes are often packed next to each other, for example in an array of
+    // mutexes, so mix all the bits of the address rather than just the low ones.
+    uint64_t hash = static_cast<uint64_t>(futex_key >> 2) * 0x9e3779b97f4a7c15ull;
+    return &buckets_[hash >> (64 - kNumBucketsShift)];
 }
 
 zx_status_t FutexContext::FutexWait(user_in_ptr<const zx_futex_t> value_ptr,
@@ -47,7 +59,8 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const zx_futex_t> value_ptr,
     // If a FutexWake() operation could occur between them, a userland mutex
     // operation built on top of futexes would have a race condition that
     // could miss wakeups.
-    Guard<fbl::Mutex> guard{&lock_};
+    Bucket* bucket = GetBucket(futex_key);
+    Guard<fbl::Mutex> guard{&bucket->lock};
 
     int value;
     zx_status_t result = value_ptr.copy_from_user(&value);
@@ -62,9 +75,9 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const zx_futex_t> value_ptr,
     node.set_hash_key(futex_key);
     node.SetAsSingletonList();
 
-    QueueNodesLocked(&node);
+    QueueNodesLocked(bucket, &node);
 
-    // Block current thread.  This releases lock_ and does not reacquire it.
+    // Block current thread.  This releases the bucket's lock and does not reacquire it.
     result = node.BlockThread(guard.take(), deadline);
     if (result == ZX_OK) {
         DEBUG_ASSERT(!node.IsInQueue());
@@ -78,8 +91,7 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const zx_futex_t> value_ptr,
     //
     // We need to ensure that the thread's node is removed from the wait
     // queue, because FutexWake() probably didn't do that.
-    Guard<fbl::Mutex> guard2{&lock_};
-    if (UnqueueNodeLocked(&node)) {
+    if (UnqueueNode(&node)) {
         return result;
     }
     // The current thread was not found on the wait queue.  This means
@@ -117,11 +129,12 @@ zx_status_t FutexContext::FutexWake(user_in_ptr<const zx_futex_t> value_ptr,
     if (futex_key % sizeof(int))
         return ZX_ERR_INVALID_ARGS;
 
+    Bucket* bucket = GetBucket(futex_key);
     AutoReschedDisable resched_disable; // Must come before the Guard.
     resched_disable.Disable();
-    Guard<fbl::Mutex> guard{&lock_};
+    Guard<fbl::Mutex> guard{&bucket->lock};
 
-    FutexNode* node = futex_table_.erase(futex_key);
+    FutexNode* node = bucket->futex_table.erase(futex_key);
     if (!node) {
         // nothing blocked on this futex if we can't find it
         return ZX_OK;
@@ -133,7 +146,7 @@ zx_status_t FutexContext::FutexWake(user_in_ptr<const zx_futex_t> value_ptr,
 
     if (remaining_waiters) {
         DEBUG_ASSERT(remaining_waiters->GetKey() == futex_key);
-        futex_table_.insert(remaining_waiters);
+        bucket->futex_table.insert(remaining_waiters);
     }
 
     return ZX_OK;
@@ -159,24 +172,47 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const zx_futex_t> wake_ptr,
         return ZX_ERR_INVALID_ARGS;
     }
 
+    uintptr_t wake_key = reinterpret_cast<uintptr_t>(wake_ptr.get());
+    uintptr_t requeue_key = reinterpret_cast<uintptr_t>(requeue_ptr.get());
+    if (wake_key == requeue_key) return ZX_ERR_INVALID_ARGS;
+    if (wake_key % sizeof(int) || requeue_key % sizeof(int))
+        return ZX_ERR_INVALID_ARGS;
+
+    Bucket* wake_bucket = GetBucket(wake_key);
+    Bucket* requeue_bucket = GetBucket(requeue_key);
+
     AutoReschedDisable resched_disable; // Must come before the Guard.
-    Guard<fbl::Mutex> guard{&lock_};
+    if (wake_bucket == requeue_bucket) {
+        Guard<fbl::Mutex> guard{&wake_bucket->lock};
+        return FutexRequeueLocked(wake_bucket, wake_key, wake_count, current_value, wake_ptr,
+                                  requeue_bucket, requeue_key, requeue_count, &resched_disable);
+    }
+    GuardMultiple<2, fbl::Mutex> guard{&wake_bucket->lock, &requeue_bucket->lock};
+    return FutexRequeueLocked(wake_bucket, wake_key, wake_count, current_value, wake_ptr,
+                              requeue_bucket, requeue_key, requeue_count, &resched_disable);
+}
+
+// The thread safety analysis cannot tell that the callers hold both locks, one
+// of them possibly twice.
+zx_status_t FutexContext::FutexRequeueLocked(Bucket* wake_bucket, uintptr_t wake_key,
+                                             uint32_t wake_count, zx_futex_t current_value,
+                                             user_in_ptr<const zx_futex_t> wake_ptr,
+                                             Bucket* requeue_bucket, uintptr_t requeue_key,
+                                             uint32_t requeue_count,
+                                             AutoReschedDisable* resched_disable)
+    TA_NO_THREAD_SAFETY_ANALYSIS {
+    DEBUG_ASSERT(wake_bucket->lock.lock().IsHeld());
+    DEBUG_ASSERT(requeue_bucket->lock.lock().IsHeld());
 
     int value;
     zx_status_t result = wake_ptr.copy_from_user(&value);
     if (result != ZX_OK) return result;
     if (value != current_value) return ZX_ERR_BAD_STATE;
 
-    uintptr_t wake_key = reinterpret_cast<uintptr_t>(wake_ptr.get());
-    uintptr_t requeue_key = reinterpret_cast<uintptr_t>(requeue_ptr.get());
-    if (wake_key == requeue_key) return ZX_ERR_INVALID_ARGS;
-    if (wake_key % sizeof(int) || requeue_key % sizeof(int))
-        return ZX_ERR_INVALID_ARGS;
-
     // This must happen before RemoveFromHead() calls set_hash_key() on
-    // nodes below, because operations on futex_table_ look at the GetKey
+    // nodes below, because operations on futex_table look at the GetKey
     // field of the list head nodes for wake_key and requeue_key.
-    FutexNode* node = futex_table_.erase(wake_key);
+    FutexNode* node = wake_bucket->futex_table.erase(wake_key);
     if (!node) {
         // nothing blocked on this futex if we can't find it
         return ZX_OK;
@@ -184,7 +220,7 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const zx_futex_t> wake_ptr,
 
     // This must come before WakeThreads() to be useful, but we want to
     // avoid doing it before copy_from_user() in case that faults.
-    resched_disable.Disable();
+    resched_disable->Disable();
 
     if (wake_count > 0) {
         node = FutexNode::WakeThreads(node, wake_count, wake_key);
@@ -200,14 +236,14 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const zx_futex_t> wake_ptr,
 
             // now requeue our nodes to requeue_ptr mutex
             DEBUG_ASSERT(requeue_head->GetKey() == requeue_key);
-            QueueNodesLocked(requeue_head);
+            QueueNodesLocked(requeue_bucket, requeue_head);
         }
     }
 
     // add any remaining nodes back to wake_key futex
     if (node != nullptr) {
         DEBUG_ASSERT(node->GetKey() == wake_key);
-        futex_table_.insert(node);
+        wake_bucket->futex_table.insert(node);
     }
 
     return ZX_OK;
@@ -218,8 +254,8 @@ zx_status_t FutexContext::FutexGetOwner(user_in_ptr<const zx_futex_t> wake_ptr,
     return koid.copy_to_user(ZX_KOID_INVALID);
 }
 
-void FutexContext::QueueNodesLocked(FutexNode* head) {
-    DEBUG_ASSERT(lock_.lock().IsHeld());
+void FutexContext::QueueNodesLocked(Bucket* bucket, FutexNode* head) {
+    DEBUG_ASSERT(bucket->lock.lock().IsHeld());
 
     FutexNode::HashTable::iterator iter;
 
@@ -227,29 +263,37 @@ void FutexContext::QueueNodesLocked(FutexNode* head) {
     // succeeds, then the current thread is first to block on this futex and we
     // are finished.  If the insert fails, then there is already a thread
     // waiting on this futex.  Add ourselves to that thread's list.
-    if (!futex_table_.insert_or_find(head, &iter))
+    if (!bucket->futex_table.insert_or_find(head, &iter))
         iter->AppendList(head);
 }
 
 // This attempts to unqueue a thread (which may or may not be waiting on a
 // futex), given its FutexNode.  This returns whether the FutexNode was
 // found and removed from a futex wait queue.
-bool FutexContext::UnqueueNodeLocked(FutexNode* node) {
-    DEBUG_ASSERT(lock_.lock().IsHeld());
-
-    if (!node->IsInQueue())
-        return false;
-
+bool FutexContext::UnqueueNode(FutexNode* node) {
     // Note: When UnqueueNode() is called from FutexWait(), it might be
     // tempting to reuse the futex key that was passed to FutexWait().
     // However, that could be out of date if the thread was requeued by
     // FutexRequeue(), so we need to re-get the hash table key here.
-    uintptr_t futex_key = node->GetKey();
-
-    FutexNode* old_head = futex_table_.erase(futex_key);
-    DEBUG_ASSERT(old_head);
-    FutexNode* new_head = FutexNode::RemoveNodeFromList(old_head, node);
-    if (new_head)
-        futex_table_.insert(new_head);
-    return true;
+    //
+    // FutexRequeue() changes the key while holding the locks of both the
+    // old and the new key's buckets, so the key is only stable once the
+    // lock of its bucket is held. Retry until that is the case.
+    for (;;) {
+        uintptr_t futex_key = node->GetKey();
+        Bucket* bucket = GetBucket(futex_key);
+        Guard<fbl::Mutex> guard{&bucket->lock};
+        if (node->GetKey() != futex_key)
+            continue;
+
+        if (!node->IsInQueue())
+            return false;
+
+        FutexNode* old_head = bucket->futex_table.erase(futex_key);
+        DEBUG_ASSERT(old_head);
+        FutexNode* new_head = FutexNode::RemoveNodeFromList(old_head, node);
+        if (new_head)
+            bucket->futex_table.insert(new_head);
+        return true;
+    }
 }
@@ -25,6 +25,8 @@
 #include <object/port_dispatcher.h>
 #include <object/process_dispatcher.h>
 
+#include <vm/vm_object_paged.h>
+
 #include <fbl/function.h>
 
 #include <zircon/types.h>
@@ -41,6 +43,14 @@ fbl::RefPtr<JobDispatcher> GetRootJobDispatcher() {
 static void oom_lowmem(size_t shortfall_bytes) {
     printf("OOM: oom_lowmem(shortfall_bytes=%zu) called\n", shortfall_bytes);
 
+    // Cached pages that a pager can hand back are cheaper to lose than a job.
+    const size_t shortfall_pages = ROUNDUP_PAGE_SIZE(shortfall_bytes) / PAGE_SIZE;
+    const size_t evicted = VmObjectPaged::ReclaimPages(shortfall_pages);
+    if (evicted >= shortfall_pages) {
+        printf("OOM: evicted %zu pager-backed pages\n", evicted);
+        return;
+    }
+
     bool found = false;
     JobDispatcher::ForEachJob([&found](JobDispatcher* job) {
         if (job->get_kill_on_oom()) {
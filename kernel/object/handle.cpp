@@ -7,8 +7,11 @@
 #include <object/handle.h>
 
 #include <object/dispatcher.h>
+#include <arch/ops.h>
 #include <fbl/arena.h>
 #include <fbl/mutex.h>
+#include <kernel/align.h>
+#include <kernel/thread.h>
 #include <lib/counters.h>
 #include <pow2.h>
 
@@ -26,6 +29,18 @@ KCOUNTER(handle_count_duped, "kernel.handles.duped");
 KCOUNTER(handle_count_live, "kernel.handles.live");
 KCOUNTER(handle_count_max_live, "kernel.handles.max_live");
 
+// The number of LookupGuards in progress, spread out per cpu so that
+// lookups from different cpus do not contend on a cache line. A guard
+// keeps preemption disabled, so it runs to completion on the cpu whose
+// slot it took.
+struct LookupCount {
+    fbl::atomic<uint32_t> count;
+} __CPU_ALIGN;
+LookupCount lookup_counts[SMP_MAX_CPUS];
+
+// The number of times WaitForLookups() polls a count before yielding.
+constexpr uint kLookupSpinCount = 64;
+
 // Masks for building a Handle's base_value, which ProcessDispatcher
 // uses to create zx_handle_t values.
 //
@@ -58,7 +73,7 @@ void Handle::Init() TA_NO_THREAD_SAFETY_ANALYSIS {
 }
 
 void Handle::set_process_id(zx_koid_t pid) {
-    process_id_.store(pid, fbl::memory_order_relaxed);
+    process_id_.store(pid, fbl::memory_order_release);
     dispatcher_->set_owner(pid);
 }
 
@@ -179,12 +194,54 @@ void Handle::TearDown() TA_EXCL(ArenaLock::Get()) {
     DEBUG_ASSERT(process_id() == 0);
 }
 
+Handle::LookupGuard::LookupGuard() {
+    thread_preempt_disable();
+    slot_ = arch_curr_cpu_num();
+    lookup_counts[slot_].count.fetch_add(1, fbl::memory_order_relaxed);
+    // Pairs with the fence in WaitForLookups(): either the deleting thread
+    // sees this guard, or the lookup sees the handle's cleared process id.
+    fbl::atomic_thread_fence(fbl::memory_order_seq_cst);
+}
+
+Handle::LookupGuard::~LookupGuard() {
+    lookup_counts[slot_].count.fetch_sub(1, fbl::memory_order_release);
+    thread_preempt_reenable();
+}
+
+void Handle::WaitForLookups() {
+    fbl::atomic_thread_fence(fbl::memory_order_seq_cst);
+
+    // Guards that start from here on can no longer see this handle as
+    // belonging to any process, so it is enough to see each count drop to
+    // zero once. Guards cannot be preempted, so the ones in progress are
+    // running and soon done; if one is not, give up the cpu rather than
+    // spin through the rest of the time slice.
+    for (uint i = 0; i < arch_max_num_cpus(); i++) {
+        uint spins = 0;
+        while (lookup_counts[i].count.load(fbl::memory_order_acquire) != 0) {
+            if (++spins < kLookupSpinCount) {
+                arch_spinloop_pause();
+            } else {
+                spins = 0;
+                thread_yield();
+            }
+        }
+    }
+}
+
 void Handle::Delete() {
     fbl::RefPtr<Dispatcher> disp = dispatcher();
 
     if (disp->is_waitable())
         disp->Cancel(this);
 
+    // A lock-free lookup may have found this handle just before it was
+    // removed from its process. Handles made by Dup() start out with the
+    // process id of their source, so clear it here in case this one never
+    // made it into a process.
+    process_id_.store(ZX_KOID_INVALID, fbl::memory_order_relaxed);
+    WaitForLookups();
+
     TearDown();
 
     bool zero_handles = false;
@@ -203,12 +260,11 @@ void Handle::Delete() {
 }
 
 Handle* Handle::FromU32(uint32_t value) TA_NO_THREAD_SAFETY_ANALYSIS {
+    // The bounds of the arena are fixed by Init(), so checking them does
+    // not need ArenaLock. This is on the path of every handle lookup.
     uintptr_t handle_addr = IndexToHandle(value & kHandleIndexMask);
-    {
-        Guard<fbl::Mutex> guard{ArenaLock::Get()};
-        if (unlikely(!arena_.in_range(handle_addr)))
-            return nullptr;
-    }
+    if (unlikely(!arena_.in_range(handle_addr)))
+        return nullptr;
     auto handle = reinterpret_cast<Handle*>(handle_addr);
     return likely(handle->base_value() == value) ? handle : nullptr;
 }
@@ -93,7 +93,7 @@ public:
 
         // Allocate a list of pages.
         list_node pages = LIST_INITIAL_VALUE(pages);
-        zx_status_t status = pmm_alloc_pages(num_buffers, 0, &pages);
+        zx_status_t status = AllocPages(num_buffers, &pages);
         if (unlikely(status != ZX_OK)) {
             return nullptr;
         }
@@ -129,7 +129,7 @@ public:
             BufferChain::Buffer* buf = buffers.pop_front();
             buf->Buffer::~Buffer();
         }
-        pmm_free(&pages);
+        FreePages(&pages);
     }
 
     // Copies |size| bytes from |src| to this chain starting at offset |dst_offset|.
@@ -181,6 +181,13 @@ private:
         DEBUG_ASSERT(list_is_empty(&pages_));
     }
 
+    // Allocates |count| pages onto |pages| one at a time, since single pages come out of
+    // the PMM's per cpu caches, while pmm_alloc_pages() always takes the PMM's lock.
+    static zx_status_t AllocPages(size_t count, list_node* pages);
+
+    // Frees |pages| one at a time into the PMM's per cpu caches, for the same reason.
+    static void FreePages(list_node* pages);
+
     // |PTR_IN| is a user_in_ptr-like type.
     template <typename PTR_IN>
     zx_status_t CopyInCommon(PTR_IN src, size_t dst_offset, size_t size) {
@@ -44,12 +44,33 @@ public:
                      MessagePacketPtr* msg,
                      bool may_disard);
 
+    // Read up to |max_msgs| messages from this endpoint's message queue under a single
+    // acquisition of the channel lock. |msg_sizes| and |msg_handle_counts| are in-out arrays
+    // with the same meaning as for Read(), one entry per message. Messages are dequeued in
+    // order until the queue is empty or the next message does not fit its entry. On ZX_OK
+    // at least one message was read and |*actual_msgs| says how many. If the first message
+    // does not fit, ZX_ERR_BUFFER_TOO_SMALL is returned with its size in the first entry
+    // and nothing is dequeued.
+    zx_status_t ReadMany(zx_koid_t owner,
+                         uint32_t* msg_sizes,
+                         uint32_t* msg_handle_counts,
+                         MessagePacketPtr* msgs,
+                         size_t max_msgs,
+                         size_t* actual_msgs);
+
     // Write to the opposing endpoint's message queue. |owner| is the process attempting to
     // write to the channel, or ZX_KOID_INVALID if kernel is doing it. If |owner| does not
     // match what was last set by Dispatcher::set_owner() the call will fail.
     zx_status_t Write(zx_koid_t owner,
                       MessagePacketPtr msg) TA_NO_THREAD_SAFETY_ANALYSIS;
 
+    // Write |count| messages to the opposing endpoint's message queue under a single
+    // acquisition of the channel lock, so that the peer is signalled at most once. Either
+    // all of the messages are written or none are. See Write() for |owner|.
+    zx_status_t WriteMany(zx_koid_t owner,
+                          MessagePacketPtr* msgs,
+                          size_t count) TA_NO_THREAD_SAFETY_ANALYSIS;
+
     // Perform a transacted Write + Read. |owner| is the process attempting to write
     // to the channel, or ZX_KOID_INVALID if kernel is doing it. If |owner| does not
     // match what was last set by Dispatcher::set_owner() the call will fail.
@@ -14,7 +14,8 @@
 
 // FutexContext is a class that encapsulates support for futex operations.
 // FutexContext uses a hash table keyed on the futex address (a pointer to integer in userspace)
-// to contain all active futexes.
+// to contain all active futexes. The table is split into buckets, each with its own lock, so
+// that operations on unrelated futexes do not contend with each other.
 // A futex is considered active if there is one or more threads blocked on the futex.
 // After no threads are left blocked on a futex it is removed from the hash table.
 // The value in the futex hash table is the FutexNode object associated with the head
@@ -78,14 +79,34 @@ private:
     FutexContext(const FutexContext&) = delete;
     FutexContext& operator=(const FutexContext&) = delete;
 
-    void QueueNodesLocked(FutexNode* head) TA_REQ(lock_);
+    struct Bucket {
+        // protects futex_table
+        DECLARE_MUTEX(Bucket) lock;
 
-    bool UnqueueNodeLocked(FutexNode* node) TA_REQ(lock_);
+        // Hash table for the futexes of this bucket.
+        // Key is futex address, value is the FutexNode for the head of futex's blocked thread
+        // list.
+        FutexNode::HashTable futex_table TA_GUARDED(lock);
+    };
+
+    static constexpr size_t kNumBucketsShift = 5;
+    static constexpr size_t kNumBuckets = 1u << kNumBucketsShift;
+
+    Bucket* GetBucket(uintptr_t futex_key);
+
+    // Wakes and requeues threads with the locks of both |wake_bucket| and |requeue_bucket|
+    // held, which may be the same bucket.
+    zx_status_t FutexRequeueLocked(Bucket* wake_bucket, uintptr_t wake_key, uint32_t wake_count,
+                                   zx_futex_t current_value,
+                                   user_in_ptr<const zx_futex_t> wake_ptr,
+                                   Bucket* requeue_bucket, uintptr_t requeue_key,
+                                   uint32_t requeue_count,
+                                   AutoReschedDisable* resched_disable);
+
+    static void QueueNodesLocked(Bucket* bucket, FutexNode* head) TA_REQ(bucket->lock);
 
-    // protects futex_table_
-    DECLARE_MUTEX(FutexContext) lock_;
+    // Removes |node| from whichever futex wait queue it is in, if any.
+    bool UnqueueNode(FutexNode* node);
 
-    // Hash table for futexes in this context.
-    // Key is futex address, value is the FutexNode for the head of futex's blocked thread list.
-    FutexNode::HashTable futex_table_ TA_GUARDED(lock_);
+    Bucket buckets_[kNumBuckets];
 };
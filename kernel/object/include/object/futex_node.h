@@ -18,7 +18,11 @@
 // Intended to be embedded within a ThreadDispatcher Instance
 class FutexNode : public fbl::SinglyLinkedListable<FutexNode*> {
 public:
-    using HashTable = fbl::HashTable<uintptr_t, FutexNode*>;
+    // FutexContext spreads futexes over its own locked buckets first, so each
+    // table only needs a few slots.
+    static constexpr size_t kHashTableSlots = 4;
+    using HashTable = fbl::HashTable<uintptr_t, FutexNode*, fbl::SinglyLinkedList<FutexNode*>,
+                                     size_t, kHashTableSlots>;
 
     FutexNode();
     ~FutexNode();
@@ -83,13 +83,35 @@ public:
     // other things like |Dispatcher::handle_count_|.
     DECLARE_SINGLETON_MUTEX(ArenaLock);
 
+    // A Handle can be looked up without holding the owning process's
+    // handle_table_lock_ from within a LookupGuard. Deleting a Handle waits
+    // for every LookupGuard in progress, so a handle that was seen to belong
+    // to a process during one stays intact, and keeps its dispatcher alive,
+    // until the guard goes out of scope.
+    //
+    // Preemption is disabled for the life of the guard, so it must not
+    // block, and must be kept short.
+    class LookupGuard {
+    public:
+        LookupGuard();
+        ~LookupGuard();
+
+    private:
+        DISALLOW_COPY_ASSIGN_AND_MOVE(LookupGuard);
+
+        uint32_t slot_;
+    };
+
     // Returns the Dispatcher to which this instance points.
     const fbl::RefPtr<Dispatcher>& dispatcher() const { return dispatcher_; }
 
     // Returns the process that owns this instance. Used to guarantee
     // that one process may not access a handle owned by a different process.
+    //
+    // The load has acquire semantics, pairing with set_process_id(), so that
+    // lookups done under a LookupGuard see a fully constructed Handle.
     zx_koid_t process_id() const {
-        return process_id_.load(fbl::memory_order_relaxed);
+        return process_id_.load(fbl::memory_order_acquire);
     }
 
     // Sets the value returned by process_id().
@@ -156,6 +178,9 @@ private:
     void TearDown() TA_EXCL(ArenaLock::Get());
     void Delete();
 
+    // Waits for the LookupGuards in progress to finish.
+    static void WaitForLookups();
+
     // Only HandleOwner is allowed to call Delete.
     friend class HandleOwner;
 
@@ -10,10 +10,12 @@
 
 #include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_single_list.h>
+#include <fbl/ref_ptr.h>
 #include <ktl/unique_ptr.h>
 #include <lib/user_copy/user_ptr.h>
 #include <object/buffer_chain.h>
 #include <object/handle.h>
+#include <vm/vm_object.h>
 #include <zircon/types.h>
 
 constexpr uint32_t kMaxMessageSize = 65536u;
@@ -25,6 +27,7 @@ static_assert(ZX_CHANNEL_MAX_MSG_HANDLES == kMaxMessageHandles, "");
 
 class Handle;
 class MessagePacket;
+class VmAspace;
 namespace internal {
 struct MessagePacketDeleter;
 }  // namespace internal
@@ -45,14 +48,32 @@ public:
     static zx_status_t Create(const void* data, uint32_t data_size,
                               uint32_t num_handles, MessagePacketPtr* msg);
 
+    // Same as the user_in_ptr version of Create() except that, if |data| is large and
+    // lies within a single mapping of |aspace|, the packet copies the pages backing it
+    // into a clone of their VMO, which the receiver can then map rather than copy out
+    // of.  The copy is taken before the call returns, so later writes by the sender
+    // don't show through.  Falls back to copying into the buffer chain otherwise.
+    static zx_status_t CreateFromPages(VmAspace* aspace, user_in_ptr<const void> data,
+                                       uint32_t data_size, uint32_t num_handles,
+                                       MessagePacketPtr* msg);
+
     uint32_t data_size() const { return data_size_; }
 
     // Copies the packet's |data_size()| bytes to |buf|.
     // Returns an error if |buf| points to a bad user address.
     zx_status_t CopyDataTo(user_out_ptr<void> buf) const {
+        if (pages_) {
+            return pages_->ReadUser(buf, pages_offset_, data_size_);
+        }
         return buffer_chain_->CopyOut(buf, payload_offset_, data_size_);
     }
 
+    // Same as CopyDataTo() except that, for a packet created by CreateFromPages(), the
+    // whole pages of |buf| are replaced by a mapping of the packet's pages when |buf|
+    // lies within a single writable mapping of |aspace| and starts at the same offset
+    // within a page as the data did.  Only the partial pages at either end are copied.
+    zx_status_t MapDataTo(VmAspace* aspace, user_out_ptr<void> buf) const;
+
     uint32_t num_handles() const { return num_handles_; }
     Handle* const* handles() const { return handles_; }
     Handle** mutable_handles() { return handles_; }
@@ -71,6 +92,9 @@ public:
     }
 
     void set_txid(zx_txid_t txid) {
+        // The buffer chain only holds a copy of the first bytes of a packet created
+        // from pages, so changing them there would not change what is read.
+        DEBUG_ASSERT(!pages_);
         if (data_size_ >= sizeof(zx_txid_t)) {
             void* payload_start = buffer_chain_->buffers()->front().data() + payload_offset_;
             *(reinterpret_cast<zx_txid_t*>(payload_start)) = txid;
@@ -104,9 +128,13 @@ private:
     static void recycle(MessagePacket* packet);
 
     static zx_status_t CreateCommon(uint32_t data_size, uint32_t num_handles,
-                                    MessagePacketPtr* msg);
+                                    uint32_t chain_data_size, MessagePacketPtr* msg);
 
     BufferChain* buffer_chain_;
+    // For packets created by CreateFromPages(), the payload starts |pages_offset_|
+    // bytes into |pages_|, and the buffer chain only holds a copy of its txid.
+    fbl::RefPtr<VmObject> pages_;
+    uint64_t pages_offset_ = 0;
     Handle** const handles_;
     const uint32_t data_size_;
     const uint32_t payload_offset_;
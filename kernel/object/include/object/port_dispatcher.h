@@ -7,18 +7,21 @@
 #pragma once
 
 #include <object/dispatcher.h>
-#include <object/semaphore.h>
 #include <object/state_observer.h>
 
 #include <zircon/rights.h>
 #include <zircon/syscalls/port.h>
 #include <zircon/types.h>
 
+#include <fbl/array.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
 #include <ktl/unique_ptr.h>
+#include <kernel/align.h>
+#include <kernel/mutex.h>
 #include <kernel/spinlock.h>
+#include <kernel/wait.h>
 
 #include <sys/types.h>
 
@@ -94,6 +97,9 @@ struct PortPacket final : public fbl::DoublyLinkedListable<PortPacket*> {
     const void* const handle;
     ktl::unique_ptr<const PortObserver> observer;
     PortAllocator* const allocator;
+    // The queue of the port this packet was last queued on. Only changed by
+    // PortDispatcher::Queue() while the packet is not in any queue.
+    uint32_t shard = 0u;
 
     PortPacket(const void* handle, PortAllocator* allocator);
     PortPacket(const PortPacket&) = delete;
@@ -150,16 +156,25 @@ private:
 //  3- Manual queuing: zx_port_queue()
 //  4- Interrupt change notification: zx_interrupt_bind()
 //
-// This makes the implementation non-trivial. Cases 1, 2 and 3 uses the
-// |packets_| linked list and case 4 uses |interrupt_packets_| linked list.
+// This makes the implementation non-trivial. Cases 1, 2 and 3 use the
+// |shards_| linked lists and case 4 uses |interrupt_packets_| linked list.
+//
+// A port normally has a single shard, so packets are dequeued in the order
+// they were queued. A port created with ZX_PORT_PER_CPU instead has one shard
+// per cpu: packets are queued on the shard of the cpu that queued them, and
+// Dequeue() looks at the shard of the cpu it runs on before taking packets
+// from the others. This gives up the ordering between packets queued from
+// different cpus in exchange for not serializing every queue and dequeue of
+// a busy port on one lock.
 //
 // The threads that wish to receive notifications block on Dequeue() (which
 // maps to zx_port_wait()) and will receive packets from any of the four sources
 // depending on what kind of object the port has been 'bound' to.
 //
 // When a packet from any of the sources arrives to the port, one waiting
-// thread unblocks and gets the packet. In all cases |sema_| is used to signal
-// and manage the waiting threads.
+// thread unblocks and gets the packet. Waiting threads block on the shard of
+// the cpu they run on, and a new packet wakes a thread waiting on the shard it
+// was queued on before one waiting elsewhere.
 
 class PortDispatcher final : public SoloDispatcher<PortDispatcher, ZX_DEFAULT_PORT_RIGHTS> {
 public:
@@ -172,6 +187,7 @@ public:
     zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_PORT; }
 
     bool can_bind_to_interrupt() const { return options_ & ZX_PORT_BIND_TO_INTERRUPT; }
+    bool per_cpu() const { return options_ & ZX_PORT_PER_CPU; }
     void on_zero_handles() final;
 
     zx_status_t Queue(PortPacket* port_packet, zx_signals_t observed, uint64_t count);
@@ -195,13 +211,38 @@ public:
     bool CancelQueued(const void* handle, uint64_t key);
 
     // Removes |port_packet| from this port's queue. Returns false if the packet was
-    // not in this queue. It is undefined to call this with a packet queued in another port.
+    // not in this queue. It is undefined to call this with a packet queued in another port,
+    // or concurrently with Queue() for the same packet.
     bool CancelQueued(PortPacket* port_packet);
 
 private:
     friend class ExceptionPort;
 
-    explicit PortDispatcher(uint32_t options);
+    // Each cpu queues on and locks its own shard, so shards get cache lines of their own.
+    struct Shard {
+        DECLARE_MUTEX(Shard) lock;
+        bool zero_handles TA_GUARDED(lock) = false;
+        size_t num_packets TA_GUARDED(lock) = 0u;
+        fbl::DoublyLinkedList<PortPacket*> packets TA_GUARDED(lock);
+        // Threads blocked in Dequeue() on this shard's cpu. Protected by the thread lock.
+        WaitQueue waiters;
+    } __CPU_ALIGN;
+
+    PortDispatcher(uint32_t options, fbl::Array<Shard> shards);
+
+    // The shard new packets are queued on, and the first one Dequeue() looks at.
+    Shard& LocalShard(uint32_t* index);
+
+    bool CancelQueuedLocked(Shard* shard, const void* handle, uint64_t key)
+        TA_REQ(shard->lock);
+
+    // Wakes one thread blocked in Dequeue() after a packet was queued on shard |index|,
+    // preferring one blocked on that shard. With no thread blocked, the wakeup is kept
+    // for the next thread that would otherwise block.
+    void Wake(uint32_t index);
+
+    // Blocks the calling thread on |shard| until Wake() is called or |deadline| passes.
+    zx_status_t Wait(Shard* shard, const Deadline& deadline);
 
     // Adopts a RefPtr to |eport|, and adds it to |eports_|.
     // Called by ExceptionPort.
@@ -214,12 +255,15 @@ private:
 
     fbl::Canary<fbl::magic("PORT")> canary_;
     const uint32_t options_;
-    Semaphore sema_;
     bool zero_handles_ TA_GUARDED(get_lock());
 
-    // Next three members handle the object, manual and exception notifications.
-    size_t num_packets_ TA_GUARDED(get_lock());
-    fbl::DoublyLinkedList<PortPacket*> packets_ TA_GUARDED(get_lock());
+    // Wakeups that found no thread blocked in Dequeue(), and the number of threads
+    // blocked across all shards. Protected by the thread lock.
+    uint64_t pending_wakeups_ = 0u;
+    uint32_t num_waiting_ = 0u;
+
+    // Next two members handle the object, manual and exception notifications.
+    const fbl::Array<Shard> shards_;
     fbl::DoublyLinkedList<fbl::RefPtr<ExceptionPort>> eports_ TA_GUARDED(get_lock());
     // Next two members handle the interrupt notifications.
     DECLARE_SPINLOCK(PortDispatcher) spinlock_;
@@ -89,6 +89,14 @@ public:
     Handle* GetHandleLocked(
         zx_handle_t handle_value, bool skip_policy = false) TA_REQ(handle_table_lock_);
 
+    // Like GetHandleLocked(), but without taking |handle_table_lock_|. The
+    // returned Handle may only be used while |lookup| is in scope. Returns
+    // nullptr if the handle does not belong to this process, without
+    // applying any policy; callers should retry under the lock, which
+    // decides whether the handle is really bad.
+    Handle* GetHandleLockFree(zx_handle_t handle_value,
+                              const Handle::LookupGuard& lookup) const;
+
     // Adds |handle| to this process handle list. The handle->process_id() is
     // set to this process id().
     void AddHandle(HandleOwner handle);
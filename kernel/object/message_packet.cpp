@@ -8,9 +8,16 @@
 
 #include <err.h>
 #include <fbl/algorithm.h>
+#include <kernel/lockdep.h>
+#include <lib/counters.h>
 #include <new>
 #include <stdint.h>
 #include <string.h>
+#include <vm/vm_address_region.h>
+#include <vm/vm_aspace.h>
+
+KCOUNTER(channel_pages_cloned, "kernel.channel.pages.cloned");
+KCOUNTER(channel_pages_remapped, "kernel.channel.pages.remapped");
 
 // MessagePackets have special allocation requirements because they can contain a variable number of
 // handles and a variable size payload.
@@ -36,7 +43,11 @@ static inline uint32_t PayloadOffset(uint32_t num_handles) {
     return kHandlesOffset + num_handles * static_cast<uint32_t>(sizeof(Handle*));
 }
 
-// Creates a MessagePacket in |msg| sufficient to hold |data_size| bytes and |num_handles|.
+// Payloads smaller than this are cheaper to copy than to clone and map.
+static constexpr uint32_t kMinPagesSize = 4 * PAGE_SIZE;
+
+// Creates a MessagePacket in |msg| for |data_size| bytes and |num_handles|, with room for
+// the first |chain_data_size| bytes of the payload in its buffer chain.
 //
 // Note: This method does not write the payload into the MessagePacket.
 //
@@ -44,7 +55,7 @@ static inline uint32_t PayloadOffset(uint32_t num_handles) {
 //
 // static
 inline zx_status_t MessagePacket::CreateCommon(uint32_t data_size, uint32_t num_handles,
-                                               MessagePacketPtr* msg) {
+                                               uint32_t chain_data_size, MessagePacketPtr* msg) {
     if (unlikely(data_size > kMaxMessageSize || num_handles > kMaxMessageHandles)) {
         return ZX_ERR_OUT_OF_RANGE;
     }
@@ -53,7 +64,7 @@ inline zx_status_t MessagePacket::CreateCommon(uint32_t data_size, uint32_t num_
 
     // MessagePackets lives *inside* a list of buffers.  The first buffer holds the MessagePacket
     // object, followed by its handles (if any), and finally the payload data.
-    BufferChain* chain = BufferChain::Alloc(payload_offset + data_size);
+    BufferChain* chain = BufferChain::Alloc(payload_offset + chain_data_size);
     if (unlikely(!chain)) {
         return ZX_ERR_NO_MEMORY;
     }
@@ -76,7 +87,7 @@ inline zx_status_t MessagePacket::CreateCommon(uint32_t data_size, uint32_t num_
 zx_status_t MessagePacket::Create(user_in_ptr<const void> data, uint32_t data_size,
                                   uint32_t num_handles, MessagePacketPtr* msg) {
     MessagePacketPtr new_msg;
-    zx_status_t status = CreateCommon(data_size, num_handles, &new_msg);
+    zx_status_t status = CreateCommon(data_size, num_handles, data_size, &new_msg);
     if (unlikely(status != ZX_OK)) {
         return status;
     }
@@ -92,7 +103,7 @@ zx_status_t MessagePacket::Create(user_in_ptr<const void> data, uint32_t data_si
 zx_status_t MessagePacket::Create(const void* data, uint32_t data_size, uint32_t num_handles,
                                   MessagePacketPtr* msg) {
     MessagePacketPtr new_msg;
-    zx_status_t status = CreateCommon(data_size, num_handles, &new_msg);
+    zx_status_t status = CreateCommon(data_size, num_handles, data_size, &new_msg);
     if (unlikely(status != ZX_OK)) {
         return status;
     }
@@ -104,6 +115,120 @@ zx_status_t MessagePacket::Create(const void* data, uint32_t data_size, uint32_t
     return ZX_OK;
 }
 
+// static
+zx_status_t MessagePacket::CreateFromPages(VmAspace* aspace, user_in_ptr<const void> data,
+                                           uint32_t data_size, uint32_t num_handles,
+                                           MessagePacketPtr* msg) {
+    if (data_size < kMinPagesSize || data_size > kMaxMessageSize) {
+        return Create(data, data_size, num_handles, msg);
+    }
+
+    const vaddr_t va = reinterpret_cast<vaddr_t>(data.get());
+    auto region = aspace->FindRegion(va);
+    fbl::RefPtr<VmMapping> mapping = region ? region->as_vm_mapping() : nullptr;
+    if (!mapping || va + data_size < va) {
+        return Create(data, data_size, num_handles, msg);
+    }
+
+    // The mapping may be unmapped concurrently, which drops its VMO, so take a reference to
+    // the VMO under the aspace lock, once it is known to still be mapped.
+    fbl::RefPtr<VmObject> vmo;
+    uint64_t offset;
+    {
+        Guard<fbl::Mutex> guard{aspace->lock()};
+        if (!mapping->vmo() || !(mapping->arch_mmu_flags() & ARCH_MMU_FLAG_PERM_READ) ||
+            va < mapping->base() || va + data_size > mapping->base() + mapping->size()) {
+            return Create(data, data_size, num_handles, msg);
+        }
+        vmo = mapping->vmo();
+        offset = va - mapping->base() + mapping->object_offset();
+    }
+
+    // Mappings start on a page boundary of their VMO, so the payload starts at the
+    // same offset into the clone as into its first page.
+    const uint64_t start = ROUNDDOWN(offset, PAGE_SIZE);
+    const uint64_t end = ROUNDUP(offset + data_size, PAGE_SIZE);
+    fbl::RefPtr<VmObject> pages;
+    if (vmo->CloneCOW(false, start, end - start, false, &pages) != ZX_OK) {
+        return Create(data, data_size, num_handles, msg);
+    }
+
+    // A clone keeps seeing the pages of its parent until it copies them, so the sender could
+    // still change the message after sending it, even while the receiver reads it. Copy them
+    // now, which makes the clone a snapshot of the message as it was sent; the receiver
+    // still maps the copies rather than copying them again.
+    if (pages->CommitRange(0, end - start) != ZX_OK) {
+        return Create(data, data_size, num_handles, msg);
+    }
+
+    // Keep a copy of the txid in the buffer chain so WriteSelf() can match replies.
+    zx_txid_t txid;
+    if (pages->Read(&txid, offset - start, sizeof(txid)) != ZX_OK) {
+        return Create(data, data_size, num_handles, msg);
+    }
+
+    MessagePacketPtr new_msg;
+    zx_status_t status = CreateCommon(data_size, num_handles, sizeof(txid), &new_msg);
+    if (unlikely(status != ZX_OK)) {
+        return status;
+    }
+    memcpy(new_msg->buffer_chain_->buffers()->front().data() + new_msg->payload_offset_,
+           &txid, sizeof(txid));
+    new_msg->pages_ = ktl::move(pages);
+    new_msg->pages_offset_ = offset - start;
+
+    kcounter_add(channel_pages_cloned, (end - start) / PAGE_SIZE);
+    *msg = ktl::move(new_msg);
+    return ZX_OK;
+}
+
+zx_status_t MessagePacket::MapDataTo(VmAspace* aspace, user_out_ptr<void> buf) const {
+    const vaddr_t va = reinterpret_cast<vaddr_t>(buf.get());
+    if (!pages_ || (va & (PAGE_SIZE - 1)) != pages_offset_ || va + data_size_ < va) {
+        return CopyDataTo(buf);
+    }
+    const vaddr_t first = ROUNDUP(va, PAGE_SIZE);
+    const vaddr_t last = ROUNDDOWN(va + data_size_, PAGE_SIZE);
+    if (first >= last) {
+        return CopyDataTo(buf);
+    }
+
+    // Find the mapping that holds |buf| and the region it lives in.
+    fbl::RefPtr<VmAddressRegion> vmar = aspace->RootVmar();
+    fbl::RefPtr<VmAddressRegionOrMapping> next;
+    while ((next = vmar->FindRegion(va)) && !next->is_mapping()) {
+        vmar = next->as_vm_address_region();
+    }
+    fbl::RefPtr<VmMapping> mapping = next ? next->as_vm_mapping() : nullptr;
+    if (!mapping || !(mapping->arch_mmu_flags() & ARCH_MMU_FLAG_PERM_WRITE) ||
+        va + data_size_ > mapping->base() + mapping->size()) {
+        return CopyDataTo(buf);
+    }
+
+    // The clone is never written through the packet, so the receiver gets its own
+    // copy of any page it writes to.
+    fbl::RefPtr<VmMapping> remapped;
+    zx_status_t status = vmar->CreateVmMapping(
+        first - vmar->base(), last - first, 0, VMAR_FLAG_SPECIFIC_OVERWRITE, pages_,
+        pages_offset_ + (first - va), mapping->arch_mmu_flags(), "channel-pages", &remapped);
+    if (status != ZX_OK) {
+        return CopyDataTo(buf);
+    }
+    kcounter_add(channel_pages_remapped, (last - first) / PAGE_SIZE);
+
+    if (first > va) {
+        status = pages_->ReadUser(buf, pages_offset_, first - va);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+    if (va + data_size_ > last) {
+        status = pages_->ReadUser(buf.byte_offset(last - va), pages_offset_ + (last - va),
+                                  va + data_size_ - last);
+    }
+    return status;
+}
+
 void MessagePacket::recycle(MessagePacket* packet) {
     // Grab the buffer chain for this packet
     BufferChain* chain = packet->buffer_chain_;
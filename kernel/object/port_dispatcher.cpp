@@ -6,6 +6,7 @@
 
 #include <object/port_dispatcher.h>
 
+#include <arch/ops.h>
 #include <assert.h>
 #include <err.h>
 #include <platform.h>
@@ -14,6 +15,7 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/arena.h>
 #include <fbl/auto_lock.h>
+#include <kernel/thread_lock.h>
 #include <lib/counters.h>
 #include <object/excp_port.h>
 #include <object/handle.h>
@@ -38,6 +40,8 @@ static_assert(sizeof(zx_packet_page_request_t) == 32,
 
 KCOUNTER(port_arena_count, "kernel.port.arena.count");
 KCOUNTER(port_full_count, "kernel.port.full.count");
+KCOUNTER(port_remote_dequeue_count, "kernel.port.dequeue.remote");
+KCOUNTER(port_remote_wake_count, "kernel.port.wake.remote");
 
 class ArenaPortAllocator final : public PortAllocator {
 public:
@@ -172,11 +176,16 @@ PortAllocator* PortDispatcher::DefaultPortAllocator() {
 
 zx_status_t PortDispatcher::Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
                                    zx_rights_t* rights) {
-    if (options && options != ZX_PORT_BIND_TO_INTERRUPT) {
+    if (options & ~(ZX_PORT_BIND_TO_INTERRUPT | ZX_PORT_PER_CPU)) {
         return ZX_ERR_INVALID_ARGS;
     }
+    size_t num_shards = (options & ZX_PORT_PER_CPU) ? arch_max_num_cpus() : 1u;
     fbl::AllocChecker ac;
-    auto disp = new (&ac) PortDispatcher(options);
+    fbl::Array<Shard> shards(new (&ac) Shard[num_shards], num_shards);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    auto disp = new (&ac) PortDispatcher(options, ktl::move(shards));
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
@@ -185,46 +194,63 @@ zx_status_t PortDispatcher::Create(uint32_t options, fbl::RefPtr<Dispatcher>* di
     return ZX_OK;
 }
 
-PortDispatcher::PortDispatcher(uint32_t options)
-    : options_(options), zero_handles_(false), num_packets_(0u) {
+PortDispatcher::PortDispatcher(uint32_t options, fbl::Array<Shard> shards)
+    : options_(options), zero_handles_(false), shards_(ktl::move(shards)) {
 }
 
 PortDispatcher::~PortDispatcher() {
     DEBUG_ASSERT(zero_handles_);
-    DEBUG_ASSERT(num_packets_ == 0u);
+    for (auto& shard : shards_) {
+        Guard<fbl::Mutex> guard{&shard.lock};
+        DEBUG_ASSERT(shard.num_packets == 0u);
+    }
+}
+
+PortDispatcher::Shard& PortDispatcher::LocalShard(uint32_t* index) {
+    // The thread can migrate right after this, which only costs locality.
+    uint32_t count = static_cast<uint32_t>(shards_.size());
+    *index = (count == 1u) ? 0u : arch_curr_cpu_num() % count;
+    return shards_[*index];
 }
 
 void PortDispatcher::on_zero_handles() {
     canary_.Assert();
 
-    Guard<fbl::Mutex> guard{get_lock()};
-    zero_handles_ = true;
+    {
+        Guard<fbl::Mutex> guard{get_lock()};
+        zero_handles_ = true;
 
-    // Unlink and unbind exception ports.
-    while (!eports_.is_empty()) {
-        auto eport = eports_.pop_back();
+        // Unlink and unbind exception ports.
+        while (!eports_.is_empty()) {
+            auto eport = eports_.pop_back();
 
-        // Tell the eport to unbind itself, then drop our ref to it. Called
-        // unlocked because the eport may call our ::UnlinkExceptionPort.
-        guard.CallUnlocked([&eport]() { eport->OnPortZeroHandles(); });
+            // Tell the eport to unbind itself, then drop our ref to it. Called
+            // unlocked because the eport may call our ::UnlinkExceptionPort.
+            guard.CallUnlocked([&eport]() { eport->OnPortZeroHandles(); });
+        }
     }
 
     // Free any queued packets.
-    while (!packets_.is_empty()) {
-        auto packet = packets_.pop_front();
-        --num_packets_;
-
-        // If the packet is ephemeral, free it outside of the lock. Otherwise,
-        // reset the observer if it is present.
-        if (packet->is_ephemeral()) {
-            guard.CallUnlocked([packet]() {
-                    packet->Free();
-            });
-        } else {
-            // The reference to the port that the observer holds cannot be the last one
-            // because another reference was used to call on_zero_handles, so we don't
-            // need to worry about destroying ourselves.
-            packet->observer.reset();
+    for (auto& shard : shards_) {
+        Guard<fbl::Mutex> guard{&shard.lock};
+        shard.zero_handles = true;
+
+        while (!shard.packets.is_empty()) {
+            auto packet = shard.packets.pop_front();
+            shard.num_packets--;
+
+            // If the packet is ephemeral, free it outside of the lock. Otherwise,
+            // reset the observer if it is present.
+            if (packet->is_ephemeral()) {
+                guard.CallUnlocked([packet]() {
+                        packet->Free();
+                });
+            } else {
+                // The reference to the port that the observer holds cannot be the last one
+                // because another reference was used to call on_zero_handles, so we don't
+                // need to worry about destroying ourselves.
+                packet->observer.reset();
+            }
         }
     }
 }
@@ -261,7 +287,9 @@ bool PortDispatcher::QueueInterruptPacket(PortInterruptPacket* port_packet, zx_t
     } else {
         port_packet->timestamp = timestamp;
         interrupt_packets_.push_back(port_packet);
-        sema_.Post();
+        uint32_t index;
+        LocalShard(&index);
+        Wake(index);
         return true;
     }
 }
@@ -270,11 +298,28 @@ zx_status_t PortDispatcher::Queue(PortPacket* port_packet, zx_signals_t observed
     canary_.Assert();
 
     AutoReschedDisable resched_disable; // Must come before the lock guard.
-    Guard<fbl::Mutex> guard{get_lock()};
-    if (zero_handles_)
+
+    uint32_t index;
+    Shard* shard = &LocalShard(&index);
+
+    // An observer's packet may still be queued on the shard it was last queued on,
+    // in which case the new signals are merged into it there. It cannot be queued
+    // concurrently because the observer is called under its object's lock.
+    if (observed && port_packet->shard != index) {
+        Guard<fbl::Mutex> guard{&shards_[port_packet->shard].lock};
+        if (port_packet->InContainer()) {
+            port_packet->packet.signal.observed |= observed;
+            return ZX_OK;
+        }
+    }
+
+    Guard<fbl::Mutex> guard{&shard->lock};
+    if (shard->zero_handles)
         return ZX_ERR_BAD_STATE;
 
-    if (num_packets_ > kMaxPendingPacketCountPerPort) {
+    // Each shard holds its share of the limit, so that queueing never has to look at
+    // the other shards. The limit merely stops runaway producers.
+    if (shard->num_packets > kMaxPendingPacketCountPerPort / shards_.size()) {
         kcounter_add(port_full_count, 1);
         return ZX_ERR_SHOULD_WAIT;
     }
@@ -288,22 +333,66 @@ zx_status_t PortDispatcher::Queue(PortPacket* port_packet, zx_signals_t observed
         port_packet->packet.signal.observed = observed;
         port_packet->packet.signal.count = count;
     }
-    packets_.push_back(port_packet);
-    ++num_packets_;
-    // This Disable() call must come before Post() to be useful, but doing
+    port_packet->shard = index;
+    shard->packets.push_back(port_packet);
+    shard->num_packets++;
+    guard.Release();
+
+    // This Disable() call must come before Wake() to be useful, but doing
     // it earlier would also be OK.
     resched_disable.Disable();
-    sema_.Post();
+    Wake(index);
 
     return ZX_OK;
 }
 
+void PortDispatcher::Wake(uint32_t index) {
+    Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+    if (num_waiting_ > 0u) {
+        uint32_t count = static_cast<uint32_t>(shards_.size());
+        for (uint32_t i = 0; i < count; i++) {
+            if (shards_[(index + i) % count].waiters.WakeOne(true, ZX_OK) > 0) {
+                if (i != 0) {
+                    kcounter_add(port_remote_wake_count, 1);
+                }
+                return;
+            }
+        }
+    }
+    // A thread that found nothing to dequeue may not have blocked yet. It
+    // takes this instead of blocking and looks at the shards again.
+    pending_wakeups_++;
+}
+
+zx_status_t PortDispatcher::Wait(Shard* shard, const Deadline& deadline) {
+    thread_t* current_thread = get_current_thread();
+
+    Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+    if (pending_wakeups_ > 0u) {
+        pending_wakeups_--;
+        return ZX_OK;
+    }
+
+    current_thread->interruptable = true;
+    num_waiting_++;
+    zx_status_t status = shard->waiters.Block(deadline);
+    num_waiting_--;
+    current_thread->interruptable = false;
+    return status;
+}
+
 zx_status_t PortDispatcher::Dequeue(const Deadline& deadline,
                                     zx_port_packet_t* out_packet) {
     canary_.Assert();
 
     while (true) {
-        if (options_ == ZX_PORT_BIND_TO_INTERRUPT) {
+        // Start with the shard of this cpu, then take packets queued elsewhere
+        // rather than sleeping while there is work. Block on this cpu's shard
+        // if there is none.
+        uint32_t local;
+        Shard* local_shard = &LocalShard(&local);
+
+        if (can_bind_to_interrupt()) {
             Guard<SpinLock, IrqSave> guard{&spinlock_};
             PortInterruptPacket* port_interrupt_packet = interrupt_packets_.pop_front();
             if (port_interrupt_packet != nullptr) {
@@ -315,11 +404,13 @@ zx_status_t PortDispatcher::Dequeue(const Deadline& deadline,
                 return ZX_OK;
             }
         }
-        {
-            Guard<fbl::Mutex> guard{get_lock()};
-            PortPacket* port_packet = packets_.pop_front();
+        for (uint32_t i = 0; i < shards_.size(); i++) {
+            uint32_t index = (local + i) % static_cast<uint32_t>(shards_.size());
+            Shard& shard = shards_[index];
+            Guard<fbl::Mutex> guard{&shard.lock};
+            PortPacket* port_packet = shard.packets.pop_front();
             if (port_packet != nullptr) {
-                --num_packets_;
+                shard.num_packets--;
                 *out_packet = port_packet->packet;
 
                 bool is_ephemeral = port_packet->is_ephemeral();
@@ -329,6 +420,9 @@ zx_status_t PortDispatcher::Dequeue(const Deadline& deadline,
                 port_packet->observer.reset();
                 guard.Release();
 
+                if (i != 0) {
+                    kcounter_add(port_remote_dequeue_count, 1);
+                }
                 // If the packet is ephemeral, free it outside of the lock. We need to read
                 // is_ephemeral inside the lock because it's possible for a non-ephemeral packet
                 // to get deleted after a call to |MaybeReap| as soon as we release the lock.
@@ -341,7 +435,7 @@ zx_status_t PortDispatcher::Dequeue(const Deadline& deadline,
 
         {
             ThreadDispatcher::AutoBlocked by(ThreadDispatcher::Blocked::PORT);
-            zx_status_t st = sema_.Wait(deadline);
+            zx_status_t st = Wait(local_shard, deadline);
             if (st != ZX_OK)
                 return st;
         }
@@ -353,7 +447,9 @@ ktl::unique_ptr<PortObserver> PortDispatcher::MaybeReap(ktl::unique_ptr<PortObse
     canary_.Assert();
     DEBUG_ASSERT(!port_packet->is_ephemeral());
 
-    Guard<fbl::Mutex> guard{get_lock()};
+    // The observer is being removed from its object under the object's lock, so
+    // it cannot be queued again, and so move to another shard, concurrently.
+    Guard<fbl::Mutex> guard{&shards_[port_packet->shard].lock};
     if (port_packet->InContainer()) {
         // The destruction will happen when the packet is dequeued or in CancelQueued()
         DEBUG_ASSERT(port_packet->observer == nullptr);
@@ -397,8 +493,15 @@ zx_status_t PortDispatcher::MakeObserver(uint32_t options, Handle* handle, uint6
 bool PortDispatcher::CancelQueued(const void* handle, uint64_t key) {
     canary_.Assert();
 
-    Guard<fbl::Mutex> guard{get_lock()};
+    bool packet_removed = false;
+    for (auto& shard : shards_) {
+        Guard<fbl::Mutex> guard{&shard.lock};
+        packet_removed |= CancelQueuedLocked(&shard, handle, key);
+    }
+    return packet_removed;
+}
 
+bool PortDispatcher::CancelQueuedLocked(Shard* shard, const void* handle, uint64_t key) {
     // This loop can take a while if there are many items.
     // In practice, the number of pending signal packets is
     // approximately the number of signaled _and_ watched
@@ -408,7 +511,7 @@ bool PortDispatcher::CancelQueued(const void* handle, uint64_t key) {
     // There are two strategies to deal with too much
     // looping here if that is seen in practice.
     //
-    // 1. Swap the |packets_| list for an empty list and
+    // 1. Swap the |packets| list for an empty list and
     //    release the lock. New arriving packets are
     //    added to the empty list while the loop happens.
     //    Readers will be blocked but the watched objects
@@ -421,13 +524,13 @@ bool PortDispatcher::CancelQueued(const void* handle, uint64_t key) {
 
     bool packet_removed = false;
 
-    for (auto it = packets_.begin(); it != packets_.end();) {
+    for (auto it = shard->packets.begin(); it != shard->packets.end();) {
         if ((it->handle == handle) && (it->key() == key)) {
             auto to_remove = it++;
             // Destroyed as we go around the loop.
             ktl::unique_ptr<const PortObserver> observer =
-                ktl::move(packets_.erase(to_remove)->observer);
-            --num_packets_;
+                ktl::move(shard->packets.erase(to_remove)->observer);
+            shard->num_packets--;
             packet_removed = true;
         } else {
             ++it;
@@ -440,11 +543,12 @@ bool PortDispatcher::CancelQueued(const void* handle, uint64_t key) {
 bool PortDispatcher::CancelQueued(PortPacket* port_packet) {
     canary_.Assert();
 
-    Guard<fbl::Mutex> guard{get_lock()};
+    Shard& shard = shards_[port_packet->shard];
+    Guard<fbl::Mutex> guard{&shard.lock};
 
     if (port_packet->InContainer()) {
-        packets_.erase(*port_packet)->observer.reset();
-        --num_packets_;
+        shard.packets.erase(*port_packet)->observer.reset();
+        shard.num_packets--;
         return true;
     }
 
@@ -460,6 +460,14 @@ Handle* ProcessDispatcher::GetHandleLocked(zx_handle_t handle_value,
     return nullptr;
 }
 
+Handle* ProcessDispatcher::GetHandleLockFree(zx_handle_t handle_value,
+                                             const Handle::LookupGuard& lookup) const {
+    auto handle = map_value_to_handle(handle_value, handle_rand_);
+    if (handle && handle->process_id() == get_koid())
+        return handle;
+    return nullptr;
+}
+
 void ProcessDispatcher::AddHandle(HandleOwner handle) {
     Guard<fbl::Mutex> guard{&handle_table_lock_};
     AddHandleLocked(ktl::move(handle));
@@ -522,6 +530,13 @@ zx_status_t ProcessDispatcher::RemoveHandles(user_in_ptr<const zx_handle_t> user
 }
 
 zx_koid_t ProcessDispatcher::GetKoidForHandle(zx_handle_t handle_value) {
+    {
+        Handle::LookupGuard lookup;
+        Handle* handle = GetHandleLockFree(handle_value, lookup);
+        if (likely(handle))
+            return handle->dispatcher()->get_koid();
+    }
+
     Guard<fbl::Mutex> guard{&handle_table_lock_};
     Handle* handle = GetHandleLocked(handle_value);
     if (!handle)
@@ -532,6 +547,26 @@ zx_koid_t ProcessDispatcher::GetKoidForHandle(zx_handle_t handle_value) {
 zx_status_t ProcessDispatcher::GetDispatcherInternal(zx_handle_t handle_value,
                                                      fbl::RefPtr<Dispatcher>* dispatcher,
                                                      zx_rights_t* rights) {
+    // The reference dropped by assigning to |dispatcher| may be the last one,
+    // so that is left until the guard is gone.
+    fbl::RefPtr<Dispatcher> found;
+    zx_rights_t found_rights = 0;
+    {
+        Handle::LookupGuard lookup;
+        Handle* handle = GetHandleLockFree(handle_value, lookup);
+        if (likely(handle)) {
+            found = handle->dispatcher();
+            found_rights = handle->rights();
+        }
+    }
+    if (likely(found)) {
+        *dispatcher = ktl::move(found);
+        if (rights)
+            *rights = found_rights;
+        return ZX_OK;
+    }
+
+    // Not found, check again under the lock to apply the bad handle policy.
     Guard<fbl::Mutex> guard{&handle_table_lock_};
     Handle* handle = GetHandleLocked(handle_value);
     if (!handle)
@@ -547,6 +582,28 @@ zx_status_t ProcessDispatcher::GetDispatcherWithRightsInternal(zx_handle_t handl
                                                                zx_rights_t desired_rights,
                                                                fbl::RefPtr<Dispatcher>* dispatcher_out,
                                                                zx_rights_t* out_rights) {
+    // As in GetDispatcherInternal(), only assign to |dispatcher_out| once the
+    // guard is gone.
+    fbl::RefPtr<Dispatcher> found;
+    zx_rights_t found_rights = 0;
+    {
+        Handle::LookupGuard lookup;
+        Handle* handle = GetHandleLockFree(handle_value, lookup);
+        if (likely(handle)) {
+            if (!handle->HasRights(desired_rights))
+                return ZX_ERR_ACCESS_DENIED;
+            found = handle->dispatcher();
+            found_rights = handle->rights();
+        }
+    }
+    if (likely(found)) {
+        *dispatcher_out = ktl::move(found);
+        if (out_rights)
+            *out_rights = found_rights;
+        return ZX_OK;
+    }
+
+    // Not found, check again under the lock to apply the bad handle policy.
     Guard<fbl::Mutex> guard{&handle_table_lock_};
     Handle* handle = GetHandleLocked(handle_value);
     if (!handle)
@@ -863,13 +920,18 @@ const char* StateToString(ProcessDispatcher::State state) {
 }
 
 bool ProcessDispatcher::IsHandleValid(zx_handle_t handle_value) {
+    {
+        Handle::LookupGuard lookup;
+        if (likely(GetHandleLockFree(handle_value, lookup) != nullptr))
+            return true;
+    }
     Guard<fbl::Mutex> guard{&handle_table_lock_};
     return (GetHandleLocked(handle_value) != nullptr);
 }
 
 bool ProcessDispatcher::IsHandleValidNoPolicyCheck(zx_handle_t handle_value) {
-    Guard<fbl::Mutex> guard{&handle_table_lock_};
-    return (GetHandleLocked(handle_value, true) != nullptr);
+    Handle::LookupGuard lookup;
+    return (GetHandleLockFree(handle_value, lookup) != nullptr);
 }
 
 void ProcessDispatcher::OnProcessStartForJobDebugger(ThreadDispatcher *t) {
@@ -11,17 +11,34 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/ref_ptr.h>
 
+#include <kernel/sched.h>
 #include <object/thread_dispatcher.h>
 
 #include <zircon/rights.h>
 
+static_assert(sizeof(zx_profile_deadline_t) == sizeof(zx_profile_scheduler_t),
+              "deadline profiles must not change the size of zx_profile_info_t");
+
 zx_status_t validate_profile(const zx_profile_info_t& info) {
-    if (info.type != ZX_PROFILE_INFO_SCHEDULER)
+    switch (info.type) {
+    case ZX_PROFILE_INFO_SCHEDULER:
+        if ((info.scheduler.priority < LOWEST_PRIORITY) ||
+            (info.scheduler.priority  > HIGHEST_PRIORITY))
+            return ZX_ERR_INVALID_ARGS;
+        return ZX_OK;
+    case ZX_PROFILE_INFO_DEADLINE:
+        if (!sched_fair_enabled())
+            return ZX_ERR_NOT_SUPPORTED;
+        if ((info.deadline.capacity == 0) ||
+            (info.deadline.capacity >= info.deadline.deadline) ||
+            (info.deadline.deadline > info.deadline.period) ||
+            (info.deadline.period >= ZX_SEC(1)) ||
+            (info.deadline.reserved != 0))
+            return ZX_ERR_INVALID_ARGS;
+        return ZX_OK;
+    default:
         return ZX_ERR_NOT_SUPPORTED;
-    if ((info.scheduler.priority < LOWEST_PRIORITY) ||
-        (info.scheduler.priority  > HIGHEST_PRIORITY))
-        return ZX_ERR_INVALID_ARGS;
-    return ZX_OK;
+    }
 }
 
 zx_status_t ProfileDispatcher::Create(const zx_profile_info_t& info,
@@ -48,6 +65,12 @@ ProfileDispatcher::~ProfileDispatcher() {
 }
 
 zx_status_t ProfileDispatcher::ApplyProfile(fbl::RefPtr<ThreadDispatcher> thread) {
-    // At the moment, the only thing we support is the priority.
-    return thread->SetPriority(info_.scheduler.priority);
+    switch (info_.type) {
+    case ZX_PROFILE_INFO_DEADLINE:
+        return thread->SetDeadline(info_.deadline.capacity, info_.deadline.deadline,
+                                   info_.deadline.period);
+    default:
+        // Of the scheduler parameters, the only thing we support is the priority.
+        return thread->SetPriority(info_.scheduler.priority);
+    }
 }
@@ -128,8 +128,7 @@ static zx_status_t channel_read(zx_handle_t handle_value, uint32_t options,
     if (result != ZX_OK)
         return result;
 
-    // Currently MAY_DISCARD is the only allowable option.
-    if (options & ~ZX_CHANNEL_READ_MAY_DISCARD)
+    if (options & ~(ZX_CHANNEL_READ_MAY_DISCARD | ZX_CHANNEL_READ_REMAP_PAGES))
         return ZX_ERR_NOT_SUPPORTED;
 
     MessagePacketPtr msg;
@@ -155,7 +154,10 @@ static zx_status_t channel_read(zx_handle_t handle_value, uint32_t options,
         return result;
 
     if (num_bytes > 0u) {
-        if (msg->CopyDataTo(bytes) != ZX_OK)
+        zx_status_t status = (options & ZX_CHANNEL_READ_REMAP_PAGES)
+                                 ? msg->MapDataTo(up->aspace().get(), bytes)
+                                 : msg->CopyDataTo(bytes);
+        if (status != ZX_OK)
             return ZX_ERR_INVALID_ARGS;
     }
 
@@ -192,6 +194,90 @@ zx_status_t sys_channel_read_etc(zx_handle_t handle_value, uint32_t options,
         bytes, handle_info, num_bytes, num_handles, actual_bytes, actual_handles);
 }
 
+// zx_status_t zx_channel_read_many
+zx_status_t sys_channel_read_many(zx_handle_t handle_value, uint32_t options,
+                                  user_inout_ptr<zx_channel_msg_t> user_msgs,
+                                  uint32_t num_msgs,
+                                  user_out_ptr<uint32_t> actual_msgs) {
+    LTRACEF("handle %x msgs %p num_msgs %u\n", handle_value, user_msgs.get(), num_msgs);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<ChannelDispatcher> channel;
+    zx_status_t result = up->GetDispatcherWithRights(handle_value, ZX_RIGHT_READ, &channel);
+    if (result != ZX_OK)
+        return result;
+
+    if (options != 0u)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    if (num_msgs == 0u)
+        return ZX_ERR_INVALID_ARGS;
+    if (num_msgs > ZX_CHANNEL_MAX_BATCH_MSGS)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    zx_channel_msg_t msgs[ZX_CHANNEL_MAX_BATCH_MSGS];
+    if (user_msgs.copy_array_from_user(msgs, num_msgs) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+
+    uint32_t num_bytes[ZX_CHANNEL_MAX_BATCH_MSGS];
+    uint32_t num_handles[ZX_CHANNEL_MAX_BATCH_MSGS];
+    for (uint32_t i = 0; i < num_msgs; ++i) {
+        num_bytes[i] = msgs[i].num_bytes;
+        num_handles[i] = msgs[i].num_handles;
+    }
+
+    MessagePacketPtr packets[ZX_CHANNEL_MAX_BATCH_MSGS];
+    size_t count;
+    result = channel->ReadMany(up->get_koid(), num_bytes, num_handles, packets, num_msgs, &count);
+    if (result != ZX_OK && result != ZX_ERR_BUFFER_TOO_SMALL)
+        return result;
+
+    // On ZX_ERR_BUFFER_TOO_SMALL, ReadMany() gives us the size of the next message, which
+    // remains unconsumed, in the first entry.
+    if (result == ZX_ERR_BUFFER_TOO_SMALL) {
+        msgs[0].num_bytes = num_bytes[0];
+        msgs[0].num_handles = num_handles[0];
+        zx_status_t status = user_msgs.copy_to_user(msgs[0]);
+        if (status != ZX_OK)
+            return status;
+        if (actual_msgs) {
+            status = actual_msgs.copy_to_user(0u);
+            if (status != ZX_OK)
+                return status;
+        }
+        return result;
+    }
+
+    // As with channel_read(), a message that cannot be copied out is lost, and so
+    // are the ones after it in this batch.
+    for (size_t i = 0; i < count; ++i) {
+        if (num_bytes[i] > 0u) {
+            if (packets[i]->CopyDataTo(make_user_out_ptr(msgs[i].bytes)) != ZX_OK)
+                return ZX_ERR_INVALID_ARGS;
+        }
+        if (num_handles[i] > 0u) {
+            msg_get_handles(up, packets[i].get(), make_user_out_ptr(msgs[i].handles),
+                            num_handles[i]);
+        }
+        msgs[i].num_bytes = num_bytes[i];
+        msgs[i].num_handles = num_handles[i];
+
+        record_recv_msg_sz(num_bytes[i]);
+        ktrace(TAG_CHANNEL_READ, (uint32_t)channel->get_koid(), num_bytes[i], num_handles[i], 0);
+    }
+
+    zx_status_t status = user_msgs.copy_array_to_user(msgs, count);
+    if (status != ZX_OK)
+        return status;
+    if (actual_msgs) {
+        status = actual_msgs.copy_to_user(static_cast<uint32_t>(count));
+        if (status != ZX_OK)
+            return status;
+    }
+    return ZX_OK;
+}
+
 static zx_status_t channel_read_out(ProcessDispatcher* up,
                                     MessagePacketPtr reply,
                                     zx_channel_call_args_t* args,
@@ -288,7 +374,7 @@ zx_status_t sys_channel_write(zx_handle_t handle_value, uint32_t options,
 
     auto cleanup = fbl::MakeAutoCall([&]() { up->RemoveHandles(user_handles, num_handles); });
 
-    if (options != 0u) {
+    if (options & ~ZX_CHANNEL_WRITE_DONATE_PAGES) {
         return ZX_ERR_INVALID_ARGS;
     }
 
@@ -299,7 +385,12 @@ zx_status_t sys_channel_write(zx_handle_t handle_value, uint32_t options,
     }
 
     MessagePacketPtr msg;
-    status = MessagePacket::Create(user_bytes, num_bytes, num_handles, &msg);
+    if (options & ZX_CHANNEL_WRITE_DONATE_PAGES) {
+        status = MessagePacket::CreateFromPages(up->aspace().get(), user_bytes, num_bytes,
+                                                num_handles, &msg);
+    } else {
+        status = MessagePacket::Create(user_bytes, num_bytes, num_handles, &msg);
+    }
     if (status != ZX_OK) {
         return status;
     }
@@ -323,6 +414,77 @@ zx_status_t sys_channel_write(zx_handle_t handle_value, uint32_t options,
     return ZX_OK;
 }
 
+// zx_status_t zx_channel_write_many
+zx_status_t sys_channel_write_many(zx_handle_t handle_value, uint32_t options,
+                                   user_in_ptr<const zx_channel_msg_t> user_msgs,
+                                   uint32_t num_msgs) {
+    LTRACEF("handle %x msgs %p num_msgs %u options 0x%x\n",
+            handle_value, user_msgs.get(), num_msgs, options);
+
+    // The handles to consume are only known once the descriptors have been
+    // read, so a batch that is empty, too large or unreadable consumes nothing.
+    if (num_msgs == 0u)
+        return ZX_ERR_INVALID_ARGS;
+    if (num_msgs > ZX_CHANNEL_MAX_BATCH_MSGS)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    zx_channel_msg_t msgs[ZX_CHANNEL_MAX_BATCH_MSGS];
+    if (user_msgs.copy_array_from_user(msgs, num_msgs) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // Messages before |consumed| have had their handles taken by msg_put_handles().
+    uint32_t consumed = 0u;
+    auto cleanup = fbl::MakeAutoCall([&]() {
+        for (uint32_t i = consumed; i < num_msgs; ++i) {
+            up->RemoveHandles(make_user_in_ptr(static_cast<const zx_handle_t*>(msgs[i].handles)),
+                              msgs[i].num_handles);
+        }
+    });
+
+    if (options != 0u) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    fbl::RefPtr<ChannelDispatcher> channel;
+    zx_status_t status = up->GetDispatcherWithRights(handle_value, ZX_RIGHT_WRITE, &channel);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    // Prepare every message before writing any, so that the batch is all or nothing.
+    MessagePacketPtr packets[ZX_CHANNEL_MAX_BATCH_MSGS];
+    for (uint32_t i = 0; i < num_msgs; ++i) {
+        status = MessagePacket::Create(make_user_in_ptr(static_cast<const void*>(msgs[i].bytes)),
+                                       msgs[i].num_bytes, msgs[i].num_handles, &packets[i]);
+        if (status != ZX_OK) {
+            return status;
+        }
+
+        consumed = i + 1;
+
+        if (msgs[i].num_handles > 0u) {
+            status = msg_put_handles(up, packets[i].get(),
+                                     make_user_in_ptr(static_cast<const zx_handle_t*>(msgs[i].handles)),
+                                     msgs[i].num_handles, static_cast<Dispatcher*>(channel.get()));
+            if (status != ZX_OK)
+                return status;
+        }
+    }
+    cleanup.cancel();
+
+    status = channel->WriteMany(up->get_koid(), packets, num_msgs);
+    if (status != ZX_OK)
+        return status;
+
+    for (uint32_t i = 0; i < num_msgs; ++i) {
+        ktrace(TAG_CHANNEL_WRITE, (uint32_t)channel->get_koid(),
+               msgs[i].num_bytes, msgs[i].num_handles, 0);
+    }
+    return ZX_OK;
+}
+
 // zx_status_t zx_channel_call_noretry
 zx_status_t sys_channel_call_noretry(zx_handle_t handle_value, uint32_t options,
                                      zx_time_t deadline,
@@ -528,7 +528,11 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
         stats.total_bytes = total * PAGE_SIZE;
         size_t other_bytes = stats.total_bytes;
 
-        stats.free_bytes = state_count[VM_PAGE_STATE_FREE] * PAGE_SIZE;
+        // Pages parked in the pmm's per-cpu caches and pre-zeroed pool are
+        // free as far as userspace is concerned.
+        stats.free_bytes = (state_count[VM_PAGE_STATE_FREE] +
+                            state_count[VM_PAGE_STATE_FREE_CACHED] +
+                            state_count[VM_PAGE_STATE_FREE_ZEROED]) * PAGE_SIZE;
         other_bytes -= stats.free_bytes;
 
         stats.wired_bytes = state_count[VM_PAGE_STATE_WIRED] * PAGE_SIZE;
@@ -111,3 +111,44 @@ zx_status_t sys_pager_supply_pages(zx_handle_t pager, zx_handle_t pager_vmo,
 
     return pager_vmo_dispatcher->vmo()->SupplyPages(offset, size, &pages);
 }
+
+// zx_status_t zx_pager_op_range
+zx_status_t sys_pager_op_range(zx_handle_t pager, uint32_t op, zx_handle_t pager_vmo,
+                               uint64_t offset, uint64_t length, uint64_t data) {
+    auto up = ProcessDispatcher::GetCurrent();
+    fbl::RefPtr<PagerDispatcher> pager_dispatcher;
+    zx_status_t status = up->GetDispatcher(pager, &pager_dispatcher);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    fbl::RefPtr<VmObjectDispatcher> pager_vmo_dispatcher;
+    status = up->GetDispatcher(pager_vmo, &pager_vmo_dispatcher);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    if (pager_vmo_dispatcher->vmo()->get_page_source_id() != pager_dispatcher->get_koid()) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(length)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    switch (op) {
+    case ZX_PAGER_OP_FAIL: {
+        // Only errors that describe the pager failing to read the pages can be
+        // passed on to whatever is waiting for them.
+        const zx_status_t error_status = static_cast<zx_status_t>(data);
+        if (static_cast<uint64_t>(error_status) != data ||
+            (error_status != ZX_ERR_IO && error_status != ZX_ERR_IO_DATA_INTEGRITY &&
+             error_status != ZX_ERR_BAD_STATE)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        return pager_vmo_dispatcher->vmo()->FailPageRequests(offset, length, error_status);
+    }
+    default:
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+}
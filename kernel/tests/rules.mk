@@ -21,6 +21,7 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/preempt_disable_tests.cpp \
     $(LOCAL_DIR)/printf_tests.cpp \
     $(LOCAL_DIR)/resource_tests.cpp \
+    $(LOCAL_DIR)/sched_tests.cpp \
     $(LOCAL_DIR)/sleep_tests.cpp \
     $(LOCAL_DIR)/string_tests.cpp \
     $(LOCAL_DIR)/sync_ipi_tests.cpp \
@@ -0,0 +1,253 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <fbl/atomic.h>
+#include <inttypes.h>
+#include <kernel/cpu.h>
+#include <kernel/mp.h>
+#include <kernel/sched.h>
+#include <kernel/thread.h>
+#include <lib/unittest/unittest.h>
+#include <zircon/types.h>
+
+namespace {
+
+struct spinner_args {
+    fbl::atomic<bool>* stop;
+    zx_duration_t runtime;
+};
+
+// Burns cpu until told to stop, then records how much cpu time it got.
+int spinner_thread(void* arg) {
+    auto* args = static_cast<spinner_args*>(arg);
+    while (!args->stop->load()) {
+    }
+    args->runtime = thread_runtime(get_current_thread());
+    return 0;
+}
+
+// Runs one spinner per entry of |priorities| on the same cpu for |duration|,
+// filling in |runtimes| with the cpu time each one got.
+bool run_spinners(const int* priorities, zx_duration_t* runtimes, size_t count,
+                  zx_duration_t duration) {
+    BEGIN_TEST;
+
+    // use the highest active cpu so the boot cpu's housekeeping does not skew the result
+    cpu_mask_t cpu = cpu_num_to_mask(highest_cpu_set(mp_get_active_mask()));
+
+    fbl::atomic<bool> stop(false);
+    spinner_args args[4];
+    thread_t* threads[4];
+    ASSERT_LE(count, countof(threads), "");
+
+    for (size_t i = 0; i < count; i++) {
+        args[i] = {&stop, 0};
+        threads[i] = thread_create("spinner", spinner_thread, &args[i], priorities[i]);
+        ASSERT_NONNULL(threads[i], "");
+        thread_set_cpu_affinity(threads[i], cpu);
+    }
+    for (size_t i = 0; i < count; i++) {
+        thread_resume(threads[i]);
+    }
+
+    thread_sleep_relative(duration);
+    stop.store(true);
+
+    for (size_t i = 0; i < count; i++) {
+        ASSERT_EQ(ZX_OK, thread_join(threads[i], nullptr, ZX_TIME_INFINITE), "");
+        runtimes[i] = args[i].runtime;
+    }
+
+    END_TEST;
+}
+
+// Two cpu bound threads sharing a cpu should split it according to the
+// weights of their priorities under the fair scheduler.
+bool fair_share_test() {
+    BEGIN_TEST;
+
+    if (!sched_fair_enabled()) {
+        unittest_printf("fair scheduler not enabled, skipping\n");
+        END_TEST;
+    }
+
+    // four levels apart is a weight ratio of ~2.4
+    const int priorities[] = {DEFAULT_PRIORITY, DEFAULT_PRIORITY + 4};
+    zx_duration_t runtimes[countof(priorities)];
+    ASSERT_TRUE(run_spinners(priorities, runtimes, countof(priorities), ZX_MSEC(500)), "");
+
+    ASSERT_GT(runtimes[0], 0, "low priority thread starved");
+    uint64_t ratio_x100 = runtimes[1] * 100 / runtimes[0];
+    unittest_printf("runtimes %" PRId64 " %" PRId64 " ratio %" PRIu64 "/100\n",
+                    runtimes[0], runtimes[1], ratio_x100);
+    EXPECT_GE(ratio_x100, 150u, "high priority thread got too little");
+    EXPECT_LE(ratio_x100, 400u, "high priority thread got too much");
+
+    END_TEST;
+}
+
+// The priority scheduler lets the higher priority thread monopolize the cpu,
+// the fair scheduler must not starve the lower one.
+bool fair_no_starvation_test() {
+    BEGIN_TEST;
+
+    if (!sched_fair_enabled()) {
+        unittest_printf("fair scheduler not enabled, skipping\n");
+        END_TEST;
+    }
+
+    const int priorities[] = {LOW_PRIORITY, HIGH_PRIORITY};
+    zx_duration_t runtimes[countof(priorities)];
+    ASSERT_TRUE(run_spinners(priorities, runtimes, countof(priorities), ZX_MSEC(500)), "");
+
+    EXPECT_GT(runtimes[0], ZX_MSEC(1), "low priority thread starved");
+
+    END_TEST;
+}
+
+// A deadline thread gets at least its reserved share of a cpu it shares with
+// a thread of much higher priority.
+bool deadline_reservation_test() {
+    BEGIN_TEST;
+
+    if (!sched_fair_enabled()) {
+        thread_t* t = get_current_thread();
+        EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, thread_set_deadline(t, ZX_MSEC(1), ZX_MSEC(2), ZX_MSEC(4)),
+                  "deadlines need the fair scheduler");
+        END_TEST;
+    }
+
+    // bad parameters are rejected
+    thread_t* self = get_current_thread();
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, thread_set_deadline(self, 0, ZX_MSEC(2), ZX_MSEC(4)), "");
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, thread_set_deadline(self, ZX_MSEC(3), ZX_MSEC(2), ZX_MSEC(4)), "");
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, thread_set_deadline(self, ZX_MSEC(2), ZX_MSEC(2), ZX_MSEC(4)), "");
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, thread_set_deadline(self, ZX_MSEC(1), ZX_MSEC(5), ZX_MSEC(4)), "");
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, thread_set_deadline(self, ZX_MSEC(1), ZX_MSEC(2), ZX_SEC(2)), "");
+
+    cpu_mask_t cpu = cpu_num_to_mask(highest_cpu_set(mp_get_active_mask()));
+    fbl::atomic<bool> stop(false);
+    spinner_args args[2] = {{&stop, 0}, {&stop, 0}};
+
+    // reserve 3ms out of every 10ms for the lowest priority thread
+    thread_t* reserved = thread_create("reserved", spinner_thread, &args[0], LOWEST_PRIORITY + 1);
+    ASSERT_NONNULL(reserved, "");
+    thread_t* hog = thread_create("hog", spinner_thread, &args[1], HIGHEST_PRIORITY - 1);
+    ASSERT_NONNULL(hog, "");
+    thread_set_cpu_affinity(reserved, cpu);
+    thread_set_cpu_affinity(hog, cpu);
+    ASSERT_EQ(ZX_OK, thread_set_deadline(reserved, ZX_MSEC(3), ZX_MSEC(10), ZX_MSEC(10)), "");
+
+    thread_resume(reserved);
+    thread_resume(hog);
+    thread_sleep_relative(ZX_MSEC(500));
+    stop.store(true);
+
+    ASSERT_EQ(ZX_OK, thread_join(reserved, nullptr, ZX_TIME_INFINITE), "");
+    ASSERT_EQ(ZX_OK, thread_join(hog, nullptr, ZX_TIME_INFINITE), "");
+
+    // allow for the periods lost to startup and wind down
+    unittest_printf("reserved %" PRId64 " hog %" PRId64 "\n", args[0].runtime, args[1].runtime);
+    EXPECT_GE(args[0].runtime, ZX_MSEC(100), "reserved thread did not get its share");
+
+    END_TEST;
+}
+
+// Deadline threads are only admitted to a cpu while their reservations fit on it,
+// and give them up when they exit.
+bool deadline_admission_test() {
+    BEGIN_TEST;
+
+    if (!sched_fair_enabled()) {
+        unittest_printf("need the fair scheduler, skipping\n");
+        END_TEST;
+    }
+
+    cpu_mask_t cpu = cpu_num_to_mask(highest_cpu_set(mp_get_active_mask()));
+    fbl::atomic<bool> stop(true);
+    spinner_args args[2] = {{&stop, 0}, {&stop, 0}};
+    thread_t* threads[2];
+    for (size_t i = 0; i < countof(threads); i++) {
+        threads[i] = thread_create("admission", spinner_thread, &args[i], DEFAULT_PRIORITY);
+        ASSERT_NONNULL(threads[i], "");
+        thread_set_cpu_affinity(threads[i], cpu);
+    }
+
+    ASSERT_EQ(ZX_OK, thread_set_deadline(threads[0], ZX_MSEC(6), ZX_MSEC(10), ZX_MSEC(10)), "");
+    EXPECT_EQ(ZX_ERR_NO_RESOURCES,
+              thread_set_deadline(threads[1], ZX_MSEC(6), ZX_MSEC(10), ZX_MSEC(10)), "");
+    EXPECT_EQ(ZX_OK, thread_set_deadline(threads[1], ZX_MSEC(2), ZX_MSEC(10), ZX_MSEC(10)), "");
+
+    // changing a reservation counts the old one as given up
+    EXPECT_EQ(ZX_OK, thread_set_deadline(threads[0], ZX_USEC(6500), ZX_MSEC(10), ZX_MSEC(10)), "");
+    EXPECT_EQ(ZX_OK, thread_set_deadline(threads[0], 0, 0, 0), "");
+    EXPECT_EQ(ZX_OK, thread_set_deadline(threads[1], ZX_MSEC(8), ZX_MSEC(10), ZX_MSEC(10)), "");
+
+    // exiting hands the reservation back
+    thread_resume(threads[1]);
+    ASSERT_EQ(ZX_OK, thread_join(threads[1], nullptr, ZX_TIME_INFINITE), "");
+    EXPECT_EQ(ZX_OK, thread_set_deadline(threads[0], ZX_MSEC(8), ZX_MSEC(10), ZX_MSEC(10)), "");
+    thread_resume(threads[0]);
+    ASSERT_EQ(ZX_OK, thread_join(threads[0], nullptr, ZX_TIME_INFINITE), "");
+
+    END_TEST;
+}
+
+// Two cpu bound threads that start out queued on the same cpu should end up
+// running in parallel once they are allowed onto a second, idle cpu.
+bool balance_test() {
+    BEGIN_TEST;
+
+    cpu_mask_t active = mp_get_active_mask();
+    if ((active & (active - 1)) == 0) {
+        unittest_printf("need at least two cpus, skipping\n");
+        END_TEST;
+    }
+    cpu_mask_t first = cpu_num_to_mask(lowest_cpu_set(active));
+    cpu_mask_t second = cpu_num_to_mask(highest_cpu_set(active));
+
+    fbl::atomic<bool> stop(false);
+    spinner_args args[2] = {{&stop, 0}, {&stop, 0}};
+    thread_t* threads[2];
+    for (size_t i = 0; i < countof(threads); i++) {
+        threads[i] = thread_create("balance", spinner_thread, &args[i], DEFAULT_PRIORITY);
+        ASSERT_NONNULL(threads[i], "");
+        thread_set_cpu_affinity(threads[i], first);
+    }
+    for (size_t i = 0; i < countof(threads); i++) {
+        thread_resume(threads[i]);
+    }
+    thread_sleep_relative(ZX_MSEC(10));
+
+    // widening the affinity leaves both threads where they are, it is up to the
+    // balancer or an idle cpu to spread them out
+    for (size_t i = 0; i < countof(threads); i++) {
+        thread_set_cpu_affinity(threads[i], first | second);
+    }
+    thread_sleep_relative(ZX_MSEC(200));
+    stop.store(true);
+
+    for (size_t i = 0; i < countof(threads); i++) {
+        ASSERT_EQ(ZX_OK, thread_join(threads[i], nullptr, ZX_TIME_INFINITE), "");
+    }
+
+    // sharing one cpu they could not have gotten more than the 210ms that passed
+    zx_duration_t total = args[0].runtime + args[1].runtime;
+    unittest_printf("runtimes %" PRId64 " %" PRId64 "\n", args[0].runtime, args[1].runtime);
+    EXPECT_GE(total, ZX_MSEC(250), "threads were not spread across cpus");
+
+    END_TEST;
+}
+
+} // namespace
+
+UNITTEST_START_TESTCASE(sched_tests)
+UNITTEST("fair_share", fair_share_test)
+UNITTEST("fair_no_starvation", fair_no_starvation_test)
+UNITTEST("deadline_reservation", deadline_reservation_test)
+UNITTEST("deadline_admission", deadline_admission_test)
+UNITTEST("balance", balance_test)
+UNITTEST_END_TESTCASE(sched_tests, "sched", "Scheduler tests");
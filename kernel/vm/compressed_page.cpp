@@ -0,0 +1,110 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/compressed_page.h>
+
+#include <assert.h>
+#include <fbl/alloc_checker.h>
+#include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <kernel/mutex.h>
+#include <lib/counters.h>
+#include <lk/init.h>
+#include <lz4/lz4.h>
+#include <platform.h>
+#include <string.h>
+#include <trace.h>
+#include <vm/physmap.h>
+#include <vm/vm.h>
+
+#include "vm_priv.h"
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+// The compression ratio is bytes_in / bytes_out, and the average time taken
+// to bring a page back is decompress_ns / decompressed.
+KCOUNTER(compression_compressed, "kernel.vm.compression.compressed");
+KCOUNTER(compression_rejected, "kernel.vm.compression.rejected");
+KCOUNTER(compression_bytes_in, "kernel.vm.compression.bytes_in");
+KCOUNTER(compression_bytes_out, "kernel.vm.compression.bytes_out");
+KCOUNTER(compression_decompressed, "kernel.vm.compression.decompressed");
+KCOUNTER(compression_decompress_ns, "kernel.vm.compression.decompress_ns");
+
+namespace {
+
+// Pages that don't compress to at most this size are left alone, since
+// little would be saved once the heap's overhead is taken into account.
+constexpr size_t kMaxCompressedSize = PAGE_SIZE * 3 / 4;
+
+// Set by kernel.vm.compression.
+bool compression_enabled = true;
+
+// Scratch space for the compressor, which is too big for the stack.
+DECLARE_SINGLETON_MUTEX(CompressLock);
+uint64_t compress_state[LZ4_STREAMSIZE_U64] TA_GUARDED(CompressLock::Get());
+char compress_buf[LZ4_COMPRESSBOUND(PAGE_SIZE)] TA_GUARDED(CompressLock::Get());
+
+void compressed_page_init(uint level) {
+    compression_enabled = cmdline_get_bool("kernel.vm.compression", compression_enabled);
+}
+
+} // namespace
+
+LK_INIT_HOOK(compressed_page, compressed_page_init, LK_INIT_LEVEL_VM);
+
+bool CompressedPage::Enabled() {
+    return compression_enabled;
+}
+
+ktl::unique_ptr<CompressedPage> CompressedPage::Compress(uint64_t offset, paddr_t pa) {
+    if (!compression_enabled) {
+        return nullptr;
+    }
+
+    const char* src = static_cast<const char*>(paddr_to_physmap(pa));
+    DEBUG_ASSERT(src);
+
+    Guard<fbl::Mutex> guard{CompressLock::Get()};
+
+    int size = LZ4_compress_fast_extState(compress_state, src, compress_buf,
+                                          PAGE_SIZE, kMaxCompressedSize, 1);
+    if (size <= 0) {
+        kcounter_add(compression_rejected, 1);
+        return nullptr;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::Array<uint8_t> data(new (&ac) uint8_t[size], size);
+    if (!ac.check()) {
+        return nullptr;
+    }
+    memcpy(data.get(), compress_buf, size);
+
+    ktl::unique_ptr<CompressedPage> page(new (&ac) CompressedPage(offset, ktl::move(data)));
+    if (!ac.check()) {
+        return nullptr;
+    }
+
+    LTRACEF("offset %#" PRIx64 " compressed to %d bytes\n", offset, size);
+
+    kcounter_add(compression_compressed, 1);
+    kcounter_add(compression_bytes_in, PAGE_SIZE);
+    kcounter_add(compression_bytes_out, size);
+    return page;
+}
+
+void CompressedPage::Decompress(paddr_t pa) const {
+    char* dst = static_cast<char*>(paddr_to_physmap(pa));
+    DEBUG_ASSERT(dst);
+
+    const zx_time_t start = current_time();
+    int size = LZ4_decompress_safe(reinterpret_cast<const char*>(data_.get()), dst,
+                                   static_cast<int>(data_.size()), PAGE_SIZE);
+    ASSERT_MSG(size == PAGE_SIZE, "corrupt compressed page at offset %#" PRIx64 "\n", offset_);
+
+    kcounter_add(compression_decompressed, 1);
+    kcounter_add(compression_decompress_ns, current_time() - start);
+}
@@ -0,0 +1,44 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/array.h>
+#include <fbl/intrusive_wavl_tree.h>
+#include <fbl/macros.h>
+#include <ktl/move.h>
+#include <ktl/unique_ptr.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// The contents of a page of an anonymous VMO, compressed with LZ4, which the
+// VMO keeps in place of the page while it is not being used.
+class CompressedPage final
+    : public fbl::WAVLTreeContainable<ktl::unique_ptr<CompressedPage>> {
+public:
+    // Compresses the page at |pa|, which is at |offset| in its VMO.  Returns
+    // null if the page doesn't compress well enough to be worth it, if
+    // compression is disabled, or if there's no memory for the result.
+    static ktl::unique_ptr<CompressedPage> Compress(uint64_t offset, paddr_t pa);
+
+    // Whether compression is enabled, as set by kernel.vm.compression.
+    static bool Enabled();
+
+    // Writes the original contents back into the page at |pa|.
+    void Decompress(paddr_t pa) const;
+
+    uint64_t GetKey() const { return offset_; }
+    size_t compressed_size() const { return data_.size(); }
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(CompressedPage);
+
+private:
+    CompressedPage(uint64_t offset, fbl::Array<uint8_t> data)
+        : offset_(offset), data_(ktl::move(data)) {}
+
+    const uint64_t offset_;
+    const fbl::Array<uint8_t> data_;
+};
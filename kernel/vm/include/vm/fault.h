@@ -19,6 +19,9 @@ const uint VMM_PF_FLAG_NOT_PRESENT = (1u << 4);
 const uint VMM_PF_FLAG_HW_FAULT = (1u << 5); // hardware is requesting a fault
 const uint VMM_PF_FLAG_SW_FAULT = (1u << 6); // software fault
 const uint VMM_PF_FLAG_FAULT_MASK = (VMM_PF_FLAG_HW_FAULT | VMM_PF_FLAG_SW_FAULT);
+// a clone is faulting: its parent mustn't commit new pages, but has to bring back
+// compressed ones rather than let the clone see through them
+const uint VMM_PF_FLAG_CHILD_FAULT = (1u << 7);
 
 // convenience routine for converting page fault flags to a string
 static const char* vmm_pf_flags_to_string(uint pf_flags, char str[5]) {
@@ -22,11 +22,13 @@ enum vm_page_state {
     VM_PAGE_STATE_MMU,   // allocated to serve arch-specific mmu purposes
     VM_PAGE_STATE_IOMMU, // allocated for platform-specific iommu structures
     VM_PAGE_STATE_IPC,
+    VM_PAGE_STATE_FREE_CACHED, // free, but parked in a pmm per cpu cache
+    VM_PAGE_STATE_FREE_ZEROED, // free and zeroed, parked in the pmm's pre-zeroed pool
 
     VM_PAGE_STATE_COUNT_
 };
 
-#define VM_PAGE_STATE_BITS 3
+#define VM_PAGE_STATE_BITS 4
 static_assert((1u << VM_PAGE_STATE_BITS) >= VM_PAGE_STATE_COUNT_, "");
 
 // core per page structure allocated at pmm arena creation time
@@ -47,6 +49,12 @@ typedef struct vm_page {
 #define VM_PAGE_OBJECT_MAX_PIN_COUNT ((1ul << VM_PAGE_OBJECT_PIN_COUNT_BITS) - 1)
 
             uint8_t pin_count : VM_PAGE_OBJECT_PIN_COUNT_BITS;
+            // Pages of pager-backed VMOs only: set when the page is looked up
+            // and cleared when the page reclaimer ages it.
+            uint8_t accessed : 1;
+            // Pages of pager-backed VMOs only: set once the page has been
+            // written, after which it can't be evicted.
+            uint8_t dirty : 1;
         } object; // attached to a vm object
     };
 
@@ -36,6 +36,11 @@
 //      any PageRequests that have been fulfilled.
 //   6) The caller wakes up and queries the vm object again, by which
 //      point the request page will be present.
+//
+// If whatever is backing the callback can't provide the pages, it fails the
+// request instead (e.g. with VmObjectPaged::FailPageRequests), and the vm
+// object calls PageSource::OnPagesFailed. The caller then wakes up with the
+// error rather than querying the vm object again.
 
 class PageRequest;
 
@@ -89,6 +94,10 @@ public:
     // been supplied to the owning vmo.
     void OnPagesSupplied(uint64_t offset, uint64_t len);
 
+    // Fails any outstanding requests for pages in [offset, len), waking them
+    // up with |error_status|.
+    void OnPagesFailed(uint64_t offset, uint64_t len, zx_status_t error_status);
+
     // Closes the source. All pending transactions will be aborted and all future
     // calls will fail.
     void Close();
@@ -106,8 +115,9 @@ private:
     // Tree of pending_request structs which have been sent to the callback.
     fbl::WAVLTree<uint64_t, PageRequest*> outstanding_requests_ TA_GUARDED(mtx_);
 
-    // Wakes up the given PageRequest and all overlapping requests.
-    void CompleteRequestLocked(PageRequest* head) TA_REQ(mtx_);
+    // Wakes up the given PageRequest and all overlapping requests, which
+    // will return |status| from PageRequest::Wait.
+    void CompleteRequestLocked(PageRequest* head, zx_status_t status = ZX_OK) TA_REQ(mtx_);
 
     // Removes |request| from any internal tracking. Called by a PageRequest if
     // it needs to abort itself.
@@ -123,7 +133,8 @@ public:
     explicit PageRequest() {}
     ~PageRequest();
 
-    // Returns ZX_OK on success or ZX_ERR_INTERNAL_INTR_KILLED if the thread was killed.
+    // Returns ZX_OK on success, ZX_ERR_INTERNAL_INTR_KILLED if the thread was killed,
+    // or the error the request was failed with.
     zx_status_t Wait();
 
     uint64_t GetKey() const { return offset_; }
@@ -139,6 +150,8 @@ private:
     event_t event_;
     // PageRequests are active if offset_ is not UINT64_MAX.
     uint64_t offset_ = UINT64_MAX;
+    // The status Wait returns once event_ has been signaled.
+    zx_status_t complete_status_ = ZX_OK;
 
     // List node for overlapping requests.
     fbl::DoublyLinkedList<PageRequest*> overlap_;
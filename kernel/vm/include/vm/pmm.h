@@ -32,6 +32,8 @@ zx_status_t pmm_add_arena(const pmm_arena_info_t* arena) __NONNULL((1));
 // flags for allocation routines below
 #define PMM_ALLOC_FLAG_ANY (0x0)    // no restrictions on which arena to allocate from
 #define PMM_ALLOC_FLAG_LO_MEM (0x1) // allocate only from arenas marked LO_MEM
+#define PMM_ALLOC_FLAG_ZEROED (0x2) // the pages must be zero filled
+#define PMM_ALLOC_FLAG_NO_DRAIN (0x4) // fail rather than drain the per cpu caches
 
 // Allocate count pages of physical memory, adding to the tail of the passed list.
 // The list must be initialized.
@@ -48,6 +50,7 @@ zx_status_t pmm_alloc_range(paddr_t address, size_t count, list_node* list) __NO
 // Allocate a run of contiguous pages, aligned on log2 byte boundary (0-31).
 // Return the base address of the run in the physical address pointer and
 // append the allocate page structures to the tail of the passed in list.
+// A zeroed run of one large page is taken out of the pre-zeroed pool if it can be.
 zx_status_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t align_log2,
                                  paddr_t* pa, list_node* list) __NONNULL((4, 5));
 
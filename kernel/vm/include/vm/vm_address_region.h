@@ -485,7 +485,10 @@ private:
     zx_status_t UnmapLocked(vaddr_t base, size_t size);
 
     // Implementation for Protect().  This does not acquire the aspace lock.
-    zx_status_t ProtectLocked(vaddr_t base, size_t size, uint new_arch_mmu_flags);
+    // Unless |update_arch| is set only the mappings are changed, and the
+    // caller has to change the page tables for the range itself.
+    zx_status_t ProtectLocked(vaddr_t base, size_t size, uint new_arch_mmu_flags,
+                              bool update_arch);
 
     // Version of AllocatedPages() that does not acquire the aspace lock
     size_t AllocatedPagesLocked() const override;
@@ -497,6 +500,18 @@ private:
     // in Clang around capability aliasing, we need to relax the analysis.
     void ActivateLocked();
 
+    // Called by PageFault() to map the whole LARGE_PAGE_SIZE run around |va|
+    // with a single large page, if the mapping covers it and object_ can back
+    // it with one.  Returns an error if PageFault() should map |va| alone.
+    // Same locking requirements as FaultAroundLocked().
+    zx_status_t LargePageFaultLocked(vaddr_t va, uint pf_flags);
+
+    // Called by PageFault() after mapping a page at |va| that was not mapped
+    // before.  Maps, read-only, the pages around |va| that object_ already has
+    // so that touching them does not fault.  Requires the aspace and object_
+    // locks, with the same analysis caveat as ActivateLocked().
+    void FaultAroundLocked(vaddr_t va);
+
     // pointer and region of the object we are mapping
     fbl::RefPtr<VmObject> object_;
     uint64_t object_offset_ = 0;
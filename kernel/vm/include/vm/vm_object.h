@@ -128,6 +128,13 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // Fails any outstanding requests for pages in the range [offset, offset + len) of
+    // this vmo's page source, so that whatever is waiting for them gets |error_status|.
+    virtual zx_status_t FailPageRequests(uint64_t offset, uint64_t len,
+                                         zx_status_t error_status) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     // The associated VmObjectDispatcher will set an observer to notify user mode.
     void SetChildObserver(VmObjectChildObserver* child_observer);
 
@@ -179,6 +186,12 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // Returns the number of clone parents between this VMO and the root of its
+    // clone tree, each of which a fault may have to look in for a page.
+    uint32_t clone_depth() const
+        // Walks the clone chain, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
     // Returns true if this VMO was created via CloneCOW().
     // TODO: If more types of clones appear, replace this with a method that
     // returns an enum rather than adding a new method for each clone type.
@@ -208,6 +221,27 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // Returns in |pa| the address of the page at |offset| if this VMO, or a
+    // parent it reads through, already has one.  Unlike GetPageLocked(), this
+    // has no side effects: it doesn't mark the page used, bring back a
+    // compressed page, or ask a page source for one.  Returns
+    // ZX_ERR_NOT_FOUND if there is no page.
+    virtual zx_status_t PeekPageLocked(uint64_t offset, paddr_t* pa) TA_REQ(lock_) {
+        return GetPageLocked(offset, 0, nullptr, nullptr, nullptr, pa);
+    }
+
+    // Returns in |pa| the base of the physically contiguous run of
+    // LARGE_PAGE_SIZE bytes backing the LARGE_PAGE_SIZE aligned |offset|,
+    // if it already is one.  On a write fault the whole run is allocated first
+    // if none of it is committed yet, or the range is moved into one if all of
+    // it is committed, but not as one run.  Returns ZX_ERR_NOT_FOUND if the
+    // range can not be backed by a large page right now, in which case the
+    // caller should fall back to GetPageLocked().
+    virtual zx_status_t GetLargePageLocked(uint64_t offset, uint pf_flags,
+                                           paddr_t* pa) TA_REQ(lock_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     Lock<fbl::Mutex>* lock() TA_RET_CAP(lock_) { return &lock_; }
     Lock<fbl::Mutex>& lock_ref() TA_RET_CAP(lock_) { return lock_; }
 
@@ -219,6 +253,12 @@ public:
     // returns true.
     bool IsMappedByUser() const;
 
+    // Returns true if this VMO, or any of its clones, which can read its pages,
+    // is mapped into a VmAspace whose is_user() returns false.
+    bool IsMappedByKernelLocked() const
+        // Walks the clone tree, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
     // Returns an estimate of the number of unique VmAspaces that this object
     // is mapped into.
     uint32_t share_count() const;
@@ -10,13 +10,16 @@
 #include <fbl/array.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
+#include <fbl/intrusive_wavl_tree.h>
 #include <fbl/macros.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
 #include <kernel/mutex.h>
 #include <lib/user_copy/user_ptr.h>
 #include <list.h>
+#include <ktl/unique_ptr.h>
 #include <stdint.h>
+#include <vm/compressed_page.h>
 #include <vm/page_source.h>
 #include <vm/pmm.h>
 #include <vm/vm.h>
@@ -86,6 +89,7 @@ public:
 
     zx_status_t TakePages(uint64_t offset, uint64_t len, VmPageSpliceList* pages) override;
     zx_status_t SupplyPages(uint64_t offset, uint64_t len, VmPageSpliceList* pages) override;
+    zx_status_t FailPageRequests(uint64_t offset, uint64_t len, zx_status_t error_status) override;
 
     void Dump(uint depth, bool verbose) override;
 
@@ -99,6 +103,13 @@ public:
         // Calls a Locked method of the parent, which confuses analysis.
         TA_NO_THREAD_SAFETY_ANALYSIS;
 
+    zx_status_t PeekPageLocked(uint64_t offset, paddr_t* pa) override
+        // Walks the clone chain, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    zx_status_t GetLargePageLocked(uint64_t offset, uint pf_flags, paddr_t* pa) override
+        TA_REQ(lock_);
+
     zx_status_t CloneCOW(bool resizable, uint64_t offset, uint64_t size, bool copy_name,
                          fbl::RefPtr<VmObject>* clone_vmo) override
         // Calls a Locked method of the child, which confuses analysis.
@@ -118,6 +129,16 @@ public:
         return 0;
     }
 
+    // Frees up to |target| unpinned pages that VMOs have not used recently.
+    // Clean pages of pager-backed VMOs are evicted, and requested from the
+    // pager again the next time they are needed.  Pages of anonymous VMOs are
+    // compressed, and decompressed the next time they are needed.  Returns
+    // the number of pages freed.
+    static size_t ReclaimPages(size_t target);
+
+    // Like ReclaimPages(), but only looks at this VMO's pages.
+    size_t Reclaim(size_t target);
+
     // maximum size of a VMO is one page less than the full 64bit range
     static const uint64_t MAX_SIZE = ROUNDDOWN(UINT64_MAX, PAGE_SIZE);
 
@@ -168,6 +189,46 @@ private:
     // set our offset within our parent
     zx_status_t SetParentOffsetLocked(uint64_t o) TA_REQ(lock_);
 
+    // Looks for a clone in the chain from this VMO up to the root whose only
+    // reference is held by its one child, and merges it into that child.
+    // Returns the merged clone, for the caller to drop after releasing the
+    // lock, or null if there was nothing to merge.
+    fbl::RefPtr<VmObject> CollapseChainLocked()
+        // Walks the clone chain, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    // Merges our parent into this VMO if nothing else can see it, moving our
+    // reference to it into |*merged|.  Returns false if the parent has to
+    // stay.
+    bool CollapseParentLocked(fbl::RefPtr<VmObject>* merged)
+        // Touches the parent, which shares our lock but confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    // Advances the reclaim clock hand over a batch of this VMO's pages, aging
+    // the ones used since it last passed and evicting or compressing up to
+    // |target| of the ones that weren't.  A large page run is aged and
+    // compressed as a unit, so it may overshoot |target|.  Sets |*progress|
+    // if any page was aged or freed.  Returns the number of pages freed.
+    size_t ReclaimPagesLocked(size_t target, bool* progress) TA_REQ(lock_);
+
+    // Returns true if the pages at [offset, offset + LARGE_PAGE_SIZE) are all
+    // resident and make up one aligned, physically contiguous run.
+    bool IsLargeRunLocked(uint64_t offset) TA_REQ(lock_);
+
+    // Returns true if the reclaimer may compress this VMO's pages.
+    bool CanCompressLocked() const TA_REQ(lock_);
+
+    // Replaces the compressed page at |offset|, if there is one, with a page
+    // from |free_list| or the pmm.  Returns ZX_ERR_NOT_FOUND if there isn't.
+    zx_status_t DecompressPageLocked(uint64_t offset, list_node* free_list,
+                                     vm_page_t** page_out, paddr_t* pa_out) TA_REQ(lock_);
+
+    // Decompresses every compressed page in [start, end).
+    zx_status_t DecompressRangeLocked(uint64_t start, uint64_t end) TA_REQ(lock_);
+
+    // Discards every compressed page in [start, end).
+    void FreeCompressedPagesLocked(uint64_t start, uint64_t end) TA_REQ(lock_);
+
     // members
     const uint32_t options_;
     uint64_t size_ TA_GUARDED(lock_) = 0;
@@ -180,4 +241,45 @@ private:
 
     // a tree of pages
     VmPageList page_list_ TA_GUARDED(lock_);
+
+    // Pages of clone parents that were merged into this VMO, which stand in
+    // for the parent's pages at offsets this VMO has no page of its own.
+    VmPageList collapsed_pages_ TA_GUARDED(lock_);
+
+    // Offsets at or above this one read zeros rather than going to the parent,
+    // since a parent merged into this VMO was smaller than it now is.
+    uint64_t parent_limit_ TA_GUARDED(lock_) = UINT64_MAX;
+
+    // Pages that were compressed by the reclaimer, keyed by offset.  An offset
+    // is never in both this and |page_list_|.
+    fbl::WAVLTree<uint64_t, ktl::unique_ptr<CompressedPage>> compressed_pages_ TA_GUARDED(lock_);
+
+    // Offset at which ReclaimPagesLocked() resumes.
+    uint64_t reclaim_cursor_ TA_GUARDED(lock_) = 0;
+
+    // Large page ranges the pmm recently had no contiguous run for, and when
+    // GetLargePageLocked() may ask for one again.  Indexed by large page
+    // number, so a range only displaces the ones that share its slot.
+    struct LargePageBackoff {
+        uint64_t offset = UINT64_MAX;
+        zx_time_t retry = 0;
+        zx_duration_t delay = 0;
+    };
+    static constexpr size_t kLargePageBackoffSlots = 8;
+    LargePageBackoff large_page_backoff_[kLargePageBackoffSlots] TA_GUARDED(lock_);
+
+    // Per-node state for the list of all paged VMOs.
+    using ReclaimNodeState = fbl::DoublyLinkedListNodeState<VmObjectPaged*>;
+    ReclaimNodeState reclaim_list_state_;
+
+    // The list of all paged VMOs, which is what ReclaimPages() looks at.
+    // VMOs are rotated to the back as their pages are scanned.
+    struct ReclaimListTraits {
+        static ReclaimNodeState& node_state(VmObjectPaged& vmo) {
+            return vmo.reclaim_list_state_;
+        }
+    };
+    using ReclaimList = fbl::DoublyLinkedList<VmObjectPaged*, ReclaimListTraits>;
+    DECLARE_SINGLETON_MUTEX(ReclaimListLock);
+    static ReclaimList reclaim_list_ TA_GUARDED(ReclaimListLock::Get());
 };
@@ -23,7 +23,9 @@ public:
 
     DISALLOW_COPY_ASSIGN_AND_MOVE(VmPageListNode);
 
-    static const size_t kPageFanOut = 16;
+    // Each node covers 256KiB of a VMO, which keeps the tree shallow for
+    // large VMOs without wasting much on sparse ones.
+    static const size_t kPageFanOut = 64;
 
     // accessors
     uint64_t offset() const { return obj_offset_; }
@@ -218,6 +220,32 @@ public:
         return ZX_OK;
     }
 
+    // Calls |get_page(offset)| for every offset in [start_offset, end_offset)
+    // that has no page and adds the page it returns, which must not be null.
+    // Each tree node is looked up once rather than once per page.
+    template <typename F>
+    zx_status_t PopulateRange(F get_page, uint64_t start_offset, uint64_t end_offset) {
+        DEBUG_ASSERT(IS_PAGE_ALIGNED(start_offset) && IS_PAGE_ALIGNED(end_offset));
+        uint64_t offset = start_offset;
+        while (offset < end_offset) {
+            const uint64_t node_offset = ROUNDDOWN(offset, PAGE_SIZE * VmPageListNode::kPageFanOut);
+            VmPageListNode* node = GetOrAllocNode(node_offset);
+            if (!node) {
+                return ZX_ERR_NO_MEMORY;
+            }
+            const uint64_t node_end = node_offset + PAGE_SIZE * VmPageListNode::kPageFanOut;
+            for (; offset < end_offset && offset < node_end; offset += PAGE_SIZE) {
+                const size_t index = (offset - node_offset) / PAGE_SIZE;
+                if (!node->GetPage(index)) {
+                    vm_page* p = get_page(offset);
+                    DEBUG_ASSERT(p);
+                    node->AddPage(p, index);
+                }
+            }
+        }
+        return ZX_OK;
+    }
+
     zx_status_t AddPage(vm_page*, uint64_t offset);
     vm_page* GetPage(uint64_t offset);
     // Removes the page at |offset| from the list. Returns true if a page was
@@ -231,6 +259,25 @@ public:
     // Takes the pages in the range [offset, length) out of this page list.
     VmPageSpliceList TakePages(uint64_t offset, uint64_t length);
 
+    // Moves the pages of |src| in [start_offset, end_offset) into this list,
+    // the page at offset o landing at o - |shift|.  Where this list already
+    // has a page, the one in |src| is left there.  Returns ZX_ERR_NO_MEMORY,
+    // with the pages moved so far staying moved, if a node can't be allocated.
+    zx_status_t MergeFrom(VmPageList* src, uint64_t start_offset, uint64_t end_offset,
+                          uint64_t shift);
+
 private:
+    // Returns the node at |node_offset|, or null if there isn't one.
+    VmPageListNode* FindNode(uint64_t node_offset);
+    // Returns the node at |node_offset|, creating it if needed.  Returns null
+    // if there is no memory for a new node.
+    VmPageListNode* GetOrAllocNode(uint64_t node_offset);
+    // Removes |node| from the tree and returns it.
+    ktl::unique_ptr<VmPageListNode> EraseNode(VmPageListNode& node);
+
     fbl::WAVLTree<uint64_t, ktl::unique_ptr<VmPageListNode>> list_;
+
+    // The node most recently looked up, since consecutive lookups usually
+    // land in the same node.  Null if that node has been erased.
+    VmPageListNode* last_node_ = nullptr;
 };
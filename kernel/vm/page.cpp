@@ -34,6 +34,10 @@ const char* page_state_to_string(unsigned int state) {
         return "mmu";
     case VM_PAGE_STATE_IPC:
         return "ipc";
+    case VM_PAGE_STATE_FREE_CACHED:
+        return "free_cached";
+    case VM_PAGE_STATE_FREE_ZEROED:
+        return "free_zeroed";
     default:
         return "unknown";
     }
@@ -0,0 +1,72 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <err.h>
+#include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <kernel/thread.h>
+#include <lib/counters.h>
+#include <lk/init.h>
+#include <trace.h>
+#include <vm/pmm.h>
+#include <vm/vm.h>
+#include <vm/vm_object_paged.h>
+#include <zircon/time.h>
+#include <zircon/types.h>
+
+#include "vm_priv.h"
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+KCOUNTER(vm_reclaim_runs, "kernel.vm.reclaim.runs");
+
+namespace {
+
+// How often the reclaim thread checks the amount of free memory.
+constexpr zx_duration_t kReclaimInterval = ZX_MSEC(100);
+
+// Once free memory drops below |reclaim_low_pages|, clean pages of
+// pager-backed VMOs are evicted until it is back up to |reclaim_high_pages|.
+// Set by kernel.vm.reclaim.low-mb and kernel.vm.reclaim.high-mb.
+uint64_t reclaim_low_pages;
+uint64_t reclaim_high_pages;
+
+int reclaim_thread(void* arg) {
+    for (;;) {
+        const uint64_t free_pages = pmm_count_free_pages();
+        if (free_pages < reclaim_low_pages) {
+            const size_t target = reclaim_high_pages - free_pages;
+            const size_t evicted = VmObjectPaged::ReclaimPages(target);
+            kcounter_add(vm_reclaim_runs, 1);
+            LTRACEF("%" PRIu64 " pages free, evicted %zu of %zu\n", free_pages, evicted, target);
+        }
+        thread_sleep_relative(kReclaimInterval);
+    }
+    return 0;
+}
+
+void page_reclaim_init(uint level) {
+    // Be sure to update kernel_cmdline.md if any of these defaults change.
+    if (!cmdline_get_bool("kernel.vm.reclaim", true)) {
+        return;
+    }
+    reclaim_low_pages = cmdline_get_uint64("kernel.vm.reclaim.low-mb", 96) * MB / PAGE_SIZE;
+    reclaim_high_pages = cmdline_get_uint64("kernel.vm.reclaim.high-mb", 128) * MB / PAGE_SIZE;
+    if (reclaim_high_pages < reclaim_low_pages) {
+        reclaim_high_pages = reclaim_low_pages;
+    }
+
+    thread_t* t = thread_create("vm-reclaim", &reclaim_thread, nullptr, HIGH_PRIORITY);
+    if (!t) {
+        printf("VM: failed to start the page reclaim thread\n");
+        return;
+    }
+    thread_detach_and_resume(t);
+}
+
+} // namespace
+
+LK_INIT_HOOK(page_reclaim, page_reclaim_init, LK_INIT_LEVEL_THREADING);
@@ -66,6 +66,26 @@ void PageSource::OnPagesSupplied(uint64_t offset, uint64_t len) {
     }
 }
 
+void PageSource::OnPagesFailed(uint64_t offset, uint64_t len, zx_status_t error_status) {
+    uint64_t end = offset + len;
+    fbl::AutoLock info_lock(&mtx_);
+    LTRACEF("%p offset %lx, len %lx, status %d\n", this, offset, len, error_status);
+
+    if (closed_) {
+        return;
+    }
+
+    auto start = outstanding_requests_.lower_bound(offset);
+    while (start.IsValid() && start->offset_ < end) {
+        auto cur = start;
+        ++start;
+
+        LTRACEF("%p, failing %lx\n", this, cur->offset_);
+
+        CompleteRequestLocked(outstanding_requests_.erase(cur), error_status);
+    }
+}
+
 zx_status_t PageSource::GetPage(uint64_t offset, PageRequest* request,
                                 vm_page_t** const page_out, paddr_t* const pa_out) {
     ASSERT(request);
@@ -98,7 +118,7 @@ zx_status_t PageSource::GetPage(uint64_t offset, PageRequest* request,
     return ZX_ERR_SHOULD_WAIT;
 }
 
-void PageSource::CompleteRequestLocked(PageRequest* req) {
+void PageSource::CompleteRequestLocked(PageRequest* req, zx_status_t status) {
     // Take the request back from the callback before waking
     // up the corresponding thread.
     callback_->ClearAsyncRequest(&req->read_request_);
@@ -106,9 +126,11 @@ void PageSource::CompleteRequestLocked(PageRequest* req) {
     while (!req->overlap_.is_empty()) {
         auto waiter = req->overlap_.pop_front();
         waiter->offset_ = UINT64_MAX;
+        waiter->complete_status_ = status;
         event_signal(&waiter->event_, true);
     }
     req->offset_ = UINT64_MAX;
+    req->complete_status_ = status;
     event_signal(&req->event_, true);
 }
 
@@ -161,6 +183,7 @@ PageRequest::~PageRequest() {
 void PageRequest::Init(fbl::RefPtr<PageSource> src, uint64_t offset) {
     DEBUG_ASSERT(offset_ == UINT64_MAX);
     offset_ = offset;
+    complete_status_ = ZX_OK;
     src_ = ktl::move(src);
     event_ = EVENT_INITIAL_VALUE(event_, 0, EVENT_FLAG_AUTOUNSIGNAL);
 }
@@ -169,6 +192,7 @@ zx_status_t PageRequest::Wait() {
     zx_status_t status = src_->callback_->WaitOnEvent(&event_);
     if (status != ZX_OK) {
         src_->CancelRequest(this);
+        return status;
     }
-    return status;
+    return complete_status_;
 }
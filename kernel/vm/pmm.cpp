@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
 #include <kernel/mp.h>
 #include <kernel/timer.h>
 #include <lib/console.h>
@@ -47,6 +48,22 @@ static void pmm_enforce_fill(uint level) {
 LK_INIT_HOOK(pmm_fill, &pmm_enforce_fill, LK_INIT_LEVEL_VM);
 #endif
 
+// The per cpu page caches bump kernel counters, so hold off on turning them on
+// until those are wired up.
+static void pmm_enable_percpu_caches(uint level) {
+    if (cmdline_get_bool("kernel.pmm.percpu-cache", true)) {
+        pmm_node.EnablePerCpuCaches();
+    }
+}
+LK_INIT_HOOK(pmm_percpu_caches, &pmm_enable_percpu_caches, LK_INIT_LEVEL_VM);
+
+static void pmm_start_zeroing_thread(uint level) {
+    if (cmdline_get_bool("kernel.pmm.prezero", true)) {
+        pmm_node.StartZeroingThread();
+    }
+}
+LK_INIT_HOOK(pmm_zeroing, &pmm_start_zeroing_thread, LK_INIT_LEVEL_THREADING);
+
 vm_page_t* paddr_to_vm_page(paddr_t addr) {
     return pmm_node.PaddrToPage(addr);
 }
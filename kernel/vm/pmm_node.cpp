@@ -5,8 +5,11 @@
 // https://opensource.org/licenses/MIT
 #include "pmm_node.h"
 
+#include <arch/ops.h>
 #include <inttypes.h>
 #include <kernel/mp.h>
+#include <kernel/thread.h>
+#include <lib/counters.h>
 #include <new>
 #include <trace.h>
 #include <vm/bootalloc.h>
@@ -16,6 +19,19 @@
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+KCOUNTER(pmm_cache_alloc_hit, "kernel.pmm.cache.alloc_hit");
+KCOUNTER(pmm_cache_alloc_miss, "kernel.pmm.cache.alloc_miss");
+KCOUNTER(pmm_cache_free_hit, "kernel.pmm.cache.free_hit");
+KCOUNTER(pmm_cache_free_miss, "kernel.pmm.cache.free_miss");
+KCOUNTER(pmm_cache_drain, "kernel.pmm.cache.drain");
+KCOUNTER(pmm_zeroed_alloc_hit, "kernel.pmm.zeroed.alloc_hit");
+KCOUNTER(pmm_zeroed_alloc_miss, "kernel.pmm.zeroed.alloc_miss");
+KCOUNTER(pmm_zeroed_fill, "kernel.pmm.zeroed.fill");
+KCOUNTER(pmm_zeroed_drain, "kernel.pmm.zeroed.drain");
+KCOUNTER(pmm_zeroed_run_alloc_hit, "kernel.pmm.zeroed.run_alloc_hit");
+KCOUNTER(pmm_zeroed_run_alloc_miss, "kernel.pmm.zeroed.run_alloc_miss");
+KCOUNTER(pmm_zeroed_run_fill, "kernel.pmm.zeroed.run_fill");
+
 namespace {
 
 void set_state_alloc(vm_page* page) {
@@ -91,25 +107,132 @@ void PmmNode::AddFreePages(list_node* list) TA_NO_THREAD_SAFETY_ANALYSIS {
     LTRACEF("free count now %" PRIu64 "\n", free_count_);
 }
 
-zx_status_t PmmNode::AllocPage(uint alloc_flags, vm_page_t** page_out, paddr_t* pa_out) {
+void PmmNode::EnablePerCpuCaches() {
+    percpu_cache_enabled_ = true;
+}
+
+vm_page* PmmNode::CacheAllocPage() {
+    // if we migrate between reading the cpu number and taking the lock we
+    // simply end up using another cpu's cache, which is still correct.
+    PerCpuCache& cache = percpu_cache_[arch_curr_cpu_num()];
+
+    Guard<SpinLock, IrqSave> guard{&cache.lock};
+
+    vm_page* page = list_remove_head_type(&cache.free_list, vm_page, queue_node);
+    if (!page) {
+        return nullptr;
+    }
+
+    DEBUG_ASSERT(cache.count > 0);
+    cache.count--;
+
+    DEBUG_ASSERT(page->state == VM_PAGE_STATE_FREE_CACHED);
+    page->state = VM_PAGE_STATE_ALLOC;
+
+    return page;
+}
+
+vm_page* PmmNode::RefillCacheAndAllocPage() {
     Guard<fbl::Mutex> guard{&lock_};
 
     vm_page* page = list_remove_head_type(&free_list_, vm_page, queue_node);
     if (!page) {
-        return ZX_ERR_NO_MEMORY;
+        // the global list is dry, but other cpus may still be sitting on free pages
+        if (DrainCachesLocked() == 0) {
+            return nullptr;
+        }
+        page = list_remove_head_type(&free_list_, vm_page, queue_node);
+        DEBUG_ASSERT(page);
     }
 
     DEBUG_ASSERT(free_count_ > 0);
     free_count_--;
 
-    DEBUG_ASSERT(page->is_free());
-
     set_state_alloc(page);
 
+    // pull a batch of pages off the global list while we hold the lock
+    list_node batch = LIST_INITIAL_VALUE(batch);
+    size_t batch_count = 0;
+    while (batch_count < kPerCpuCacheBatch) {
+        vm_page* p = list_remove_head_type(&free_list_, vm_page, queue_node);
+        if (!p) {
+            break;
+        }
+        DEBUG_ASSERT(p->is_free());
+        p->state = VM_PAGE_STATE_FREE_CACHED;
+        list_add_tail(&batch, &p->queue_node);
+        batch_count++;
+    }
+    free_count_ -= batch_count;
+
+    PerCpuCache& cache = percpu_cache_[arch_curr_cpu_num()];
+    {
+        Guard<SpinLock, IrqSave> cache_guard{&cache.lock};
+
+        // frees on this cpu may have filled the cache since we missed
+        while (batch_count > 0 && cache.count < kPerCpuCacheMax) {
+            vm_page* p = list_remove_head_type(&batch, vm_page, queue_node);
+            list_add_head(&cache.free_list, &p->queue_node);
+            cache.count++;
+            batch_count--;
+        }
+    }
+
+    // anything that did not fit goes back on the global list
+    while (!list_is_empty(&batch)) {
+        ReturnCachedPageLocked(list_remove_head_type(&batch, vm_page, queue_node));
+    }
+
+    return page;
+}
+
+zx_status_t PmmNode::AllocPage(uint alloc_flags, vm_page_t** page_out, paddr_t* pa_out) {
+    vm_page* page = nullptr;
+
+    if ((alloc_flags & PMM_ALLOC_FLAG_ZEROED) && zeroing_enabled_) {
+        list_node zeroed = LIST_INITIAL_VALUE(zeroed);
+        if (ZeroedPoolAllocPages(1, &zeroed) == 1) {
+            page = list_remove_head_type(&zeroed, vm_page, queue_node);
+            goto done;
+        }
+    }
+
+    if (likely(percpu_cache_enabled_)) {
+        page = CacheAllocPage();
+        if (page) {
+            kcounter_add(pmm_cache_alloc_hit, 1);
+        } else {
+            kcounter_add(pmm_cache_alloc_miss, 1);
+            page = RefillCacheAndAllocPage();
+            if (!page) {
+                return ZX_ERR_NO_MEMORY;
+            }
+        }
+    } else {
+        Guard<fbl::Mutex> guard{&lock_};
+
+        page = list_remove_head_type(&free_list_, vm_page, queue_node);
+        if (!page) {
+            return ZX_ERR_NO_MEMORY;
+        }
+
+        DEBUG_ASSERT(free_count_ > 0);
+        free_count_--;
+
+        DEBUG_ASSERT(page->is_free());
+
+        set_state_alloc(page);
+    }
+
 #if PMM_ENABLE_FREE_FILL
     CheckFreeFill(page);
 #endif
 
+    if (alloc_flags & PMM_ALLOC_FLAG_ZEROED) {
+        ZeroPage(page);
+    }
+
+done:
     if (pa_out) {
         *pa_out = page->paddr();
     }
@@ -133,13 +256,30 @@ zx_status_t PmmNode::AllocPages(size_t count, uint alloc_flags, list_node* list)
         return ZX_OK;
     }
 
+    // pages out of the pre-zeroed pool, which are added to |list| last
+    list_node zeroed = LIST_INITIAL_VALUE(zeroed);
+    if ((alloc_flags & PMM_ALLOC_FLAG_ZEROED) && zeroing_enabled_) {
+        count -= ZeroedPoolAllocPages(count, &zeroed);
+    }
+
+    list_node fresh = LIST_INITIAL_VALUE(fresh);
     Guard<fbl::Mutex> guard{&lock_};
 
+    bool drained = false;
     while (count > 0) {
         vm_page* page = list_remove_head_type(&free_list_, vm_page, queue_node);
         if (unlikely(!page)) {
+            // before giving up, pull back whatever the per cpu caches are holding
+            if (!drained) {
+                drained = true;
+                if (DrainCachesLocked() > 0) {
+                    continue;
+                }
+            }
+
             // free pages that have already been allocated
-            FreeListLocked(list);
+            FreeListLocked(&fresh);
+            FreeListLocked(&zeroed);
             return ZX_ERR_NO_MEMORY;
         }
 
@@ -155,11 +295,23 @@ zx_status_t PmmNode::AllocPages(size_t count, uint alloc_flags, list_node* list)
 #endif
 
         page->state = VM_PAGE_STATE_ALLOC;
-        list_add_tail(list, &page->queue_node);
+        list_add_tail(&fresh, &page->queue_node);
 
         count--;
     }
 
+    guard.Release();
+
+    if (alloc_flags & PMM_ALLOC_FLAG_ZEROED) {
+        vm_page* page;
+        list_for_every_entry (&fresh, page, vm_page, queue_node) {
+            ZeroPage(page);
+        }
+    }
+
+    list_splice_after(&fresh, list->prev);
+    list_splice_after(&zeroed, list->prev);
+
     return ZX_OK;
 }
 
@@ -178,6 +330,10 @@ zx_status_t PmmNode::AllocRange(paddr_t address, size_t count, list_node* list)
 
     Guard<fbl::Mutex> guard{&lock_};
 
+    // pages parked in the per cpu caches are not free as far as the arenas
+    // are concerned, so put them back before looking for specific pages
+    DrainCachesLocked();
+
     // walk through the arenas, looking to see if the physical page belongs to it
     for (auto& a : arena_list_) {
         while (allocated < count && a.address_in_arena(address)) {
@@ -230,8 +386,20 @@ zx_status_t PmmNode::AllocContiguous(const size_t count, uint alloc_flags, uint8
     DEBUG_ASSERT(pa);
     DEBUG_ASSERT(list);
 
+    // a zeroed large page can come out of the pre-zeroed runs, rather than
+    // being zeroed here, in the faulting thread
+    if ((alloc_flags & PMM_ALLOC_FLAG_ZEROED) && zeroing_enabled_ &&
+        count == kZeroedRunPages && alignment_log2 <= LARGE_PAGE_SIZE_SHIFT &&
+        ZeroedRunAlloc(pa, list)) {
+        return ZX_OK;
+    }
+
     Guard<fbl::Mutex> guard{&lock_};
 
+    // the first pass leaves the per cpu caches alone. if that fails, drain
+    // them to see if the pages they hold complete a run.
+    bool drained = false;
+retry:
     for (auto& a : arena_list_) {
         vm_page_t* p = a.FindFreeContiguous(count, alignment_log2);
         if (!p) {
@@ -239,6 +407,7 @@ zx_status_t PmmNode::AllocContiguous(const size_t count, uint alloc_flags, uint8
         }
 
         *pa = p->paddr();
+        vm_page_t* const run = p;
 
         // remove the pages from the run out of the free list
         for (size_t i = 0; i < count; i++, p++) {
@@ -259,9 +428,24 @@ zx_status_t PmmNode::AllocContiguous(const size_t count, uint alloc_flags, uint8
             list_add_tail(list, &p->queue_node);
         }
 
+        guard.Release();
+
+        if (alloc_flags & PMM_ALLOC_FLAG_ZEROED) {
+            for (size_t i = 0; i < count; i++) {
+                ZeroPage(&run[i]);
+            }
+        }
+
         return ZX_OK;
     }
 
+    if (!drained && !(alloc_flags & PMM_ALLOC_FLAG_NO_DRAIN)) {
+        drained = true;
+        if (DrainCachesLocked() > 0) {
+            goto retry;
+        }
+    }
+
     LTRACEF("couldn't find run\n");
     return ZX_ERR_NOT_FOUND;
 }
@@ -290,7 +474,319 @@ void PmmNode::FreePageLocked(vm_page* page) {
     free_count_++;
 }
 
+void PmmNode::CacheFreePage(vm_page* page) {
+    LTRACEF("page %p state %u paddr %#" PRIxPTR "\n", page, page->state, page->paddr());
+
+    DEBUG_ASSERT(page->state != VM_PAGE_STATE_OBJECT || page->object.pin_count == 0);
+    DEBUG_ASSERT(!page->is_free());
+
+#if PMM_ENABLE_FREE_FILL
+    FreeFill(page);
+#endif
+
+    if (list_in_list(&page->queue_node)) {
+        list_delete(&page->queue_node);
+    }
+
+    list_node overflow = LIST_INITIAL_VALUE(overflow);
+    PerCpuCache& cache = percpu_cache_[arch_curr_cpu_num()];
+    {
+        Guard<SpinLock, IrqSave> guard{&cache.lock};
+
+        page->state = VM_PAGE_STATE_FREE_CACHED;
+        list_add_head(&cache.free_list, &page->queue_node);
+        cache.count++;
+
+        if (likely(cache.count <= kPerCpuCacheMax)) {
+            kcounter_add(pmm_cache_free_hit, 1);
+            return;
+        }
+
+        // trim the coldest pages off the tail of the cache
+        for (size_t i = 0; i < kPerCpuCacheBatch; i++) {
+            vm_page* p = list_remove_tail_type(&cache.free_list, vm_page, queue_node);
+            list_add_tail(&overflow, &p->queue_node);
+        }
+        cache.count -= kPerCpuCacheBatch;
+    }
+
+    kcounter_add(pmm_cache_free_miss, 1);
+
+    Guard<fbl::Mutex> guard{&lock_};
+    while (!list_is_empty(&overflow)) {
+        ReturnCachedPageLocked(list_remove_head_type(&overflow, vm_page, queue_node));
+    }
+}
+
+void PmmNode::ReturnCachedPageLocked(vm_page* page) {
+    DEBUG_ASSERT(page->state == VM_PAGE_STATE_FREE_CACHED);
+
+    page->state = VM_PAGE_STATE_FREE;
+    list_add_head(&free_list_, &page->queue_node);
+    free_count_++;
+}
+
+size_t PmmNode::DrainCachesLocked() {
+    size_t drained = 0;
+
+    for (auto& cache : percpu_cache_) {
+        Guard<SpinLock, IrqSave> guard{&cache.lock};
+
+        while (!list_is_empty(&cache.free_list)) {
+            ReturnCachedPageLocked(list_remove_head_type(&cache.free_list, vm_page, queue_node));
+            drained++;
+        }
+        cache.count = 0;
+    }
+
+    if (drained > 0) {
+        kcounter_add(pmm_cache_drain, 1);
+    }
+
+    // the pre-zeroed pool is another cache of free pages as far as the
+    // callers are concerned
+    return drained + DrainZeroedPoolLocked();
+}
+
+size_t PmmNode::ZeroedPoolAllocPages(size_t count, list_node* list) {
+    size_t taken = 0;
+    bool low;
+    {
+        Guard<SpinLock, IrqSave> guard{&zeroed_lock_};
+
+        while (taken < count) {
+            vm_page* page = list_remove_head_type(&zeroed_list_, vm_page, queue_node);
+            if (!page) {
+                break;
+            }
+            DEBUG_ASSERT(page->state == VM_PAGE_STATE_FREE_ZEROED);
+            page->state = VM_PAGE_STATE_ALLOC;
+            list_add_tail(list, &page->queue_node);
+            taken++;
+        }
+        zeroed_count_ -= taken;
+        low = zeroed_count_ < kZeroedPoolLow;
+    }
+
+    kcounter_add(pmm_zeroed_alloc_hit, taken);
+    if (taken < count) {
+        kcounter_add(pmm_zeroed_alloc_miss, count - taken);
+    }
+
+    if (low) {
+        event_signal(&zeroing_event_, false);
+    }
+
+    return taken;
+}
+
+bool PmmNode::ZeroedRunAlloc(paddr_t* pa, list_node* list) {
+    vm_page* run = nullptr;
+    {
+        Guard<SpinLock, IrqSave> guard{&zeroed_lock_};
+        if (zeroed_run_count_ > 0) {
+            run = zeroed_runs_[--zeroed_run_count_];
+        }
+        zeroed_runs_wanted_ = true;
+    }
+    event_signal(&zeroing_event_, false);
+
+    if (!run) {
+        kcounter_add(pmm_zeroed_run_alloc_miss, 1);
+        return false;
+    }
+    kcounter_add(pmm_zeroed_run_alloc_hit, 1);
+
+    // nothing else looks at the pages of a run once it is out of the pool
+    *pa = run->paddr();
+    for (size_t i = 0; i < kZeroedRunPages; i++) {
+        DEBUG_ASSERT(run[i].state == VM_PAGE_STATE_FREE_ZEROED);
+        run[i].state = VM_PAGE_STATE_ALLOC;
+        list_add_tail(list, &run[i].queue_node);
+    }
+    return true;
+}
+
+void PmmNode::ZeroPage(vm_page* page) {
+    void* ptr = paddr_to_physmap(page->paddr());
+    DEBUG_ASSERT(ptr);
+
+    arch_zero_page(ptr);
+}
+
+size_t PmmNode::DrainZeroedPoolLocked() {
+    size_t drained = 0;
+
+    Guard<SpinLock, IrqSave> guard{&zeroed_lock_};
+
+    while (!list_is_empty(&zeroed_list_)) {
+        vm_page* page = list_remove_head_type(&zeroed_list_, vm_page, queue_node);
+        DEBUG_ASSERT(page->state == VM_PAGE_STATE_FREE_ZEROED);
+
+#if PMM_ENABLE_FREE_FILL
+        FreeFill(page);
+#endif
+
+        page->state = VM_PAGE_STATE_FREE;
+        list_add_head(&free_list_, &page->queue_node);
+        free_count_++;
+        drained++;
+    }
+    zeroed_count_ = 0;
+
+    for (size_t r = 0; r < zeroed_run_count_; r++) {
+        vm_page* run = zeroed_runs_[r];
+        for (size_t i = 0; i < kZeroedRunPages; i++) {
+            DEBUG_ASSERT(run[i].state == VM_PAGE_STATE_FREE_ZEROED);
+#if PMM_ENABLE_FREE_FILL
+            FreeFill(&run[i]);
+#endif
+            run[i].state = VM_PAGE_STATE_FREE;
+            list_add_head(&free_list_, &run[i].queue_node);
+        }
+        free_count_ += kZeroedRunPages;
+        drained += kZeroedRunPages;
+    }
+    zeroed_run_count_ = 0;
+
+    if (drained > 0) {
+        kcounter_add(pmm_zeroed_drain, 1);
+    }
+
+    return drained;
+}
+
+void PmmNode::StartZeroingThread() {
+    event_init(&zeroing_event_, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+    thread_t* t = thread_create("pmm-zero", &ZeroingThread, this, LOWEST_PRIORITY + 1);
+    if (!t) {
+        printf("PMM: failed to start the page zeroing thread\n");
+        return;
+    }
+    zeroing_enabled_ = true;
+    thread_detach_and_resume(t);
+
+    event_signal(&zeroing_event_, false);
+}
+
+int PmmNode::ZeroingThread(void* arg) {
+    PmmNode* node = static_cast<PmmNode*>(arg);
+
+    for (;;) {
+        event_wait(&node->zeroing_event_);
+        node->FillZeroedPool();
+        node->FillZeroedRuns();
+    }
+
+    return 0;
+}
+
+void PmmNode::FillZeroedPool() {
+    for (;;) {
+        {
+            Guard<SpinLock, IrqSave> guard{&zeroed_lock_};
+            if (zeroed_count_ >= kZeroedPoolMax) {
+                return;
+            }
+        }
+
+        // take a batch of pages off the free list, unless memory is running
+        // low, in which case the pages are better left for allocations that
+        // need them now than parked in the pool.
+        list_node batch = LIST_INITIAL_VALUE(batch);
+        {
+            Guard<fbl::Mutex> guard{&lock_};
+            if (free_count_ < kZeroedPoolMax * 4) {
+                return;
+            }
+            for (size_t i = 0; i < kZeroingBatch; i++) {
+                vm_page* page = list_remove_head_type(&free_list_, vm_page, queue_node);
+                DEBUG_ASSERT(page && page->is_free());
+                set_state_alloc(page);
+                list_add_tail(&batch, &page->queue_node);
+            }
+            free_count_ -= kZeroingBatch;
+        }
+
+        // zero them without holding any locks
+        vm_page* page;
+        list_for_every_entry (&batch, page, vm_page, queue_node) {
+#if PMM_ENABLE_FREE_FILL
+            CheckFreeFill(page);
+#endif
+            ZeroPage(page);
+        }
+
+        {
+            Guard<SpinLock, IrqSave> guard{&zeroed_lock_};
+            list_for_every_entry (&batch, page, vm_page, queue_node) {
+                page->state = VM_PAGE_STATE_FREE_ZEROED;
+            }
+            list_splice_after(&batch, zeroed_list_.prev);
+            zeroed_count_ += kZeroingBatch;
+        }
+        kcounter_add(pmm_zeroed_fill, kZeroingBatch);
+    }
+}
+
+void PmmNode::FillZeroedRuns() {
+    for (;;) {
+        {
+            Guard<SpinLock, IrqSave> guard{&zeroed_lock_};
+            if (!zeroed_runs_wanted_ || zeroed_run_count_ >= kZeroedRunsMax) {
+                zeroed_runs_wanted_ = false;
+                return;
+            }
+        }
+
+        // as with single pages, leave the memory alone once it runs low
+        vm_page* run = nullptr;
+        {
+            Guard<fbl::Mutex> guard{&lock_};
+            if (free_count_ >= kZeroedRunPages * kZeroedRunsMax * 4) {
+                for (auto& a : arena_list_) {
+                    run = a.FindFreeContiguous(kZeroedRunPages, LARGE_PAGE_SIZE_SHIFT);
+                    if (run) {
+                        break;
+                    }
+                }
+            }
+            if (!run) {
+                Guard<SpinLock, IrqSave> zeroed_guard{&zeroed_lock_};
+                zeroed_runs_wanted_ = false;
+                return;
+            }
+            for (size_t i = 0; i < kZeroedRunPages; i++) {
+                list_delete(&run[i].queue_node);
+                set_state_alloc(&run[i]);
+            }
+            free_count_ -= kZeroedRunPages;
+        }
+
+        for (size_t i = 0; i < kZeroedRunPages; i++) {
+#if PMM_ENABLE_FREE_FILL
+            CheckFreeFill(&run[i]);
+#endif
+            ZeroPage(&run[i]);
+            run[i].state = VM_PAGE_STATE_FREE_ZEROED;
+        }
+
+        {
+            Guard<SpinLock, IrqSave> guard{&zeroed_lock_};
+            DEBUG_ASSERT(zeroed_run_count_ < kZeroedRunsMax);
+            zeroed_runs_[zeroed_run_count_++] = run;
+        }
+        kcounter_add(pmm_zeroed_run_fill, 1);
+    }
+}
+
 void PmmNode::FreePage(vm_page* page) {
+    if (likely(percpu_cache_enabled_)) {
+        CacheFreePage(page);
+        return;
+    }
+
     Guard<fbl::Mutex> guard{&lock_};
 
     FreePageLocked(page);
@@ -314,7 +810,11 @@ void PmmNode::FreeList(list_node* list) {
 
 // okay if accessed outside of a lock
 uint64_t PmmNode::CountFreePages() const TA_NO_THREAD_SAFETY_ANALYSIS {
-    return free_count_;
+    uint64_t count = free_count_ + zeroed_count_ + zeroed_run_count_ * kZeroedRunPages;
+    for (const auto& cache : percpu_cache_) {
+        count += cache.count;
+    }
+    return count;
 }
 
 uint64_t PmmNode::CountTotalBytes() const TA_NO_THREAD_SAFETY_ANALYSIS {
@@ -340,6 +840,17 @@ void PmmNode::Dump(bool is_panic) const {
     auto dump = [this]() TA_NO_THREAD_SAFETY_ANALYSIS {
         printf("pmm node %p: free_count %zu (%zu bytes), total size %zu\n",
                this, free_count_, free_count_ * PAGE_SIZE, arena_cumulative_size_);
+        if (zeroing_enabled_) {
+            printf("\tpre-zeroed pool: %zu pages, %zu large page runs\n",
+                   zeroed_count_, zeroed_run_count_);
+        }
+        if (percpu_cache_enabled_) {
+            for (size_t i = 0; i < countof(percpu_cache_); i++) {
+                if (percpu_cache_[i].count > 0) {
+                    printf("\tcpu %zu cache: %zu pages\n", i, percpu_cache_[i].count);
+                }
+            }
+        }
         for (auto& a : arena_list_) {
             a.Dump(false, false);
         }
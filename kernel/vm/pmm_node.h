@@ -9,8 +9,12 @@
 #include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
 
+#include <kernel/align.h>
+#include <kernel/event.h>
 #include <kernel/lockdep.h>
+#include <kernel/spinlock.h>
 #include <vm/pmm.h>
+#include <vm/vm.h>
 
 #include "pmm_arena.h"
 
@@ -55,10 +59,69 @@ public:
     // add new pages to the free queue. used when boostrapping a PmmArena
     void AddFreePages(list_node* list);
 
+    // turn on the per cpu page caches. called once the kernel counters are
+    // available, single page allocations and frees go straight to the global
+    // free list until then.
+    void EnablePerCpuCaches();
+
+    // start the low priority thread that keeps the pool of pre-zeroed pages
+    // filled. until then PMM_ALLOC_FLAG_ZEROED allocations zero pages inline.
+    void StartZeroingThread();
+
 private:
     void FreePageLocked(vm_page* page) TA_REQ(lock_);
     void FreeListLocked(list_node* list) TA_REQ(lock_);
 
+    // per cpu page cache fast paths. a nullptr return or false means the local
+    // cache could not satisfy the request and the caller has to go to the
+    // global free list.
+    vm_page* CacheAllocPage();
+    void CacheFreePage(vm_page* page);
+
+    // refill the local cache from the global free list, returning one page to the caller
+    vm_page* RefillCacheAndAllocPage();
+
+    // return every page in every per cpu cache to the global free list,
+    // returning the number of pages moved
+    size_t DrainCachesLocked() TA_REQ(lock_);
+
+    // move a page that is sitting in a per cpu cache back onto the global free list
+    void ReturnCachedPageLocked(vm_page* page) TA_REQ(lock_);
+
+    // take up to |count| pages out of the pre-zeroed pool, adding them to
+    // |list| and returning how many were taken
+    size_t ZeroedPoolAllocPages(size_t count, list_node* list);
+
+    // take a pre-zeroed run of kZeroedRunPages pages, if there is one, adding
+    // its pages to |list| in address order
+    bool ZeroedRunAlloc(paddr_t* pa, list_node* list);
+
+    // zero |page| unless it came out of the pre-zeroed pool
+    void ZeroPage(vm_page* page);
+
+    // return every page in the pre-zeroed pool to the global free list,
+    // returning the number of pages moved
+    size_t DrainZeroedPoolLocked() TA_REQ(lock_);
+
+    static int ZeroingThread(void* arg);
+    void FillZeroedPool();
+    void FillZeroedRuns();
+
+    // the number of pages that can sit in a per cpu cache, and the number of
+    // pages moved to or from the global free list when it runs dry or overflows
+    static constexpr size_t kPerCpuCacheMax = 64;
+    static constexpr size_t kPerCpuCacheBatch = 32;
+
+    // a small stack of free pages that may be allocated from and freed to
+    // without touching the node wide lock. pages sitting in a cache are in the
+    // VM_PAGE_STATE_FREE_CACHED state so that the contiguous and range
+    // allocators, which walk the arenas directly, leave them alone.
+    struct PerCpuCache {
+        DECLARE_SPINLOCK(PerCpuCache) lock;
+        list_node free_list TA_GUARDED(lock) = LIST_INITIAL_VALUE(free_list);
+        size_t count TA_GUARDED(lock) = 0;
+    } __CPU_ALIGN;
+
     fbl::Canary<fbl::magic("PNOD")> canary_;
 
     mutable DECLARE_MUTEX(PmmNode) lock_;
@@ -75,6 +138,36 @@ private:
     list_node modified_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(modified_list_);
     list_node wired_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(wired_list_);
 
+    bool percpu_cache_enabled_ = false;
+    PerCpuCache percpu_cache_[SMP_MAX_CPUS];
+
+    // the number of pages the zeroing thread keeps in the pre-zeroed pool, the
+    // level below which allocations wake it up, and the number of pages it
+    // takes off the free list at a time
+    static constexpr size_t kZeroedPoolMax = 512;
+    static constexpr size_t kZeroedPoolLow = kZeroedPoolMax / 2;
+    static constexpr size_t kZeroingBatch = 16;
+
+    // free pages that have already been zeroed, in the VM_PAGE_STATE_FREE_ZEROED
+    // state so that the contiguous and range allocators leave them alone.
+    DECLARE_SPINLOCK(PmmNode) zeroed_lock_;
+    list_node zeroed_list_ TA_GUARDED(zeroed_lock_) = LIST_INITIAL_VALUE(zeroed_list_);
+    size_t zeroed_count_ TA_GUARDED(zeroed_lock_) = 0;
+
+    // pre-zeroed runs of one large page each, for the contiguous allocator to
+    // hand out to large page faults. their pages are in the
+    // VM_PAGE_STATE_FREE_ZEROED state too, but on no list. the zeroing thread
+    // only looks for a new run after one was asked for, since the search
+    // walks the arenas and fails outright once memory is fragmented.
+    static constexpr size_t kZeroedRunPages = LARGE_PAGE_SIZE / PAGE_SIZE;
+    static constexpr size_t kZeroedRunsMax = 2;
+    vm_page* zeroed_runs_[kZeroedRunsMax] TA_GUARDED(zeroed_lock_) = {};
+    size_t zeroed_run_count_ TA_GUARDED(zeroed_lock_) = 0;
+    bool zeroed_runs_wanted_ TA_GUARDED(zeroed_lock_) = true;
+
+    bool zeroing_enabled_ = false;
+    event_t zeroing_event_;
+
 #if PMM_ENABLE_FREE_FILL
     void FreeFill(vm_page_t* page);
     void CheckFreeFill(vm_page_t* page);
@@ -296,6 +296,20 @@ zx_status_t VmAddressRegion::DestroyLocked() {
     DEBUG_ASSERT(aspace_->lock()->lock().IsHeld());
     LTRACEF("%p '%s'\n", this, name_);
 
+    // As in UnmapInternalLocked, clear the whole region from the page tables
+    // up front so that destroying a region full of mappings, such as the root
+    // VMAR on process exit, costs one TLB shootdown instead of one per
+    // mapping.  Skip this if the vDSO is in here, since its mapping will
+    // refuse to be destroyed.
+    if (!subregions_.is_empty() &&
+        !(aspace_->vdso_code_mapping_ &&
+          aspace_->vdso_code_mapping_->base() - base_ < size_)) {
+        zx_status_t status = aspace_->arch_aspace().Unmap(base_, size_ / PAGE_SIZE, nullptr);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+
     // The cur reference prevents regions from being destructed after dropping
     // the last reference to them when removing from their parent.
     fbl::RefPtr<VmAddressRegion> cur(this);
@@ -690,6 +704,22 @@ zx_status_t VmAddressRegion::UnmapInternalLocked(vaddr_t base, size_t size,
         }
     }
 
+    // If more than one mapping is affected, take the whole range out of the
+    // page tables at once so that the TLB is shot down once for all of them,
+    // rather than once per mapping.  The mappings then find nothing left to
+    // unmap below.  A single mapping is left to itself, since unmapping from
+    // its middle can fail and we must not have changed anything if it does.
+    if (begin != end) {
+        auto second = begin;
+        ++second;
+        if (!begin->is_mapping() || second != end) {
+            zx_status_t status = aspace_->arch_aspace().Unmap(base, size / PAGE_SIZE, nullptr);
+            if (status != ZX_OK) {
+                return status;
+            }
+        }
+    }
+
     bool at_top = true;
     for (auto itr = begin; itr != end;) {
         // Create a copy of the iterator, in case we destroy this element
@@ -801,11 +831,17 @@ zx_status_t VmAddressRegion::Protect(vaddr_t base, size_t size, uint new_arch_mm
 
     // Check if we're overlapping a subregion, or a part of the range is not
     // mapped, or the new permissions are invalid for some mapping in the range.
+    // Also see whether the mappings share a cache policy, see below.
     vaddr_t last_mapped = begin->base();
+    bool same_cache_policy = true;
     for (auto itr = begin; itr != end; ++itr) {
         if (!itr->is_mapping()) {
             return ZX_ERR_INVALID_ARGS;
         }
+        if ((itr->as_vm_mapping()->arch_mmu_flags() & ARCH_MMU_FLAG_CACHE_MASK) !=
+            (begin->as_vm_mapping()->arch_mmu_flags() & ARCH_MMU_FLAG_CACHE_MASK)) {
+            same_cache_policy = false;
+        }
         if (itr->base() != last_mapped) {
             return ZX_ERR_NOT_FOUND;
         }
@@ -822,6 +858,26 @@ zx_status_t VmAddressRegion::Protect(vaddr_t base, size_t size, uint new_arch_mm
         return ZX_ERR_NOT_FOUND;
     }
 
+    // If more than one mapping is affected, change the mappings first and then
+    // the page tables for the whole range at once, so that the TLB is shot
+    // down once for all of them, rather than once per mapping.  The cache
+    // policy is part of what the page tables are given, so this only works
+    // if the mappings share one.  Nothing can fault on the range in between,
+    // since that takes the aspace lock.
+    auto second = begin;
+    ++second;
+    const bool batch = second != end && same_cache_policy;
+    const uint batch_arch_mmu_flags =
+        new_arch_mmu_flags | (begin->as_vm_mapping()->arch_mmu_flags() & ARCH_MMU_FLAG_CACHE_MASK);
+    auto protect_arch = [this, base, batch_arch_mmu_flags](vaddr_t protect_end) {
+        const size_t count = (protect_end - base) / PAGE_SIZE;
+        if (batch_arch_mmu_flags & ARCH_MMU_FLAG_PERM_RWX_MASK) {
+            return aspace_->arch_aspace().Protect(base, count, batch_arch_mmu_flags);
+        } else {
+            return aspace_->arch_aspace().Unmap(base, count, nullptr);
+        }
+    };
+
     for (auto itr = begin; itr != end;) {
         DEBUG_ASSERT(itr->is_mapping());
 
@@ -834,8 +890,13 @@ zx_status_t VmAddressRegion::Protect(vaddr_t base, size_t size, uint new_arch_mm
         const size_t protect_size = protect_end - protect_base;
 
         zx_status_t status = itr->as_vm_mapping()->ProtectLocked(protect_base, protect_size,
-                                                                 new_arch_mmu_flags);
+                                                                 new_arch_mmu_flags, !batch);
         if (status != ZX_OK) {
+            // The page tables must not be left more permissive than the
+            // mappings that were already changed.
+            if (batch && protect_base > base) {
+                protect_arch(protect_base);
+            }
             // TODO(teisenbe): Try to work out a way to guarantee success, or
             // provide a full unwind?
             return status;
@@ -844,6 +905,11 @@ zx_status_t VmAddressRegion::Protect(vaddr_t base, size_t size, uint new_arch_mm
         itr = ktl::move(next);
     }
 
+    if (batch) {
+        zx_status_t status = protect_arch(end_addr);
+        LTRACEF("arch_mmu_protect returns %d\n", status);
+    }
+
     return ZX_OK;
 }
 
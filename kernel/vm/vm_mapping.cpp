@@ -9,10 +9,15 @@
 #include "vm_priv.h"
 #include <assert.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
-#include <ktl/move.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <ktl/move.h>
+#include <lib/counters.h>
+#include <lk/init.h>
+#include <pow2.h>
 #include <trace.h>
 #include <vm/fault.h>
 #include <vm/vm.h>
@@ -22,6 +27,35 @@
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+KCOUNTER(vm_fault_around_mapped, "kernel.vm.fault_around.mapped");
+KCOUNTER(vm_large_page_mapped, "kernel.vm.large_page.mapped");
+
+namespace {
+
+// Number of pages in the aligned window around a faulting address whose
+// already resident pages are mapped along with the faulting one.  Set by
+// kernel.vm.fault-around, 0 or 1 disables fault-around.
+size_t fault_around_pages = 16;
+
+// Whether a fault may back and map a whole LARGE_PAGE_SIZE aligned run at
+// once.  Set by kernel.vm.large-pages.
+bool large_pages_enabled = true;
+
+void vm_mapping_init(uint level) {
+    uint32_t pages = cmdline_get_uint32("kernel.vm.fault-around",
+                                        static_cast<uint32_t>(fault_around_pages));
+    if (pages > 1 && !ispow2(pages)) {
+        pages = 1u << log2_uint_floor(pages);
+    }
+    fault_around_pages = pages;
+
+    large_pages_enabled = cmdline_get_bool("kernel.vm.large-pages", large_pages_enabled);
+}
+
+} // namespace
+
+LK_INIT_HOOK(vm_mapping, vm_mapping_init, LK_INIT_LEVEL_VM);
+
 VmMapping::VmMapping(VmAddressRegion& parent, vaddr_t base, size_t size, uint32_t vmar_flags,
                      fbl::RefPtr<VmObject> vmo, uint64_t vmo_offset, uint arch_mmu_flags)
     : VmAddressRegionOrMapping(base, size, vmar_flags,
@@ -92,7 +126,7 @@ zx_status_t VmMapping::Protect(vaddr_t base, size_t size, uint new_arch_mmu_flag
         return ZX_ERR_INVALID_ARGS;
     }
 
-    return ProtectLocked(base, size, new_arch_mmu_flags);
+    return ProtectLocked(base, size, new_arch_mmu_flags, true);
 }
 
 namespace {
@@ -109,7 +143,8 @@ zx_status_t ProtectOrUnmap(const fbl::RefPtr<VmAspace>& aspace, vaddr_t base, si
 
 } // namespace
 
-zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mmu_flags) {
+zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mmu_flags,
+                                     bool update_arch) {
     DEBUG_ASSERT(aspace_->lock()->lock().IsHeld());
     DEBUG_ASSERT(size != 0 && IS_PAGE_ALIGNED(base) && IS_PAGE_ALIGNED(size));
 
@@ -138,8 +173,10 @@ zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mm
 
     // If we're changing the whole mapping, just make the change.
     if (base_ == base && size_ == size) {
-        zx_status_t status = ProtectOrUnmap(aspace_, base, size, new_arch_mmu_flags);
-        LTRACEF("arch_mmu_protect returns %d\n", status);
+        if (update_arch) {
+            zx_status_t status = ProtectOrUnmap(aspace_, base, size, new_arch_mmu_flags);
+            LTRACEF("arch_mmu_protect returns %d\n", status);
+        }
         arch_mmu_flags_ = new_arch_mmu_flags;
         return ZX_OK;
     }
@@ -155,8 +192,10 @@ zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mm
             return ZX_ERR_NO_MEMORY;
         }
 
-        zx_status_t status = ProtectOrUnmap(aspace_, base, size, new_arch_mmu_flags);
-        LTRACEF("arch_mmu_protect returns %d\n", status);
+        if (update_arch) {
+            zx_status_t status = ProtectOrUnmap(aspace_, base, size, new_arch_mmu_flags);
+            LTRACEF("arch_mmu_protect returns %d\n", status);
+        }
         arch_mmu_flags_ = new_arch_mmu_flags;
 
         size_ = size;
@@ -177,8 +216,10 @@ zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mm
             return ZX_ERR_NO_MEMORY;
         }
 
-        zx_status_t status = ProtectOrUnmap(aspace_, base, size, new_arch_mmu_flags);
-        LTRACEF("arch_mmu_protect returns %d\n", status);
+        if (update_arch) {
+            zx_status_t status = ProtectOrUnmap(aspace_, base, size, new_arch_mmu_flags);
+            LTRACEF("arch_mmu_protect returns %d\n", status);
+        }
 
         size_ -= size;
         mapping->ActivateLocked();
@@ -205,8 +246,10 @@ zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mm
         return ZX_ERR_NO_MEMORY;
     }
 
-    zx_status_t status = ProtectOrUnmap(aspace_, base, size, new_arch_mmu_flags);
-    LTRACEF("arch_mmu_protect returns %d\n", status);
+    if (update_arch) {
+        zx_status_t status = ProtectOrUnmap(aspace_, base, size, new_arch_mmu_flags);
+        LTRACEF("arch_mmu_protect returns %d\n", status);
+    }
 
     // Turn us into the left half
     size_ = left_size;
@@ -393,6 +436,8 @@ namespace {
 class VmMappingCoalescer {
 public:
     VmMappingCoalescer(VmMapping* mapping, vaddr_t base);
+    // Map the run with |mmu_flags| instead of the mapping's own flags.
+    VmMappingCoalescer(VmMapping* mapping, vaddr_t base, uint mmu_flags);
     ~VmMappingCoalescer();
 
     // Add a page to the mapping run.  If this fails, the VmMappingCoalescer is
@@ -427,13 +472,17 @@ private:
 
     VmMapping* mapping_;
     vaddr_t base_;
+    uint mmu_flags_;
     paddr_t phys_[16];
     size_t count_;
     bool aborted_;
 };
 
 VmMappingCoalescer::VmMappingCoalescer(VmMapping* mapping, vaddr_t base)
-    : mapping_(mapping), base_(base), count_(0), aborted_(false) {}
+    : VmMappingCoalescer(mapping, base, mapping->arch_mmu_flags()) {}
+
+VmMappingCoalescer::VmMappingCoalescer(VmMapping* mapping, vaddr_t base, uint mmu_flags)
+    : mapping_(mapping), base_(base), mmu_flags_(mmu_flags), count_(0), aborted_(false) {}
 
 VmMappingCoalescer::~VmMappingCoalescer() {
     // Make sure we've flushed or aborted
@@ -445,7 +494,7 @@ zx_status_t VmMappingCoalescer::Flush() {
         return ZX_OK;
     }
 
-    uint flags = mapping_->arch_mmu_flags();
+    uint flags = mmu_flags_;
     if (flags & ARCH_MMU_FLAG_PERM_RWX_MASK) {
         size_t mapped;
         zx_status_t ret = mapping_->aspace()->arch_aspace().Map(base_, phys_, count_, flags,
@@ -491,6 +540,16 @@ zx_status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
         pf_flags |= VMM_PF_FLAG_SW_FAULT;
     }
 
+    // pages supplied by a pager are only marked dirty, which keeps the
+    // reclaimer from evicting them, by a write fault. map the ones already
+    // present read-only so that the first write to each one faults. there's
+    // no way to wait on the pager from here, so don't ask it for new pages.
+    uint mmu_flags = arch_mmu_flags_;
+    if (object_->get_page_source_id() != 0) {
+        pf_flags = 0;
+        mmu_flags &= ~ARCH_MMU_FLAG_PERM_WRITE;
+    }
+
     // grab the lock for the vmo
     Guard<fbl::Mutex> object_guard{object_->lock()};
 
@@ -502,7 +561,7 @@ zx_status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
     // iterate through the range, grabbing a page from the underlying object and
     // mapping it in
     size_t o;
-    VmMappingCoalescer coalescer(this, base_ + offset);
+    VmMappingCoalescer coalescer(this, base_ + offset, mmu_flags);
     for (o = offset; o < offset + len; o += PAGE_SIZE) {
         uint64_t vmo_offset = object_offset_ + o;
 
@@ -644,6 +703,11 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags, PageRequest* p
     currently_faulting_ = true;
     auto ac = fbl::MakeAutoCall([&]() { currently_faulting_ = false; });
 
+    // large anonymous memory is best mapped a large page at a time
+    if (!(pf_flags & VMM_PF_FLAG_GUEST) && LargePageFaultLocked(va, pf_flags) == ZX_OK) {
+        return ZX_OK;
+    }
+
     // fault in or grab an existing page
     paddr_t new_pa;
     vm_page_t* page;
@@ -732,6 +796,12 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags, PageRequest* p
             return ZX_ERR_NO_MEMORY;
         }
         DEBUG_ASSERT(mapped == 1);
+
+        // a fault on an unmapped page is usually followed by faults on its
+        // neighbours, map the ones the vmo already has while we are here
+        if (!(pf_flags & VMM_PF_FLAG_GUEST)) {
+            FaultAroundLocked(va);
+        }
     }
 
 // TODO: figure out what to do with this
@@ -745,6 +815,128 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags, PageRequest* p
     return ZX_OK;
 }
 
+// Thread safety analysis is disabled for the same reason as ActivateLocked():
+// the caller holds object_->lock() through an alias the analyzer cannot see.
+zx_status_t VmMapping::LargePageFaultLocked(vaddr_t va, uint pf_flags)
+    TA_NO_THREAD_SAFETY_ANALYSIS {
+    DEBUG_ASSERT(aspace_->lock()->lock().IsHeld());
+    DEBUG_ASSERT(object_->lock()->lock().IsHeld());
+
+    if (!large_pages_enabled) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // the whole large page has to be inside the mapping, and line up with a
+    // large page of the vmo
+    const vaddr_t large_va = ROUNDDOWN(va, LARGE_PAGE_SIZE);
+    if (large_va < base_ || size_ - (large_va - base_) < LARGE_PAGE_SIZE) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    const uint64_t vmo_offset = large_va - base_ + object_offset_;
+    if (!IS_ALIGNED(vmo_offset, LARGE_PAGE_SIZE)) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    paddr_t pa;
+    zx_status_t status = object_->GetLargePageLocked(vmo_offset, pf_flags, &pa);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    // another thread may have beaten us to it
+    paddr_t cur_pa;
+    uint cur_flags;
+    if (aspace_->arch_aspace().Query(va, &cur_pa, &cur_flags) == ZX_OK &&
+        cur_pa == pa + (va - large_va) && cur_flags == arch_mmu_flags_) {
+        return ZX_OK;
+    }
+
+    // the pages belong to this vmo alone, so unlike in PageFault() they can be
+    // mapped writable right away.  whatever small pages are mapped in the range
+    // (the zero page, or the same pages mapped before) are replaced.
+    status = aspace_->arch_aspace().Unmap(large_va, LARGE_PAGE_SIZE / PAGE_SIZE, nullptr);
+    if (status != ZX_OK) {
+        return status;
+    }
+    size_t mapped;
+    status = aspace_->arch_aspace().MapContiguous(large_va, pa, LARGE_PAGE_SIZE / PAGE_SIZE,
+                                                  arch_mmu_flags_, &mapped);
+    if (status != ZX_OK) {
+        TRACEF("failed to map large page\n");
+        return status;
+    }
+    DEBUG_ASSERT(mapped == LARGE_PAGE_SIZE / PAGE_SIZE);
+
+    LTRACEF("mapped large page pa %#" PRIxPTR " at va %#" PRIxPTR "\n", pa, large_va);
+    kcounter_add(vm_large_page_mapped, 1);
+
+#if ARCH_ARM64
+    if (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_EXECUTE) {
+        arch_sync_cache_range(large_va, LARGE_PAGE_SIZE);
+    }
+#endif
+    return ZX_OK;
+}
+
+// Thread safety analysis is disabled for the same reason as ActivateLocked():
+// the caller holds object_->lock() through an alias the analyzer cannot see.
+void VmMapping::FaultAroundLocked(vaddr_t va) TA_NO_THREAD_SAFETY_ANALYSIS {
+    DEBUG_ASSERT(aspace_->lock()->lock().IsHeld());
+    DEBUG_ASSERT(object_->lock()->lock().IsHeld());
+
+    if (fault_around_pages <= 1) {
+        return;
+    }
+#if ARCH_ARM64
+    // executable pages would each need their caches synced, which costs more
+    // than the faults we would save
+    if (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_EXECUTE) {
+        return;
+    }
+#endif
+
+    const size_t window = fault_around_pages * PAGE_SIZE;
+    const vaddr_t window_base = ROUNDDOWN(va, window);
+    const vaddr_t start = fbl::max(window_base, base_);
+    const vaddr_t end = base_ + size_ - window_base > window ? window_base + window
+                                                             : base_ + size_;
+
+    // the neighbours may be copy-on-write pages shared with a parent or the
+    // zero page, so map them read-only and let a write fault sort them out
+    const uint mmu_flags = arch_mmu_flags_ & ~ARCH_MMU_FLAG_PERM_WRITE;
+    VmMappingCoalescer coalescer(this, start, mmu_flags);
+    size_t mapped = 0;
+    for (vaddr_t addr = start; addr < end; addr += PAGE_SIZE) {
+        if (addr == va) {
+            continue;
+        }
+
+        // only take pages that are already there, this must not allocate,
+        // go to a page source, or make the reclaimer think the page was used
+        paddr_t pa;
+        if (object_->PeekPageLocked(addr - base_ + object_offset_, &pa) != ZX_OK) {
+            continue;
+        }
+
+        paddr_t cur_pa;
+        uint cur_flags;
+        if (aspace_->arch_aspace().Query(addr, &cur_pa, &cur_flags) == ZX_OK) {
+            continue;
+        }
+
+        if (coalescer.Append(addr, pa) != ZX_OK) {
+            return;
+        }
+        mapped++;
+    }
+    if (coalescer.Flush() != ZX_OK) {
+        return;
+    }
+
+    LTRACEF("mapped %zu pages around va %#" PRIxPTR "\n", mapped, va);
+    kcounter_add(vm_fault_around_mapped, mapped);
+}
+
 // We disable thread safety analysis here because one of the common uses of this
 // function is for splitting one mapping object into several that will be backed
 // by the same VmObject.  In that case, object_->lock() gets aliased across all
@@ -110,6 +110,17 @@ uint64_t VmObject::parent_user_id() const {
     return parent->user_id();
 }
 
+uint32_t VmObject::clone_depth() const {
+    canary_.Assert();
+    // The whole clone tree shares our lock.
+    Guard<fbl::Mutex> guard{&lock_};
+    uint32_t depth = 0;
+    for (const VmObject* vmo = this; vmo->parent_; vmo = vmo->parent_.get()) {
+        depth++;
+    }
+    return depth;
+}
+
 bool VmObject::is_cow_clone() const {
     canary_.Assert();
     Guard<fbl::Mutex> guard{&lock_};
@@ -148,6 +159,22 @@ bool VmObject::IsMappedByUser() const {
     return false;
 }
 
+bool VmObject::IsMappedByKernelLocked() const {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.lock().IsHeld());
+    for (const auto& m : mapping_list_) {
+        if (!m.aspace()->is_user()) {
+            return true;
+        }
+    }
+    for (const auto& child : children_list_) {
+        if (child.IsMappedByKernelLocked()) {
+            return true;
+        }
+    }
+    return false;
+}
+
 uint32_t VmObject::share_count() const {
     canary_.Assert();
 
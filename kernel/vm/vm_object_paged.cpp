@@ -11,14 +11,18 @@
 #include <arch/ops.h>
 #include <assert.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
 #include <inttypes.h>
 #include <ktl/move.h>
 #include <lib/console.h>
+#include <lib/counters.h>
+#include <platform.h>
 #include <stdlib.h>
 #include <string.h>
 #include <trace.h>
+#include <vm/compressed_page.h>
 #include <vm/fault.h>
 #include <vm/page_source.h>
 #include <vm/physmap.h>
@@ -28,6 +32,14 @@
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+KCOUNTER(vm_large_page_alloc, "kernel.vm.large_page.alloc");
+KCOUNTER(vm_large_page_alloc_fail, "kernel.vm.large_page.alloc_fail");
+KCOUNTER(vm_large_page_promote, "kernel.vm.large_page.promote");
+KCOUNTER(vm_large_page_backoff, "kernel.vm.large_page.backoff");
+KCOUNTER(vm_reclaim_aged, "kernel.vm.reclaim.aged");
+KCOUNTER(vm_reclaim_evicted, "kernel.vm.reclaim.evicted");
+KCOUNTER(vm_clone_collapsed, "kernel.vm.clone.collapsed");
+
 namespace {
 
 void ZeroPage(paddr_t pa) {
@@ -46,8 +58,22 @@ void InitializeVmPage(vm_page_t* p) {
     DEBUG_ASSERT(p->state == VM_PAGE_STATE_ALLOC);
     p->state = VM_PAGE_STATE_OBJECT;
     p->object.pin_count = 0;
+    p->object.accessed = 1;
+    p->object.dirty = 0;
 }
 
+// Number of pages the reclaimer looks at in one VMO before moving on to the next.
+constexpr size_t kReclaimBatch = 64;
+
+// How long GetLargePageLocked() leaves a range alone after the pmm had no run
+// for it, doubling up to the max while it keeps failing.
+constexpr zx_duration_t kLargePageBackoffMin = ZX_MSEC(10);
+constexpr zx_duration_t kLargePageBackoffMax = ZX_SEC(1);
+
+// Upper bound on the number of times ReclaimPages() sweeps the VMOs, in case
+// their pages keep getting used as fast as they are aged.
+constexpr uint kReclaimMaxPasses = 64;
+
 // round up the size to the next page size boundary and make sure we dont wrap
 zx_status_t RoundSize(uint64_t size, uint64_t* out_size) {
     *out_size = ROUNDUP_PAGE_SIZE(size);
@@ -65,6 +91,8 @@ zx_status_t RoundSize(uint64_t size, uint64_t* out_size) {
 
 } // namespace
 
+VmObjectPaged::ReclaimList VmObjectPaged::reclaim_list_ = {};
+
 VmObjectPaged::VmObjectPaged(
     uint32_t options, uint32_t pmm_alloc_flags, uint64_t size,
     fbl::RefPtr<VmObject> parent, fbl::RefPtr<PageSource> page_source)
@@ -77,6 +105,9 @@ VmObjectPaged::VmObjectPaged(
 
     DEBUG_ASSERT(IS_PAGE_ALIGNED(size_));
     DEBUG_ASSERT(page_source_ == nullptr || parent_ == nullptr);
+
+    Guard<fbl::Mutex> guard{ReclaimListLock::Get()};
+    reclaim_list_.push_back(this);
 }
 
 VmObjectPaged::~VmObjectPaged() {
@@ -84,6 +115,11 @@ VmObjectPaged::~VmObjectPaged() {
 
     LTRACEF("%p\n", this);
 
+    {
+        Guard<fbl::Mutex> guard{ReclaimListLock::Get()};
+        reclaim_list_.erase(*this);
+    }
+
     page_list_.ForEveryPage(
         [this](const auto p, uint64_t off) {
             if (this->is_contiguous()) {
@@ -95,6 +131,8 @@ VmObjectPaged::~VmObjectPaged() {
 
     // free all of the pages attached to us
     page_list_.FreeAllPages();
+    collapsed_pages_.FreeAllPages();
+    compressed_pages_.clear();
 
     if (page_source_) {
         page_source_->Close();
@@ -278,6 +316,21 @@ zx_status_t VmObjectPaged::CloneCOW(bool resizable, uint64_t offset, uint64_t si
 
     auto options = resizable ? kResizable : 0u;
 
+    // Merge away clones between us and the root that nothing else refers to
+    // any more, so that cloning a clone over and over, as forking does,
+    // doesn't keep making the chain longer.  Each one is dropped after the
+    // lock is released, since it takes the lock again on the way out.
+    for (;;) {
+        fbl::RefPtr<VmObject> merged;
+        {
+            Guard<fbl::Mutex> guard{&lock_};
+            merged = CollapseChainLocked();
+        }
+        if (!merged) {
+            break;
+        }
+    }
+
     // allocate the clone up front outside of our lock
     fbl::AllocChecker ac;
     auto vmo = fbl::AdoptRef<VmObjectPaged>(new (&ac) VmObjectPaged(
@@ -315,8 +368,9 @@ zx_status_t VmObjectPaged::CloneCOW(bool resizable, uint64_t offset, uint64_t si
 void VmObjectPaged::Dump(uint depth, bool verbose) {
     canary_.Assert();
 
-    // This can grab our lock.
+    // These can grab our lock.
     uint64_t parent_id = parent_user_id();
+    uint32_t depth = clone_depth();
 
     Guard<fbl::Mutex> guard{&lock_};
 
@@ -330,8 +384,8 @@ void VmObjectPaged::Dump(uint depth, bool verbose) {
         printf("  ");
     }
     printf("vmo %p/k%" PRIu64 " size %#" PRIx64
-           " pages %zu ref %d parent k%" PRIu64 "\n",
-           this, user_id_, size_, count, ref_count_debug(), parent_id);
+           " pages %zu ref %d parent k%" PRIu64 " depth %u\n",
+           this, user_id_, size_, count, ref_count_debug(), parent_id, depth);
 
     if (verbose) {
         auto f = [depth](const auto p, uint64_t offset) {
@@ -366,6 +420,19 @@ size_t VmObjectPaged::AllocatedPagesInRangeLocked(uint64_t offset, uint64_t len)
             }
             return ZX_ERR_NEXT;
         });
+    // the pages of parents merged into us are ours alone, including those our
+    // own pages shadow, since decommitting ours shows them again
+    collapsed_pages_.ForEveryPageInRange(
+        [&count](const auto p, uint64_t off) {
+            count++;
+            return ZX_ERR_NEXT;
+        },
+        offset, offset + new_len);
+    // compressed pages are still committed, they just take up less memory
+    for (auto iter = compressed_pages_.lower_bound(offset);
+         iter.IsValid() && iter->GetKey() < offset + new_len; ++iter) {
+        count++;
+    }
     return count;
 }
 
@@ -421,6 +488,14 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
     // see if we already have a page at that offset
     p = page_list_.GetPage(offset);
     if (p) {
+        // Keep the reclaimer away from the page.  Write faults are the only
+        // way for a pager-backed page to become writable, read faults map it
+        // read-only.
+        p->object.accessed = 1;
+        if (page_source_ &&
+            (pf_flags & VMM_PF_FLAG_FAULT_MASK) && (pf_flags & VMM_PF_FLAG_WRITE)) {
+            p->object.dirty = 1;
+        }
         if (page_out) {
             *page_out = p;
         }
@@ -430,21 +505,53 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         return ZX_OK;
     }
 
+    // the page may have been compressed while it wasn't in use.  only bring
+    // it back for a fault, lookups that just look at what's there treat it as
+    // missing, but mustn't fall through to a parent page it shadows.
+    if (!compressed_pages_.is_empty()) {
+        if (pf_flags & (VMM_PF_FLAG_FAULT_MASK | VMM_PF_FLAG_CHILD_FAULT)) {
+            zx_status_t status = DecompressPageLocked(offset, free_list, page_out, pa_out);
+            if (status != ZX_ERR_NOT_FOUND) {
+                return status;
+            }
+        } else if (compressed_pages_.find(offset).IsValid()) {
+            return ZX_ERR_NOT_FOUND;
+        }
+    }
+
     __UNUSED char pf_string[5];
     LTRACEF("vmo %p, offset %#" PRIx64 ", pf_flags %#x (%s)\n", this, offset, pf_flags,
             vmm_pf_flags_to_string(pf_flags, pf_string));
 
-    // if we have a parent see if they have a page for us
+    // if we have a parent see if they have a page for us. the pages of parents
+    // that were merged into us come first, since they sat between us and it.
     if (parent_) {
-        uint64_t parent_offset;
-        bool overflowed = add_overflow(parent_offset_, offset, &parent_offset);
-        ASSERT(!overflowed);
-
-        // make sure we don't cause the parent to fault in new pages, just ask for any that already exist
-        uint parent_pf_flags = pf_flags & ~(VMM_PF_FLAG_FAULT_MASK);
+        zx_status_t status = ZX_ERR_NOT_FOUND;
+        p = collapsed_pages_.GetPage(offset);
+        if (p) {
+            pa = p->paddr();
+            status = ZX_OK;
+        } else if (offset < parent_limit_) {
+            uint64_t parent_offset;
+            bool overflowed = add_overflow(parent_offset_, offset, &parent_offset);
+            ASSERT(!overflowed);
+
+            // make sure we don't cause the parent to fault in new pages, just ask for any that already exist.
+            // the exception is a tree whose root is backed by a pager: there the root has to ask its
+            // page source for the page, but only ever to read it, since we copy it if we're writing.
+            uint parent_pf_flags;
+            if (GetRootPageSourceLocked()) {
+                parent_pf_flags = pf_flags & ~VMM_PF_FLAG_WRITE;
+            } else {
+                parent_pf_flags = pf_flags & ~(VMM_PF_FLAG_FAULT_MASK);
+                if (pf_flags & VMM_PF_FLAG_FAULT_MASK) {
+                    parent_pf_flags |= VMM_PF_FLAG_CHILD_FAULT;
+                }
+            }
 
-        zx_status_t status = parent_->GetPageLocked(parent_offset, parent_pf_flags,
-                                                    nullptr, page_request, &p, &pa);
+            status = parent_->GetPageLocked(parent_offset, parent_pf_flags,
+                                            nullptr, page_request, &p, &pa);
+        }
         if (status == ZX_OK) {
             // we have a page from them. if we're read-only faulting, return that page so they can map
             // or read from it directly
@@ -520,6 +627,8 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         if (status != ZX_OK) {
             return status;
         }
+        p->object.accessed = 1;
+        p->object.dirty = !!(pf_flags & VMM_PF_FLAG_WRITE);
     } else {
         // if we're read faulting, we don't already have a page, and the parent doesn't have it,
         // return the single global zero page
@@ -534,7 +643,9 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
             return ZX_OK;
         }
 
-        // allocate a page
+        // allocate a page. pages handed to us by the caller still need to be
+        // zeroed, the pmm can usually hand out one that already is.
+        bool zeroed = false;
         if (free_list) {
             p = list_remove_head_type(free_list, vm_page, queue_node);
             if (p) {
@@ -542,7 +653,8 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
             }
         }
         if (!p) {
-            pmm_alloc_page(pmm_alloc_flags_, &p, &pa);
+            pmm_alloc_page(pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZEROED, &p, &pa);
+            zeroed = true;
         }
         if (!p) {
             return ZX_ERR_NO_MEMORY;
@@ -550,8 +662,9 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
 
         InitializeVmPage(p);
 
-        // TODO: remove once pmm returns zeroed pages
-        ZeroPage(pa);
+        if (!zeroed) {
+            ZeroPage(pa);
+        }
 
         // if ARM and not fully cached, clean/invalidate the page after zeroing it
 #if ARCH_ARM64
@@ -579,6 +692,184 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
     return ZX_OK;
 }
 
+zx_status_t VmObjectPaged::PeekPageLocked(uint64_t offset, paddr_t* pa_out) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.lock().IsHeld());
+
+    // follow the same path through the clone chain as GetPageLocked(), but
+    // without touching anything on the way
+    VmObjectPaged* vmo = this;
+    while (offset < vmo->size_) {
+        vm_page_t* p = vmo->page_list_.GetPage(offset);
+        if (!p && vmo->compressed_pages_.find(offset).IsValid()) {
+            return ZX_ERR_NOT_FOUND;
+        }
+        if (!p && vmo->parent_) {
+            p = vmo->collapsed_pages_.GetPage(offset);
+        }
+        if (p) {
+            *pa_out = p->paddr();
+            return ZX_OK;
+        }
+        if (!vmo->parent_ || offset >= vmo->parent_limit_ ||
+            add_overflow(vmo->parent_offset_, offset, &offset)) {
+            return ZX_ERR_NOT_FOUND;
+        }
+        DEBUG_ASSERT(vmo->parent_->is_paged());
+        vmo = static_cast<VmObjectPaged*>(vmo->parent_.get());
+    }
+    return ZX_ERR_NOT_FOUND;
+}
+
+bool VmObjectPaged::IsLargeRunLocked(uint64_t offset) {
+    DEBUG_ASSERT(IS_ALIGNED(offset, LARGE_PAGE_SIZE));
+
+    if (size_ < LARGE_PAGE_SIZE || offset > size_ - LARGE_PAGE_SIZE) {
+        return false;
+    }
+    vm_page_t* p = page_list_.GetPage(offset);
+    if (!p || !IS_ALIGNED(p->paddr(), LARGE_PAGE_SIZE)) {
+        return false;
+    }
+    const paddr_t pa = p->paddr();
+    for (uint64_t o = PAGE_SIZE; o < LARGE_PAGE_SIZE; o += PAGE_SIZE) {
+        p = page_list_.GetPage(offset + o);
+        if (!p || p->paddr() != pa + o) {
+            return false;
+        }
+    }
+    return true;
+}
+
+zx_status_t VmObjectPaged::GetLargePageLocked(uint64_t offset, uint pf_flags, paddr_t* pa_out) {
+    canary_.Assert();
+    DEBUG_ASSERT(IS_ALIGNED(offset, LARGE_PAGE_SIZE));
+
+    // only plain anonymous memory, whose pages can not come from anywhere else
+    if (parent_ || page_source_ || cache_policy_ != ARCH_MMU_FLAG_CACHED) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (offset >= size_ || size_ - offset < LARGE_PAGE_SIZE) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    const uint64_t end = offset + LARGE_PAGE_SIZE;
+    if (IsLargeRunLocked(offset)) {
+        // the reclaimer ages a run as a unit, through its first page
+        vm_page_t* p = page_list_.GetPage(offset);
+        p->object.accessed = 1;
+        *pa_out = p->paddr();
+        return ZX_OK;
+    }
+
+    // reads are served by the zero page or by whatever pages are already
+    // committed, only back the range with a run once it is written to
+    if (!(pf_flags & VMM_PF_FLAG_FAULT_MASK) || !(pf_flags & VMM_PF_FLAG_WRITE)) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    // don't make the pmm search its arenas again for a range it just had no
+    // run for
+    LargePageBackoff& backoff =
+        large_page_backoff_[(offset / LARGE_PAGE_SIZE) % kLargePageBackoffSlots];
+    const zx_time_t now = current_time();
+    if (backoff.offset == offset && now < backoff.retry) {
+        kcounter_add(vm_large_page_backoff, 1);
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    // count what is committed in the range, resident or compressed
+    size_t committed = 0;
+    bool pinned = false;
+    page_list_.ForEveryPageInRange(
+        [&committed, &pinned](const auto p, uint64_t off) {
+            committed++;
+            if (p->object.pin_count > 0) {
+                pinned = true;
+                return ZX_ERR_STOP;
+            }
+            return ZX_ERR_NEXT;
+        },
+        offset, end);
+    for (auto iter = compressed_pages_.lower_bound(offset);
+         iter.IsValid() && iter->GetKey() < end; ++iter) {
+        committed++;
+    }
+
+    // a range that was committed piecemeal, or has had pages compressed since
+    // it was one run, is moved into a run of its own once all of it is
+    // committed again, as long as none of its pages are pinned and the kernel
+    // doesn't reach them through a mapping of its own.
+    const bool promote = committed != 0;
+    if (promote &&
+        (committed != LARGE_PAGE_SIZE / PAGE_SIZE || pinned || IsMappedByKernelLocked())) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    // this is opportunistic, fail rather than disturb the per cpu caches. a
+    // fresh run is usually taken out of the pmm's pre-zeroed pool, rather
+    // than zeroed here with the lock held.
+    list_node pages = LIST_INITIAL_VALUE(pages);
+    paddr_t pa;
+    zx_status_t status = pmm_alloc_contiguous(
+        LARGE_PAGE_SIZE / PAGE_SIZE,
+        pmm_alloc_flags_ | PMM_ALLOC_FLAG_NO_DRAIN | (promote ? 0 : PMM_ALLOC_FLAG_ZEROED),
+        LARGE_PAGE_SIZE_SHIFT, &pa, &pages);
+    if (status != ZX_OK) {
+        // back off for longer each time the same range fails in a row
+        if (backoff.offset == offset) {
+            backoff.delay = fbl::min(backoff.delay * 2, kLargePageBackoffMax);
+        } else {
+            backoff.offset = offset;
+            backoff.delay = kLargePageBackoffMin;
+        }
+        backoff.retry = zx_time_add_duration(now, backoff.delay);
+        kcounter_add(vm_large_page_alloc_fail, 1);
+        return ZX_ERR_NOT_FOUND;
+    }
+    if (backoff.offset == offset) {
+        backoff.offset = UINT64_MAX;
+    }
+    kcounter_add(promote ? vm_large_page_promote : vm_large_page_alloc, 1);
+
+    // other mappings may have the zero page or the old pages mapped here, and
+    // the old pages must not change while they are copied
+    RangeChangeUpdateLocked(offset, LARGE_PAGE_SIZE);
+
+    // the run comes back in address order
+    list_node old_pages = LIST_INITIAL_VALUE(old_pages);
+    uint64_t o = offset;
+    vm_page_t* p;
+    while ((p = list_remove_head_type(&pages, vm_page, queue_node)) != nullptr) {
+        InitializeVmPage(p);
+        if (promote) {
+            vm_page_t* old;
+            if (page_list_.RemovePage(o, &old)) {
+                memcpy(paddr_to_physmap(p->paddr()), paddr_to_physmap(old->paddr()), PAGE_SIZE);
+                list_add_tail(&old_pages, &old->queue_node);
+            } else {
+                auto compressed = compressed_pages_.find(o);
+                DEBUG_ASSERT(compressed.IsValid());
+                compressed->Decompress(p->paddr());
+                compressed_pages_.erase(compressed);
+            }
+        }
+        status = page_list_.AddPage(p, o);
+        DEBUG_ASSERT(status == ZX_OK);
+        o += PAGE_SIZE;
+    }
+    DEBUG_ASSERT(o == end);
+    if (!list_is_empty(&old_pages)) {
+        pmm_free(&old_pages);
+    }
+
+    LTRACEF("%s large page at offset %#" PRIx64 ", pa %#" PRIxPTR "\n",
+            promote ? "promoted" : "faulted in", offset, pa);
+
+    *pa_out = pa;
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len) {
     canary_.Assert();
     LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
@@ -606,6 +897,12 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len) {
     DEBUG_ASSERT(end > offset);
     offset = ROUNDDOWN(offset, PAGE_SIZE);
 
+    // compressed pages count as committed
+    zx_status_t status = DecompressRangeLocked(offset, end);
+    if (status != ZX_OK) {
+        return status;
+    }
+
     // make a pass through the list, counting the number of pages we need to allocate
     size_t count = 0;
     uint64_t expected_next_off = offset;
@@ -630,7 +927,7 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len) {
     list_node page_list;
     list_initialize(&page_list);
 
-    zx_status_t status = pmm_alloc_pages(count, pmm_alloc_flags_, &page_list);
+    status = pmm_alloc_pages(count, pmm_alloc_flags_, &page_list);
     if (status != ZX_OK) {
         return status;
     }
@@ -638,6 +935,34 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len) {
     // unmap all of the pages in this range on all the mapping regions
     RangeChangeUpdateLocked(offset, end - offset);
 
+    if (!parent_) {
+        // There's nowhere else for the pages to come from, so fill in every
+        // gap in one pass over the page list, without going through
+        // GetPageLocked() and its per page unmapping.
+        __UNUSED const bool clean = cache_policy_ != ARCH_MMU_FLAG_CACHED;
+        status = page_list_.PopulateRange(
+            [&](uint64_t off) {
+                vm_page_t* p = list_remove_head_type(&page_list, vm_page, queue_node);
+                DEBUG_ASSERT(p);
+                InitializeVmPage(p);
+                ZeroPage(p);
+#if ARCH_ARM64
+                if (clean) {
+                    arch_clean_invalidate_cache_range((addr_t)paddr_to_physmap(p->paddr()),
+                                                      PAGE_SIZE);
+                }
+#endif
+                return p;
+            },
+            offset, end);
+        if (status != ZX_OK) {
+            pmm_free(&page_list);
+            return status;
+        }
+        DEBUG_ASSERT(list_is_empty(&page_list));
+        return ZX_OK;
+    }
+
     // add them to the appropriate range of the object
     for (uint64_t o = offset; o < end; o += PAGE_SIZE) {
         // Don't commit if we already have this page
@@ -651,7 +976,7 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len) {
         const uint flags = VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE;
         // Should not be able to fail, since we're providing it memory and the
         // range should be valid.
-        zx_status_t status = GetPageLocked(o, flags, &page_list, nullptr, &p, &pa);
+        status = GetPageLocked(o, flags, &page_list, nullptr, &p, &pa);
         ASSERT(status == ZX_OK);
     }
 
@@ -702,6 +1027,7 @@ zx_status_t VmObjectPaged::DecommitRange(uint64_t offset, uint64_t len) {
     RangeChangeUpdateLocked(start, page_aligned_len);
 
     page_list_.FreePages(start, end);
+    FreeCompressedPagesLocked(start, end);
 
     return ZX_OK;
 }
@@ -728,8 +1054,14 @@ zx_status_t VmObjectPaged::PinLocked(uint64_t offset, uint64_t len) {
     const uint64_t start_page_offset = ROUNDDOWN(offset, PAGE_SIZE);
     const uint64_t end_page_offset = ROUNDUP(offset + len, PAGE_SIZE);
 
+    // pages committed before pinning may have been compressed since
+    zx_status_t status = DecompressRangeLocked(start_page_offset, end_page_offset);
+    if (status != ZX_OK) {
+        return status;
+    }
+
     uint64_t expected_next_off = start_page_offset;
-    zx_status_t status = page_list_.ForEveryPageInRange(
+    status = page_list_.ForEveryPageInRange(
         [&expected_next_off](const auto p, uint64_t off) {
             if (off != expected_next_off) {
                 return ZX_ERR_NOT_FOUND;
@@ -855,6 +1187,8 @@ zx_status_t VmObjectPaged::ResizeLocked(uint64_t s) {
         RangeChangeUpdateLocked(start, len);
 
         page_list_.FreePages(start, end);
+        collapsed_pages_.FreePages(start, end);
+        FreeCompressedPagesLocked(start, end);
     } else if (s > size_) {
         // expanding
         // figure the starting and ending page offset that is affected
@@ -899,6 +1233,80 @@ zx_status_t VmObjectPaged::SetParentOffsetLocked(uint64_t offset) {
     return ZX_OK;
 }
 
+fbl::RefPtr<VmObject> VmObjectPaged::CollapseChainLocked() {
+    fbl::RefPtr<VmObject> merged;
+    for (VmObjectPaged* vmo = this; vmo && vmo->parent_;
+         vmo = VmObjectPaged::AsVmObjectPaged(vmo->parent_)) {
+        if (vmo->CollapseParentLocked(&merged)) {
+            break;
+        }
+    }
+    return merged;
+}
+
+bool VmObjectPaged::CollapseParentLocked(fbl::RefPtr<VmObject>* merged) {
+    DEBUG_ASSERT(lock_.lock().IsHeld());
+
+    auto parent = VmObjectPaged::AsVmObjectPaged(parent_);
+    if (!parent) {
+        return false;
+    }
+    // The root owns the lock that the whole tree shares, so it has to stay.
+    // Since any new reference has to be copied from an existing one, and the
+    // ones here are only copied under the lock, a count of one means that
+    // our |parent_| is all that is left: no handle, mapping or pin.
+    if (!parent->parent_ || !VmObjectPaged::AsVmObjectPaged(parent->parent_) ||
+        parent->ref_count_debug() != 1 || parent->children_list_len_ != 1) {
+        return false;
+    }
+    DEBUG_ASSERT(!parent->page_source_);
+
+    // The part of the parent we can see, all of whose pages we gather.  The
+    // grandparent only shows through the part of that below the parent's own
+    // limit: past it the parent reads as zeros where it has no page, so the
+    // grandparent mustn't show through there afterwards.
+    const uint64_t start = parent_offset_;
+    uint64_t new_offset;
+    if (add_overflow(parent->parent_offset_, start, &new_offset)) {
+        return false;
+    }
+    const uint64_t visible = fbl::min(size_, parent_limit_);
+    const uint64_t end =
+        start + (start < parent->size_ ? fbl::min(parent->size_ - start, visible) : 0);
+    const uint64_t limit = fbl::min(parent->size_, parent->parent_limit_);
+    const uint64_t shown = start < limit ? limit - start : 0;
+
+    // Gather everything in the window that we might read into our own list
+    // of collapsed pages.  Nothing but us can see the parent, so if we run
+    // out of memory part way the pages that have already moved are still
+    // found in the same order, and the parent simply stays for now.
+    if (parent->DecompressRangeLocked(start, end) != ZX_OK ||
+        parent->page_list_.MergeFrom(&parent->collapsed_pages_, start, end, 0) != ZX_OK ||
+        collapsed_pages_.MergeFrom(&parent->page_list_, start, end, start) != ZX_OK) {
+        return false;
+    }
+
+    // Become a child of the grandparent.  Adding ourself before removing the
+    // parent keeps it from seeing its child count drop to zero.
+    fbl::RefPtr<VmObject> grandparent = ktl::move(parent->parent_);
+    grandparent->AddChildLocked(this);
+    grandparent->RemoveChildLocked(parent);
+    parent->RemoveChildLocked(this);
+
+    *merged = ktl::move(parent_);
+    parent_ = ktl::move(grandparent);
+    parent_offset_ = new_offset;
+    parent_limit_ = fbl::min(parent_limit_, shown);
+
+    // The pages we could see are the same pages as before, just found here
+    // now, so there's nothing to unmap.
+    kcounter_add(vm_clone_collapsed, 1);
+    LTRACEF("merged parent %p into %p, now at offset %#" PRIx64 "\n",
+            merged->get(), this, parent_offset_);
+
+    return true;
+}
+
 // perform some sort of copy in/out on a range of the object using a passed in lambda
 // for the copy routine
 template <typename T>
@@ -918,14 +1326,10 @@ zx_status_t VmObjectPaged::ReadWriteInternal(uint64_t offset, size_t len, bool w
         return ZX_ERR_OUT_OF_RANGE;
     }
 
-    // TODO: Update read/write to support these
-    if (GetRootPageSourceLocked() != nullptr) {
-        return ZX_ERR_INVALID_ARGS;
-    }
-
     // walk the list of pages and do the write
     uint64_t src_offset = offset;
     size_t dest_offset = 0;
+    PageRequest page_request;
     while (len > 0) {
         size_t page_offset = src_offset % PAGE_SIZE;
         size_t tocopy = MIN(PAGE_SIZE - page_offset, len);
@@ -934,7 +1338,21 @@ zx_status_t VmObjectPaged::ReadWriteInternal(uint64_t offset, size_t len, bool w
         paddr_t pa;
         auto status = GetPageLocked(src_offset,
                                     VMM_PF_FLAG_SW_FAULT | (write ? VMM_PF_FLAG_WRITE : 0),
-                                    nullptr, nullptr, nullptr, &pa);
+                                    nullptr, &page_request, nullptr, &pa);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            // the page has to come from a pager, wait for it without the lock
+            // held and look again, since the vmo may have changed meanwhile
+            guard.CallUnlocked([&page_request, &status]() {
+                status = page_request.Wait();
+            });
+            if (status != ZX_OK) {
+                return status;
+            }
+            if (end_offset > size_) {
+                return ZX_ERR_OUT_OF_RANGE;
+            }
+            continue;
+        }
         if (status != ZX_OK) {
             return status;
         }
@@ -1009,6 +1427,12 @@ zx_status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len,
     const uint64_t start_page_offset = ROUNDDOWN(offset, PAGE_SIZE);
     const uint64_t end_page_offset = ROUNDUP(offset + len, PAGE_SIZE);
 
+    // the caller is going to use the pages, so they have to be there
+    zx_status_t decompress_status = DecompressRangeLocked(start_page_offset, end_page_offset);
+    if (decompress_status != ZX_OK) {
+        return decompress_status;
+    }
+
     uint64_t expected_next_off = start_page_offset;
     zx_status_t status = page_list_.ForEveryPageInRange(
         [&expected_next_off, this, lookup_fn, context,
@@ -1103,6 +1527,11 @@ zx_status_t VmObjectPaged::TakePages(uint64_t offset, uint64_t len, VmPageSplice
         return ZX_ERR_BAD_STATE;
     }
 
+    zx_status_t status = DecompressRangeLocked(offset, offset + len);
+    if (status != ZX_OK) {
+        return status;
+    }
+
     // This is only used by the userpager API, which has significant restrictions on
     // what sorts of vmos are acceptable. If splice starts being used in more places,
     // then this restriction might need to be lifted.
@@ -1129,6 +1558,9 @@ zx_status_t VmObjectPaged::SupplyPages(uint64_t offset, uint64_t len, VmPageSpli
     page_source_->OnPagesSupplied(offset, len);
     while (!pages->IsDone()) {
         vm_page* src_page = pages->Pop();
+        // supplied pages are clean, and are presumably about to be used
+        src_page->object.accessed = 1;
+        src_page->object.dirty = 0;
         zx_status_t status = AddPageLocked(src_page, offset);
         if (status == ZX_ERR_ALREADY_EXISTS) {
             pmm_free_page(src_page);
@@ -1141,6 +1573,283 @@ zx_status_t VmObjectPaged::SupplyPages(uint64_t offset, uint64_t len, VmPageSpli
     return ZX_OK;
 }
 
+zx_status_t VmObjectPaged::FailPageRequests(uint64_t offset, uint64_t len,
+                                            zx_status_t error_status) {
+    Guard<fbl::Mutex> guard{&lock_};
+    ASSERT(page_source_);
+
+    uint64_t end;
+    if (add_overflow(offset, len, &end) || size() < end) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    page_source_->OnPagesFailed(offset, len, error_status);
+    return ZX_OK;
+}
+
+size_t VmObjectPaged::ReclaimPages(size_t target) {
+    // A page is only freed the second time the clock hand passes it, so a
+    // sweep over all the VMOs that only ages pages is still progress.
+    size_t freed = 0;
+    for (uint pass = 0; pass < kReclaimMaxPasses && freed < target; pass++) {
+        bool progress = false;
+        size_t n;
+        {
+            Guard<fbl::Mutex> list_guard{ReclaimListLock::Get()};
+            n = reclaim_list_.size_slow();
+        }
+        for (; n > 0 && freed < target; n--) {
+            // The list lock keeps the VMO from being destroyed while its
+            // batch is looked at, and is dropped before moving on to the
+            // next one, so that creating and destroying VMOs only ever waits
+            // for one batch.
+            Guard<fbl::Mutex> list_guard{ReclaimListLock::Get()};
+            if (reclaim_list_.is_empty()) {
+                break;
+            }
+            VmObjectPaged* vmo = reclaim_list_.pop_front();
+            reclaim_list_.push_back(vmo);
+
+            Guard<fbl::Mutex> guard{&vmo->lock_};
+            freed += vmo->ReclaimPagesLocked(target - freed, &progress);
+        }
+        if (!progress) {
+            break;
+        }
+    }
+
+    return freed;
+}
+
+size_t VmObjectPaged::Reclaim(size_t target) {
+    canary_.Assert();
+
+    size_t freed = 0;
+    for (uint pass = 0; pass < kReclaimMaxPasses && freed < target; pass++) {
+        bool progress = false;
+        Guard<fbl::Mutex> guard{&lock_};
+        freed += ReclaimPagesLocked(target - freed, &progress);
+        if (!progress) {
+            break;
+        }
+    }
+
+    return freed;
+}
+
+size_t VmObjectPaged::ReclaimPagesLocked(size_t target, bool* progress) {
+    canary_.Assert();
+
+    // Cold pages of pager-backed VMOs can be fetched again, so they are
+    // simply evicted.  Those of anonymous VMOs are compressed instead.
+    const bool evict_clean = page_source_ != nullptr;
+    if (!evict_clean && !CanCompressLocked()) {
+        return 0;
+    }
+
+    if (reclaim_cursor_ >= size_) {
+        reclaim_cursor_ = 0;
+    }
+    // never start in the middle of a run that is mapped as one large page
+    if (!evict_clean && IsLargeRunLocked(ROUNDDOWN(reclaim_cursor_, LARGE_PAGE_SIZE))) {
+        reclaim_cursor_ = ROUNDDOWN(reclaim_cursor_, LARGE_PAGE_SIZE);
+    }
+
+    // Ranges to unmap, in ascending order, and which of them to free.  The
+    // rest were used since the clock hand last passed them, and are unmapped
+    // so that the next use faults and marks them again.  A range is a single
+    // page, or a whole large page run, which is aged and evicted as a unit so
+    // that its large mappings aren't split up.
+    uint64_t unmap[kReclaimBatch];
+    uint64_t unmap_len[kReclaimBatch];
+    bool evict[kReclaimBatch];
+    size_t unmap_count = 0;
+    size_t evict_count = 0;
+    size_t scanned = 0;
+    uint64_t next = 0;
+    uint64_t run_end = 0;
+    page_list_.ForEveryPageInRange(
+        // Looks up the pages of a run under lock_, which confuses analysis.
+        [&](const auto p, uint64_t off) TA_NO_THREAD_SAFETY_ANALYSIS {
+            if (off < run_end) {
+                return ZX_ERR_NEXT;
+            }
+            if (scanned == kReclaimBatch || evict_count >= target) {
+                next = off;
+                return ZX_ERR_STOP;
+            }
+            scanned++;
+
+            uint64_t len = PAGE_SIZE;
+            bool accessed = p->object.accessed;
+            bool keep = p->object.pin_count > 0 || p->object.dirty;
+            if (!evict_clean && IS_ALIGNED(off, LARGE_PAGE_SIZE) && IsLargeRunLocked(off)) {
+                len = LARGE_PAGE_SIZE;
+                run_end = off + len;
+                for (uint64_t o = off; o < run_end; o += PAGE_SIZE) {
+                    vm_page_t* q = page_list_.GetPage(o);
+                    accessed = accessed || q->object.accessed;
+                    keep = keep || q->object.pin_count > 0;
+                }
+            }
+            if (keep) {
+                return ZX_ERR_NEXT;
+            }
+            evict[unmap_count] = !accessed;
+            unmap_len[unmap_count] = len;
+            unmap[unmap_count++] = off;
+            if (accessed) {
+                for (uint64_t o = off; o < off + len; o += PAGE_SIZE) {
+                    page_list_.GetPage(o)->object.accessed = 0;
+                }
+            } else {
+                evict_count += len / PAGE_SIZE;
+            }
+            return ZX_ERR_NEXT;
+        },
+        reclaim_cursor_, size_);
+    reclaim_cursor_ = next;
+
+    if (unmap_count == 0) {
+        return 0;
+    }
+    *progress = true;
+
+    // unmap adjacent ranges with one call each
+    for (size_t i = 0; i < unmap_count;) {
+        uint64_t len = unmap_len[i];
+        size_t j = i + 1;
+        while (j < unmap_count && unmap[j] == unmap[i] + len) {
+            len += unmap_len[j];
+            j++;
+        }
+        RangeChangeUpdateLocked(unmap[i], len);
+        i = j;
+    }
+
+    list_node free_list = LIST_INITIAL_VALUE(free_list);
+    size_t aged = 0;
+    size_t freed = 0;
+    for (size_t i = 0; i < unmap_count; i++) {
+        const uint64_t end = unmap[i] + unmap_len[i];
+        if (!evict[i]) {
+            aged += unmap_len[i] / PAGE_SIZE;
+            continue;
+        }
+        if (!evict_clean) {
+            // now that the pages are unmapped their contents can't change.  a
+            // run is only compressed if all of it is, so that it can still be
+            // mapped as a large page otherwise.
+            uint64_t o;
+            for (o = unmap[i]; o < end; o += PAGE_SIZE) {
+                vm_page* p = page_list_.GetPage(o);
+                auto compressed = CompressedPage::Compress(o, p->paddr());
+                if (!compressed) {
+                    break;
+                }
+                compressed_pages_.insert(ktl::move(compressed));
+            }
+            if (o < end) {
+                // don't try again until the clock hand comes back around
+                FreeCompressedPagesLocked(unmap[i], o);
+                page_list_.GetPage(unmap[i])->object.accessed = 1;
+                continue;
+            }
+        }
+        for (uint64_t o = unmap[i]; o < end; o += PAGE_SIZE) {
+            vm_page* p;
+            __UNUSED bool removed = page_list_.RemovePage(o, &p);
+            DEBUG_ASSERT(removed);
+            list_add_tail(&free_list, &p->queue_node);
+            freed++;
+        }
+    }
+    if (freed > 0) {
+        pmm_free(&free_list);
+    }
+
+    kcounter_add(vm_reclaim_aged, aged);
+    if (evict_clean) {
+        kcounter_add(vm_reclaim_evicted, freed);
+    }
+
+    return freed;
+}
+
+bool VmObjectPaged::CanCompressLocked() const {
+    if (!CompressedPage::Enabled()) {
+        return false;
+    }
+    // Only compress memory that belongs to user mode, and that the kernel
+    // doesn't access through a mapping of its own, or of a clone that sees
+    // its pages, since a kernel fault on a compressed page wouldn't be
+    // handled.
+    if (user_id_ == 0 || is_contiguous() || cache_policy_ != ARCH_MMU_FLAG_CACHED) {
+        return false;
+    }
+    return !IsMappedByKernelLocked();
+}
+
+zx_status_t VmObjectPaged::DecompressPageLocked(uint64_t offset, list_node* free_list,
+                                                vm_page_t** page_out, paddr_t* pa_out) {
+    auto compressed = compressed_pages_.find(offset);
+    if (!compressed.IsValid()) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    vm_page_t* p;
+    paddr_t pa;
+    if (free_list && (p = list_remove_head_type(free_list, vm_page, queue_node))) {
+        pa = p->paddr();
+    } else {
+        zx_status_t status = pmm_alloc_page(pmm_alloc_flags_, &p, &pa);
+        if (status != ZX_OK) {
+            return ZX_ERR_NO_MEMORY;
+        }
+    }
+    InitializeVmPage(p);
+
+    compressed->Decompress(pa);
+    compressed_pages_.erase(compressed);
+
+    // nothing can have the offset mapped, it was unmapped everywhere before
+    // the page was compressed and lookups since then found nothing, so there
+    // is no need to go through AddPageLocked() and unmap it all over again
+    zx_status_t status = page_list_.AddPage(p, offset);
+    DEBUG_ASSERT(status == ZX_OK);
+    p->object.accessed = 1;
+
+    LTRACEF("decompressed page at offset %#" PRIx64 "\n", offset);
+
+    if (page_out) {
+        *page_out = p;
+    }
+    if (pa_out) {
+        *pa_out = pa;
+    }
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::DecompressRangeLocked(uint64_t start, uint64_t end) {
+    for (auto iter = compressed_pages_.lower_bound(start);
+         iter.IsValid() && iter->GetKey() < end;) {
+        const uint64_t offset = iter->GetKey();
+        ++iter;
+        zx_status_t status = DecompressPageLocked(offset, nullptr, nullptr, nullptr);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
+void VmObjectPaged::FreeCompressedPagesLocked(uint64_t start, uint64_t end) {
+    auto iter = compressed_pages_.lower_bound(start);
+    while (iter.IsValid() && iter->GetKey() < end) {
+        compressed_pages_.erase(iter++);
+    }
+}
+
 zx_status_t VmObjectPaged::InvalidateCache(const uint64_t offset, const uint64_t len) {
     return CacheOp(offset, len, CacheOpType::Invalidate);
 }
@@ -96,6 +96,45 @@ VmPageList::~VmPageList() {
     DEBUG_ASSERT(list_.is_empty());
 }
 
+VmPageListNode* VmPageList::FindNode(uint64_t node_offset) {
+    if (last_node_ && last_node_->offset() == node_offset) {
+        return last_node_;
+    }
+
+    auto pln = list_.find(node_offset);
+    if (!pln.IsValid()) {
+        return nullptr;
+    }
+    last_node_ = &*pln;
+    return last_node_;
+}
+
+VmPageListNode* VmPageList::GetOrAllocNode(uint64_t node_offset) {
+    VmPageListNode* node = FindNode(node_offset);
+    if (node) {
+        return node;
+    }
+
+    fbl::AllocChecker ac;
+    ktl::unique_ptr<VmPageListNode> pl =
+        ktl::unique_ptr<VmPageListNode>(new (&ac) VmPageListNode(node_offset));
+    if (!ac.check()) {
+        return nullptr;
+    }
+
+    LTRACEF("allocating new inner node %p\n", pl.get());
+    last_node_ = pl.get();
+    list_.insert(ktl::move(pl));
+    return last_node_;
+}
+
+ktl::unique_ptr<VmPageListNode> VmPageList::EraseNode(VmPageListNode& node) {
+    if (last_node_ == &node) {
+        last_node_ = nullptr;
+    }
+    return list_.erase(node);
+}
+
 zx_status_t VmPageList::AddPage(vm_page* p, uint64_t offset) {
     uint64_t node_offset = offset_to_node_offset(offset);
     size_t index = offset_to_node_index(offset);
@@ -103,25 +142,12 @@ zx_status_t VmPageList::AddPage(vm_page* p, uint64_t offset) {
     LTRACEF_LEVEL(2, "%p page %p, offset %#" PRIx64 " node_offset %#" PRIx64 " index %zu\n", this, p, offset,
                   node_offset, index);
 
-    // lookup the tree node that holds this page
-    auto pln = list_.find(node_offset);
-    if (!pln.IsValid()) {
-        fbl::AllocChecker ac;
-        ktl::unique_ptr<VmPageListNode> pl =
-            ktl::unique_ptr<VmPageListNode>(new (&ac) VmPageListNode(node_offset));
-        if (!ac.check()) {
-            return ZX_ERR_NO_MEMORY;
-        }
-
-        LTRACEF("allocating new inner node %p\n", pl.get());
-        __UNUSED auto status = pl->AddPage(p, index);
-        DEBUG_ASSERT(status == ZX_OK);
-
-        list_.insert(ktl::move(pl));
-        return ZX_OK;
-    } else {
-        return pln->AddPage(p, index);
+    // lookup the tree node that holds this page, creating it if needed
+    VmPageListNode* pln = GetOrAllocNode(node_offset);
+    if (!pln) {
+        return ZX_ERR_NO_MEMORY;
     }
+    return pln->AddPage(p, index);
 }
 
 vm_page* VmPageList::GetPage(uint64_t offset) {
@@ -132,8 +158,8 @@ vm_page* VmPageList::GetPage(uint64_t offset) {
                   index);
 
     // lookup the tree node that holds this page
-    auto pln = list_.find(node_offset);
-    if (!pln.IsValid()) {
+    VmPageListNode* pln = FindNode(node_offset);
+    if (!pln) {
         return nullptr;
     }
 
@@ -150,8 +176,8 @@ bool VmPageList::RemovePage(uint64_t offset, vm_page_t** page_out) {
                   index);
 
     // lookup the tree node that holds this page
-    auto pln = list_.find(node_offset);
-    if (!pln.IsValid()) {
+    VmPageListNode* pln = FindNode(node_offset);
+    if (!pln) {
         return false;
     }
 
@@ -161,7 +187,7 @@ bool VmPageList::RemovePage(uint64_t offset, vm_page_t** page_out) {
         // if it was the last page in the node, remove the node from the tree
         if (pln->IsEmpty()) {
             LTRACEF_LEVEL(2, "%p freeing the list node\n", this);
-            list_.erase(*pln);
+            EraseNode(*pln);
         }
 
         *page_out = page;
@@ -199,7 +225,7 @@ void VmPageList::FreePages(uint64_t start_offset, uint64_t end_offset) {
         auto cur = start++;
         cur->ForEveryPage(per_page_func, start_offset, end_offset);
         if (cur->IsEmpty()) {
-            list_.erase(cur);
+            EraseNode(*cur);
         }
     }
 
@@ -231,6 +257,7 @@ size_t VmPageList::FreeAllPages() {
     pmm_free(&list);
 
     // empty the tree
+    last_node_ = nullptr;
     list_.clear();
 
     return count;
@@ -240,37 +267,85 @@ bool VmPageList::IsEmpty() {
     return list_.is_empty();
 }
 
+zx_status_t VmPageList::MergeFrom(VmPageList* src, uint64_t start_offset, uint64_t end_offset,
+                                  uint64_t shift) {
+    DEBUG_ASSERT(src != this);
+    DEBUG_ASSERT(shift <= start_offset);
+
+    auto start = --src->list_.upper_bound(start_offset);
+    if (!start.IsValid()) {
+        start = src->list_.begin();
+    }
+    const auto end = src->list_.lower_bound(end_offset);
+
+    zx_status_t status = ZX_ERR_NEXT;
+    auto per_page_func = [this, shift, &status](vm_page*& p, uint64_t offset) {
+        const uint64_t dest_offset = offset - shift;
+        VmPageListNode* node = GetOrAllocNode(offset_to_node_offset(dest_offset));
+        if (!node) {
+            status = ZX_ERR_NO_MEMORY;
+            return ZX_ERR_STOP;
+        }
+        if (node->AddPage(p, offset_to_node_index(dest_offset)) == ZX_OK) {
+            p = nullptr;
+        }
+        return ZX_ERR_NEXT;
+    };
+
+    while (start != end && status == ZX_ERR_NEXT) {
+        auto cur = start++;
+        cur->ForEveryPage(per_page_func, start_offset, end_offset);
+        if (cur->IsEmpty()) {
+            src->EraseNode(*cur);
+        }
+    }
+
+    return status == ZX_ERR_NEXT ? ZX_OK : status;
+}
+
 VmPageSpliceList VmPageList::TakePages(uint64_t offset, uint64_t length) {
     VmPageSpliceList res(offset, length);
     const uint64_t end = offset + length;
 
+    // Moves the pages in [offset, limit) of the node holding |offset| into
+    // |dest|, and erases the node if that empties it.
+    auto take_from_node = [this, &offset](VmPageListNode* dest, uint64_t limit) {
+        VmPageListNode* node = FindNode(offset_to_node_offset(offset));
+        for (; offset < limit; offset += PAGE_SIZE) {
+            vm_page_t* page = node ? node->RemovePage(offset_to_node_index(offset)) : nullptr;
+            if (page) {
+                dest->AddPage(page, offset_to_node_index(offset));
+            }
+        }
+        if (node && node->IsEmpty()) {
+            EraseNode(*node);
+        }
+    };
+
     // If we can't take the whole node at the start of the range,
     // the shove the pages into the splice list head_ node.
-    while (offset_to_node_index(offset) != 0 && offset < end) {
-        vm_page_t* page;
-        if (RemovePage(offset, &page)) {
-            res.head_.AddPage(page, offset_to_node_index(offset));
-        }
-        offset += PAGE_SIZE;
+    if (offset_to_node_index(offset) != 0) {
+        const uint64_t head_end =
+            offset_to_node_offset(offset) + PAGE_SIZE * VmPageListNode::kPageFanOut;
+        take_from_node(&res.head_, head_end < end ? head_end : end);
     }
 
-    // As long as the current and end node offsets are different, we
-    // can just move the whole node into the splice list.
-    while (offset_to_node_offset(offset) != offset_to_node_offset(end)) {
-        ktl::unique_ptr<VmPageListNode> node = list_.erase(offset_to_node_offset(offset));
-        if (node) {
-            res.middle_.insert(ktl::move(node));
+    // As long as the current and end node offsets are different, we can
+    // just move whole nodes into the splice list.  Only the nodes that
+    // exist are visited, so sparse ranges are cheap.
+    const uint64_t tail_node_offset = offset_to_node_offset(end);
+    if (offset < tail_node_offset) {
+        auto iter = list_.lower_bound(offset);
+        while (iter.IsValid() && iter->offset() < tail_node_offset) {
+            auto cur = iter++;
+            res.middle_.insert(EraseNode(*cur));
         }
-        offset += (PAGE_SIZE * VmPageListNode::kPageFanOut);
+        offset = tail_node_offset;
     }
 
     // Move any remaining pages into the splice list tail_ node.
-    while (offset < end) {
-        vm_page_t* page;
-        if (RemovePage(offset, &page)) {
-            res.tail_.AddPage(page, offset_to_node_index(offset));
-        }
-        offset += PAGE_SIZE;
+    if (offset < end) {
+        take_from_node(&res.tail_, end);
     }
 
     return res;
@@ -8,8 +8,13 @@
 #include <err.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/array.h>
+#include <inttypes.h>
 #include <ktl/move.h>
 #include <lib/unittest/unittest.h>
+#include <platform.h>
+#include <vm/compressed_page.h>
+#include <vm/fault.h>
+#include <vm/page_source.h>
 #include <vm/physmap.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
@@ -55,6 +60,83 @@ static bool pmm_multi_alloc_test() {
     END_TEST;
 }
 
+// Allocates and frees enough single pages to overflow and refill the per cpu
+// page caches, making sure every page comes back in a sane state.
+static bool pmm_single_page_churn_test() {
+    BEGIN_TEST;
+    list_node list = LIST_INITIAL_VALUE(list);
+
+    static const size_t alloc_count = 256;
+
+    for (size_t i = 0; i < alloc_count; i++) {
+        vm_page_t* page;
+        zx_status_t status = pmm_alloc_page(0, &page);
+        ASSERT_EQ(ZX_OK, status, "pmm_alloc single page");
+        EXPECT_EQ(VM_PAGE_STATE_ALLOC, page->state, "allocated page state");
+        list_add_tail(&list, &page->queue_node);
+    }
+
+    // free them one at a time so they go through the cache
+    while (!list_is_empty(&list)) {
+        vm_page_t* page = list_remove_head_type(&list, vm_page_t, queue_node);
+        pmm_free_page(page);
+    }
+
+    // a multi page contiguous run must still be satisfiable with the caches full
+    paddr_t pa;
+    zx_status_t status = pmm_alloc_contiguous(alloc_count, 0, PAGE_SIZE_SHIFT, &pa, &list);
+    ASSERT_EQ(ZX_OK, status, "pmm_alloc_contiguous after churn");
+    EXPECT_EQ(alloc_count, list_length(&list), "pmm_alloc_contiguous list count");
+
+    pmm_free(&list);
+    END_TEST;
+}
+
+static bool page_is_zero(vm_page_t* page) {
+    const uint64_t* ptr = static_cast<const uint64_t*>(paddr_to_physmap(page->paddr()));
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+        if (ptr[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Allocates zeroed pages, dirties them and frees them, more than once so that
+// both pages out of the pre-zeroed pool and pages zeroed inline are checked.
+static bool pmm_alloc_zeroed_test() {
+    BEGIN_TEST;
+    list_node list = LIST_INITIAL_VALUE(list);
+
+    static const size_t alloc_count = 64;
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < alloc_count; i++) {
+            vm_page_t* page;
+            zx_status_t status = pmm_alloc_page(PMM_ALLOC_FLAG_ZEROED, &page);
+            ASSERT_EQ(ZX_OK, status, "pmm_alloc zeroed page");
+            EXPECT_EQ(VM_PAGE_STATE_ALLOC, page->state, "allocated page state");
+            EXPECT_TRUE(page_is_zero(page), "page is not zero");
+            memset(paddr_to_physmap(page->paddr()), 0xa5, PAGE_SIZE);
+            list_add_tail(&list, &page->queue_node);
+        }
+        pmm_free(&list);
+
+        zx_status_t status = pmm_alloc_pages(alloc_count, PMM_ALLOC_FLAG_ZEROED, &list);
+        ASSERT_EQ(ZX_OK, status, "pmm_alloc_pages zeroed pages");
+        EXPECT_EQ(alloc_count, list_length(&list), "pmm_alloc_pages list count");
+        vm_page_t* page;
+        list_for_every_entry (&list, page, vm_page_t, queue_node) {
+            EXPECT_EQ(VM_PAGE_STATE_ALLOC, page->state, "allocated page state");
+            EXPECT_TRUE(page_is_zero(page), "page is not zero");
+            memset(paddr_to_physmap(page->paddr()), 0xa5, PAGE_SIZE);
+        }
+        pmm_free(&list);
+    }
+
+    END_TEST;
+}
+
 // Allocates too many pages and makes sure it fails nicely.
 static bool pmm_oversized_alloc_test() {
     BEGIN_TEST;
@@ -907,6 +989,514 @@ static bool vmo_cache_test() {
     END_TEST;
 }
 
+// Checks that a write fault backs a large enough vm object with one aligned,
+// contiguous run per large page, and that decommitting part of it breaks it up.
+static bool vmo_large_page_test() {
+    BEGIN_TEST;
+
+    static const size_t alloc_size = LARGE_PAGE_SIZE * 2;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &vmo);
+    ASSERT_EQ(status, ZX_OK, "vmobject creation\n");
+    ASSERT_TRUE(vmo, "vmobject creation\n");
+
+    paddr_t pa;
+    {
+        Guard<fbl::Mutex> guard{vmo->lock()};
+
+        // reads are left to the zero page
+        status = vmo->GetLargePageLocked(0, VMM_PF_FLAG_SW_FAULT, &pa);
+        EXPECT_EQ(ZX_ERR_NOT_FOUND, status, "read fault\n");
+
+        status = vmo->GetLargePageLocked(0, VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE, &pa);
+        if (status == ZX_ERR_NOT_FOUND) {
+            unittest_printf("no contiguous run of memory available, skipping\n");
+            END_TEST;
+        }
+        ASSERT_EQ(ZX_OK, status, "write fault\n");
+        EXPECT_TRUE(IS_ALIGNED(pa, LARGE_PAGE_SIZE), "large page alignment\n");
+
+        // once committed it is found again, with or without a fault
+        paddr_t pa2;
+        EXPECT_EQ(ZX_OK, vmo->GetLargePageLocked(0, 0, &pa2), "lookup\n");
+        EXPECT_EQ(pa, pa2, "lookup\n");
+
+        // and is made of the pages the vmo has
+        paddr_t page_pa;
+        EXPECT_EQ(ZX_OK, vmo->GetPageLocked(PAGE_SIZE * 3, 0, nullptr, nullptr, nullptr, &page_pa),
+                  "page lookup\n");
+        EXPECT_EQ(pa + PAGE_SIZE * 3, page_pa, "page lookup\n");
+    }
+    EXPECT_EQ(LARGE_PAGE_SIZE / PAGE_SIZE, vmo->AllocatedPages(), "committed pages\n");
+
+    // a hole means the range can no longer be mapped with a large page
+    EXPECT_EQ(ZX_OK, vmo->DecommitRange(PAGE_SIZE, PAGE_SIZE), "decommit\n");
+    {
+        Guard<fbl::Mutex> guard{vmo->lock()};
+        status = vmo->GetLargePageLocked(0, VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE, &pa);
+        EXPECT_EQ(ZX_ERR_NOT_FOUND, status, "partially committed\n");
+    }
+
+    END_TEST;
+}
+
+// Checks that a range committed a page at a time is moved into a large page
+// run on a write fault, but not on a read fault.
+static bool vmo_large_page_promote_test() {
+    BEGIN_TEST;
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, LARGE_PAGE_SIZE, &vmo);
+    ASSERT_EQ(status, ZX_OK, "vmobject creation\n");
+    ASSERT_TRUE(vmo, "vmobject creation\n");
+
+    status = vmo->CommitRange(0, LARGE_PAGE_SIZE);
+    ASSERT_EQ(ZX_OK, status, "committing vm object\n");
+    const uint32_t val = 0x12345678;
+    status = vmo->Write(&val, PAGE_SIZE * 3, sizeof(val));
+    ASSERT_EQ(ZX_OK, status, "writing vm object\n");
+
+    paddr_t pa;
+    {
+        Guard<fbl::Mutex> guard{vmo->lock()};
+        status = vmo->GetLargePageLocked(0, VMM_PF_FLAG_SW_FAULT, &pa);
+        if (status == ZX_OK) {
+            unittest_printf("pages were committed as one run, skipping\n");
+            END_TEST;
+        }
+        EXPECT_EQ(ZX_ERR_NOT_FOUND, status, "read fault\n");
+
+        status = vmo->GetLargePageLocked(0, VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE, &pa);
+        if (status == ZX_ERR_NOT_FOUND) {
+            unittest_printf("no contiguous run of memory available, skipping\n");
+            END_TEST;
+        }
+        ASSERT_EQ(ZX_OK, status, "write fault\n");
+        EXPECT_TRUE(IS_ALIGNED(pa, LARGE_PAGE_SIZE), "large page alignment\n");
+        EXPECT_EQ(val, *static_cast<uint32_t*>(paddr_to_physmap(pa + PAGE_SIZE * 3)),
+                  "contents\n");
+    }
+    EXPECT_EQ(LARGE_PAGE_SIZE / PAGE_SIZE, vmo->AllocatedPages(), "committed pages\n");
+
+    END_TEST;
+}
+
+// Checks that the reclaimer ages and compresses a large page run as a unit,
+// and that the next write fault moves it back into a run.
+static bool vmo_large_page_reclaim_test() {
+    BEGIN_TEST;
+
+    // anonymous pages are only reclaimed by compressing them
+    if (!CompressedPage::Enabled()) {
+        unittest_printf("compression is disabled, skipping\n");
+        END_TEST;
+    }
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, LARGE_PAGE_SIZE, &vmo);
+    ASSERT_EQ(status, ZX_OK, "vmobject creation\n");
+    ASSERT_TRUE(vmo, "vmobject creation\n");
+    vmo->set_user_id(1);
+
+    paddr_t pa;
+    {
+        Guard<fbl::Mutex> guard{vmo->lock()};
+        status = vmo->GetLargePageLocked(0, VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE, &pa);
+        if (status == ZX_ERR_NOT_FOUND) {
+            unittest_printf("no contiguous run of memory available, skipping\n");
+            END_TEST;
+        }
+        ASSERT_EQ(ZX_OK, status, "write fault\n");
+        *static_cast<uint32_t*>(paddr_to_physmap(pa + PAGE_SIZE * 3)) = 0x12345678;
+    }
+
+    // the first pass ages the whole run, and the second evicts all of it,
+    // even though only one page was asked for
+    auto paged = static_cast<VmObjectPaged*>(vmo.get());
+    EXPECT_EQ(LARGE_PAGE_SIZE / PAGE_SIZE, paged->Reclaim(1), "reclaim\n");
+    {
+        Guard<fbl::Mutex> guard{vmo->lock()};
+        paddr_t page_pa;
+        EXPECT_EQ(ZX_ERR_NOT_FOUND, vmo->PeekPageLocked(PAGE_SIZE * 3, &page_pa), "compressed\n");
+
+        status = vmo->GetLargePageLocked(0, VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE, &pa);
+        if (status == ZX_ERR_NOT_FOUND) {
+            unittest_printf("no contiguous run of memory available, skipping\n");
+            END_TEST;
+        }
+        ASSERT_EQ(ZX_OK, status, "write fault\n");
+        EXPECT_TRUE(IS_ALIGNED(pa, LARGE_PAGE_SIZE), "large page alignment\n");
+        EXPECT_EQ(0x12345678u, *static_cast<uint32_t*>(paddr_to_physmap(pa + PAGE_SIZE * 3)),
+                  "contents\n");
+    }
+    EXPECT_EQ(LARGE_PAGE_SIZE / PAGE_SIZE, vmo->AllocatedPages(), "committed pages\n");
+
+    END_TEST;
+}
+
+// Checks that a large page run with a page that doesn't compress is left
+// whole, rather than compressed around that page.
+static bool vmo_large_page_compress_test() {
+    BEGIN_TEST;
+
+    if (!CompressedPage::Enabled()) {
+        unittest_printf("compression is disabled, skipping\n");
+        END_TEST;
+    }
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, LARGE_PAGE_SIZE, &vmo);
+    ASSERT_EQ(status, ZX_OK, "vmobject creation\n");
+    ASSERT_TRUE(vmo, "vmobject creation\n");
+    vmo->set_user_id(1);
+
+    paddr_t pa;
+    {
+        Guard<fbl::Mutex> guard{vmo->lock()};
+        status = vmo->GetLargePageLocked(0, VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE, &pa);
+        if (status == ZX_ERR_NOT_FOUND) {
+            unittest_printf("no contiguous run of memory available, skipping\n");
+            END_TEST;
+        }
+        ASSERT_EQ(ZX_OK, status, "write fault\n");
+
+        // pseudo-random bytes, which don't compress
+        auto words = static_cast<uint64_t*>(paddr_to_physmap(pa + PAGE_SIZE * 5));
+        uint64_t x = 0x9e3779b97f4a7c15;
+        for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            words[i] = x;
+        }
+    }
+
+    auto paged = static_cast<VmObjectPaged*>(vmo.get());
+    EXPECT_EQ(0u, paged->Reclaim(SIZE_MAX), "reclaim\n");
+    {
+        Guard<fbl::Mutex> guard{vmo->lock()};
+        paddr_t run_pa;
+        EXPECT_EQ(ZX_OK, vmo->GetLargePageLocked(0, VMM_PF_FLAG_SW_FAULT, &run_pa), "read fault\n");
+        EXPECT_EQ(pa, run_pa, "same run\n");
+    }
+    EXPECT_EQ(LARGE_PAGE_SIZE / PAGE_SIZE, vmo->AllocatedPages(), "committed pages\n");
+
+    END_TEST;
+}
+
+// A page source whose pages are all supplied up front.
+class SuppliedPageSourceCallback : public PageSourceCallback {
+public:
+    bool GetPage(uint64_t offset, vm_page_t** const page_out, paddr_t* const pa_out) override {
+        return false;
+    }
+    void GetPageAsync(page_request_t* request) override {}
+    void ClearAsyncRequest(page_request_t* request) override {}
+    void SwapRequest(page_request_t* old, page_request_t* new_req) override {}
+    void OnClose() override {}
+    zx_status_t WaitOnEvent(event_t* event) override { return ZX_ERR_NOT_SUPPORTED; }
+};
+
+static bool vmo_reclaim_test() {
+    BEGIN_TEST;
+
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    SuppliedPageSourceCallback callback;
+    fbl::AllocChecker ac;
+    auto src = fbl::AdoptRef(new (&ac) PageSource(&callback, 0));
+    ASSERT_TRUE(ac.check(), "page source creation\n");
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::CreateExternal(ktl::move(src), alloc_size, &vmo);
+    ASSERT_EQ(ZX_OK, status, "vmobject creation\n");
+
+    // supply the pages out of another vmo, as a pager would
+    fbl::RefPtr<VmObject> aux;
+    status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &aux);
+    ASSERT_EQ(ZX_OK, status, "vmobject creation\n");
+    ASSERT_EQ(ZX_OK, aux->CommitRange(0, alloc_size), "commit\n");
+    VmPageSpliceList pages;
+    ASSERT_EQ(ZX_OK, aux->TakePages(0, alloc_size, &pages), "take pages\n");
+    ASSERT_EQ(ZX_OK, vmo->SupplyPages(0, alloc_size, &pages), "supply pages\n");
+    EXPECT_EQ(alloc_size / PAGE_SIZE, vmo->AllocatedPages(), "supplied pages\n");
+
+    // map it, which maps the supplied pages read-only, so that writing
+    // through the mapping faults and dirties the page
+    auto ka = VmAspace::kernel_aspace();
+    void* ptr;
+    status = ka->MapObjectInternal(vmo, "test", 0, alloc_size, &ptr,
+                                   0, VmAspace::VMM_FLAG_COMMIT, kArchRwFlags);
+    ASSERT_EQ(ZX_OK, status, "mapping object\n");
+
+    // a written page and a pinned page must both stay
+    static_cast<volatile uint8_t*>(ptr)[0] = 0xff;
+    EXPECT_EQ(ZX_OK, vmo->Pin(PAGE_SIZE, PAGE_SIZE), "pin\n");
+
+    // pages are only evicted the second time the reclaimer passes them
+    auto paged = static_cast<VmObjectPaged*>(vmo.get());
+    EXPECT_EQ(2u, paged->Reclaim(SIZE_MAX), "reclaim\n");
+    EXPECT_EQ(2u, vmo->AllocatedPages(), "pages left\n");
+    EXPECT_EQ(1u, vmo->AllocatedPagesInRange(0, PAGE_SIZE), "written page\n");
+    EXPECT_EQ(1u, vmo->AllocatedPagesInRange(PAGE_SIZE, PAGE_SIZE), "pinned page\n");
+
+    vmo->Unpin(PAGE_SIZE, PAGE_SIZE);
+    EXPECT_EQ(ZX_OK, ka->FreeRegion(reinterpret_cast<vaddr_t>(ptr)), "unmap\n");
+
+    END_TEST;
+}
+
+static bool vmo_compressed_page_test() {
+    BEGIN_TEST;
+
+    if (!CompressedPage::Enabled()) {
+        unittest_printf("compression disabled, skipping\n");
+        END_TEST;
+    }
+
+    paddr_t pa;
+    vm_page_t* page;
+    zx_status_t status = pmm_alloc_page(0, &page, &pa);
+    ASSERT_EQ(ZX_OK, status, "pmm_alloc single page");
+    uint32_t* words = static_cast<uint32_t*>(paddr_to_physmap(pa));
+    const size_t count = PAGE_SIZE / sizeof(uint32_t);
+
+    // a repetitive page compresses, and comes back the same
+    for (size_t i = 0; i < count; i++) {
+        words[i] = static_cast<uint32_t>(i % 16);
+    }
+    auto compressed = CompressedPage::Compress(PAGE_SIZE, pa);
+    ASSERT_NONNULL(compressed.get(), "compress\n");
+    EXPECT_EQ(PAGE_SIZE, compressed->GetKey(), "offset\n");
+    EXPECT_LT(compressed->compressed_size(), PAGE_SIZE / 4, "compressed size\n");
+    memset(words, 0xff, PAGE_SIZE);
+    compressed->Decompress(pa);
+    bool same = true;
+    for (size_t i = 0; i < count; i++) {
+        same = same && words[i] == i % 16;
+    }
+    EXPECT_TRUE(same, "decompressed contents\n");
+
+    // a page of noise doesn't compress well enough to keep
+    uint32_t x = 0x12345678;
+    for (size_t i = 0; i < count; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        words[i] = x;
+    }
+    EXPECT_NULL(CompressedPage::Compress(0, pa).get(), "incompressible page\n");
+
+    pmm_free_page(page);
+
+    END_TEST;
+}
+
+// Checks that peeking at a VMO's pages finds the ones it and its parents
+// already have, without touching them or committing new ones.
+static bool vmo_peek_page_test() {
+    BEGIN_TEST;
+
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &vmo);
+    ASSERT_EQ(ZX_OK, status, "vmobject creation\n");
+    ASSERT_EQ(ZX_OK, vmo->CommitRange(0, PAGE_SIZE), "commit\n");
+
+    fbl::RefPtr<VmObject> clone;
+    ASSERT_EQ(ZX_OK, vmo->CloneCOW(false, 0, alloc_size, false, &clone), "clone\n");
+    {
+        Guard<fbl::Mutex> guard{vmo->lock()};
+        vm_page_t* page;
+        paddr_t pa;
+        ASSERT_EQ(ZX_OK, vmo->GetPageLocked(0, 0, nullptr, nullptr, &page, &pa), "lookup\n");
+        page->object.accessed = 0;
+
+        paddr_t peeked;
+        EXPECT_EQ(ZX_OK, vmo->PeekPageLocked(0, &peeked), "peek\n");
+        EXPECT_EQ(pa, peeked, "peek\n");
+        EXPECT_EQ(ZX_OK, clone->PeekPageLocked(0, &peeked), "peek through clone\n");
+        EXPECT_EQ(pa, peeked, "peek through clone\n");
+        EXPECT_EQ(0u, page->object.accessed, "page left alone\n");
+
+        EXPECT_EQ(ZX_ERR_NOT_FOUND, clone->PeekPageLocked(PAGE_SIZE, &peeked), "no page\n");
+        EXPECT_EQ(ZX_ERR_NOT_FOUND, clone->PeekPageLocked(alloc_size, &peeked), "past end\n");
+    }
+    EXPECT_EQ(1u, vmo->AllocatedPages(), "committed pages\n");
+    EXPECT_EQ(0u, clone->AllocatedPages(), "clone pages\n");
+
+    END_TEST;
+}
+
+// Checks that reclaimed pages of an anonymous VMO are compressed, still count
+// as committed, and only come back when they are used.
+static bool vmo_reclaim_compress_test() {
+    BEGIN_TEST;
+
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &vmo);
+    ASSERT_EQ(ZX_OK, status, "vmobject creation\n");
+    vmo->set_user_id(1);
+
+    // a repetitive pattern, which compresses well
+    fbl::AllocChecker ac;
+    fbl::Array<uint8_t> data(new (&ac) uint8_t[alloc_size], alloc_size);
+    ASSERT_TRUE(ac.check(), "allocating buffer\n");
+    for (size_t i = 0; i < alloc_size; i++) {
+        data[i] = static_cast<uint8_t>(i % 16);
+    }
+    ASSERT_EQ(ZX_OK, vmo->Write(data.get(), 0, alloc_size), "write\n");
+    auto paged = static_cast<VmObjectPaged*>(vmo.get());
+
+    // nothing is compressed when kernel.vm.compression turns it off
+    if (!CompressedPage::Enabled()) {
+        EXPECT_EQ(0u, paged->Reclaim(SIZE_MAX), "reclaim while disabled\n");
+        END_TEST;
+    }
+
+    // a clone the kernel maps keeps the pages as they are, since it would
+    // read them without faulting
+    fbl::RefPtr<VmObject> clone;
+    ASSERT_EQ(ZX_OK, vmo->CloneCOW(false, 0, alloc_size, false, &clone), "clone\n");
+    auto ka = VmAspace::kernel_aspace();
+    void* ptr;
+    status = ka->MapObjectInternal(clone, "test", 0, alloc_size, &ptr, 0, 0, kArchRwFlags);
+    ASSERT_EQ(ZX_OK, status, "mapping object\n");
+    EXPECT_EQ(0u, paged->Reclaim(SIZE_MAX), "reclaim while mapped\n");
+    EXPECT_EQ(ZX_OK, ka->FreeRegion(reinterpret_cast<vaddr_t>(ptr)), "unmap\n");
+
+    EXPECT_EQ(alloc_size / PAGE_SIZE, paged->Reclaim(SIZE_MAX), "reclaim\n");
+    EXPECT_EQ(alloc_size / PAGE_SIZE, vmo->AllocatedPages(), "compressed pages\n");
+
+    // looking at what's there doesn't bring a page back, or see through it
+    {
+        Guard<fbl::Mutex> guard{vmo->lock()};
+        paddr_t pa;
+        EXPECT_EQ(ZX_ERR_NOT_FOUND,
+                  vmo->GetPageLocked(0, 0, nullptr, nullptr, nullptr, &pa), "lookup\n");
+        EXPECT_EQ(ZX_ERR_NOT_FOUND,
+                  clone->GetPageLocked(0, 0, nullptr, nullptr, nullptr, &pa), "clone lookup\n");
+    }
+
+    // but reading through the clone does
+    fbl::Array<uint8_t> buf(new (&ac) uint8_t[PAGE_SIZE], PAGE_SIZE);
+    ASSERT_TRUE(ac.check(), "allocating buffer\n");
+    EXPECT_EQ(ZX_OK, clone->Read(buf.get(), PAGE_SIZE, PAGE_SIZE), "clone read\n");
+    EXPECT_EQ(0, memcmp(buf.get(), data.get() + PAGE_SIZE, PAGE_SIZE), "clone contents\n");
+    EXPECT_EQ(ZX_OK, vmo->Read(buf.get(), 0, PAGE_SIZE), "read\n");
+    EXPECT_EQ(0, memcmp(buf.get(), data.get(), PAGE_SIZE), "contents\n");
+    EXPECT_EQ(alloc_size / PAGE_SIZE, vmo->AllocatedPages(), "committed pages\n");
+
+    END_TEST;
+}
+
+// Checks that a clone nothing else refers to is merged into its only child
+// without changing what the child sees.
+static bool vmo_clone_collapse_test() {
+    BEGIN_TEST;
+
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> root;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &root);
+    ASSERT_EQ(ZX_OK, status, "vmobject creation\n");
+
+    auto write_byte = [](const fbl::RefPtr<VmObject>& vmo, uint64_t page, uint8_t value) {
+        return vmo->Write(&value, page * PAGE_SIZE, sizeof(value));
+    };
+    auto read_byte = [](const fbl::RefPtr<VmObject>& vmo, uint64_t page) {
+        uint8_t value = 0;
+        vmo->Read(&value, page * PAGE_SIZE, sizeof(value));
+        return value;
+    };
+
+    // root: page 3 is 1
+    // middle: pages 0 and 1 are 2
+    // child: page 1 is 3
+    EXPECT_EQ(ZX_OK, write_byte(root, 3, 1), "write\n");
+    fbl::RefPtr<VmObject> middle;
+    ASSERT_EQ(ZX_OK, root->CloneCOW(false, 0, alloc_size, false, &middle), "clone\n");
+    EXPECT_EQ(ZX_OK, write_byte(middle, 0, 2), "write\n");
+    EXPECT_EQ(ZX_OK, write_byte(middle, 1, 2), "write\n");
+    fbl::RefPtr<VmObject> child;
+    ASSERT_EQ(ZX_OK, middle->CloneCOW(false, 0, alloc_size, false, &child), "clone\n");
+    EXPECT_EQ(ZX_OK, write_byte(child, 1, 3), "write\n");
+    EXPECT_EQ(2u, child->clone_depth(), "depth before\n");
+
+    // cloning the child merges the middle once nothing else holds it
+    middle.reset();
+    fbl::RefPtr<VmObject> grandchild;
+    ASSERT_EQ(ZX_OK, child->CloneCOW(false, 0, alloc_size, false, &grandchild), "clone\n");
+    EXPECT_EQ(1u, child->clone_depth(), "depth after\n");
+    EXPECT_EQ(2u, grandchild->clone_depth(), "grandchild depth\n");
+    EXPECT_EQ(1u, root->num_children(), "root children\n");
+
+    EXPECT_EQ(2u, read_byte(child, 0), "merged page\n");
+    EXPECT_EQ(3u, read_byte(child, 1), "own page\n");
+    EXPECT_EQ(0u, read_byte(child, 2), "zero page\n");
+    EXPECT_EQ(1u, read_byte(child, 3), "root page\n");
+    EXPECT_EQ(2u, read_byte(grandchild, 0), "merged page through child\n");
+    EXPECT_EQ(3u, child->AllocatedPages(), "own and merged pages\n");
+    EXPECT_EQ(2u, child->AllocatedPagesInRange(PAGE_SIZE, PAGE_SIZE), "shadowed merged page\n");
+
+    // decommitting still shows what the merged clone had underneath
+    EXPECT_EQ(ZX_OK, child->DecommitRange(PAGE_SIZE, PAGE_SIZE), "decommit\n");
+    EXPECT_EQ(2u, read_byte(child, 1), "merged page after decommit\n");
+
+    // and writing still copies rather than changing the merged page
+    EXPECT_EQ(ZX_OK, write_byte(child, 0, 4), "write\n");
+    EXPECT_EQ(4u, read_byte(grandchild, 0), "written page through child\n");
+    EXPECT_EQ(ZX_OK, child->DecommitRange(0, PAGE_SIZE), "decommit\n");
+    EXPECT_EQ(2u, read_byte(child, 0), "merged page after write\n");
+
+    END_TEST;
+}
+
+static bool vmo_clone_collapse_limit_test() {
+    BEGIN_TEST;
+
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> root;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &root);
+    ASSERT_EQ(ZX_OK, status, "vmobject creation\n");
+
+    auto write_byte = [](const fbl::RefPtr<VmObject>& vmo, uint64_t page, uint8_t value) {
+        return vmo->Write(&value, page * PAGE_SIZE, sizeof(value));
+    };
+    auto read_byte = [](const fbl::RefPtr<VmObject>& vmo, uint64_t page) {
+        uint8_t value = 0;
+        vmo->Read(&value, page * PAGE_SIZE, sizeof(value));
+        return value;
+    };
+
+    // root: pages 1 and 3 are 1
+    // small: the first two pages of root
+    // middle: page 2 is 2, and merges small, which leaves root showing
+    // through only its first two pages
+    EXPECT_EQ(ZX_OK, write_byte(root, 1, 1), "write\n");
+    EXPECT_EQ(ZX_OK, write_byte(root, 3, 1), "write\n");
+    fbl::RefPtr<VmObject> small;
+    ASSERT_EQ(ZX_OK, root->CloneCOW(false, 0, PAGE_SIZE * 2, false, &small), "clone\n");
+    fbl::RefPtr<VmObject> middle;
+    ASSERT_EQ(ZX_OK, small->CloneCOW(false, 0, alloc_size, false, &middle), "clone\n");
+    EXPECT_EQ(ZX_OK, write_byte(middle, 2, 2), "write\n");
+    small.reset();
+    fbl::RefPtr<VmObject> child;
+    ASSERT_EQ(ZX_OK, middle->CloneCOW(false, 0, alloc_size, false, &child), "clone\n");
+    EXPECT_EQ(1u, middle->clone_depth(), "middle depth\n");
+
+    // merging middle into child keeps middle's pages past where root stops
+    // showing through, and still hides the rest of root
+    middle.reset();
+    fbl::RefPtr<VmObject> grandchild;
+    ASSERT_EQ(ZX_OK, child->CloneCOW(false, 0, alloc_size, false, &grandchild), "clone\n");
+    EXPECT_EQ(1u, child->clone_depth(), "child depth\n");
+
+    EXPECT_EQ(1u, read_byte(child, 1), "root page\n");
+    EXPECT_EQ(2u, read_byte(child, 2), "merged page past the limit\n");
+    EXPECT_EQ(0u, read_byte(child, 3), "hidden root page\n");
+
+    END_TEST;
+}
+
 static bool vmo_lookup_test() {
     BEGIN_TEST;
 
@@ -1281,6 +1871,139 @@ static bool vmpl_take_cleanup_test() {
     END_TEST;
 }
 
+// Tests that populating a range only fills in the gaps
+static bool vmpl_populate_range_test() {
+    BEGIN_TEST;
+
+    VmPageList pl;
+    constexpr uint32_t kCount = VmPageListNode::kPageFanOut + 8;
+    vm_page_t test_pages[kCount] = {};
+    vm_page_t existing_page = {};
+    pl.AddPage(&existing_page, 5 * PAGE_SIZE);
+
+    constexpr uint32_t kStart = 2;
+    size_t calls = 0;
+    zx_status_t status = pl.PopulateRange(
+        [&](uint64_t offset) {
+            calls++;
+            return test_pages + offset / PAGE_SIZE;
+        },
+        kStart * PAGE_SIZE, kCount * PAGE_SIZE);
+    EXPECT_EQ(ZX_OK, status, "populate\n");
+    EXPECT_EQ(kCount - kStart - 1, calls, "populated pages\n");
+
+    for (uint32_t i = 0; i < kCount; i++) {
+        vm_page* page;
+        bool res = pl.RemovePage(i * PAGE_SIZE, &page);
+        if (i < kStart) {
+            EXPECT_FALSE(res, "extra page\n");
+        } else if (i == 5) {
+            EXPECT_TRUE(res, "missing page\n");
+            EXPECT_EQ(&existing_page, page, "replaced page\n");
+        } else {
+            EXPECT_TRUE(res, "missing page\n");
+            EXPECT_EQ(test_pages + i, page, "wrong page\n");
+        }
+    }
+    EXPECT_TRUE(pl.IsEmpty(), "non-empty list\n");
+
+    END_TEST;
+}
+
+// Tests taking a large, mostly empty range
+static bool vmpl_take_sparse_test() {
+    BEGIN_TEST;
+
+    VmPageList pl;
+    constexpr uint64_t kStride = 1000 * VmPageListNode::kPageFanOut + 3;
+    constexpr uint32_t kCount = 4;
+    vm_page_t test_pages[kCount] = {};
+    for (uint32_t i = 0; i < kCount; i++) {
+        pl.AddPage(test_pages + i, (i + 1) * kStride * PAGE_SIZE);
+    }
+
+    VmPageSpliceList splice = pl.TakePages(PAGE_SIZE, (kCount + 1) * kStride * PAGE_SIZE);
+    EXPECT_TRUE(pl.IsEmpty(), "non-empty list\n");
+
+    uint32_t found = 0;
+    for (uint64_t offset = PAGE_SIZE; !splice.IsDone(); offset += PAGE_SIZE) {
+        vm_page* page = splice.Pop();
+        if (page) {
+            EXPECT_LT(found, kCount, "extra page\n");
+            EXPECT_EQ(test_pages + found, page, "wrong page\n");
+            EXPECT_EQ((found + 1) * kStride * PAGE_SIZE, offset, "wrong offset\n");
+            found++;
+        }
+    }
+    EXPECT_EQ(kCount, found, "missing pages\n");
+
+    END_TEST;
+}
+
+// Reports how long the common page list operations take on a 64MiB range,
+// to compare node layouts and lookup strategies.
+static bool vmpl_benchmark() {
+    BEGIN_TEST;
+
+    constexpr size_t kCount = 64 * MB / PAGE_SIZE;
+    fbl::AllocChecker ac;
+    fbl::Array<vm_page_t> pages(new (&ac) vm_page_t[kCount], kCount);
+    ASSERT_TRUE(ac.check(), "allocating pages\n");
+
+    VmPageList pl;
+    zx_time_t start = current_time();
+    for (size_t i = 0; i < kCount; i++) {
+        ASSERT_EQ(ZX_OK, pl.AddPage(&pages[i], i * PAGE_SIZE), "add page\n");
+    }
+    const zx_duration_t add = current_time() - start;
+
+    start = current_time();
+    for (size_t i = 0; i < kCount; i++) {
+        EXPECT_EQ(&pages[i], pl.GetPage(i * PAGE_SIZE), "sequential lookup\n");
+    }
+    const zx_duration_t sequential = current_time() - start;
+
+    // visit every page once, in an order that defeats any locality
+    constexpr size_t kStep = 7919;
+    start = current_time();
+    for (size_t i = 0, n = 0; i < kCount; i++, n = (n + kStep) % kCount) {
+        EXPECT_EQ(&pages[n], pl.GetPage(n * PAGE_SIZE), "scattered lookup\n");
+    }
+    const zx_duration_t scattered = current_time() - start;
+
+    size_t visited = 0;
+    start = current_time();
+    pl.ForEveryPageInRange(
+        [&visited](const auto p, uint64_t off) {
+            visited++;
+            return ZX_ERR_NEXT;
+        },
+        0, kCount * PAGE_SIZE);
+    const zx_duration_t walk = current_time() - start;
+    EXPECT_EQ(kCount, visited, "range walk\n");
+
+    start = current_time();
+    VmPageSpliceList splice = pl.TakePages(PAGE_SIZE, (kCount - 2) * PAGE_SIZE);
+    const zx_duration_t take = current_time() - start;
+    while (!splice.IsDone()) {
+        splice.Pop();
+    }
+
+    vm_page* page;
+    EXPECT_TRUE(pl.RemovePage(0, &page), "first page\n");
+    EXPECT_TRUE(pl.RemovePage((kCount - 1) * PAGE_SIZE, &page), "last page\n");
+    EXPECT_TRUE(pl.IsEmpty(), "non-empty list\n");
+
+    const zx_duration_t n = kCount;
+    unittest_printf("%zu pages, %zu per node: add %" PRIi64 " ns/page, "
+                    "sequential lookup %" PRIi64 " ns/page, scattered lookup %" PRIi64 " ns/page, "
+                    "range walk %" PRIi64 " ns/page, take %" PRIi64 " ns\n",
+                    kCount, VmPageListNode::kPageFanOut, add / n, sequential / n,
+                    scattered / n, walk / n, take);
+
+    END_TEST;
+}
+
 // Use the function name as the test name
 #define VM_UNITTEST(fname) UNITTEST(#fname, fname)
 
@@ -1310,6 +2033,16 @@ VM_UNITTEST(vmo_double_remap_test)
 VM_UNITTEST(vmo_read_write_smoke_test)
 VM_UNITTEST(vmo_cache_test)
 VM_UNITTEST(vmo_lookup_test)
+VM_UNITTEST(vmo_large_page_test)
+VM_UNITTEST(vmo_large_page_promote_test)
+VM_UNITTEST(vmo_large_page_reclaim_test)
+VM_UNITTEST(vmo_large_page_compress_test)
+VM_UNITTEST(vmo_reclaim_test)
+VM_UNITTEST(vmo_compressed_page_test)
+VM_UNITTEST(vmo_reclaim_compress_test)
+VM_UNITTEST(vmo_peek_page_test)
+VM_UNITTEST(vmo_clone_collapse_test)
+VM_UNITTEST(vmo_clone_collapse_limit_test)
 VM_UNITTEST(arch_noncontiguous_map)
 // Uncomment for debugging
 // VM_UNITTEST(dump_all_aspaces)  // Run last
@@ -1319,6 +2052,8 @@ UNITTEST_START_TESTCASE(pmm_tests)
 VM_UNITTEST(pmm_smoke_test)
 VM_UNITTEST(pmm_alloc_contiguous_one_test)
 VM_UNITTEST(pmm_multi_alloc_test)
+VM_UNITTEST(pmm_single_page_churn_test)
+VM_UNITTEST(pmm_alloc_zeroed_test)
 // runs the system out of memory, uncomment for debugging
 //VM_UNITTEST(pmm_oversized_alloc_test)
 UNITTEST_END_TESTCASE(pmm_tests, "pmm", "Physical memory manager tests");
@@ -1333,4 +2068,7 @@ VM_UNITTEST(vmpl_take_all_pages_test)
 VM_UNITTEST(vmpl_take_middle_pages_test)
 VM_UNITTEST(vmpl_take_gap_test)
 VM_UNITTEST(vmpl_take_cleanup_test)
+VM_UNITTEST(vmpl_populate_range_test)
+VM_UNITTEST(vmpl_take_sparse_test)
+VM_UNITTEST(vmpl_benchmark)
 UNITTEST_END_TESTCASE(vm_page_list_tests, "vmpl", "VmPageList tests");
@@ -622,6 +622,7 @@ zx_status_t block_device_added(int dirfd, int event, const char* name, void* coo
             return ZX_OK;
         }
         mount_options_t options = default_mount_options;
+        options.enable_journal = true;
         mount_minfs(watcher, std::move(fd), &options);
         return ZX_OK;
     }
@@ -581,51 +581,18 @@ void MinfsCreator::ProcessDirectoryEntry(char* path) {
 }
 
 zx_status_t MinfsCreator::ProcessBlocks(off_t file_size) {
-    uint64_t total_blocks = 0;
-    uint32_t remaining = (file_size + minfs::kMinfsBlockSize - 1) / minfs::kMinfsBlockSize;
-
-    // Add direct blocks to the total.
-    uint32_t direct_blocks = fbl::min(remaining, minfs::kMinfsDirect);
-    total_blocks += direct_blocks;
-    remaining -= direct_blocks;
-
-    if (remaining) {
-        // If more blocks remain, calculate how many indirect blocks we need.
-        uint32_t indirect_blocks = fbl::min(
-            (remaining + minfs::kMinfsDirectPerIndirect + 1) / minfs::kMinfsDirectPerIndirect,
-            minfs::kMinfsIndirect);
-
-        direct_blocks = fbl::min(remaining, indirect_blocks * minfs::kMinfsDirectPerIndirect);
-
-        // Add blocks to the total, and update remaining.
-        total_blocks += indirect_blocks + direct_blocks;
-        remaining -= direct_blocks;
-
-        if (remaining) {
-            // If blocks remain past the indirect block range, calculate required doubly indirect
-            // and indirect blocks.
-            uint32_t dindirect_blocks = fbl::min(
-                (remaining + minfs::kMinfsDirectPerDindirect + 1) / minfs::kMinfsDirectPerDindirect,
-                minfs::kMinfsDoublyIndirect);
-
-            indirect_blocks = fbl::min(
-                (remaining + minfs::kMinfsDirectPerIndirect + 1) / minfs::kMinfsDirectPerIndirect,
-                minfs::kMinfsDirectPerIndirect * minfs::kMinfsDoublyIndirect);
-
-            direct_blocks = fbl::min(remaining,
-                                     minfs::kMinfsDoublyIndirect * minfs::kMinfsDirectPerDindirect);
-
-            // Add blocks to the total, and update remaining.
-            total_blocks += dindirect_blocks + indirect_blocks + direct_blocks;
-            remaining -= direct_blocks;
-
-            if (remaining) {
-                // If we still have more blocks remaining at this point, the file is larger than
-                // the current minfs max file size.
-                fprintf(stderr, "Error: File too large for minfs @ %" PRIu64 " bytes\n", file_size);
-                return ZX_ERR_INVALID_ARGS;
-            }
-        }
+    uint64_t total_blocks = (file_size + minfs::kMinfsBlockSize - 1) / minfs::kMinfsBlockSize;
+    if (total_blocks > minfs::kMinfsMaxFileBlock) {
+        // The file is larger than the current minfs max file size.
+        fprintf(stderr, "Error: File too large for minfs @ %" PRIu64 " bytes\n", file_size);
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    if (total_blocks > minfs::kMinfsInlineExtents) {
+        // If the extents of the file may not fit in its inode, allow for the extent blocks
+        // which could be needed to map it, assuming each is only half full.
+        constexpr uint64_t kExtentsPerHalfBlock = minfs::kMinfsExtentsPerBlock / 2;
+        total_blocks += (total_blocks + kExtentsPerHalfBlock - 1) / kExtentsPerHalfBlock;
     }
 
     // Add calculated blocks to the total so far.
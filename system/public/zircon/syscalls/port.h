@@ -30,6 +30,7 @@ __BEGIN_CDECLS
 
 // For options passed to port_create
 #define ZX_PORT_BIND_TO_INTERRUPT   ((uint32_t)(0x1u << 0))
+#define ZX_PORT_PER_CPU             ((uint32_t)(0x1u << 1))
 
 #define ZX_PKT_TYPE_MASK            ((uint32_t)0x000000FFu)
 
@@ -12,6 +12,7 @@ __BEGIN_CDECLS
 // clang-format off
 
 #define ZX_PROFILE_INFO_SCHEDULER   1
+#define ZX_PROFILE_INFO_DEADLINE    2
 
 typedef struct zx_profile_scheduler {
     int32_t priority;
@@ -26,10 +27,20 @@ typedef struct zx_profile_scheduler {
 #define ZX_PRIORITY_HIGH                24
 #define ZX_PRIORITY_HIGHEST             31
 
+// Requires the kernel to be booted with kernel.scheduler=fair. Durations are
+// in nanoseconds; the period must be under a second.
+typedef struct zx_profile_deadline {
+    uint32_t capacity;              // runtime guaranteed in every period
+    uint32_t deadline;              // relative to the start of the period
+    uint32_t period;
+    uint32_t reserved;              // must be zero
+} zx_profile_deadline_t;
+
 typedef struct zx_profile_info {
     uint32_t type;                  // one of ZX_PROFILE_INFO_
     union {
         zx_profile_scheduler_t scheduler;
+        zx_profile_deadline_t deadline;
     };
 } zx_profile_info_t;
 
@@ -192,6 +192,16 @@ typedef struct zx_channel_call_args {
     uint32_t rd_num_handles;
 } zx_channel_call_args_t;
 
+// Message descriptor for zx_channel_write_many() and zx_channel_read_many().
+// For reads, |num_bytes| and |num_handles| give the size of the buffers on
+// input and are updated with the size of the message read on output.
+typedef struct zx_channel_msg {
+    void* bytes;
+    zx_handle_t* handles;
+    uint32_t num_bytes;
+    uint32_t num_handles;
+} zx_channel_msg_t;
+
 // Maximum number of wait items allowed for zx_object_wait_many()
 // TODO(ZX-1349) Re-lower this.
 #define ZX_WAIT_MANY_MAX_ITEMS ((size_t)16)
@@ -217,6 +227,9 @@ typedef struct zx_wait_item {
 #define ZX_VMO_OP_CACHE_CLEAN            ((uint32_t)8u)
 #define ZX_VMO_OP_CACHE_CLEAN_INVALIDATE ((uint32_t)9u)
 
+// Pager opcodes
+#define ZX_PAGER_OP_FAIL                 ((uint32_t)1u)
+
 // VM Object clone flags
 #define ZX_VMO_CLONE_COPY_ON_WRITE        ((uint32_t)1u << 0)
 #define ZX_VMO_CLONE_NON_RESIZEABLE       ((uint32_t)1u << 1)
@@ -278,9 +291,12 @@ typedef uint64_t zx_off_t;
 
 // Channel options and limits.
 #define ZX_CHANNEL_READ_MAY_DISCARD         ((uint32_t)1u)
+#define ZX_CHANNEL_READ_REMAP_PAGES         ((uint32_t)2u)
+#define ZX_CHANNEL_WRITE_DONATE_PAGES       ((uint32_t)1u)
 
 #define ZX_CHANNEL_MAX_MSG_BYTES            ((uint32_t)65536u)
 #define ZX_CHANNEL_MAX_MSG_HANDLES          ((uint32_t)64u)
+#define ZX_CHANNEL_MAX_BATCH_MSGS           ((uint32_t)16u)
 
 // Socket options and limits.
 // These options can be passed to zx_socket_shutdown()
@@ -17,6 +17,7 @@
 #include <lib/zx/channel.h>
 #include <blobfs/blobfs.h>
 #include <blobfs/fsck.h>
+#include <fbl/algorithm.h>
 #include <fbl/auto_call.h>
 #include <fbl/string.h>
 #include <fbl/unique_fd.h>
@@ -26,11 +27,16 @@
 #include <trace-provider/provider.h>
 #include <zircon/process.h>
 #include <zircon/processargs.h>
+#include <zircon/syscalls.h>
 
 #include <utility>
 
 namespace {
 
+// Each thread which touches the block device takes one of its few transaction
+// groups, and the journal, writeback and pager threads need one each too.
+constexpr uint32_t kMaxDispatchThreads = 4;
+
 int Mount(fbl::unique_fd fd, blobfs::MountOptions* options) {
     if (!options->readonly) {
         block_info_t block_info;
@@ -56,6 +62,16 @@ int Mount(fbl::unique_fd fd, blobfs::MountOptions* options) {
                             std::move(root), std::move(loop_quit)) != ZX_OK) {
         return -1;
     }
+
+    // This thread dispatches too, once the others have been started.
+    for (uint32_t i = 1; i < options->dispatch_threads; i++) {
+        zx_status_t status = loop.StartThread("blobfs-dispatch");
+        if (status != ZX_OK) {
+            FS_TRACE_ERROR("blobfs: Could not start dispatch thread: %d\n", status);
+            break;
+        }
+    }
+
     loop.Run();
     return ZX_OK;
 }
@@ -97,14 +113,16 @@ int usage() {
     fprintf(stderr,
             "usage: blobfs [ <options>* ] <command> [ <arg>* ]\n"
             "\n"
-            "options: -r|--readonly  Mount filesystem read-only\n"
-            "         -m|--metrics   Collect filesystem metrics\n"
-            "         -h|--help      Display this message\n"
+            "options: -r|--readonly         Mount filesystem read-only\n"
+            "         -m|--metrics          Collect filesystem metrics\n"
+            "         -t|--threads THREADS  Dispatch requests on |THREADS| threads\n"
+            "                               (1 to %u; defaults to one per CPU)\n"
+            "         -h|--help             Display this message\n"
             "\n"
             "On Fuchsia, blobfs takes the block device argument by handle.\n"
             "This can make 'blobfs' commands hard to invoke from command line.\n"
             "Try using the [mkfs,fsck,mount,umount] commands instead\n"
-            "\n");
+            "\n", kMaxDispatchThreads);
     for (unsigned n = 0; n < (sizeof(kCmds) / sizeof(kCmds[0])); n++) {
         fprintf(stderr, "%9s %-10s %s\n", n ? "" : "commands:",
                 kCmds[n].name, kCmds[n].help);
@@ -120,11 +138,12 @@ int ProcessArgs(int argc, char** argv, CommandFunction* func, blobfs::MountOptio
             {"readonly", no_argument, nullptr, 'r'},
             {"metrics", no_argument, nullptr, 'm'},
             {"journal", no_argument, nullptr, 'j'},
+            {"threads", required_argument, nullptr, 't'},
             {"help", no_argument, nullptr, 'h'},
             {nullptr, 0, nullptr, 0},
         };
         int opt_index;
-        int c = getopt_long(argc, argv, "rmjh", opts, &opt_index);
+        int c = getopt_long(argc, argv, "rmjt:h", opts, &opt_index);
         if (c < 0) {
             break;
         }
@@ -138,6 +157,13 @@ int ProcessArgs(int argc, char** argv, CommandFunction* func, blobfs::MountOptio
         case 'j':
             options->journal = true;
             break;
+        case 't':
+            options->dispatch_threads = static_cast<uint32_t>(strtoul(optarg, NULL, 0));
+            if (options->dispatch_threads < 1 ||
+                options->dispatch_threads > kMaxDispatchThreads) {
+                return usage();
+            }
+            break;
         case 'h':
         default:
             return usage();
@@ -172,6 +198,7 @@ int ProcessArgs(int argc, char** argv, CommandFunction* func, blobfs::MountOptio
 int main(int argc, char** argv) {
     CommandFunction func = nullptr;
     blobfs::MountOptions options;
+    options.dispatch_threads = fbl::min(zx_system_get_num_cpus(), kMaxDispatchThreads);
     fbl::unique_fd fd(ProcessArgs(argc, argv, &func, &options));
 
     if (!fd) {
@@ -13,6 +13,8 @@
 #include <fbl/algorithm.h>
 #include <fbl/unique_ptr.h>
 #include <zircon/compiler.h>
+#include <zircon/limits.h>
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
 #include <zircon/time.h>
 #include <zircon/types.h>
@@ -30,10 +32,34 @@ void duplicate_handles(uint32_t n, zx_handle_t src, zx_handle_t* dest) {
     }
 }
 
+// Maps a page aligned buffer of |size| bytes, so that messages written from it
+// with ZX_CHANNEL_WRITE_DONATE_PAGES can be remapped into another such buffer.
+uint8_t* map_buffer(uint32_t size) {
+    size = fbl::round_up(size, ZX_PAGE_SIZE);
+    zx_handle_t vmo;
+    __UNUSED zx_status_t status = zx_vmo_create(size, 0u, &vmo);
+    assert(status == ZX_OK);
+    zx_vaddr_t addr;
+    status = zx_vmar_map(zx_vmar_root_self(), ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, 0u, vmo, 0u,
+                         size, &addr);
+    assert(status == ZX_OK);
+    status = zx_handle_close(vmo);
+    assert(status == ZX_OK);
+    return reinterpret_cast<uint8_t*>(addr);
+}
+
+void unmap_buffer(uint8_t* buffer, uint32_t size) {
+    __UNUSED zx_status_t status = zx_vmar_unmap(zx_vmar_root_self(),
+                                                reinterpret_cast<zx_vaddr_t>(buffer),
+                                                fbl::round_up(size, ZX_PAGE_SIZE));
+    assert(status == ZX_OK);
+}
+
 struct TestArgs {
     uint32_t size;
     uint32_t handles;
     uint32_t queue;
+    bool pages;
 };
 
 void do_test(uint32_t duration_sec, const TestArgs& test_args) {
@@ -51,13 +77,18 @@ void do_test(uint32_t duration_sec, const TestArgs& test_args) {
     status = zx_event_create(0u, &event);
     assert(status == ZX_OK);
 
-    // Storage space for our messages' stuff.
-    fbl::unique_ptr<uint8_t[]> data;
+    // Storage space for our messages' stuff.  Messages are read into a separate
+    // buffer so that remapping pages never replaces the pages being written from.
+    uint8_t* data = nullptr;
+    uint8_t* recv_data = nullptr;
     if (test_args.size) {
-        data.reset(new uint8_t[test_args.size]);
+        data = map_buffer(test_args.size);
+        recv_data = map_buffer(test_args.size);
         for (uint32_t i = 0; i < test_args.size; i++)
             data[i] = static_cast<uint8_t>(i);
     }
+    const uint32_t write_options = test_args.pages ? ZX_CHANNEL_WRITE_DONATE_PAGES : 0u;
+    const uint32_t read_options = test_args.pages ? ZX_CHANNEL_READ_REMAP_PAGES : 0u;
     fbl::unique_ptr<zx_handle_t[]> handles;
     if (test_args.handles)
         handles.reset(new zx_handle_t[test_args.handles]);
@@ -65,7 +96,7 @@ void do_test(uint32_t duration_sec, const TestArgs& test_args) {
     // Pre-queue |test_args.queue| messages (there'll always be this many messages in the queue).
     for (uint32_t i = 0; i < test_args.queue; i++) {
         duplicate_handles(test_args.handles, event, handles.get());
-        status = zx_channel_write(mp[0], 0u, data.get(), test_args.size,
+        status = zx_channel_write(mp[0], write_options, data, test_args.size,
                                   handles.get(), test_args.handles);
         assert(status == ZX_OK);
     }
@@ -79,13 +110,13 @@ void do_test(uint32_t duration_sec, const TestArgs& test_args) {
     for (;;) {
         big_its++;
         for (uint32_t i = 0; i < big_it_size; i++) {
-            status = zx_channel_write(mp[0], 0, data.get(), test_args.size,
+            status = zx_channel_write(mp[0], write_options, data, test_args.size,
                                       handles.get(), test_args.handles);
             assert(status == ZX_OK);
 
             uint32_t r_size = test_args.size;
             uint32_t r_handles = test_args.handles;
-            status = zx_channel_read(mp[1], 0u, data.get(), handles.get(), r_size,
+            status = zx_channel_read(mp[1], read_options, recv_data, handles.get(), r_size,
                                      r_handles, &r_size, &r_handles);
             assert(status == ZX_OK);
             assert(r_size == test_args.size);
@@ -107,12 +138,17 @@ void do_test(uint32_t duration_sec, const TestArgs& test_args) {
     assert(status == ZX_OK);
     status = zx_handle_close(mp[1]);
     assert(status == ZX_OK);
+    if (test_args.size) {
+        unmap_buffer(data, test_args.size);
+        unmap_buffer(recv_data, test_args.size);
+    }
 
     double real_duration = static_cast<double>(zx_time_sub_time(end_ns, start_ns)) / 1000000000.0;
     double its_per_second = static_cast<double>(big_its) * big_it_size / real_duration;
-    printf("write/read %" PRIu32 " bytes, %" PRIu32 " handles (%" PRIu32 " pre-queued): "
-               "%.0f iterations/second\n",
-           test_args.size, test_args.handles, test_args.queue, its_per_second);
+    printf("write/read %" PRIu32 " bytes, %" PRIu32 " handles (%" PRIu32 " pre-queued, %s): "
+               "%.0f iterations/second, %.0f bytes/second\n",
+           test_args.size, test_args.handles, test_args.queue,
+           test_args.pages ? "pages" : "copy", its_per_second, its_per_second * test_args.size);
 }
 
 }  // namespace
@@ -129,7 +165,8 @@ int main(int argc, char** argv) {
         "  -d N  set test duration to N seconds (default: 5)\n"
         "  -S N  set message size to N bytes (default: 10)\n"
         "  -H N  set message handle count to N handles (default: 0)\n"
-        "  -Q N  set message pre-queue count to N messages (default: 0)\n";
+        "  -Q N  set message pre-queue count to N messages (default: 0)\n"
+        "  -P    also donate and remap pages, after copying (default: copy only)\n";
 
     bool run_suite = false;  // -o/-s
     uint32_t duration = 5;   // -d
@@ -138,11 +175,12 @@ int main(int argc, char** argv) {
     TestArgs test_args = {
         10,                  // -S (size)
         0,                   // -H (handles)
-        0                    // -Q (queue)
+        0,                   // -Q (queue)
+        false                // -P (pages)
     };
 
     int opt;
-    while ((opt = getopt(argc, argv, "+hosn:d:S:H:Q:")) != -1) {
+    while ((opt = getopt(argc, argv, "+hosn:d:S:H:Q:P")) != -1) {
         // Our option values are always unsigned numbers.
         uint32_t value = 0;
         if (optarg) {
@@ -184,6 +222,9 @@ int main(int argc, char** argv) {
                 assert(optarg);
                 test_args.queue = value;
                 break;
+            case 'P':
+                test_args.pages = true;
+                break;
             default:  // '?'
                 argument_error(argv[0], "invalid option");
                 break;
@@ -202,24 +243,37 @@ int main(int argc, char** argv) {
 
         if (run_suite) {
             static constexpr TestArgs suite[] = {
-                {10, 0, 0},
-                {100, 0, 0},
-                {1000, 0, 0},
-                {10, 1, 0},
-                {100, 1, 0},
-                {1000, 1, 0},
-                {10, 2, 0},
-                {100, 2, 0},
-                {1000, 2, 0},
-                {10, 5, 0},
-                {100, 5, 0},
-                {1000, 5, 0},
-                {10, 0, 1},
-                {100, 0, 1},
-                {1000, 0, 1},
+                {10, 0, 0, false},
+                {100, 0, 0, false},
+                {1000, 0, 0, false},
+                {10, 1, 0, false},
+                {100, 1, 0, false},
+                {1000, 1, 0, false},
+                {10, 2, 0, false},
+                {100, 2, 0, false},
+                {1000, 2, 0, false},
+                {10, 5, 0, false},
+                {100, 5, 0, false},
+                {1000, 5, 0, false},
+                {10, 0, 1, false},
+                {100, 0, 1, false},
+                {1000, 0, 1, false},
+                // Messages large enough to be sent by page, each both ways.
+                {16384, 0, 0, false},
+                {16384, 0, 0, true},
+                {32768, 0, 0, false},
+                {32768, 0, 0, true},
+                {65536, 0, 0, false},
+                {65536, 0, 0, true},
             };
             for (size_t i = 0; i < fbl::count_of(suite); i++)
                 do_test(duration, suite[i]);
+        } else if (test_args.pages) {
+            // The page path is only worth anything next to the copy path at the same size.
+            TestArgs copy_args = test_args;
+            copy_args.pages = false;
+            do_test(duration, copy_args);
+            do_test(duration, test_args);
         } else {
             do_test(duration, test_args);
         }
@@ -14,6 +14,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/unique_ptr.h>
 #include <fs/trace.h>
 #include <lib/async-loop/cpp/loop.h>
@@ -23,11 +24,16 @@
 #include <zircon/compiler.h>
 #include <zircon/process.h>
 #include <zircon/processargs.h>
+#include <zircon/syscalls.h>
 
 #include <utility>
 
 namespace {
 
+// Each thread which touches the block device takes one of its few transaction
+// groups, and the writeback thread needs one too.
+constexpr uint32_t kMaxDispatchThreads = 4;
+
 int Fsck(fbl::unique_ptr<minfs::Bcache> bc, const minfs::MountOptions& options) {
     return Fsck(std::move(bc));
 }
@@ -56,6 +62,14 @@ int Mount(fbl::unique_ptr<minfs::Bcache> bc, const minfs::MountOptions& options)
         fprintf(stderr, "minfs: Mounted successfully\n");
     }
 
+    // This thread dispatches too, once the others have been started.
+    for (uint32_t i = 1; i < options.dispatch_threads; i++) {
+        if ((status = loop.StartThread("minfs-dispatch")) != ZX_OK) {
+            FS_TRACE_ERROR("minfs: Could not start dispatch thread: %d\n", status);
+            break;
+        }
+    }
+
     loop.Run();
     return 0;
 }
@@ -83,14 +97,17 @@ int usage() {
                     "    -v|--verbose                  Some debug messages\n"
                     "    -r|--readonly                 Mount filesystem read-only\n"
                     "    -m|--metrics                  Collect filesystem metrics\n"
+                    "    -j|--journal                  Write metadata through the journal\n"
                     "    -s|--fvm_data_slices SLICES   When mkfs on top of FVM,\n"
                     "                                  preallocate |SLICES| slices of data. \n"
+                    "    -t|--threads THREADS          Dispatch requests on |THREADS| threads\n"
+                    "                                  (1 to %u; defaults to one per CPU)\n"
                     "    -h|--help                     Display this message\n"
                     "\n"
                     "On Fuchsia, MinFS takes the block device argument by handle.\n"
                     "This can make 'minfs' commands hard to invoke from command line.\n"
                     "Try using the [mkfs,fsck,mount,umount] commands instead\n"
-                    "\n");
+                    "\n", kMaxDispatchThreads);
     for (unsigned n = 0; n < fbl::count_of(CMDS); n++) {
         fprintf(stderr, "%9s %-10s %s\n", n ? "" : "commands:", CMDS[n].name, CMDS[n].help);
     }
@@ -115,6 +132,7 @@ int main(int argc, char** argv) {
     options.readonly = false;
     options.metrics = false;
     options.verbose = false;
+    options.dispatch_threads = fbl::min(zx_system_get_num_cpus(), kMaxDispatchThreads);
 
     while (1) {
         static struct option opts[] = {
@@ -123,11 +141,12 @@ int main(int argc, char** argv) {
             {"journal", no_argument, nullptr, 'j'},
             {"verbose", no_argument, nullptr, 'v'},
             {"fvm_data_slices", required_argument, nullptr, 's'},
+            {"threads", required_argument, nullptr, 't'},
             {"help", no_argument, nullptr, 'h'},
             {nullptr, 0, nullptr, 0},
         };
         int opt_index;
-        int c = getopt_long(argc, argv, "rmjvhs:", opts, &opt_index);
+        int c = getopt_long(argc, argv, "rmjvhs:t:", opts, &opt_index);
         if (c < 0) {
             break;
         }
@@ -139,15 +158,20 @@ int main(int argc, char** argv) {
             options.metrics = true;
             break;
         case 'j':
-            //TODO(planders): Enable journaling here once minfs supports it.
-            fprintf(stderr, "minfs: Journaling option not supported\n");
-            return usage();
+            options.journal = true;
+            break;
         case 'v':
             options.verbose = true;
             break;
         case 's':
             options.fvm_data_slices = static_cast<uint32_t>(strtoul(optarg, NULL, 0));
             break;
+        case 't':
+            options.dispatch_threads = static_cast<uint32_t>(strtoul(optarg, NULL, 0));
+            if (options.dispatch_threads < 1 || options.dispatch_threads > kMaxDispatchThreads) {
+                return usage();
+            }
+            break;
         case 'h':
         default:
             return usage();
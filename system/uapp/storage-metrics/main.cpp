@@ -82,9 +82,8 @@ void PrintFsMetrics(const MinfsMetrics& metrics, const char* path) {
 
     printf("Vnode initialization metrics\n");
     printf("initialized VMOs:                   %lu\n", metrics.initialized_vmos);
-    printf("initialized direct blocks:          %u\n", metrics.init_dnum_count);
-    printf("initialized indirect blocks:        %u\n", metrics.init_inum_count);
-    printf("initialized doubly indirect blocks: %u\n", metrics.init_dinum_count);
+    printf("initialized extents:                %u\n", metrics.init_extent_count);
+    printf("initialized extent blocks:          %u\n", metrics.init_extent_block_count);
     printf("bytes of files initialized:         %lu\n", metrics.init_user_data_size);
     printf("ticks during initialization:        %lu\n", metrics.init_user_data_ticks);
     printf("\n");
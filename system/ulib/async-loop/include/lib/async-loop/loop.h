@@ -172,6 +172,37 @@ zx_status_t async_loop_start_thread(async_loop_t* loop, const char* name,
 // have terminated.
 void async_loop_join_threads(async_loop_t* loop);
 
+// Handles one message read by |async_loop_drain_channel()|.
+// |msg| describes the message; its bytes and handles belong to the handler
+// until it returns.  Returning anything other than |ZX_OK| stops the drain.
+typedef zx_status_t(async_loop_channel_handler_t)(void* data, zx_channel_msg_t* msg);
+
+// The number of batches |async_loop_drain_channel()| reads at most per call.
+#define ASYNC_LOOP_DRAIN_MAX_BATCHES ((uint32_t) 4)
+
+// Reads messages from |channel| in batches of up to |num_msgs| using
+// |zx_channel_read_many()| and passes each of them to |handler|, until the
+// channel has no more messages to read or |ASYNC_LOOP_DRAIN_MAX_BATCHES|
+// batches have been read.  This is meant to be called from the handler of a
+// wait for |ZX_CHANNEL_READABLE| so that a backlog of small messages is
+// drained with a few syscalls instead of one wait per message.  The bound
+// keeps a channel that is written as fast as it is read from starving the
+// rest of the loop: whatever is left is picked up by the next wait, which
+// is satisfied right away.
+//
+// |msgs| provides the buffers to read into, as for |zx_channel_read_many()|.
+// Their sizes are restored before each batch.  |num_msgs| must be at most
+// |ZX_CHANNEL_MAX_BATCH_MSGS|.
+//
+// Returns |ZX_OK| once the channel is empty, or the bound is reached.
+// Returns the first status other than |ZX_OK| returned by |handler|, in which
+// case the rest of the batch is dropped and its handles are closed.
+// Returns the error from |zx_channel_read_many()| otherwise, for instance
+// |ZX_ERR_PEER_CLOSED| once the channel is empty and its peer is closed.
+zx_status_t async_loop_drain_channel(zx_handle_t channel, zx_channel_msg_t* msgs,
+                                     uint32_t num_msgs,
+                                     async_loop_channel_handler_t* handler, void* data);
+
 __END_CDECLS
 
 #endif  // LIB_ASYNC_LOOP_LOOP_H_
@@ -795,3 +795,40 @@ void async_loop_join_threads(async_loop_t* loop) {
     }
     mtx_unlock(&loop->lock);
 }
+
+zx_status_t async_loop_drain_channel(zx_handle_t channel, zx_channel_msg_t* msgs,
+                                     uint32_t num_msgs,
+                                     async_loop_channel_handler_t* handler, void* data) {
+    ZX_DEBUG_ASSERT(num_msgs > 0u && num_msgs <= ZX_CHANNEL_MAX_BATCH_MSGS);
+
+    // zx_channel_read_many() overwrites the sizes with those of the messages read.
+    uint32_t num_bytes[ZX_CHANNEL_MAX_BATCH_MSGS];
+    uint32_t num_handles[ZX_CHANNEL_MAX_BATCH_MSGS];
+    for (uint32_t i = 0; i < num_msgs; i++) {
+        num_bytes[i] = msgs[i].num_bytes;
+        num_handles[i] = msgs[i].num_handles;
+    }
+
+    for (uint32_t batch = 0u; batch < ASYNC_LOOP_DRAIN_MAX_BATCHES; batch++) {
+        uint32_t actual = 0u;
+        zx_status_t status = zx_channel_read_many(channel, 0u, msgs, num_msgs, &actual);
+        zx_status_t handler_status = ZX_OK;
+        uint32_t i = 0;
+        for (; i < actual && handler_status == ZX_OK; i++) {
+            handler_status = handler(data, &msgs[i]);
+        }
+        // Messages the handler did not get to are dropped.
+        for (; i < actual; i++) {
+            zx_handle_close_many(msgs[i].handles, msgs[i].num_handles);
+        }
+        for (i = 0; i < num_msgs; i++) {
+            msgs[i].num_bytes = num_bytes[i];
+            msgs[i].num_handles = num_handles[i];
+        }
+        if (handler_status != ZX_OK)
+            return handler_status;
+        if (status != ZX_OK)
+            return status == ZX_ERR_SHOULD_WAIT ? ZX_OK : status;
+    }
+    return ZX_OK;
+}
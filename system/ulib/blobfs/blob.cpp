@@ -24,6 +24,7 @@
 #include <fbl/ref_ptr.h>
 #include <fbl/string_piece.h>
 #include <fs/metrics.h>
+#include <fs/shared-mutex.h>
 #include <fuchsia/io/c/fidl.h>
 #include <lib/fdio/vfs.h>
 #include <lib/sync/completion.h>
@@ -85,10 +86,8 @@ zx_status_t Blob::Verify() const {
     const void* tree = inode_.blob_size ? GetMerkle() : nullptr;
     const uint64_t data_size = inode_.blob_size;
     const uint64_t merkle_size = MerkleTree::GetTreeLength(data_size);
-    // TODO(smklein): We could lazily verify more of the VMO if
-    // we could fault in pages on-demand.
-    //
-    // For now, we aggressively verify the entire VMO up front.
+    // Blobs read back from disk are verified a piece at a time by the
+    // pager instead; this verifies the entire VMO at once.
     Digest digest(GetKey());
     zx_status_t status =
         MerkleTree::Verify(data, data_size, tree, merkle_size, 0, data_size, digest);
@@ -155,6 +154,40 @@ zx_status_t Blob::InitVmos() {
     return ZX_OK;
 }
 
+zx_status_t Blob::InitPagedVmo() {
+    TRACE_DURATION("blobfs", "Blobfs::InitPagedVmo");
+
+    if (mapping_.vmo() || paged_vmo_) {
+        return ZX_OK;
+    }
+
+    // Every fault on a compressed blob would decompress and verify all of
+    // it again, so it is read in whole once and kept.
+    if ((inode_.header.flags & kBlobFlagLZ4Compressed) != 0) {
+        return InitVmos();
+    }
+
+    zx::vmo vmo;
+    uint64_t key;
+    zx_status_t status = blobfs_->GetPager()->CreateVmo(GetMapIndex(), inode_, &vmo, &key);
+    if (status != ZX_OK) {
+        FS_TRACE_ERROR("Failed to create paged vmo; error: %d\n", status);
+        return status;
+    }
+    paged_vmo_ = std::move(vmo);
+    pager_key_ = key;
+    return ZX_OK;
+}
+
+const zx::vmo& Blob::DataVmo(uint64_t* out_offset) const {
+    if (paged_vmo_) {
+        *out_offset = 0;
+        return paged_vmo_;
+    }
+    *out_offset = MerkleTreeBlocks(inode_) * kBlobfsBlockSize;
+    return mapping_.vmo();
+}
+
 zx_status_t Blob::InitCompressed() {
     TRACE_DURATION("blobfs", "Blobfs::InitCompressed", "size", inode_.blob_size, "blocks",
                    inode_.block_count);
@@ -675,17 +708,16 @@ zx_status_t Blob::CloneVmo(zx_rights_t rights, zx_handle_t* out_vmo, size_t* out
     if (inode_.blob_size == 0) {
         return ZX_ERR_BAD_STATE;
     }
-    zx_status_t status = InitVmos();
+    zx_status_t status = InitPagedVmo();
     if (status != ZX_OK) {
         return status;
     }
 
-    // TODO(smklein): Only clone / verify the part of the vmo that
-    // was requested.
-    const size_t merkle_bytes = MerkleTreeBlocks(inode_) * kBlobfsBlockSize;
+    uint64_t data_offset;
+    const zx::vmo& vmo = DataVmo(&data_offset);
     zx::vmo clone;
-    if ((status = mapping_.vmo().clone(ZX_VMO_CLONE_COPY_ON_WRITE, merkle_bytes, inode_.blob_size,
-                                       &clone)) != ZX_OK) {
+    if ((status = vmo.clone(ZX_VMO_CLONE_COPY_ON_WRITE, data_offset, inode_.blob_size,
+                            &clone)) != ZX_OK) {
         return status;
     }
 
@@ -701,7 +733,7 @@ zx_status_t Blob::CloneVmo(zx_rights_t rights, zx_handle_t* out_vmo, size_t* out
     *out_size = inode_.blob_size;
 
     if (clone_watcher_.object() == ZX_HANDLE_INVALID) {
-        clone_watcher_.set_object(mapping_.vmo().get());
+        clone_watcher_.set_object(vmo.get());
         clone_watcher_.set_trigger(ZX_VMO_ZERO_CHILDREN);
 
         // Keep a reference to "this" alive, preventing the blob
@@ -720,6 +752,10 @@ void Blob::HandleNoClones(async_dispatcher_t* dispatcher, async::WaitBase* wait,
                                zx_status_t status, const zx_packet_signal_t* signal) {
     ZX_DEBUG_ASSERT(status == ZX_OK);
     ZX_DEBUG_ASSERT((signal->observed & ZX_VMO_ZERO_CHILDREN) != 0);
+
+    // Dropping the reference may close the blob, which touches blobfs's
+    // cache, so this is serialized with the operations of connections.
+    fs::ExclusiveLock lock(blobfs_->dispatch_lock());
     ZX_DEBUG_ASSERT(clone_watcher_.object() != ZX_HANDLE_INVALID);
     clone_watcher_.set_object(ZX_HANDLE_INVALID);
     clone_ref_ = nullptr;
@@ -737,13 +773,11 @@ zx_status_t Blob::ReadInternal(void* data, size_t len, size_t off, size_t* actua
         return ZX_OK;
     }
 
-    zx_status_t status = InitVmos();
+    zx_status_t status = InitPagedVmo();
     if (status != ZX_OK) {
         return status;
     }
 
-    Digest d(GetKey());
-
     if (off >= inode_.blob_size) {
         *actual = 0;
         return ZX_OK;
@@ -752,8 +786,10 @@ zx_status_t Blob::ReadInternal(void* data, size_t len, size_t off, size_t* actua
         len = inode_.blob_size - off;
     }
 
-    const size_t merkle_bytes = MerkleTreeBlocks(inode_) * kBlobfsBlockSize;
-    status = mapping_.vmo().read(data, merkle_bytes + off, len);
+    // If the pager can't read or verify the pages, this fails rather than
+    // handing out their contents.
+    uint64_t data_offset;
+    status = DataVmo(&data_offset).read(data, data_offset + off, len);
     if (status == ZX_OK) {
         *actual = len;
     }
@@ -799,6 +835,10 @@ void Blob::ActivateLowMemory() {
         blobfs_->DetachVmo(vmoid_);
     }
     mapping_.Reset();
+    if (paged_vmo_) {
+        paged_vmo_.reset();
+        blobfs_->GetPager()->ReleaseVmo(pager_key_);
+    }
 }
 
 Blob::~Blob() {
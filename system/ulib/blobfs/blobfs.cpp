@@ -22,6 +22,7 @@
 #include <fbl/auto_call.h>
 #include <fbl/ref_ptr.h>
 #include <fs/block-txn.h>
+#include <fs/shared-mutex.h>
 #include <fs/ticker.h>
 #include <lib/async/cpp/task.h>
 #include <lib/fdio/debug.h>
@@ -267,10 +268,13 @@ void Blobfs::Shutdown(fs::Vfs::ShutdownCallback cb) {
     // 1) Shutdown all external connections to blobfs.
     ManagedVfs::Shutdown([this, cb = std::move(cb)](zx_status_t status) mutable {
         // 2a) Shutdown all internal connections to blobfs.
-        Cache().ForAllOpenNodes([](fbl::RefPtr<CacheNode> cache_node) {
-            auto vnode = fbl::RefPtr<Blob>::Downcast(std::move(cache_node));
-            vnode->CloneWatcherTeardown();
-        });
+        {
+            fs::ExclusiveLock lock(dispatch_lock());
+            Cache().ForAllOpenNodes([](fbl::RefPtr<CacheNode> cache_node) {
+                auto vnode = fbl::RefPtr<Blob>::Downcast(std::move(cache_node));
+                vnode->CloneWatcherTeardown();
+            });
+        }
 
         // 2b) Flush all pending work to blobfs to the underlying storage.
         Sync([this, cb = std::move(cb)](zx_status_t status) mutable {
@@ -561,6 +565,9 @@ Blobfs::~Blobfs() {
 
     Cache().Reset();
 
+    // The pager goes once no blob can be using it, while it can still read.
+    pager_.reset();
+
     if (blockfd_) {
         ioctl_block_fifo_close(Fd());
     }
@@ -597,6 +604,11 @@ zx_status_t Blobfs::Create(fbl::unique_fd fd, const MountOptions& options, const
         return status;
     }
 
+    if ((status = Pager::Create(fs.get(), &fs->pager_)) != ZX_OK) {
+        FS_TRACE_ERROR("blobfs: Failed to start pager: %d\n", status);
+        return status;
+    }
+
     RawBitmap block_map;
     // Keep the block_map aligned to a block multiple
     if ((status = block_map.Reset(BlockMapBlocks(fs->info_) * kBlobfsBlockBits)) < 0) {
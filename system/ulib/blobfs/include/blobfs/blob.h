@@ -212,12 +212,20 @@ private:
 
     // Reads both VMOs into memory, if we haven't already.
     //
-    // TODO(ZX-1481): When we have can register the Blob Store as a pager
-    // service, and it can properly handle pages faults on a vnode's contents,
-    // then we can avoid reading the entire blob up-front. Until then, read
-    // the contents of a VMO into memory when it is opened.
+    // This reads the entire blob up-front, and is used to verify it and to
+    // serve compressed blobs.  Otherwise, blobs are paged in as they are used
+    // by |InitPagedVmo()|.
     zx_status_t InitVmos();
 
+    // Creates a VMO of the blob's data which blobfs's pager fills in as it
+    // is touched, unless the blob is already in memory.  A compressed blob is
+    // read in whole with |InitVmos()| instead.
+    zx_status_t InitPagedVmo();
+
+    // Returns the VMO holding the blob's data, and the offset of the data
+    // within it.  InitPagedVmo() must have already been called for this blob.
+    const zx::vmo& DataVmo(uint64_t* out_offset) const;
+
     // Initializes a compressed blob by reading it from disk and decompressing
     // it.
     // Does not verify the blob.
@@ -249,6 +257,11 @@ private:
     fzl::OwnedVmoMapper mapping_;
     vmoid_t vmoid_ = {};
 
+    // The data of a blob read back from disk, whose pages are supplied by the
+    // pager.  The Merkle tree stays with the pager.
+    zx::vmo paged_vmo_;
+    uint64_t pager_key_ = {};
+
     // Watches any clones of "vmo_" provided to clients.
     // Observes the ZX_VMO_ZERO_CHILDREN signal.
     async::WaitMethod<Blob, &Blob::HandleNoClones> clone_watcher_;
@@ -51,6 +51,7 @@
 #include <blobfs/lz4.h>
 #include <blobfs/metrics.h>
 #include <blobfs/node-reserver.h>
+#include <blobfs/pager.h>
 #include <blobfs/writeback.h>
 
 #include <atomic>
@@ -77,6 +78,8 @@ struct MountOptions {
     bool metrics = false;
     bool journal = false;
     CachePolicy cache_policy = CachePolicy::EvictImmediately;
+    // Number of threads dispatching requests to the mounted filesystem.
+    uint32_t dispatch_threads = 1;
 };
 
 class Blobfs : public fs::ManagedVfs,
@@ -182,6 +185,8 @@ public:
         return blob_cache_;
     }
 
+    Pager* GetPager() { return pager_.get(); }
+
     zx_status_t Readdir(fs::vdircookie_t* cookie, void* dirents, size_t len, size_t* out_actual);
 
     int Fd() const { return blockfd_.get(); }
@@ -260,6 +265,7 @@ private:
 
     fbl::unique_ptr<WritebackQueue> writeback_;
     fbl::unique_ptr<Journal> journal_;
+    fbl::unique_ptr<Pager> pager_;
     Superblock info_;
 
     BlobCache blob_cache_;
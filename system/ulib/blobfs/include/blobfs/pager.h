@@ -0,0 +1,124 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file describes the pager, which reads blobs in from disk as they are used.
+
+#pragma once
+
+#ifndef __Fuchsia__
+#error Fuchsia-only Header
+#endif
+
+#include <threads.h>
+
+#include <fbl/intrusive_wavl_tree.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/ref_counted.h>
+#include <fbl/ref_ptr.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+#include <fs/block-txn.h>
+#include <lib/zx/handle.h>
+#include <lib/zx/port.h>
+#include <lib/zx/vmo.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+
+#include <blobfs/format.h>
+
+namespace blobfs {
+
+class Blobfs;
+
+// Everything the pager needs to read one blob in from disk, copied out of the
+// blob when its VMO is created so that the pager thread never has to touch the
+// blob itself, or blobfs's maps of inodes and blocks.
+class PagedBlob : public fbl::RefCounted<PagedBlob>,
+                  public fbl::WAVLTreeContainable<fbl::RefPtr<PagedBlob>> {
+public:
+    PagedBlob(Blobfs* blobfs, uint64_t key, const Inode& inode, uint64_t data_start)
+        : blobfs_(blobfs), key_(key), inode_(inode), data_start_(data_start) {}
+    ~PagedBlob();
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PagedBlob);
+
+    uint64_t GetKey() const { return key_; }
+
+private:
+    friend class Pager;
+
+    Blobfs* const blobfs_;
+    const uint64_t key_;
+    const Inode inode_;
+    const uint64_t data_start_;
+
+    // The blob's extents, in order.
+    fbl::Vector<Extent> extents_;
+
+    // The pages handed to the blob's VMO are read into here first.  Like the
+    // mapping of a blob being written, it holds the Merkle tree, which is read
+    // up front and stays, followed by the data aligned to kBlobfsBlockSize.
+    // It isn't kept mapped, since the kernel won't take pages that are.
+    zx::vmo transfer_vmo_;
+    vmoid_t transfer_vmoid_ = {};
+
+    // The VMO the pages are supplied to.
+    zx::vmo vmo_;
+};
+
+// Reads blobs in from disk a piece at a time, as their pages are first touched,
+// rather than all at once when they are opened.  Each blob is given a VMO whose
+// pages are supplied by the pager's thread, which reads the blocks holding them
+// and checks them against the blob's Merkle tree before handing them over.
+class Pager {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(Pager);
+
+    static zx_status_t Create(Blobfs* blobfs, fbl::unique_ptr<Pager>* out);
+    ~Pager();
+
+    // Creates a VMO of the data of the blob at |node_index|, whose inode is
+    // |inode|, and returns it along with the key to give |ReleaseVmo|.
+    // Returns ZX_ERR_NOT_SUPPORTED for a compressed blob.
+    zx_status_t CreateVmo(uint32_t node_index, const Inode& inode, zx::vmo* out_vmo,
+                          uint64_t* out_key);
+
+    // Stops supplying pages to the VMO created with |key|, once its last
+    // copy-on-write clone has gone.  Should only be called once the VMO
+    // itself can't be touched or cloned any more.
+    void ReleaseVmo(uint64_t key);
+
+private:
+    explicit Pager(Blobfs* blobfs) : blobfs_(blobfs) {}
+
+    static int PagerThread(void* arg);
+
+    // Reads in, verifies and supplies at least the range [offset, offset + length)
+    // of |blob|'s VMO.
+    zx_status_t SupplyPages(const PagedBlob& blob, uint64_t offset, uint64_t length);
+
+    // Fails the requests for the range [offset, offset + length) of |blob|'s
+    // VMO, after |SupplyPages| has failed with |status|.
+    void FailPages(const PagedBlob& blob, uint64_t offset, uint64_t length, zx_status_t status);
+
+    // Forgets the blob registered with |key|.
+    void RemoveBlob(uint64_t key);
+
+    // Enqueues reads of |count| of |blob|'s blocks, starting at block |start|,
+    // into the same blocks of the VMO attached as |vmoid|, less |vmo_shift|.
+    zx_status_t EnqueueBlocks(fs::ReadTxn* txn, const PagedBlob& blob, vmoid_t vmoid,
+                              uint64_t vmo_shift, uint64_t start, uint64_t count);
+
+    Blobfs* const blobfs_;
+    zx::handle pager_;
+    zx::port port_;
+    thrd_t thread_;
+    bool thread_started_ = false;
+
+    fbl::Mutex lock_;
+    uint64_t next_key_ TA_GUARDED(lock_) = 1;
+    fbl::WAVLTree<uint64_t, fbl::RefPtr<PagedBlob>> blobs_ TA_GUARDED(lock_);
+};
+
+} // namespace blobfs
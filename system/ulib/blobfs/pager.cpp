@@ -0,0 +1,333 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+#include <limits.h>
+#include <string.h>
+
+#include <blobfs/blobfs.h>
+#include <blobfs/pager.h>
+#include <digest/digest.h>
+#include <digest/merkle-tree.h>
+#include <fbl/algorithm.h>
+#include <fbl/auto_lock.h>
+#include <fs/trace.h>
+#include <lib/fzl/vmo-mapper.h>
+#include <trace/event.h>
+#include <zircon/status.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+#include <utility>
+
+namespace blobfs {
+namespace {
+
+using digest::Digest;
+using digest::MerkleTree;
+
+// The least the pager reads in at a time: a run of leaves of the Merkle tree,
+// so that each read can be verified by itself, and long enough that reading a
+// blob from start to finish doesn't cost a trip to the disk for every page.
+constexpr uint64_t kReadAheadSize = 16 * MerkleTree::kNodeSize;
+static_assert(kReadAheadSize % kBlobfsBlockSize == 0, "Read-ahead must be whole blocks");
+static_assert(kReadAheadSize % PAGE_SIZE == 0, "Read-ahead must be whole pages");
+
+// Keys start from one, leaving zero to tell the pager thread to exit.
+constexpr uint64_t kShutdownKey = 0;
+
+} // namespace
+
+PagedBlob::~PagedBlob() {
+    if (transfer_vmoid_ != VMOID_INVALID) {
+        blobfs_->DetachVmo(transfer_vmoid_);
+    }
+}
+
+zx_status_t Pager::Create(Blobfs* blobfs, fbl::unique_ptr<Pager>* out) {
+    fbl::unique_ptr<Pager> pager(new Pager(blobfs));
+
+    zx_status_t status = zx_pager_create(0, pager->pager_.reset_and_get_address());
+    if (status != ZX_OK) {
+        return status;
+    }
+    if ((status = zx::port::create(0, &pager->port_)) != ZX_OK) {
+        return status;
+    }
+
+    if (thrd_create_with_name(&pager->thread_, Pager::PagerThread, pager.get(),
+                              "blobfs-pager") != thrd_success) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    pager->thread_started_ = true;
+
+    *out = std::move(pager);
+    return ZX_OK;
+}
+
+Pager::~Pager() {
+    if (thread_started_) {
+        zx_port_packet_t packet = {};
+        packet.key = kShutdownKey;
+        packet.type = ZX_PKT_TYPE_USER;
+        ZX_ASSERT(port_.queue(&packet) == ZX_OK);
+        thrd_join(thread_, nullptr);
+    }
+}
+
+zx_status_t Pager::CreateVmo(uint32_t node_index, const Inode& inode, zx::vmo* out_vmo,
+                             uint64_t* out_key) {
+    TRACE_DURATION("blobfs", "Pager::CreateVmo", "size", inode.blob_size);
+    ZX_DEBUG_ASSERT(inode.blob_size > 0);
+
+    // A compressed blob is a single stream, which would have to be read and
+    // decompressed whole to supply any page of it.
+    if ((inode.header.flags & kBlobFlagLZ4Compressed) != 0) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    uint64_t key;
+    {
+        fbl::AutoLock lock(&lock_);
+        key = next_key_++;
+    }
+    fbl::AllocChecker ac;
+    fbl::RefPtr<PagedBlob> blob = fbl::AdoptRef(
+        new (&ac) PagedBlob(blobfs_, key, inode, DataStartBlock(blobfs_->Info())));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    AllocatedExtentIterator extent_iter = blobfs_->GetExtents(node_index);
+    while (!extent_iter.Done()) {
+        const Extent* extent;
+        zx_status_t status = extent_iter.Next(&extent);
+        if (status != ZX_OK) {
+            return status;
+        }
+        blob->extents_.push_back(*extent, &ac);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+    }
+
+    const uint64_t merkle_blocks = MerkleTreeBlocks(inode);
+    const uint64_t num_blocks = merkle_blocks + BlobDataBlocks(inode);
+    zx_status_t status = zx::vmo::create(num_blocks * kBlobfsBlockSize, 0, &blob->transfer_vmo_);
+    if (status != ZX_OK) {
+        return status;
+    }
+    if ((status = blobfs_->AttachVmo(blob->transfer_vmo_, &blob->transfer_vmoid_)) != ZX_OK) {
+        FS_TRACE_ERROR("blobfs: Failed to attach pager VMO: %d\n", status);
+        return status;
+    }
+
+    // The Merkle tree is needed to verify anything at all, so read it now.
+    if (merkle_blocks > 0) {
+        fs::ReadTxn txn(blobfs_);
+        if ((status = EnqueueBlocks(&txn, *blob, blob->transfer_vmoid_, 0, 0,
+                                    merkle_blocks)) != ZX_OK ||
+            (status = txn.Transact()) != ZX_OK) {
+            FS_TRACE_ERROR("blobfs: Failed to read Merkle tree: %d\n", status);
+            return status;
+        }
+    }
+
+    zx::vmo vmo;
+    const uint64_t vmo_size = fbl::round_up(inode.blob_size, static_cast<uint64_t>(PAGE_SIZE));
+    if ((status = zx_pager_create_vmo(pager_.get(), 0, port_.get(), key, vmo_size,
+                                      vmo.reset_and_get_address())) != ZX_OK) {
+        return status;
+    }
+    vmo.set_property(ZX_PROP_NAME, "blob", strlen("blob"));
+    if ((status = vmo.duplicate(ZX_RIGHT_SAME_RIGHTS, &blob->vmo_)) != ZX_OK) {
+        return status;
+    }
+
+    {
+        fbl::AutoLock lock(&lock_);
+        blobs_.insert(std::move(blob));
+    }
+    *out_vmo = std::move(vmo);
+    *out_key = key;
+    return ZX_OK;
+}
+
+void Pager::ReleaseVmo(uint64_t key) {
+    {
+        fbl::AutoLock lock(&lock_);
+        auto iter = blobs_.find(key);
+        if (!iter.IsValid()) {
+            return;
+        }
+
+        // Clones handed out to clients still fault on the VMO, so keep
+        // supplying it until the last of them has gone.  The pager thread
+        // removes the blob then.
+        zx_signals_t observed;
+        zx_status_t status = iter->vmo_.wait_one(ZX_VMO_ZERO_CHILDREN, zx::time(), &observed);
+        if (status != ZX_OK || (observed & ZX_VMO_ZERO_CHILDREN) == 0) {
+            status = iter->vmo_.wait_async(port_, key, ZX_VMO_ZERO_CHILDREN,
+                                           ZX_WAIT_ASYNC_ONCE);
+            if (status == ZX_OK) {
+                return;
+            }
+            FS_TRACE_ERROR("blobfs: Failed to watch paged VMO: %d\n", status);
+        }
+    }
+    RemoveBlob(key);
+}
+
+void Pager::RemoveBlob(uint64_t key) {
+    fbl::RefPtr<PagedBlob> blob;
+    {
+        fbl::AutoLock lock(&lock_);
+        blob = blobs_.erase(key);
+    }
+    // Dropped outside the lock, since it talks to the block device.
+    blob.reset();
+}
+
+int Pager::PagerThread(void* arg) {
+    Pager* pager = static_cast<Pager*>(arg);
+
+    for (;;) {
+        zx_port_packet_t packet;
+        zx_status_t status = pager->port_.wait(zx::time::infinite(), &packet);
+        if (status != ZX_OK) {
+            FS_TRACE_ERROR("blobfs: Pager failed to wait for requests: %d\n", status);
+            return -1;
+        }
+        if (packet.type == ZX_PKT_TYPE_USER && packet.key == kShutdownKey) {
+            return 0;
+        }
+        if (packet.type == ZX_PKT_TYPE_SIGNAL_ONE) {
+            // The last clone of a released blob's VMO has gone.
+            pager->RemoveBlob(packet.key);
+            continue;
+        }
+        if (packet.type != ZX_PKT_TYPE_PAGE_REQUEST ||
+            packet.page_request.command != ZX_PAGER_VMO_READ) {
+            continue;
+        }
+
+        // Blobs stay registered until nothing can fault on their VMO, so
+        // only a request which was already queued when the last clone went
+        // can miss; nothing is waiting for it.
+        fbl::RefPtr<PagedBlob> blob;
+        {
+            fbl::AutoLock lock(&pager->lock_);
+            auto iter = pager->blobs_.find(packet.key);
+            if (!iter.IsValid()) {
+                continue;
+            }
+            blob = iter.CopyPointer();
+        }
+
+        status = pager->SupplyPages(*blob, packet.page_request.offset,
+                                    packet.page_request.length);
+        if (status != ZX_OK) {
+            pager->FailPages(*blob, packet.page_request.offset, packet.page_request.length,
+                             status);
+        }
+    }
+}
+
+void Pager::FailPages(const PagedBlob& blob, uint64_t offset, uint64_t length,
+                      zx_status_t status) {
+    Digest digest(blob.inode_.merkle_root_hash);
+    char name[Digest::kLength * 2 + 1];
+    ZX_ASSERT(digest.ToString(name, sizeof(name)) == ZX_OK);
+    FS_TRACE_ERROR("blobfs: Failed to page in %s at %#" PRIx64 ": %s\n", name, offset,
+                   zx_status_get_string(status));
+
+    // Whatever is waiting for the pages gets an error, as it would have when
+    // the whole blob was read and verified up front.  Anything else that went
+    // wrong reading the blob is reported as an I/O error.
+    if (status != ZX_ERR_IO_DATA_INTEGRITY) {
+        status = ZX_ERR_IO;
+    }
+    zx_status_t fail_status = zx_pager_op_range(pager_.get(), ZX_PAGER_OP_FAIL, blob.vmo_.get(),
+                                                offset, length, status);
+    if (fail_status != ZX_OK) {
+        FS_TRACE_ERROR("blobfs: Failed to fail page request: %d\n", fail_status);
+    }
+}
+
+zx_status_t Pager::SupplyPages(const PagedBlob& blob, uint64_t offset, uint64_t length) {
+    TRACE_DURATION("blobfs", "Pager::SupplyPages", "offset", offset, "length", length);
+
+    const uint64_t blob_size = blob.inode_.blob_size;
+    const uint64_t merkle_blocks = MerkleTreeBlocks(blob.inode_);
+    const uint64_t data_offset = merkle_blocks * kBlobfsBlockSize;
+
+    fzl::VmoMapper mapper;
+    zx_status_t status = mapper.Map(blob.transfer_vmo_, 0, 0,
+                                    ZX_VM_PERM_READ | ZX_VM_PERM_WRITE);
+    if (status != ZX_OK) {
+        return status;
+    }
+    const uint8_t* merkle = static_cast<const uint8_t*>(mapper.start());
+    uint8_t* data = static_cast<uint8_t*>(mapper.start()) + data_offset;
+
+    // Read in the leaves of the Merkle tree covering the request, and a little
+    // more.
+    const uint64_t start = fbl::round_down(offset, kReadAheadSize);
+    const uint64_t end =
+        fbl::min<uint64_t>(fbl::round_up(offset + length, kReadAheadSize), blob_size);
+    const uint64_t start_block = start / kBlobfsBlockSize;
+    const uint64_t end_block = fbl::round_up(end, kBlobfsBlockSize) / kBlobfsBlockSize;
+    fs::ReadTxn txn(blobfs_);
+    status = EnqueueBlocks(&txn, blob, blob.transfer_vmoid_, 0, merkle_blocks + start_block,
+                           end_block - start_block);
+    if (status == ZX_OK) {
+        status = txn.Transact();
+    }
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    Digest digest(blob.inode_.merkle_root_hash);
+    const size_t merkle_size = MerkleTree::GetTreeLength(blob_size);
+    if ((status = MerkleTree::Verify(data, blob_size, merkle, merkle_size, start, end - start,
+                                     digest)) != ZX_OK) {
+        return status;
+    }
+
+    // The end of the last page, past the end of the blob, has to read as zeros.
+    const uint64_t supply_end = fbl::round_up(end, static_cast<uint64_t>(PAGE_SIZE));
+    memset(data + end, 0, supply_end - end);
+    mapper.Unmap();
+
+    status = zx_pager_supply_pages(pager_.get(), blob.vmo_.get(), start, supply_end - start,
+                                   blob.transfer_vmo_.get(), data_offset + start);
+
+    // Don't hold on to what was read past the end of the last page.
+    blob.transfer_vmo_.op_range(ZX_VMO_OP_DECOMMIT, data_offset + start,
+                                fbl::round_up(end, kBlobfsBlockSize) - start, nullptr, 0);
+    return status;
+}
+
+zx_status_t Pager::EnqueueBlocks(fs::ReadTxn* txn, const PagedBlob& blob, vmoid_t vmoid,
+                                 uint64_t vmo_shift, uint64_t start, uint64_t count) {
+    uint64_t extent_start = 0;
+    for (const Extent& extent : blob.extents_) {
+        if (count == 0) {
+            break;
+        }
+        const uint64_t extent_end = extent_start + extent.Length();
+        if (start < extent_end) {
+            const uint64_t skip = start - extent_start;
+            const uint64_t length = fbl::min<uint64_t>(count, extent.Length() - skip);
+            txn->Enqueue(vmoid, start - vmo_shift, blob.data_start_ + extent.Start() + skip,
+                         length);
+            start += length;
+            count -= length;
+        }
+        extent_start = extent_end;
+    }
+    return count == 0 ? ZX_OK : ZX_ERR_IO_DATA_INTEGRITY;
+}
+
+} // namespace blobfs
@@ -37,6 +37,7 @@ COMMON_TARGET_SRCS := \
     $(LOCAL_DIR)/iterator/node-populator.cpp \
     $(LOCAL_DIR)/journal.cpp \
     $(LOCAL_DIR)/metrics.cpp \
+    $(LOCAL_DIR)/pager.cpp \
     $(LOCAL_DIR)/writeback.cpp \
 
 TARGET_MODULE_STATIC_LIBS := \
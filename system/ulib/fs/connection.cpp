@@ -11,7 +11,9 @@
 #include <string.h>
 #include <sys/stat.h>
 
+#include <fbl/auto_lock.h>
 #include <fs/handler.h>
+#include <fs/shared-mutex.h>
 #include <fs/trace.h>
 #include <fs/vnode.h>
 #include <fuchsia/io/c/fidl.h>
@@ -100,6 +102,25 @@ void FilterFlags(uint32_t flags, uint32_t* out_flags, bool* out_describe) {
     *out_flags = flags & (~ZX_FS_FLAG_DESCRIBE);
 }
 
+// Returns true if the operation identified by |ordinal| only reads from the
+// connection's vnode, and so may be dispatched alongside operations on other
+// vnodes of the same filesystem.
+bool IsReadOnlyOrdinal(uint32_t ordinal) {
+    switch (ordinal) {
+    case fuchsia_io_NodeDescribeOrdinal:
+    case fuchsia_io_NodeGetAttrOrdinal:
+    case fuchsia_io_FileReadOrdinal:
+    case fuchsia_io_FileReadAtOrdinal:
+    case fuchsia_io_FileSeekOrdinal:
+    case fuchsia_io_FileGetFlagsOrdinal:
+    case fuchsia_io_DirectoryReadDirentsOrdinal:
+    case fuchsia_io_DirectoryRewindOrdinal:
+        return true;
+    default:
+        return false;
+    }
+}
+
 void VnodeServe(Vfs* vfs, fbl::RefPtr<Vnode> vnode, zx::channel channel, uint32_t open_flags) {
     if (IsPathOnly(open_flags)) {
         vnode->Vnode::Serve(vfs, std::move(channel), open_flags);
@@ -357,6 +378,7 @@ void Connection::HandleSignals(async_dispatcher_t* dispatcher, async::WaitBase*
     }
 
     bool call_close = (status != ERR_DISPATCHER_DONE);
+    ExclusiveLock lock(vfs_->dispatch_lock());
     Terminate(call_close);
 }
 
@@ -377,6 +399,13 @@ void Connection::Terminate(bool call_close) {
 
 zx_status_t Connection::CallHandler() {
     return ReadMessage(channel_.get(), [this] (fidl_msg_t* msg, FidlConnection* txn) {
+        auto header = reinterpret_cast<fidl_message_header_t*>(msg->bytes);
+        if (IsReadOnlyOrdinal(header->ordinal)) {
+            SharedLock lock(vfs_->dispatch_lock());
+            fbl::AutoLock vnode_lock(&vnode_->dispatch_lock_);
+            return HandleMessage(msg, txn->Txn());
+        }
+        ExclusiveLock lock(vfs_->dispatch_lock());
         return HandleMessage(msg, txn->Txn());
     });
 }
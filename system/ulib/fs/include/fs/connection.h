@@ -57,6 +57,9 @@ public:
     // In practice, this means the connection must have already been remotely
     // closed, or it must be destroyed on the wait handler's dispatch thread
     // to prevent a race.
+    //
+    // Since destroying the connection may close and release its vnode, the
+    // VFS's dispatch lock must be held exclusively.
     virtual ~Connection();
 
     // Set a signal on the channel which causes it to be torn down and
@@ -64,6 +67,9 @@ public:
     void AsyncTeardown();
 
     // Explicitly tear down and close the connection synchronously.
+    //
+    // If the VFS may dispatch on several threads, its dispatch lock must be
+    // held exclusively.
     void SyncTeardown();
 
     // Begins waiting for messages on the channel.
@@ -139,10 +145,14 @@ private:
     void HandleSignals(async_dispatcher_t* dispatcher, async::WaitBase* wait, zx_status_t status,
                        const zx_packet_signal_t* signal);
     // Closes the connection and unregisters it from the VFS object.
+    //
+    // The VFS's dispatch lock must be held exclusively.
     void Terminate(bool call_close);
 
     // Method used to dispatch into filesystem.
     // Invoked by |HandleSignals()| or synthesized internally.
+    //
+    // Holds the VFS's dispatch lock for the duration of the operation.
     zx_status_t CallHandler();
 
     // Sends an explicit close message to the underlying vnode.
@@ -11,6 +11,7 @@
 #include <lib/async/cpp/task.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/function.h>
+#include <fbl/mutex.h>
 #include <fbl/unique_ptr.h>
 #include <fs/connection.h>
 #include <fs/vfs.h>
@@ -20,10 +21,10 @@ namespace fs {
 // A specialization of |Vfs| which provides a mechanism to tear down
 // all active connections before it is destroyed.
 //
-// This class is NOT thread-safe and it must be used with a
-// single-threaded asynchronous dispatcher. However, after an operation
-// has been dispatched to a connection, it is safe to defer completion
-// of that operation, returning "ERR_DISPATCHER_ASYNC".
+// This class is thread-safe, and its connections may be served by a
+// multi-threaded asynchronous dispatcher; see |Vfs::dispatch_lock|.
+// After an operation has been dispatched to a connection, it is safe to
+// defer completion of that operation, returning "ERR_DISPATCHER_ASYNC".
 //
 // It is unsafe to shutdown the dispatch loop before shutting down the
 // ManagedVfs object.
@@ -49,26 +50,30 @@ public:
 
 private:
     // Posts the task for OnShutdownComplete if it is safe to do so.
-    void CheckForShutdownComplete();
+    void CheckForShutdownComplete() __TA_REQUIRES(lock_);
 
     // Identifies if the filesystem has fully terminated, and is
     // ready for "OnShutdownComplete" to execute.
-    bool IsTerminated() const;
+    bool IsTerminated() const __TA_REQUIRES(lock_);
 
     // Invokes the handler from |Shutdown| once all connections have been
     // released. Additionally, unmounts all sub-mounted filesystems, if any
     // exist.
     void OnShutdownComplete(async_dispatcher_t*, async::TaskBase*, zx_status_t status);
 
-    void RegisterConnection(fbl::unique_ptr<Connection> connection) final;
+    zx_status_t RegisterConnection(fbl::unique_ptr<Connection> connection) final;
     void UnregisterConnection(Connection* connection) final;
     bool IsTerminating() const final;
 
-    fbl::DoublyLinkedList<fbl::unique_ptr<Connection>> connections_;
+    // Guards the connections and the state of the shutdown.  Connections are
+    // never destroyed while it is held, since that calls into their vnodes.
+    mutable fbl::Mutex lock_;
 
-    bool is_shutting_down_;
+    fbl::DoublyLinkedList<fbl::unique_ptr<Connection>> connections_ __TA_GUARDED(lock_);
+
+    bool is_shutting_down_ __TA_GUARDED(lock_);
     async::TaskMethod<ManagedVfs, &ManagedVfs::OnShutdownComplete> shutdown_task_{this};
-    ShutdownCallback shutdown_handler_;
+    ShutdownCallback shutdown_handler_ __TA_GUARDED(lock_);
 };
 
 } // namespace fs
@@ -0,0 +1,98 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#ifndef __Fuchsia__
+#error "Fuchsia-only header"
+#endif
+
+#include <stdint.h>
+
+#include <fbl/auto_lock.h>
+#include <fbl/condition_variable.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <zircon/compiler.h>
+
+namespace fs {
+
+// A lock which may be held either exclusively, by one thread, or shared, by
+// any number of threads at once.
+//
+// Threads waiting to acquire the lock exclusively hold off new shared
+// holders, so that a steady stream of readers cannot starve writers.
+class SharedMutex {
+public:
+    SharedMutex() = default;
+    DISALLOW_COPY_ASSIGN_AND_MOVE(SharedMutex);
+
+    void Acquire() {
+        fbl::AutoLock lock(&lock_);
+        writers_waiting_++;
+        while (writer_ || readers_ > 0) {
+            writer_cv_.Wait(&lock_);
+        }
+        writers_waiting_--;
+        writer_ = true;
+    }
+
+    void Release() {
+        fbl::AutoLock lock(&lock_);
+        writer_ = false;
+        if (writers_waiting_ > 0) {
+            writer_cv_.Signal();
+        } else {
+            reader_cv_.Broadcast();
+        }
+    }
+
+    void AcquireShared() {
+        fbl::AutoLock lock(&lock_);
+        while (writer_ || writers_waiting_ > 0) {
+            reader_cv_.Wait(&lock_);
+        }
+        readers_++;
+    }
+
+    void ReleaseShared() {
+        fbl::AutoLock lock(&lock_);
+        readers_--;
+        if (readers_ == 0 && writers_waiting_ > 0) {
+            writer_cv_.Signal();
+        }
+    }
+
+private:
+    fbl::Mutex lock_;
+    fbl::ConditionVariable reader_cv_;
+    fbl::ConditionVariable writer_cv_;
+    uint32_t readers_ __TA_GUARDED(lock_) = 0;
+    uint32_t writers_waiting_ __TA_GUARDED(lock_) = 0;
+    bool writer_ __TA_GUARDED(lock_) = false;
+};
+
+// Holds a |SharedMutex| exclusively for the lifetime of the guard.
+class ExclusiveLock {
+public:
+    explicit ExclusiveLock(SharedMutex* mutex) : mutex_(mutex) { mutex_->Acquire(); }
+    ~ExclusiveLock() { mutex_->Release(); }
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ExclusiveLock);
+
+private:
+    SharedMutex* const mutex_;
+};
+
+// Holds a |SharedMutex| shared for the lifetime of the guard.
+class SharedLock {
+public:
+    explicit SharedLock(SharedMutex* mutex) : mutex_(mutex) { mutex_->AcquireShared(); }
+    ~SharedLock() { mutex_->ReleaseShared(); }
+    DISALLOW_COPY_ASSIGN_AND_MOVE(SharedLock);
+
+private:
+    SharedMutex* const mutex_;
+};
+
+} // namespace fs
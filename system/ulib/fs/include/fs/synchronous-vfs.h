@@ -45,7 +45,7 @@ private:
     // It is safe to delete SynchronousVfs from within the closure.
     void Shutdown(ShutdownCallback handler) override;
 
-    void RegisterConnection(fbl::unique_ptr<Connection> connection) final;
+    zx_status_t RegisterConnection(fbl::unique_ptr<Connection> connection) final;
     void UnregisterConnection(Connection* connection) final;
     bool IsTerminating() const final;
 
@@ -24,6 +24,7 @@
 #include <lib/zx/vmo.h>
 #include <fbl/mutex.h>
 #include <fs/client.h>
+#include <fs/shared-mutex.h>
 #endif // __Fuchsia__
 
 #include <fbl/function.h>
@@ -157,11 +158,22 @@ public:
     async_dispatcher_t* dispatcher() { return dispatcher_; }
     void SetDispatcher(async_dispatcher_t* dispatcher) { dispatcher_ = dispatcher; }
 
+    // The lock which lets connections be served by a multi-threaded dispatcher.
+    //
+    // Connections hold it shared while dispatching operations which only read
+    // from their vnode, along with the vnode's own lock, so that reads of
+    // different vnodes run in parallel.  Every other operation holds it
+    // exclusively, as must anything else the filesystem runs on the
+    // dispatcher which touches its vnodes.
+    SharedMutex* dispatch_lock() { return &dispatch_lock_; }
+
     // Begins serving VFS messages over the specified connection.
     zx_status_t ServeConnection(fbl::unique_ptr<Connection> connection) FS_TA_EXCLUDES(vfs_lock_);
 
     // Called by a VFS connection when it is closed remotely.
     // The VFS is now responsible for destroying the connection.
+    //
+    // The dispatch lock must be held exclusively.
     void OnConnectionClosedRemotely(Connection* connection) FS_TA_EXCLUDES(vfs_lock_);
 
     // Serves a Vnode over the specified channel (used for creating new filesystems)
@@ -239,12 +251,17 @@ private:
 
     async_dispatcher_t* dispatcher_{};
 
+    SharedMutex dispatch_lock_;
+
 protected:
     // A lock which should be used to protect lookup and walk operations
     mtx_t vfs_lock_{};
 
-    // Starts tracking the lifetime of the connection.
-    virtual void RegisterConnection(fbl::unique_ptr<Connection> connection) = 0;
+    // Begins serving the connection, and starts tracking its lifetime.
+    //
+    // The connection is tracked before its first message can be dispatched,
+    // so that it may safely be closed from another thread straight away.
+    virtual zx_status_t RegisterConnection(fbl::unique_ptr<Connection> connection) = 0;
 
     // Stops tracking the lifetime of the connection.
     virtual void UnregisterConnection(Connection* connection) = 0;
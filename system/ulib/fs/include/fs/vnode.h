@@ -25,6 +25,7 @@
 #include <utility>
 
 #ifdef __Fuchsia__
+#include <fbl/mutex.h>
 #include <fuchsia/io/c/fidl.h>
 #include <lib/zx/channel.h>
 
@@ -209,6 +210,15 @@ public:
 protected:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Vnode);
     Vnode();
+
+#ifdef __Fuchsia__
+private:
+    friend class Connection;
+
+    // Serializes the operations which connections dispatch to this vnode
+    // while holding the VFS's dispatch lock shared.
+    fbl::Mutex dispatch_lock_;
+#endif
 };
 
 // Opens a vnode by reference.
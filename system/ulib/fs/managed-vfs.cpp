@@ -4,6 +4,7 @@
 
 #include <fs/managed-vfs.h>
 
+#include <fbl/auto_lock.h>
 #include <fbl/unique_ptr.h>
 #include <lib/async/cpp/task.h>
 #include <lib/sync/completion.h>
@@ -17,6 +18,7 @@ ManagedVfs::ManagedVfs() : is_shutting_down_(false) {}
 ManagedVfs::ManagedVfs(async_dispatcher_t* dispatcher) : Vfs(dispatcher), is_shutting_down_(false) {}
 
 ManagedVfs::~ManagedVfs() {
+    fbl::AutoLock lock(&lock_);
     ZX_DEBUG_ASSERT(connections_.is_empty());
 }
 
@@ -28,14 +30,18 @@ bool ManagedVfs::IsTerminated() const {
 void ManagedVfs::Shutdown(ShutdownCallback handler) {
     ZX_DEBUG_ASSERT(handler);
     zx_status_t status = async::PostTask(dispatcher(), [this, closure = std::move(handler)]() mutable {
-        ZX_DEBUG_ASSERT(!shutdown_handler_);
-        shutdown_handler_ = std::move(closure);
-        is_shutting_down_ = true;
+        {
+            fbl::AutoLock lock(&lock_);
+            ZX_DEBUG_ASSERT(!shutdown_handler_);
+            shutdown_handler_ = std::move(closure);
+            is_shutting_down_ = true;
+        }
 
         UninstallAll(ZX_TIME_INFINITE);
 
         // Signal the teardown on channels in a way that doesn't potentially
         // pull them out from underneath async callbacks.
+        fbl::AutoLock lock(&lock_);
         for (auto& c : connections_) {
             c.AsyncTeardown();
         }
@@ -53,28 +59,59 @@ void ManagedVfs::CheckForShutdownComplete() {
 }
 
 void ManagedVfs::OnShutdownComplete(async_dispatcher_t*, async::TaskBase*, zx_status_t status) {
-    ZX_ASSERT_MSG(IsTerminated(),
-                  "Failed to complete VFS shutdown: dispatcher status = %d\n", status);
-    ZX_DEBUG_ASSERT(shutdown_handler_);
+    // The handler may delete this object, so first wait out the thread which
+    // posted this task, which may still hold the dispatch lock.
+    {
+        ExclusiveLock dispatch(dispatch_lock());
+    }
+
+    ShutdownCallback handler;
+    {
+        fbl::AutoLock lock(&lock_);
+        ZX_ASSERT_MSG(IsTerminated(),
+                      "Failed to complete VFS shutdown: dispatcher status = %d\n", status);
+        ZX_DEBUG_ASSERT(shutdown_handler_);
+        handler = std::move(shutdown_handler_);
+    }
 
-    auto handler = std::move(shutdown_handler_);
     handler(status);
 }
 
-void ManagedVfs::RegisterConnection(fbl::unique_ptr<Connection> connection) {
-    ZX_DEBUG_ASSERT(!is_shutting_down_);
+zx_status_t ManagedVfs::RegisterConnection(fbl::unique_ptr<Connection> connection) {
+    // Holding the lock while the connection begins waiting for messages
+    // keeps another dispatch thread from unregistering it before it has
+    // been added to the list.
+    fbl::AutoLock lock(&lock_);
+    zx_status_t status = connection->Serve();
+    if (status != ZX_OK) {
+        return status;
+    }
+    if (is_shutting_down_) {
+        // The connection was opened by an operation which raced with
+        // |Shutdown|, so it is torn down along with the rest.
+        connection->AsyncTeardown();
+    }
     connections_.push_back(std::move(connection));
+    return ZX_OK;
 }
 
 void ManagedVfs::UnregisterConnection(Connection* connection) {
-    // We drop the result of |erase| on the floor, effectively destroying the
-    // connection when all other references (like async callbacks) have
-    // completed.
-    connections_.erase(*connection);
+    fbl::unique_ptr<Connection> closed;
+    {
+        fbl::AutoLock lock(&lock_);
+        closed = connections_.erase(*connection);
+    }
+
+    // Destroy the connection, and with it perhaps the vnode, outside the
+    // lock; the caller holds the dispatch lock exclusively.
+    closed.reset();
+
+    fbl::AutoLock lock(&lock_);
     CheckForShutdownComplete();
 }
 
 bool ManagedVfs::IsTerminating() const {
+    fbl::AutoLock lock(&lock_);
     return is_shutting_down_;
 }
 
@@ -36,9 +36,14 @@ void SynchronousVfs::Shutdown(ShutdownCallback handler) {
     }
 }
 
-void SynchronousVfs::RegisterConnection(fbl::unique_ptr<Connection> connection) {
+zx_status_t SynchronousVfs::RegisterConnection(fbl::unique_ptr<Connection> connection) {
     ZX_DEBUG_ASSERT(!is_shutting_down_);
+    zx_status_t status = connection->Serve();
+    if (status != ZX_OK) {
+        return status;
+    }
     connections_.push_back(std::move(connection));
+    return ZX_OK;
 }
 
 void SynchronousVfs::UnregisterConnection(Connection* connection) {
@@ -399,11 +399,7 @@ zx_status_t Vfs::Link(zx::event token, fbl::RefPtr<Vnode> oldparent,
 zx_status_t Vfs::ServeConnection(fbl::unique_ptr<Connection> connection) {
     ZX_DEBUG_ASSERT(connection);
 
-    zx_status_t status = connection->Serve();
-    if (status == ZX_OK) {
-        RegisterConnection(std::move(connection));
-    }
-    return status;
+    return RegisterConnection(std::move(connection));
 }
 
 void Vfs::OnConnectionClosedRemotely(Connection* connection) {
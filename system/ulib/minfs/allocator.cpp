@@ -7,6 +7,7 @@
 #include <string.h>
 
 #include <bitmap/raw-bitmap.h>
+#include <fbl/algorithm.h>
 
 #include <minfs/allocator.h>
 #include <minfs/block-txn.h>
@@ -38,6 +39,39 @@ size_t AllocatorPromise::Allocate(WriteTxn* txn) {
     return allocator_->Allocate(txn);
 }
 
+size_t AllocatorPromise::AllocateNear(WriteTxn* txn, size_t goal) {
+    ZX_DEBUG_ASSERT(allocator_ != nullptr);
+    ZX_DEBUG_ASSERT(reserved_ > 0);
+    reserved_--;
+    return allocator_->AllocateNear(txn, goal);
+}
+
+size_t AllocatorPromise::AllocateRun(WriteTxn* txn, size_t goal, size_t count,
+                                     size_t* out_index) {
+    ZX_DEBUG_ASSERT(allocator_ != nullptr);
+    ZX_DEBUG_ASSERT(count > 0);
+    ZX_DEBUG_ASSERT(reserved_ >= count);
+    size_t allocated = allocator_->AllocateRun(txn, goal, count, out_index);
+    reserved_ -= allocated;
+    return allocated;
+}
+
+void AllocatorPromise::Give(size_t count, fbl::unique_ptr<AllocatorPromise>* out) {
+    ZX_DEBUG_ASSERT(reserved_ >= count);
+    if (*out == nullptr) {
+        out->reset(new AllocatorPromise(allocator_, 0));
+    }
+    ZX_DEBUG_ASSERT((*out)->allocator_ == allocator_);
+    reserved_ -= count;
+    (*out)->reserved_ += count;
+}
+
+void AllocatorPromise::Cancel(size_t count) {
+    ZX_DEBUG_ASSERT(reserved_ >= count);
+    reserved_ -= count;
+    allocator_->Unreserve(count);
+}
+
 AllocatorFvmMetadata::AllocatorFvmMetadata() = default;
 AllocatorFvmMetadata::AllocatorFvmMetadata(uint32_t* data_slices,
                                            uint32_t* metadata_slices,
@@ -135,10 +169,22 @@ void Allocator::Unreserve(size_t count) {
 }
 
 size_t Allocator::Allocate(WriteTxn* txn) {
+    size_t index = AllocateFrom(txn, hint_);
+    hint_ = index + 1;
+    return index;
+}
+
+size_t Allocator::AllocateNear(WriteTxn* txn, size_t goal) {
+    // Allocations near a goal leave the hint alone, so that they don't drag
+    // unrelated allocations back towards it.
+    return AllocateFrom(txn, goal < map_.size() ? goal : hint_);
+}
+
+size_t Allocator::AllocateFrom(WriteTxn* txn, size_t start) {
     ZX_DEBUG_ASSERT(reserved_ > 0);
     size_t bitoff_start;
-    if (map_.Find(false, hint_, map_.size(), 1, &bitoff_start) != ZX_OK) {
-        ZX_ASSERT(map_.Find(false, 0, hint_, 1, &bitoff_start) == ZX_OK);
+    if (map_.Find(false, start, map_.size(), 1, &bitoff_start) != ZX_OK) {
+        ZX_ASSERT(map_.Find(false, 0, start, 1, &bitoff_start) == ZX_OK);
     }
 
     ZX_ASSERT(map_.Set(bitoff_start, bitoff_start + 1) == ZX_OK);
@@ -147,10 +193,44 @@ size_t Allocator::Allocate(WriteTxn* txn) {
     metadata_.PoolAllocate(1);
     reserved_ -= 1;
     sb_->Write(txn);
-    hint_ = bitoff_start + 1;
     return bitoff_start;
 }
 
+size_t Allocator::AllocateRun(WriteTxn* txn, size_t goal, size_t count, size_t* out_index) {
+    ZX_DEBUG_ASSERT(reserved_ >= count);
+    size_t start;
+    if (goal != 0 && goal < map_.size() && !map_.Get(goal, goal + 1)) {
+        start = goal;
+    } else {
+        // Look for a free run long enough to take all |count| elements, failing which, take the
+        // first free element and as many as follow it.
+        size_t from = (goal != 0 && goal < map_.size()) ? goal : hint_;
+        if (map_.Find(false, from, map_.size(), count, &start) != ZX_OK &&
+            map_.Find(false, 0, map_.size(), count, &start) != ZX_OK &&
+            map_.Find(false, from, map_.size(), 1, &start) != ZX_OK) {
+            ZX_ASSERT(map_.Find(false, 0, from, 1, &start) == ZX_OK);
+        }
+    }
+
+    size_t end = fbl::min(start + count, map_.size());
+    size_t first_set;
+    if (map_.Find(true, start, end, 1, &first_set) == ZX_OK) {
+        end = first_set;
+    }
+    ZX_ASSERT(map_.Set(start, end) == ZX_OK);
+
+    size_t allocated = end - start;
+    Persist(txn, start, allocated);
+    metadata_.PoolAllocate(static_cast<uint32_t>(allocated));
+    reserved_ -= allocated;
+    sb_->Write(txn);
+    if (start != goal) {
+        hint_ = end;
+    }
+    *out_index = start;
+    return allocated;
+}
+
 void Allocator::Free(WriteTxn* txn, size_t index) {
     ZX_DEBUG_ASSERT(map_.Get(index, index + 1));
     map_.Clear(index, index + 1);
@@ -236,9 +316,11 @@ zx_status_t Allocator::Extend(WriteTxn* txn) {
 }
 
 void Allocator::Persist(WriteTxn* txn, size_t index, size_t count) {
+    ZX_DEBUG_ASSERT(count > 0);
     blk_t rel_block = static_cast<blk_t>(index) / kMinfsBlockBits;
     blk_t abs_block = metadata_.MetadataStartBlock() + rel_block;
-    blk_t blk_count = BitmapBlocksForSize(count);
+    // The elements may straddle the boundary between two blocks of the bitmap.
+    blk_t blk_count = static_cast<blk_t>(index + count - 1) / kMinfsBlockBits - rel_block + 1;
 
 #ifdef __Fuchsia__
     zx_handle_t data = map_.StorageUnsafe()->GetVmo().get();
@@ -0,0 +1,511 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file maintains the hashed name index of large directories, which lets
+// names be found without scanning every dirent. See format.h for its layout.
+
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/array.h>
+#include <fbl/string_piece.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+#include <fs/trace.h>
+
+#include "minfs-private.h"
+
+namespace minfs {
+namespace {
+
+constexpr uint32_t DepthMask(uint32_t depth) {
+    return (1u << depth) - 1;
+}
+
+// Buckets are filled to no more than this when the index is built, leaving
+// room for the directory to grow before any of them need to be split.
+constexpr uint32_t kMinfsDirIndexBuildEntries = kMinfsDirIndexBucketEntries * 3 / 4;
+
+// The index is rebuilt, merging the free dirents which unlinks through it left
+// unmerged, once there are more of those than this or than a quarter of the
+// entries in the directory.
+constexpr uint32_t kMinfsDirIndexMaxUnmerged = 64;
+
+// Returns true if enough dirents have been freed without being merged with
+// the free dirent before them for the directory to be worth compacting.
+bool TooManyUnmerged(const DirIndexHeader& header) {
+    return header.unmerged_count > fbl::max(kMinfsDirIndexMaxUnmerged, header.entry_count / 4);
+}
+
+} // namespace anonymous
+
+zx_status_t VnodeMinfs::LoadDirIndex() {
+    if (inode_.dir_index == 0) {
+        dir_index_.reset();
+        return ZX_ERR_NOT_FOUND;
+    } else if (dir_index_ != nullptr) {
+        if (dir_index_->seq_num == inode_.seq_num) {
+            return ZX_OK;
+        }
+        dir_index_.reset();
+        return ZX_ERR_BAD_STATE;
+    }
+
+    zx_status_t status;
+    if (dir_index_vn_ == nullptr &&
+        (status = fs_->VnodeGet(&dir_index_vn_, inode_.dir_index)) != ZX_OK) {
+        return status;
+    }
+    dir_index_vn_->is_dir_index_ = true;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<DirIndexHeader> header(new (&ac) DirIndexHeader);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if ((status = dir_index_vn_->ReadExactInternal(header.get(), kMinfsBlockSize, 0)) != ZX_OK) {
+        return status;
+    }
+
+    // An index which is being built, or which was left behind by changes to the
+    // directory, is simply not used.
+    if ((header->magic != kMinfsDirIndexMagic) || (header->seq_num != inode_.seq_num)) {
+        return ZX_ERR_BAD_STATE;
+    }
+    if ((header->depth > kMinfsDirIndexMaxDepth) || (header->bucket_count == 0) ||
+        (header->bucket_count > (1u << header->depth)) ||
+        (dir_index_vn_->inode_.size < (header->bucket_count + 1) * kMinfsBlockSize)) {
+        FS_TRACE_ERROR("minfs: ino#%u: bad directory index header\n", ino_);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    for (uint32_t slot = 0; slot < (1u << header->depth); slot++) {
+        if ((header->buckets[slot] == 0) || (header->buckets[slot] > header->bucket_count)) {
+            FS_TRACE_ERROR("minfs: ino#%u: bad directory index bucket %u\n", ino_,
+                           header->buckets[slot]);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+    }
+
+    dir_index_ = std::move(header);
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::ReadDirIndexBucket(blk_t bucket, DirIndexBucket* out) {
+    zx_status_t status = dir_index_vn_->ReadExactInternal(out, kMinfsBlockSize,
+                                                          bucket * kMinfsBlockSize);
+    if (status != ZX_OK) {
+        return status;
+    } else if ((out->depth > dir_index_->depth) || (out->count > kMinfsDirIndexBucketEntries)) {
+        FS_TRACE_ERROR("minfs: ino#%u: bad directory index bucket %u\n", ino_, bucket);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    return ZX_OK;
+}
+
+void VnodeMinfs::PrepareDirIndex() {
+    if (dir_index_failed_) {
+        return;
+    } else if (LoadDirIndex() == ZX_OK) {
+        if (!TooManyUnmerged(*dir_index_)) {
+            return;
+        }
+    } else if ((inode_.dir_index == 0) && (inode_.dirent_count < kMinfsDirIndexMinEntries)) {
+        return;
+    }
+
+    zx_status_t status;
+    if ((status = BuildDirIndex()) != ZX_OK) {
+        FS_TRACE_WARN("minfs: ino#%u: could not build directory index: %d\n", ino_, status);
+        dir_index_.reset();
+        dir_index_failed_ = true;
+    }
+}
+
+zx_status_t VnodeMinfs::BuildDirIndex() {
+    TRACE_DURATION("minfs", "VnodeMinfs::BuildDirIndex", "ino", ino_);
+    dir_index_.reset();
+
+    // Gather the hash and offset of every dirent.
+    fbl::AllocChecker ac;
+    fbl::Vector<DirIndexEntry> entries;
+    entries.reserve(inode_.dirent_count, &ac);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    // Runs of free dirents, which unlinks through the index may have left, are
+    // merged along the way.
+    char data[kMinfsMaxDirentSize];
+    Dirent* de = reinterpret_cast<Dirent*>(data);
+    size_t off = 0;
+    size_t last_off = 0;
+    size_t free_off = 0;
+    size_t free_len = 0;
+    uint32_t free_count = 0;
+    zx_status_t status;
+    while (off + MINFS_DIRENT_SIZE < kMinfsMaxDirectorySize) {
+        size_t r;
+        if ((status = ReadInternal(data, kMinfsMaxDirentSize, off, &r)) != ZX_OK) {
+            return status;
+        } else if ((status = ValidateDirent(de, r, off)) != ZX_OK) {
+            return status;
+        }
+        const bool last = de->reclen & kMinfsReclenLast;
+        if (de->ino != 0) {
+            if ((free_count > 1) && (status = MergeFreeDirents(free_off, free_len, false))
+                != ZX_OK) {
+                return status;
+            }
+            free_count = 0;
+            DirIndexEntry entry = { DirIndexHash(de->name, de->namelen),
+                                    static_cast<uint32_t>(off) };
+            entries.push_back(entry, &ac);
+            if (!ac.check()) {
+                return ZX_ERR_NO_MEMORY;
+            }
+        } else {
+            if (free_count++ == 0) {
+                free_off = off;
+                free_len = 0;
+            }
+            free_len += MinfsReclen(de, off);
+        }
+        if (last) {
+            last_off = off;
+            if (free_count > 1) {
+                if ((status = MergeFreeDirents(free_off, free_len, true)) != ZX_OK) {
+                    return status;
+                }
+                last_off = free_off;
+            }
+            break;
+        }
+        off += MinfsReclen(de, off);
+    }
+
+    // Use as few buckets as will hold the entries with room to spare.
+    fbl::Array<uint32_t> counts(new (&ac) uint32_t[kMinfsDirIndexMaxBuckets],
+                                kMinfsDirIndexMaxBuckets);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    uint32_t depth = 0;
+    while (true) {
+        memset(counts.get(), 0, (1u << depth) * sizeof(uint32_t));
+        uint32_t fullest = 0;
+        for (const DirIndexEntry& entry : entries) {
+            fullest = fbl::max(fullest, ++counts[entry.hash & DepthMask(depth)]);
+        }
+        if (fullest <= kMinfsDirIndexBuildEntries) {
+            break;
+        } else if (++depth > kMinfsDirIndexMaxDepth) {
+            return ZX_ERR_NO_SPACE;
+        }
+    }
+    const uint32_t bucket_count = 1u << depth;
+
+    // Sort the entries by bucket; afterwards, counts[b] is the end of bucket b.
+    fbl::Array<DirIndexEntry> sorted(new (&ac) DirIndexEntry[entries.size()], entries.size());
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    uint32_t next = 0;
+    for (uint32_t b = 0; b < bucket_count; b++) {
+        uint32_t count = counts[b];
+        counts[b] = next;
+        next += count;
+    }
+    for (const DirIndexEntry& entry : entries) {
+        sorted[counts[entry.hash & DepthMask(depth)]++] = entry;
+    }
+
+    fbl::unique_ptr<DirIndexHeader> header(new (&ac) DirIndexHeader);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    fbl::unique_ptr<DirIndexBucket> bucket(new (&ac) DirIndexBucket);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // Until the whole index has been written, its header is left blank, so
+    // that it is not trusted if we don't get that far.
+    fbl::unique_ptr<Transaction> state;
+    if ((status = fs_->BeginTransaction(inode_.dir_index == 0 ? 1 : 0, 1, &state)) != ZX_OK) {
+        return status;
+    }
+    if (inode_.dir_index == 0) {
+        if ((status = fs_->VnodeNew(state.get(), &dir_index_vn_, kMinfsTypeFile)) != ZX_OK) {
+            return status;
+        }
+        inode_.dir_index = dir_index_vn_->ino_;
+        InodeSync(state->GetWork(), kMxFsSyncDefault);
+        state->GetWork()->PinVnode(fbl::WrapRefPtr(this));
+    } else if (dir_index_vn_ == nullptr &&
+               (status = fs_->VnodeGet(&dir_index_vn_, inode_.dir_index)) != ZX_OK) {
+        return status;
+    }
+    dir_index_vn_->is_dir_index_ = true;
+    memset(header.get(), 0, sizeof(DirIndexHeader));
+    if ((status = dir_index_vn_->WriteExactInternal(state.get(), header.get(), kMinfsBlockSize,
+                                                    0)) != ZX_OK) {
+        return status;
+    }
+    state->GetWork()->PinVnode(dir_index_vn_);
+    fs_->CommitTransaction(std::move(state));
+
+    // Write out the buckets, one per transaction, so that no transaction needs
+    // more than a block or two however large the directory is.
+    uint32_t start = 0;
+    for (uint32_t b = 0; b < bucket_count; b++) {
+        memset(bucket.get(), 0, sizeof(DirIndexBucket));
+        bucket->depth = depth;
+        bucket->count = counts[b] - start;
+        memcpy(bucket->entries, &sorted[start], bucket->count * sizeof(DirIndexEntry));
+        start = counts[b];
+
+        if ((status = fs_->BeginTransaction(0, kMinfsDirIndexReserveBlocks, &state)) != ZX_OK) {
+            return status;
+        }
+        if ((status = dir_index_vn_->WriteExactInternal(state.get(), bucket.get(),
+                                                        kMinfsBlockSize,
+                                                        (b + 1) * kMinfsBlockSize)) != ZX_OK) {
+            return status;
+        }
+        state->GetWork()->PinVnode(dir_index_vn_);
+        fs_->CommitTransaction(std::move(state));
+    }
+
+    header->magic = kMinfsDirIndexMagic;
+    header->seq_num = inode_.seq_num;
+    header->depth = depth;
+    header->bucket_count = bucket_count;
+    header->entry_count = static_cast<uint32_t>(entries.size());
+    header->last_off = static_cast<uint32_t>(last_off);
+    for (uint32_t slot = 0; slot < bucket_count; slot++) {
+        header->buckets[slot] = slot + 1;
+    }
+
+    if ((status = fs_->BeginTransaction(0, 0, &state)) != ZX_OK) {
+        return status;
+    }
+    if ((status = dir_index_vn_->WriteExactInternal(state.get(), header.get(), kMinfsBlockSize,
+                                                    0)) != ZX_OK) {
+        return status;
+    }
+    // Release whatever was left over from a larger index.
+    size_t index_size = (bucket_count + 1) * kMinfsBlockSize;
+    if (dir_index_vn_->inode_.size > index_size) {
+        dir_index_vn_->TruncateInternal(state.get(), index_size);
+        dir_index_vn_->InodeSync(state->GetWork(), kMxFsSyncMtime);
+    }
+    state->GetWork()->PinVnode(dir_index_vn_);
+    fs_->CommitTransaction(std::move(state));
+
+    dir_index_ = std::move(header);
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::MergeFreeDirents(size_t off, size_t len, bool last) {
+    fbl::unique_ptr<Transaction> state;
+    zx_status_t status;
+    if ((status = fs_->BeginTransaction(0, 0, &state)) != ZX_OK) {
+        return status;
+    }
+    Dirent de;
+    memset(&de, 0, sizeof(de));
+    de.reclen = last ? kMinfsReclenLast : static_cast<uint32_t>(len);
+    if ((status = WriteExactInternal(state.get(), &de, MINFS_DIRENT_SIZE, off)) != ZX_OK) {
+        return status;
+    }
+    if (last) {
+        // As when unlinking, failing to truncate merely leaves unused space.
+        TruncateInternal(state.get(), off + MINFS_DIRENT_SIZE);
+    }
+    // Cookies of readdir may point into the merged dirents.
+    inode_.seq_num++;
+    InodeSync(state->GetWork(), kMxFsSyncDefault);
+    state->GetWork()->PinVnode(fbl::WrapRefPtr(this));
+    fs_->CommitTransaction(std::move(state));
+    return ZX_OK;
+}
+
+blk_t VnodeMinfs::DirIndexReserveBlocks() const {
+    return (dir_index_ != nullptr) ? kMinfsDirIndexReserveBlocks : 0;
+}
+
+zx_status_t VnodeMinfs::SplitDirIndexBucket(Transaction* state, uint32_t slot,
+                                            DirIndexBucket* bucket) {
+    DirIndexHeader* header = dir_index_.get();
+    if (bucket->depth == header->depth) {
+        if (header->depth == kMinfsDirIndexMaxDepth) {
+            return ZX_ERR_NO_SPACE;
+        }
+        // Double the table; each new slot shares the bucket of its twin.
+        uint32_t slots = 1u << header->depth;
+        memcpy(&header->buckets[slots], &header->buckets[0], slots * sizeof(blk_t));
+        header->depth++;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<DirIndexBucket> split(new (&ac) DirIndexBucket);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    memset(split.get(), 0, sizeof(DirIndexBucket));
+
+    // Entries with the next bit of their hash set move to the new bucket.
+    const blk_t old_bucket = header->buckets[slot & DepthMask(header->depth)];
+    const blk_t new_bucket = header->bucket_count + 1;
+    const uint32_t bit = 1u << bucket->depth;
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < bucket->count; i++) {
+        if (bucket->entries[i].hash & bit) {
+            split->entries[split->count++] = bucket->entries[i];
+        } else {
+            bucket->entries[kept++] = bucket->entries[i];
+        }
+    }
+    memset(&bucket->entries[kept], 0, (bucket->count - kept) * sizeof(DirIndexEntry));
+    bucket->count = kept;
+    bucket->depth++;
+    split->depth = bucket->depth;
+
+    zx_status_t status;
+    if ((status = dir_index_vn_->WriteExactInternal(state, bucket, kMinfsBlockSize,
+                                                    old_bucket * kMinfsBlockSize)) != ZX_OK) {
+        return status;
+    } else if ((status = dir_index_vn_->WriteExactInternal(state, split.get(), kMinfsBlockSize,
+                                                           new_bucket * kMinfsBlockSize))
+               != ZX_OK) {
+        return status;
+    }
+
+    for (uint32_t s = 0; s < (1u << header->depth); s++) {
+        if ((header->buckets[s] == old_bucket) && (s & bit)) {
+            header->buckets[s] = new_bucket;
+        }
+    }
+    header->bucket_count++;
+    return ZX_OK;
+}
+
+void VnodeMinfs::DirIndexInsert(Transaction* state, fbl::StringPiece name, size_t off) {
+    if (dir_index_ == nullptr) {
+        return;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<DirIndexBucket> bucket(new (&ac) DirIndexBucket);
+    zx_status_t status = ac.check() ? ZX_OK : ZX_ERR_NO_MEMORY;
+    const uint32_t hash = DirIndexHash(name.data(), name.length());
+    blk_t b = dir_index_->buckets[hash & DepthMask(dir_index_->depth)];
+    if ((status == ZX_OK) && (status = ReadDirIndexBucket(b, bucket.get())) == ZX_OK &&
+        (bucket->count == kMinfsDirIndexBucketEntries)) {
+        // One split is all that has been reserved for; should every entry land
+        // on the same side, the index is given up on.
+        if ((status = SplitDirIndexBucket(state, hash, bucket.get())) == ZX_OK) {
+            b = dir_index_->buckets[hash & DepthMask(dir_index_->depth)];
+            if ((status = ReadDirIndexBucket(b, bucket.get())) == ZX_OK &&
+                (bucket->count == kMinfsDirIndexBucketEntries)) {
+                status = ZX_ERR_NO_SPACE;
+            }
+        }
+    }
+    if (status == ZX_OK) {
+        bucket->entries[bucket->count++] = { hash, static_cast<uint32_t>(off) };
+        status = dir_index_vn_->WriteExactInternal(state, bucket.get(), kMinfsBlockSize,
+                                                   b * kMinfsBlockSize);
+    }
+
+    if (status != ZX_OK) {
+        // Leaving the index as it is on disk means it will no longer match the
+        // directory, so it won't be used.
+        FS_TRACE_WARN("minfs: ino#%u: giving up on directory index: %d\n", ino_, status);
+        dir_index_.reset();
+        dir_index_failed_ = true;
+        return;
+    }
+    dir_index_->entry_count++;
+    state->GetWork()->PinVnode(dir_index_vn_);
+}
+
+void VnodeMinfs::DirIndexRemove(Transaction* state, fbl::StringPiece name, size_t off) {
+    if (dir_index_ == nullptr) {
+        return;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<DirIndexBucket> bucket(new (&ac) DirIndexBucket);
+    zx_status_t status = ac.check() ? ZX_OK : ZX_ERR_NO_MEMORY;
+    const uint32_t hash = DirIndexHash(name.data(), name.length());
+    const blk_t b = dir_index_->buckets[hash & DepthMask(dir_index_->depth)];
+    if (status == ZX_OK && (status = ReadDirIndexBucket(b, bucket.get())) == ZX_OK) {
+        status = ZX_ERR_NOT_FOUND;
+        for (uint32_t i = 0; i < bucket->count; i++) {
+            if ((bucket->entries[i].hash == hash) && (bucket->entries[i].off == off)) {
+                bucket->entries[i] = bucket->entries[--bucket->count];
+                memset(&bucket->entries[bucket->count], 0, sizeof(DirIndexEntry));
+                status = dir_index_vn_->WriteExactInternal(state, bucket.get(), kMinfsBlockSize,
+                                                           b * kMinfsBlockSize);
+                break;
+            }
+        }
+    }
+
+    if (status != ZX_OK) {
+        FS_TRACE_WARN("minfs: ino#%u: giving up on directory index: %d\n", ino_, status);
+        dir_index_.reset();
+        dir_index_failed_ = true;
+        return;
+    }
+    dir_index_->entry_count--;
+    state->GetWork()->PinVnode(dir_index_vn_);
+}
+
+void VnodeMinfs::DirIndexSetLast(size_t off) {
+    if (dir_index_ != nullptr) {
+        dir_index_->last_off = static_cast<uint32_t>(off);
+    }
+}
+
+void VnodeMinfs::DirIndexUnmerged() {
+    if (dir_index_ != nullptr) {
+        dir_index_->unmerged_count++;
+    }
+}
+
+void VnodeMinfs::DirIndexSync(Transaction* state) {
+    if (dir_index_ == nullptr) {
+        return;
+    }
+    dir_index_->seq_num = inode_.seq_num;
+    zx_status_t status = dir_index_vn_->WriteExactInternal(state, dir_index_.get(),
+                                                           kMinfsBlockSize, 0);
+    if (status != ZX_OK) {
+        FS_TRACE_WARN("minfs: ino#%u: giving up on directory index: %d\n", ino_, status);
+        dir_index_.reset();
+        dir_index_failed_ = true;
+        return;
+    }
+    state->GetWork()->PinVnode(dir_index_vn_);
+}
+
+void VnodeMinfs::DropDirIndex(WritebackWork* wb) {
+    if (inode_.dir_index == 0) {
+        return;
+    }
+    if (dir_index_vn_ == nullptr && fs_->VnodeGet(&dir_index_vn_, inode_.dir_index) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: ino#%u: could not free directory index ino#%u\n", ino_,
+                       inode_.dir_index);
+        return;
+    }
+    dir_index_.reset();
+    inode_.dir_index = 0;
+    wb->PinVnode(dir_index_vn_);
+    dir_index_vn_->RemoveInodeLink(wb);
+    dir_index_vn_.reset();
+}
+
+} // namespace minfs
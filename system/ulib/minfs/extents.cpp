@@ -0,0 +1,510 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file maintains the extents which map the blocks of a vnode to data
+// blocks. See format.h for their layout.
+
+#include <string.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <fs/block-txn.h>
+#include <fs/trace.h>
+
+#ifdef __Fuchsia__
+#include <lib/fzl/resizeable-vmo-mapper.h>
+#endif
+
+#include "minfs-private.h"
+
+namespace minfs {
+namespace {
+
+// Returns the index of the first of |count| sorted |entries| which starts after block |n|,
+// or |count| if there is none.
+template <typename T>
+uint32_t FindAfter(const T* entries, uint32_t count, blk_t n) {
+    uint32_t lo = 0;
+    uint32_t hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (entries[mid].start <= n) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Returns the index of the extent reference of |inode| whose extent block may map block |n|.
+uint32_t FindExtentRef(const Inode& inode, blk_t n) {
+    uint32_t ref = FindAfter(inode.extent_refs, inode.extent_count, n);
+    return (ref > 0) ? ref - 1 : 0;
+}
+
+// Frees the data blocks which the last |*count| |extents| map from block |start|
+// onwards, dropping the extents left empty. Blocks of |metadata| are revoked from
+// the journal. Returns the number of blocks freed.
+blk_t ShrinkExtents(Minfs* fs, WritebackWork* wb, Extent* extents, uint32_t* count,
+                    blk_t start, bool metadata) {
+    blk_t freed = 0;
+    while (*count > 0) {
+        Extent* extent = &extents[*count - 1];
+        if (extent->start + extent->length <= start) {
+            break;
+        }
+        blk_t keep = (extent->start < start) ? start - extent->start : 0;
+        for (blk_t i = keep; i < extent->length; i++) {
+            fs->ValidateBno(extent->bno + i);
+            if (metadata) {
+                fs->MetadataBlockFree(wb, extent->bno + i);
+            } else {
+                fs->BlockFree(wb, extent->bno + i);
+            }
+        }
+        freed += extent->length - keep;
+        if (keep > 0) {
+            extent->length = keep;
+            break;
+        }
+        memset(extent, 0, sizeof(Extent));
+        (*count)--;
+    }
+    return freed;
+}
+
+} // namespace anonymous
+
+zx_status_t VnodeMinfs::InitExtentBlocks() {
+#ifdef __Fuchsia__
+    if (vmo_extents_ != nullptr) {
+        return ZX_OK;
+    }
+
+    vmo_extents_ = fzl::ResizeableVmoMapper::Create(kMinfsBlockSize * kMinfsExtentRefs,
+                                                    "minfs-extents");
+    if (vmo_extents_ == nullptr) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    zx_status_t status;
+    if ((status = fs_->bc_->AttachVmo(vmo_extents_->vmo(), &vmoid_extents_)) != ZX_OK) {
+        vmo_extents_ = nullptr;
+        return status;
+    }
+#else
+    if (extent_blocks_ != nullptr) {
+        return ZX_OK;
+    }
+
+    fbl::AllocChecker ac;
+    extent_blocks_.reset(new (&ac) ExtentBlock[kMinfsExtentRefs]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+#endif
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::LoadExtentBlocks() {
+#ifdef __Fuchsia__
+    bool loaded = vmo_extents_ != nullptr;
+#else
+    bool loaded = extent_blocks_ != nullptr;
+#endif
+    // Once created, the storage for extent blocks holds every extent block of the vnode.
+    if (inode_.extent_depth == 0 || loaded) {
+        return ZX_OK;
+    }
+
+    zx_status_t status;
+    if ((status = InitExtentBlocks()) != ZX_OK) {
+        return status;
+    }
+
+#ifdef __Fuchsia__
+    fs::ReadTxn txn(fs_->bc_.get());
+    for (uint32_t ref = 0; ref < inode_.extent_count; ref++) {
+        fs_->ValidateBno(inode_.extent_refs[ref].bno);
+        extent_slots_[ref] = static_cast<uint8_t>(ref);
+        txn.Enqueue(vmoid_extents_, ref, inode_.extent_refs[ref].bno + fs_->Info().dat_block, 1);
+    }
+    status = txn.Transact();
+#else
+    for (uint32_t ref = 0; ref < inode_.extent_count && status == ZX_OK; ref++) {
+        fs_->ValidateBno(inode_.extent_refs[ref].bno);
+        extent_slots_[ref] = static_cast<uint8_t>(ref);
+        status = fs_->bc_->Readblk(inode_.extent_refs[ref].bno + fs_->Info().dat_block,
+                                   GetExtentBlock(ref));
+    }
+#endif
+
+    for (uint32_t ref = 0; ref < inode_.extent_count && status == ZX_OK; ref++) {
+        const ExtentBlock* block = GetExtentBlock(ref);
+        if (block->magic != kMinfsExtentMagic || block->count > kMinfsExtentsPerBlock) {
+            FS_TRACE_ERROR("minfs: ino#%u: bad extent block %u\n", ino_,
+                           inode_.extent_refs[ref].bno);
+            status = ZX_ERR_IO_DATA_INTEGRITY;
+        }
+    }
+
+    if (status != ZX_OK) {
+#ifdef __Fuchsia__
+        block_fifo_request_t request;
+        request.group = fs_->bc_->BlockGroupID();
+        request.vmoid = vmoid_extents_;
+        request.opcode = BLOCKIO_CLOSE_VMO;
+        fs_->bc_->Transaction(&request, 1);
+        vmo_extents_ = nullptr;
+#else
+        extent_blocks_ = nullptr;
+#endif
+    }
+    return status;
+}
+
+ExtentBlock* VnodeMinfs::GetExtentBlock(uint32_t ref) {
+    ZX_DEBUG_ASSERT(ref < inode_.extent_count);
+#ifdef __Fuchsia__
+    ZX_DEBUG_ASSERT(vmo_extents_ != nullptr);
+    uintptr_t addr = reinterpret_cast<uintptr_t>(vmo_extents_->start());
+    return reinterpret_cast<ExtentBlock*>(addr + kMinfsBlockSize * extent_slots_[ref]);
+#else
+    ZX_DEBUG_ASSERT(extent_blocks_ != nullptr);
+    return &extent_blocks_[extent_slots_[ref]];
+#endif
+}
+
+void VnodeMinfs::WriteExtentBlock(WritebackWork* wb, uint32_t ref) {
+    blk_t bno = inode_.extent_refs[ref].bno;
+    ZX_DEBUG_ASSERT(bno != 0);
+#ifdef __Fuchsia__
+    wb->Enqueue(vmo_extents_->vmo().get(), extent_slots_[ref], bno + fs_->Info().dat_block, 1);
+#else
+    fs_->bc_->Writeblk(bno + fs_->Info().dat_block, GetExtentBlock(ref));
+#endif
+}
+
+zx_status_t VnodeMinfs::ExtentLookup(blk_t n, blk_t* out_bno) {
+    const Extent* extents = inode_.extents;
+    uint32_t count = inode_.extent_count;
+    if (inode_.extent_depth != 0) {
+        zx_status_t status;
+        if ((status = LoadExtentBlocks()) != ZX_OK) {
+            return status;
+        }
+        const ExtentBlock* block = GetExtentBlock(FindExtentRef(inode_, n));
+        extents = block->extents;
+        count = block->count;
+    }
+
+    *out_bno = 0;
+    uint32_t i = FindAfter(extents, count, n);
+    if (i > 0 && n - extents[i - 1].start < extents[i - 1].length) {
+        *out_bno = extents[i - 1].bno + (n - extents[i - 1].start);
+        fs_->ValidateBno(*out_bno);
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::ExtentMap(Transaction* state, blk_t n, blk_t blocks, blk_t* out_bno,
+                                  blk_t* out_count) {
+    ZX_DEBUG_ASSERT(state != nullptr);
+    ZX_DEBUG_ASSERT(blocks > 0);
+    zx_status_t status;
+    if ((status = LoadExtentBlocks()) != ZX_OK) {
+        return status;
+    }
+
+    // Make room for an extent of the new blocks up front, rather than after allocating them
+    // only to find they cannot be mapped.
+    uint32_t ref = 0;
+    if (inode_.extent_depth == 0) {
+        if (inode_.extent_count == kMinfsInlineExtents &&
+            (status = SpillExtents(state)) != ZX_OK) {
+            return status;
+        }
+    }
+    if (inode_.extent_depth != 0) {
+        ref = FindExtentRef(inode_, n);
+        if (GetExtentBlock(ref)->count == kMinfsExtentsPerBlock) {
+            if (inode_.extent_count < kMinfsExtentRefs) {
+                status = SplitExtentBlock(state, ref, n);
+            } else {
+                status = RebalanceExtentBlocks(state, ref, n);
+            }
+            if (status != ZX_OK) {
+                return status;
+            }
+            ref = FindExtentRef(inode_, n);
+            ZX_DEBUG_ASSERT(GetExtentBlock(ref)->count < kMinfsExtentsPerBlock);
+        }
+    }
+
+    Extent* extents = inode_.extents;
+    uint32_t* count = &inode_.extent_count;
+    if (inode_.extent_depth != 0) {
+        ExtentBlock* block = GetExtentBlock(ref);
+        extents = block->extents;
+        count = &block->count;
+    }
+
+    uint32_t i = FindAfter(extents, *count, n);
+    Extent* prev = (i > 0) ? &extents[i - 1] : nullptr;
+    Extent* next = (i < *count) ? &extents[i] : nullptr;
+    ZX_DEBUG_ASSERT(prev == nullptr || prev->start + prev->length <= n);
+    ZX_DEBUG_ASSERT(next == nullptr || n + blocks <= next->start);
+
+    // Place the blocks right after the one before them in the file, or failing that, right
+    // before the one after them, so that the extent mapping it can simply grow.
+    blk_t goal = 0;
+    if (prev != nullptr) {
+        goal = prev->bno + (n - prev->start);
+    } else if (next != nullptr && next->start - n < next->bno) {
+        goal = next->bno - (next->start - n);
+    }
+
+    blk_t bno;
+    blk_t length = fs_->BlocksNew(state, goal, blocks, &bno);
+    inode_.block_count += length;
+
+    bool after_prev = prev != nullptr && prev->start + prev->length == n &&
+                      prev->bno + prev->length == bno;
+    bool before_next = next != nullptr && n + length == next->start &&
+                       bno + length == next->bno;
+    if (after_prev && before_next) {
+        prev->length += length + next->length;
+        memmove(next, next + 1, (*count - i - 1) * sizeof(Extent));
+        (*count)--;
+        memset(&extents[*count], 0, sizeof(Extent));
+    } else if (after_prev) {
+        prev->length += length;
+    } else if (before_next) {
+        next->start -= length;
+        next->bno -= length;
+        next->length += length;
+    } else {
+        memmove(&extents[i + 1], &extents[i], (*count - i) * sizeof(Extent));
+        extents[i].start = n;
+        extents[i].bno = bno;
+        extents[i].length = length;
+        (*count)++;
+    }
+
+    if (inode_.extent_depth != 0) {
+        WriteExtentBlock(state->GetWork(), ref);
+    }
+    InodeSync(state->GetWork(), kMxFsSyncDefault);
+    *out_bno = bno;
+    *out_count = length;
+    return ZX_OK;
+}
+
+blk_t VnodeMinfs::ExtentReserveBlocks(blk_t count) const {
+    if (count == 0) {
+        return 0;
+    } else if (inode_.extent_depth == 0) {
+        // Each of the new blocks may need an extent of its own, and the extents only
+        // spill out of the inode into a single extent block.
+        return (inode_.extent_count + count <= kMinfsInlineExtents) ? 0 : 1;
+    }
+    // Consecutive blocks are mapped by at most two extent blocks which are full, each of
+    // which may need to be split.
+    return (count > 1) ? 2 : 1;
+}
+
+zx_status_t VnodeMinfs::SpillExtents(Transaction* state) {
+    ZX_DEBUG_ASSERT(inode_.extent_depth == 0);
+    zx_status_t status;
+    if ((status = InitExtentBlocks()) != ZX_OK) {
+        return status;
+    }
+
+    blk_t bno;
+    fs_->BlockNew(state, 0, &bno);
+    inode_.block_count++;
+
+    // There are no extent blocks in use, so the first slot is free.
+    extent_slots_[0] = 0;
+    inode_.extent_depth = 1;
+    uint32_t count = inode_.extent_count;
+    inode_.extent_count = 1;
+    ExtentBlock* block = GetExtentBlock(0);
+    memset(block, 0, sizeof(ExtentBlock));
+    block->magic = kMinfsExtentMagic;
+    block->count = count;
+    memcpy(block->extents, inode_.extents, count * sizeof(Extent));
+
+    memset(inode_.extents, 0, sizeof(inode_.extents));
+    inode_.extent_refs[0].start = 0;
+    inode_.extent_refs[0].bno = bno;
+
+    WriteExtentBlock(state->GetWork(), 0);
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::SplitExtentBlock(Transaction* state, uint32_t ref, blk_t n) {
+    ZX_DEBUG_ASSERT(inode_.extent_depth != 0);
+    if (inode_.extent_count == kMinfsExtentRefs) {
+        return ZX_ERR_NO_SPACE;
+    }
+
+    // Extent blocks which are in use never change slots, so find one which is not.
+    static_assert(kMinfsExtentRefs < 32, "Slots in use must fit in a uint32_t");
+    uint32_t used = 0;
+    for (uint32_t r = 0; r < inode_.extent_count; r++) {
+        used |= 1u << extent_slots_[r];
+    }
+    uint8_t slot = static_cast<uint8_t>(__builtin_ctz(~used));
+
+    blk_t bno;
+    fs_->BlockNew(state, inode_.extent_refs[ref].bno, &bno);
+    inode_.block_count++;
+
+    uint32_t after = inode_.extent_count - ref - 1;
+    memmove(&inode_.extent_refs[ref + 2], &inode_.extent_refs[ref + 1],
+            after * sizeof(ExtentRef));
+    memmove(&extent_slots_[ref + 2], &extent_slots_[ref + 1], after);
+    inode_.extent_count++;
+    extent_slots_[ref + 1] = slot;
+
+    ExtentBlock* from = GetExtentBlock(ref);
+    ExtentBlock* to = GetExtentBlock(ref + 1);
+    uint32_t kept = from->count / 2;
+    if (FindAfter(from->extents, from->count, n) == from->count) {
+        kept = from->count;
+    }
+    memset(to, 0, sizeof(ExtentBlock));
+    to->magic = kMinfsExtentMagic;
+    to->count = from->count - kept;
+    memcpy(to->extents, &from->extents[kept], to->count * sizeof(Extent));
+    memset(&from->extents[kept], 0, to->count * sizeof(Extent));
+    from->count = kept;
+
+    // The new extent block is only left empty if block |n| is about to be mapped in it.
+    inode_.extent_refs[ref + 1].start = (to->count > 0) ? to->extents[0].start : n;
+    inode_.extent_refs[ref + 1].bno = bno;
+
+    WriteExtentBlock(state->GetWork(), ref);
+    WriteExtentBlock(state->GetWork(), ref + 1);
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::RebalanceExtentBlocks(Transaction* state, uint32_t ref, blk_t n) {
+    ZX_DEBUG_ASSERT(inode_.extent_depth != 0);
+    ExtentBlock* block = GetExtentBlock(ref);
+    ZX_DEBUG_ASSERT(block->count == kMinfsExtentsPerBlock);
+    ExtentBlock* prev = (ref > 0) ? GetExtentBlock(ref - 1) : nullptr;
+    ExtentBlock* next = (ref + 1 < inode_.extent_count) ? GetExtentBlock(ref + 1) : nullptr;
+    uint32_t prev_room = (prev != nullptr) ? kMinfsExtentsPerBlock - prev->count : 0;
+    uint32_t next_room = (next != nullptr) ? kMinfsExtentsPerBlock - next->count : 0;
+    if (prev_room == 0 && next_room == 0) {
+        return ZX_ERR_NO_SPACE;
+    }
+
+    // Only the extents on the far side of block |n| move, so that it stays in the extent
+    // block which gains room. Half the room is left in the other, for its own blocks.
+    uint32_t before = FindAfter(block->extents, block->count, n);
+    if (next_room >= prev_room) {
+        uint32_t moved = fbl::min(block->count - before, (next_room + 1) / 2);
+        if (moved == 0) {
+            // Nothing follows block |n| here, so it can be mapped in the next extent block
+            // instead.
+            inode_.extent_refs[ref + 1].start = n;
+            return ZX_OK;
+        }
+        memmove(&next->extents[moved], next->extents, next->count * sizeof(Extent));
+        memcpy(next->extents, &block->extents[block->count - moved], moved * sizeof(Extent));
+        next->count += moved;
+        block->count -= moved;
+        memset(&block->extents[block->count], 0, moved * sizeof(Extent));
+        inode_.extent_refs[ref + 1].start = next->extents[0].start;
+        WriteExtentBlock(state->GetWork(), ref + 1);
+    } else {
+        uint32_t moved = fbl::min(before, (prev_room + 1) / 2);
+        if (moved == 0) {
+            // Nothing comes before block |n| here, so it can be mapped in the previous extent
+            // block instead.
+            inode_.extent_refs[ref].start = block->extents[0].start;
+            return ZX_OK;
+        }
+        memcpy(&prev->extents[prev->count], block->extents, moved * sizeof(Extent));
+        prev->count += moved;
+        block->count -= moved;
+        memmove(block->extents, &block->extents[moved], block->count * sizeof(Extent));
+        memset(&block->extents[block->count], 0, moved * sizeof(Extent));
+        inode_.extent_refs[ref].start = (moved < before) ? block->extents[0].start : n;
+        WriteExtentBlock(state->GetWork(), ref - 1);
+    }
+    WriteExtentBlock(state->GetWork(), ref);
+    return ZX_OK;
+}
+
+void VnodeMinfs::FreeExtentBlock(WritebackWork* wb, uint32_t ref) {
+    ZX_DEBUG_ASSERT(ref < inode_.extent_count);
+    fs_->ValidateBno(inode_.extent_refs[ref].bno);
+    fs_->MetadataBlockFree(wb, inode_.extent_refs[ref].bno);
+    inode_.block_count--;
+
+    uint32_t after = inode_.extent_count - ref - 1;
+    memmove(&inode_.extent_refs[ref], &inode_.extent_refs[ref + 1], after * sizeof(ExtentRef));
+    memmove(&extent_slots_[ref], &extent_slots_[ref + 1], after);
+    inode_.extent_count--;
+    memset(&inode_.extent_refs[inode_.extent_count], 0, sizeof(ExtentRef));
+    inode_.extent_refs[0].start = 0;
+
+    if (inode_.extent_count == 0) {
+        inode_.extent_depth = 0;
+    }
+}
+
+zx_status_t VnodeMinfs::BlocksShrink(WritebackWork* wb, blk_t start) {
+    ZX_DEBUG_ASSERT(wb != nullptr);
+    zx_status_t status;
+    if ((status = LoadExtentBlocks()) != ZX_OK) {
+        return status;
+    }
+
+    if (inode_.extent_depth == 0) {
+        inode_.block_count -= ShrinkExtents(fs_, wb, inode_.extents, &inode_.extent_count,
+                                            start, IsDirectory());
+        return ZX_OK;
+    }
+
+    // Extent blocks map later blocks of the file than those before them, so work back
+    // from the last until reaching one which maps blocks before |start|.
+    while (inode_.extent_count > 0) {
+        uint32_t ref = inode_.extent_count - 1;
+        ExtentBlock* block = GetExtentBlock(ref);
+        blk_t freed = ShrinkExtents(fs_, wb, block->extents, &block->count, start,
+                                    IsDirectory());
+        inode_.block_count -= freed;
+        if (block->count == 0) {
+            FreeExtentBlock(wb, ref);
+            continue;
+        }
+        if (freed > 0) {
+            WriteExtentBlock(wb, ref);
+        }
+        break;
+    }
+
+    // Move the extents back into the inode once they fit there.
+    if (inode_.extent_depth != 0 && inode_.extent_count == 1 &&
+        GetExtentBlock(0)->count <= kMinfsInlineExtents) {
+        ExtentBlock* block = GetExtentBlock(0);
+        blk_t bno = inode_.extent_refs[0].bno;
+        uint32_t count = block->count;
+        memset(inode_.extents, 0, sizeof(inode_.extents));
+        memcpy(inode_.extents, block->extents, count * sizeof(Extent));
+        inode_.extent_depth = 0;
+        inode_.extent_count = count;
+        fs_->MetadataBlockFree(wb, bno);
+        inode_.block_count--;
+    }
+    return ZX_OK;
+}
+
+} // namespace minfs
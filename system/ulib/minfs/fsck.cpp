@@ -7,6 +7,10 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <fbl/alloc_checker.h>
+#include <fbl/array.h>
+#include <fbl/unique_ptr.h>
+
 #include <minfs/format.h>
 #include <minfs/fsck.h>
 
@@ -37,16 +41,15 @@ private:
 
     zx_status_t GetInode(Inode* inode, ino_t ino);
 
-    // Returns the nth block within an inode, relative to the start of the
-    // file. Returns the "next_n" which might contain a bno. This "next_n"
-    // is for performance reasons -- it allows fsck to avoid repeatedly checking
-    // the same indirect / doubly indirect blocks with all internal
-    // bno unallocated.
-    zx_status_t GetInodeNthBno(Inode* inode, blk_t n, blk_t* next_n,
-                               blk_t* bno_out);
     zx_status_t CheckDirectory(Inode* inode, ino_t ino,
                                ino_t parent, uint32_t flags);
+    zx_status_t CheckDirIndex(Inode* inode, ino_t ino);
     const char* CheckDataBlock(blk_t bno);
+    // Checks |count| extents of inode |ino|, which should be sorted, and map no blocks of
+    // the file outside of [start, end). Counts the blocks they map into |block_count|, and
+    // updates |next_blk| to the block after the last of them.
+    void CheckExtents(const Extent* extents, uint32_t count, blk_t start, blk_t end, ino_t ino,
+                      blk_t* next_blk, uint32_t* block_count);
     zx_status_t CheckFile(Inode* inode, ino_t ino);
 
     fbl::unique_ptr<Minfs> fs_;
@@ -56,11 +59,6 @@ private:
     uint32_t alloc_inodes_;
     uint32_t alloc_blocks_;
     fbl::Array<int32_t> links_;
-
-    blk_t cached_doubly_indirect_;
-    blk_t cached_indirect_;
-    uint8_t doubly_indirect_cache_[kMinfsBlockSize];
-    uint8_t indirect_cache_[kMinfsBlockSize];
 };
 
 zx_status_t MinfsChecker::GetInode(Inode* inode, ino_t ino) {
@@ -81,89 +79,6 @@ zx_status_t MinfsChecker::GetInode(Inode* inode, ino_t ino) {
 #define CD_DUMP 1
 #define CD_RECURSE 2
 
-zx_status_t MinfsChecker::GetInodeNthBno(Inode* inode, blk_t n,
-                                         blk_t* next_n, blk_t* bno_out) {
-    // The default value for the "next n". It's easier to set it here anyway,
-    // since we proceed to modify n in the code below.
-    *next_n = n + 1;
-    if (n < kMinfsDirect) {
-        *bno_out = inode->dnum[n];
-        return ZX_OK;
-    }
-
-    n -= kMinfsDirect;
-    uint32_t i = n / kMinfsDirectPerIndirect; // indirect index
-    uint32_t j = n % kMinfsDirectPerIndirect; // direct index
-
-    if (i < kMinfsIndirect) {
-        blk_t ibno;
-        if ((ibno = inode->inum[i]) == 0) {
-            *bno_out = 0;
-            *next_n = kMinfsDirect + (i + 1) * kMinfsDirectPerIndirect;
-            return ZX_OK;
-        }
-
-        if (cached_indirect_ != ibno) {
-            zx_status_t status;
-            if ((status = fs_->ReadDat(ibno, indirect_cache_)) != ZX_OK) {
-                return status;
-            }
-            cached_indirect_ = ibno;
-        }
-
-        uint32_t* ientry = reinterpret_cast<uint32_t*>(indirect_cache_);
-        *bno_out = ientry[j];
-        return ZX_OK;
-    }
-
-    n -= kMinfsIndirect * kMinfsDirectPerIndirect;
-    i = n / (kMinfsDirectPerDindirect); // doubly indirect index
-    n -= (i * kMinfsDirectPerDindirect);
-    j = n / kMinfsDirectPerIndirect; // indirect index
-    uint32_t k = n % kMinfsDirectPerIndirect; // direct index
-
-    if (i < kMinfsDoublyIndirect) {
-        blk_t dibno;
-        if ((dibno = inode->dinum[i]) == 0) {
-            *bno_out = 0;
-            *next_n = kMinfsDirect + kMinfsIndirect * kMinfsDirectPerIndirect +
-                    (i + 1) * kMinfsDirectPerDindirect;
-            return ZX_OK;
-        }
-
-        if (cached_doubly_indirect_ != dibno) {
-            zx_status_t status;
-            if ((status = fs_->ReadDat(dibno, doubly_indirect_cache_)) != ZX_OK) {
-                return status;
-            }
-            cached_doubly_indirect_ = dibno;
-        }
-
-        uint32_t* dientry = reinterpret_cast<uint32_t*>(doubly_indirect_cache_);
-        blk_t ibno;
-        if ((ibno = dientry[j]) == 0) {
-            *bno_out = 0;
-            *next_n = kMinfsDirect + kMinfsIndirect * kMinfsDirectPerIndirect +
-                    (i * kMinfsDirectPerDindirect) + (j + 1) * kMinfsDirectPerIndirect;
-            return ZX_OK;
-        }
-
-        if (cached_indirect_ != ibno) {
-            zx_status_t status;
-            if ((status = fs_->ReadDat(ibno, indirect_cache_)) != ZX_OK) {
-                return status;
-            }
-            cached_indirect_ = ibno;
-        }
-
-        uint32_t* ientry = reinterpret_cast<uint32_t*>(indirect_cache_);
-        *bno_out = ientry[k];
-        return ZX_OK;
-    }
-
-    return ZX_ERR_OUT_OF_RANGE;
-}
-
 zx_status_t MinfsChecker::CheckDirectory(Inode* inode, ino_t ino,
                                          ino_t parent, uint32_t flags) {
     unsigned eno = 0;
@@ -273,6 +188,152 @@ zx_status_t MinfsChecker::CheckDirectory(Inode* inode, ino_t ino,
     return ZX_OK;
 }
 
+// Checks that the index of a directory, if it is up to date, holds every dirent of the
+// directory exactly once, in the right bucket.
+zx_status_t MinfsChecker::CheckDirIndex(Inode* inode, ino_t ino) {
+    zx_status_t status;
+    fbl::RefPtr<VnodeMinfs> dir;
+    fbl::RefPtr<VnodeMinfs> index;
+    if ((status = VnodeMinfs::Recreate(fs_.get(), ino, &dir)) != ZX_OK) {
+        return status;
+    } else if ((status = VnodeMinfs::Recreate(fs_.get(), inode->dir_index, &index)) != ZX_OK) {
+        return status;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<DirIndexHeader> header(new (&ac) DirIndexHeader);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    fbl::unique_ptr<DirIndexBucket> bucket(new (&ac) DirIndexBucket);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if ((status = index->ReadExactInternal(header.get(), kMinfsBlockSize, 0)) != ZX_OK) {
+        FS_TRACE_ERROR("check: ino#%u: could not read directory index\n", ino);
+        return status;
+    }
+
+    if ((header->magic != kMinfsDirIndexMagic) || (header->seq_num != inode->seq_num)) {
+        // Minfs rebuilds the index the next time the directory is modified.
+        FS_TRACE_WARN("check: ino#%u: directory index is out of date\n", ino);
+        return ZX_OK;
+    }
+    if ((header->depth > kMinfsDirIndexMaxDepth) || (header->bucket_count == 0) ||
+        (header->bucket_count > (1u << header->depth)) ||
+        (index->GetInode()->size < (header->bucket_count + 1) * kMinfsBlockSize)) {
+        FS_TRACE_WARN("check: ino#%u: bad directory index header\n", ino);
+        conforming_ = false;
+        return ZX_OK;
+    }
+
+    // Each bucket of local depth d must be reached from exactly the slots which
+    // share the low d bits of the first of them.
+    const uint32_t slots = 1u << header->depth;
+    fbl::Array<uint32_t> first_slot(new (&ac) uint32_t[header->bucket_count + 1],
+                                    header->bucket_count + 1);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    fbl::Array<uint32_t> slot_count(new (&ac) uint32_t[header->bucket_count + 1],
+                                    header->bucket_count + 1);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    memset(slot_count.get(), 0, (header->bucket_count + 1) * sizeof(uint32_t));
+    for (uint32_t slot = 0; slot < slots; slot++) {
+        blk_t b = header->buckets[slot];
+        if ((b == 0) || (b > header->bucket_count)) {
+            FS_TRACE_WARN("check: ino#%u: directory index slot %u: bad bucket %u\n", ino, slot, b);
+            conforming_ = false;
+            return ZX_OK;
+        }
+        if (slot_count[b]++ == 0) {
+            first_slot[b] = slot;
+        }
+    }
+
+    // Dirents are 4-byte aligned.
+    RawBitmap indexed;
+    if ((status = indexed.Reset(kMinfsMaxDirectorySize / 4)) != ZX_OK) {
+        return status;
+    }
+
+    uint32_t entry_count = 0;
+    for (blk_t b = 1; b <= header->bucket_count; b++) {
+        if ((status = index->ReadExactInternal(bucket.get(), kMinfsBlockSize,
+                                               b * kMinfsBlockSize)) != ZX_OK) {
+            FS_TRACE_ERROR("check: ino#%u: could not read directory index bucket %u\n", ino, b);
+            return status;
+        }
+        if ((bucket->depth > header->depth) || (bucket->count > kMinfsDirIndexBucketEntries) ||
+            (slot_count[b] != (1u << (header->depth - bucket->depth)))) {
+            FS_TRACE_WARN("check: ino#%u: directory index bucket %u: bad depth or count\n",
+                          ino, b);
+            conforming_ = false;
+            continue;
+        }
+        const uint32_t mask = (1u << bucket->depth) - 1;
+        for (uint32_t slot = 0; slot < slots; slot++) {
+            if (((slot & mask) == (first_slot[b] & mask)) != (header->buckets[slot] == b)) {
+                FS_TRACE_WARN("check: ino#%u: directory index slot %u: wrong bucket\n", ino,
+                              slot);
+                conforming_ = false;
+            }
+        }
+
+        for (uint32_t i = 0; i < bucket->count; i++) {
+            const DirIndexEntry& entry = bucket->entries[i];
+            uint32_t record[DirentSize(NAME_MAX) / sizeof(uint32_t)];
+            Dirent* de = reinterpret_cast<Dirent*>(record);
+            size_t actual;
+            if ((entry.hash & mask) != (first_slot[b] & mask) ||
+                (entry.off % 4) || (entry.off + MINFS_DIRENT_SIZE >= kMinfsMaxDirectorySize)) {
+                FS_TRACE_WARN("check: ino#%u: directory index bucket %u: bad entry %u\n", ino,
+                              b, i);
+                conforming_ = false;
+                continue;
+            }
+            status = dir->ReadInternal(record, sizeof(record), entry.off, &actual);
+            if ((status != ZX_OK) || (actual < MINFS_DIRENT_SIZE) || (de->ino == 0) ||
+                (actual < DirentSize(de->namelen)) ||
+                (DirIndexHash(de->name, de->namelen) != entry.hash)) {
+                FS_TRACE_WARN("check: ino#%u: directory index: no dirent at %u\n", ino,
+                              entry.off);
+                conforming_ = false;
+                continue;
+            }
+            if (indexed.Get(entry.off / 4, entry.off / 4 + 1)) {
+                FS_TRACE_WARN("check: ino#%u: directory index: dirent at %u indexed twice\n",
+                              ino, entry.off);
+                conforming_ = false;
+            }
+            indexed.Set(entry.off / 4, entry.off / 4 + 1);
+            entry_count++;
+        }
+    }
+
+    // Every entry names a distinct dirent, so if there are as many entries as
+    // dirents, every dirent is indexed.
+    if ((entry_count != header->entry_count) || (entry_count != inode->dirent_count)) {
+        FS_TRACE_WARN("check: ino#%u: directory index holds %u entries (%u recorded), "
+                      "directory %u\n", ino, entry_count, header->entry_count,
+                      inode->dirent_count);
+        conforming_ = false;
+    }
+
+    uint32_t data[MINFS_DIRENT_SIZE];
+    Dirent* de = reinterpret_cast<Dirent*>(data);
+    size_t actual;
+    status = dir->ReadInternal(data, MINFS_DIRENT_SIZE, header->last_off, &actual);
+    if ((status != ZX_OK) || (actual != MINFS_DIRENT_SIZE) || !(de->reclen & kMinfsReclenLast)) {
+        FS_TRACE_WARN("check: ino#%u: directory index: last dirent is not at %u\n", ino,
+                      header->last_off);
+        conforming_ = false;
+    }
+    return ZX_OK;
+}
+
 const char* MinfsChecker::CheckDataBlock(blk_t bno) {
     if (bno == 0) {
         return "reserved bno";
@@ -291,91 +352,103 @@ const char* MinfsChecker::CheckDataBlock(blk_t bno) {
     return nullptr;
 }
 
-zx_status_t MinfsChecker::CheckFile(Inode* inode, ino_t ino) {
-    FS_TRACE_DEBUG("Direct blocks: \n");
-    for (unsigned n = 0; n < kMinfsDirect; n++) {
-        FS_TRACE_DEBUG(" %d,", inode->dnum[n]);
+void MinfsChecker::CheckExtents(const Extent* extents, uint32_t count, blk_t start, blk_t end,
+                                ino_t ino, blk_t* next_blk, uint32_t* block_count) {
+    for (uint32_t i = 0; i < count; i++) {
+        const Extent& extent = extents[i];
+        FS_TRACE_DEBUG(" [%u, +%u) @%u,", extent.start, extent.length, extent.bno);
+        if (extent.length == 0 || extent.start < start || extent.start >= end ||
+            extent.length > end - extent.start) {
+            FS_TRACE_WARN("check: ino#%u: extent [%u, +%u) out of range\n", ino, extent.start,
+                          extent.length);
+            conforming_ = false;
+            continue;
+        }
+        if (extent.start < *next_blk) {
+            FS_TRACE_WARN("check: ino#%u: extent [%u, +%u) out of order\n", ino, extent.start,
+                          extent.length);
+            conforming_ = false;
+        }
+        for (blk_t n = 0; n < extent.length; n++) {
+            const char* msg;
+            if ((msg = CheckDataBlock(extent.bno + n)) != nullptr) {
+                FS_TRACE_WARN("check: ino#%u: block %u(@%u): %s\n", ino, extent.start + n,
+                              extent.bno + n, msg);
+                conforming_ = false;
+            }
+            (*block_count)++;
+        }
+        *next_blk = extent.start + extent.length;
     }
-    FS_TRACE_DEBUG(" ...\n");
+}
 
+zx_status_t MinfsChecker::CheckFile(Inode* inode, ino_t ino) {
+    // The block after the last block mapped, which would be the next allocated if we expand
+    // the file size by a single block.
+    blk_t next_blk = 0;
     uint32_t block_count = 0;
+    const blk_t kMaxBlock = static_cast<blk_t>(kMinfsMaxFileBlock);
 
-    // count and sanity-check indirect blocks
-    for (unsigned n = 0; n < kMinfsIndirect; n++) {
-        if (inode->inum[n]) {
-            const char* msg;
-            if ((msg = CheckDataBlock(inode->inum[n])) != nullptr) {
-                FS_TRACE_WARN("check: ino#%u: indirect block %u(@%u): %s\n",
-                     ino, n, inode->inum[n], msg);
+    FS_TRACE_DEBUG("Extents: \n");
+    if (inode->extent_depth == 0) {
+        if (inode->extent_count > kMinfsInlineExtents) {
+            FS_TRACE_ERROR("check: ino#%u: %u extents held inline\n", ino, inode->extent_count);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        CheckExtents(inode->extents, inode->extent_count, 0, kMaxBlock, ino, &next_blk,
+                     &block_count);
+    } else {
+        if (inode->extent_depth != 1 || inode->extent_count == 0 ||
+            inode->extent_count > kMinfsExtentRefs) {
+            FS_TRACE_ERROR("check: ino#%u: bad extent depth %u with %u extent blocks\n", ino,
+                           inode->extent_depth, inode->extent_count);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        if (inode->extent_refs[0].start != 0) {
+            FS_TRACE_WARN("check: ino#%u: first extent block starts at %u\n", ino,
+                          inode->extent_refs[0].start);
+            conforming_ = false;
+        }
+
+        for (uint32_t ref = 0; ref < inode->extent_count; ref++) {
+            const ExtentRef& extent_ref = inode->extent_refs[ref];
+            blk_t end = (ref + 1 < inode->extent_count) ? inode->extent_refs[ref + 1].start
+                                                        : kMaxBlock;
+            if (end <= extent_ref.start) {
+                FS_TRACE_WARN("check: ino#%u: extent block %u out of order\n", ino, ref);
                 conforming_ = false;
             }
-            block_count++;
-        }
-    }
 
-    // count and sanity-check doubly indirect blocks
-    for (unsigned n = 0; n < kMinfsDoublyIndirect; n++) {
-        if (inode->dinum[n]) {
             const char* msg;
-            if ((msg = CheckDataBlock(inode->dinum[n])) != nullptr) {
-                FS_TRACE_WARN("check: ino#%u: doubly indirect block %u(@%u): %s\n",
-                     ino, n, inode->dinum[n], msg);
+            if ((msg = CheckDataBlock(extent_ref.bno)) != nullptr) {
+                FS_TRACE_WARN("check: ino#%u: extent block %u(@%u): %s\n", ino, ref,
+                              extent_ref.bno, msg);
                 conforming_ = false;
+                continue;
             }
             block_count++;
 
-            char data[kMinfsBlockSize];
+            ExtentBlock block;
             zx_status_t status;
-            if ((status = fs_->ReadDat(inode->dinum[n], data)) != ZX_OK) {
+            if ((status = fs_->ReadDat(extent_ref.bno, &block)) != ZX_OK) {
                 return status;
             }
-            uint32_t* entry = reinterpret_cast<uint32_t*>(data);
-
-            for (unsigned m = 0; m < kMinfsDirectPerIndirect; m++) {
-                if (entry[m]) {
-                    if ((msg = CheckDataBlock(entry[m])) != nullptr) {
-                        FS_TRACE_WARN("check: ino#%u: indirect block (in dind) %u(@%u): %s\n",
-                            ino, m, entry[m], msg);
-                        conforming_ = false;
-                    }
-                    block_count++;
-                }
-            }
-        }
-    }
-
-    // count and sanity-check data blocks
-
-    // The next block which would be allocated if we expand the file size
-    // by a single block.
-    unsigned next_blk = 0;
-    cached_doubly_indirect_ = 0;
-    cached_indirect_ = 0;
-
-    blk_t n = 0;
-    while (true) {
-        zx_status_t status;
-        blk_t bno;
-        blk_t next_n;
-        if ((status = GetInodeNthBno(inode, n, &next_n, &bno)) < 0) {
-            if (status == ZX_ERR_OUT_OF_RANGE) {
-                break;
-            } else {
-                return status;
+            if (block.magic != kMinfsExtentMagic || block.count > kMinfsExtentsPerBlock) {
+                FS_TRACE_ERROR("check: ino#%u: extent block %u(@%u) is corrupt\n", ino, ref,
+                               extent_ref.bno);
+                return ZX_ERR_IO_DATA_INTEGRITY;
             }
-        }
-        assert(next_n > n);
-        if (bno) {
-            next_blk = n + 1;
-            block_count++;
-            const char* msg;
-            if ((msg = CheckDataBlock(bno)) != nullptr) {
-                FS_TRACE_WARN("check: ino#%u: block %u(@%u): %s\n", ino, n, bno, msg);
+            if (block.count == 0) {
+                FS_TRACE_WARN("check: ino#%u: extent block %u(@%u) is empty\n", ino, ref,
+                              extent_ref.bno);
                 conforming_ = false;
             }
+            CheckExtents(block.extents, block.count, extent_ref.start, end, ino, &next_blk,
+                         &block_count);
         }
-        n = next_n;
     }
+    FS_TRACE_DEBUG(" ...\n");
+
     if (next_blk) {
         unsigned max_blocks = fbl::round_up(inode->size, kMinfsBlockSize) / kMinfsBlockSize;
         if (next_blk > max_blocks) {
@@ -454,6 +527,24 @@ zx_status_t MinfsChecker::CheckInode(ino_t ino, ino_t parent, bool dot_or_dotdot
         if ((status = CheckDirectory(&inode, ino, parent, CD_RECURSE)) < 0) {
             return status;
         }
+        if (inode.dir_index != 0) {
+            Inode index;
+            if ((status = GetInode(&index, inode.dir_index)) < 0) {
+                FS_TRACE_ERROR("check: ino#%u: directory index ino#%u not readable\n", ino,
+                               inode.dir_index);
+                return status;
+            } else if (index.magic != kMinfsMagicFile) {
+                FS_TRACE_ERROR("check: ino#%u: directory index ino#%u is not a file\n", ino,
+                               inode.dir_index);
+                return ZX_ERR_IO_DATA_INTEGRITY;
+            }
+            if ((status = CheckInode(inode.dir_index, ino, false)) < 0) {
+                return status;
+            }
+            if ((status = CheckDirIndex(&inode, ino)) < 0) {
+                return status;
+            }
+        }
     } else {
         FS_TRACE_DEBUG("ino#%u: FILE blks=%u links=%u size=%u\n", ino, inode.block_count, inode.link_count,
                 inode.size);
@@ -582,22 +673,15 @@ zx_status_t MinfsChecker::CheckAllocatedCounts() const {
 }
 
 zx_status_t MinfsChecker::CheckJournal() const {
-    char data[kMinfsBlockSize];
-    blk_t journal_block;
-#ifdef __Fuchsia__
-    journal_block = fs_->Info().journal_start_block;
-#else
-    journal_block = fs_->offsets_.JournalStartBlock();
-#endif
-
-    if (fs_->bc_->Readblk(journal_block, data) < 0) {
-        FS_TRACE_ERROR("minfs: could not read journal block\n");
-        return ZX_ERR_IO;
+    size_t entries;
+    zx_status_t status = CountJournalEntries(fs_->bc_.get(), fs_->Info(), &entries);
+    if (status != ZX_OK) {
+        return status;
     }
 
-    const JournalInfo* journal_info = reinterpret_cast<const JournalInfo*>(data);
-    if (journal_info->magic != kJournalMagic) {
-        FS_TRACE_ERROR("minfs: invalid journal magic\n");
+    // The journal was replayed before checking, which should have left it empty.
+    if (entries > 0) {
+        FS_TRACE_ERROR("minfs: journal holds %zu entries which were not replayed\n", entries);
         return ZX_ERR_BAD_STATE;
     }
 
@@ -611,9 +695,6 @@ zx_status_t MinfsChecker::Init(fbl::unique_ptr<Bcache> bc, const Superblock* inf
     links_.reset(new int32_t[info->inode_count]{0}, info->inode_count);
     links_[0] = -1;
 
-    cached_doubly_indirect_ = 0;
-    cached_indirect_ = 0;
-
     zx_status_t status;
     if ((status = checked_inodes_.Reset(info->inode_count)) != ZX_OK) {
         FS_TRACE_ERROR("MinfsChecker::Init Failed to reset checked inodes: %d\n", status);
@@ -624,7 +705,7 @@ zx_status_t MinfsChecker::Init(fbl::unique_ptr<Bcache> bc, const Superblock* inf
         return status;
     }
     fbl::unique_ptr<Minfs> fs;
-    if ((status = Minfs::Create(std::move(bc), info, &fs)) != ZX_OK) {
+    if ((status = Minfs::Create(std::move(bc), info, {}, &fs)) != ZX_OK) {
         FS_TRACE_ERROR("MinfsChecker::Create Failed to Create Minfs: %d\n", status);
         return status;
     }
@@ -636,6 +717,12 @@ zx_status_t MinfsChecker::Init(fbl::unique_ptr<Bcache> bc, const Superblock* inf
 zx_status_t Fsck(fbl::unique_ptr<Bcache> bc) {
     zx_status_t status;
 
+    // Check the filesystem as it will be mounted, with any metadata in the journal in place.
+    if ((status = ReplayJournal(bc.get())) != ZX_OK) {
+        FS_TRACE_ERROR("Fsck: could not replay journal: %d\n", status);
+        return status;
+    }
+
     char data[kMinfsBlockSize];
     if (bc->Readblk(0, data) < 0) {
         FS_TRACE_ERROR("minfs: could not read info block\n");
@@ -149,7 +149,7 @@ int emu_mount(const char* path) {
         return -1;
     }
 
-    int r = minfs::Mount(std::move(bc), &fakeFs.fake_root);
+    int r = minfs::Mount(std::move(bc), {}, &fakeFs.fake_root);
     if (r == 0) {
         fakeFs.fake_vfs.reset(fakeFs.fake_root->fs_);
     }
@@ -157,7 +157,7 @@ int emu_mount(const char* path) {
 }
 
 int emu_mount_bcache(fbl::unique_ptr<minfs::Bcache> bc) {
-    int r = minfs::Mount(std::move(bc), &fakeFs.fake_root) == ZX_OK ? 0 : -1;
+    int r = minfs::Mount(std::move(bc), {}, &fakeFs.fake_root) == ZX_OK ? 0 : -1;
     if (r == 0) {
         fakeFs.fake_vfs.reset(fakeFs.fake_root->fs_);
     }
@@ -430,6 +430,37 @@ int emu_mkdir(const char* path, mode_t mode) {
     }
 }
 
+int emu_unlink(const char* path) {
+    ZX_DEBUG_ASSERT_MSG(!host_path(path), "'emu_' functions can only operate on target paths");
+    fbl::StringPiece str(path + PREFIX_SIZE);
+    size_t len = str.length();
+    while (len > 0 && str[len - 1] == '/') {
+        len--;
+    }
+    size_t name_start = len;
+    while (name_start > 0 && str[name_start - 1] != '/') {
+        name_start--;
+    }
+
+    // Vfs::Unlink only removes an entry from the directory it is handed, so
+    // resolve the parent the same way emu_open does before unlinking.
+    fbl::RefPtr<fs::Vnode> vn_dir = fakeFs.fake_root;
+    if (name_start > 0) {
+        fbl::StringPiece parent(str.data(), name_start);
+        zx_status_t status = fakeFs.fake_vfs->Open(fakeFs.fake_root, &vn_dir, parent, &parent,
+                                                   fdio_flags_to_zxio(O_RDONLY | O_DIRECTORY), 0);
+        if (status != ZX_OK) {
+            STATUS(status);
+        }
+    }
+    zx_status_t status = fakeFs.fake_vfs->Unlink(
+        vn_dir, fbl::StringPiece(str.data() + name_start, str.length() - name_start));
+    if (name_start > 0) {
+        vn_dir->Close();
+    }
+    STATUS(status);
+}
+
 DIR* emu_opendir(const char* name) {
     ZX_DEBUG_ASSERT_MSG(!host_path(name), "'emu_' functions can only operate on target paths");
     fbl::RefPtr<fs::Vnode> vn;
@@ -40,6 +40,24 @@ public:
 
     // Allocate a new item in allocator_. Return the index of the newly allocated item.
     size_t Allocate(WriteTxn* txn);
+
+    // Like |Allocate|, but allocates the first free item at or after |goal|, if there is one.
+    size_t AllocateNear(WriteTxn* txn, size_t goal);
+
+    // Allocate up to |count| consecutive items, starting at |goal| if it is nonzero and free.
+    // Returns the number allocated, which is at least one, and the index of the first in
+    // |out_index|.
+    size_t AllocateRun(WriteTxn* txn, size_t goal, size_t count, size_t* out_index);
+
+    // Return the number of items which are still reserved.
+    size_t Reserved() const { return reserved_; }
+
+    // Move |count| of the reserved items to |*out|, which is created if it is null, so that they
+    // may be allocated through it instead.
+    void Give(size_t count, fbl::unique_ptr<AllocatorPromise>* out);
+
+    // Give |count| of the reserved items back to the allocator.
+    void Cancel(size_t count);
 private:
     friend class Allocator;
 
@@ -202,6 +220,9 @@ public:
     // Free an item from the allocator.
     void Free(WriteTxn* txn, size_t index);
 
+    // Return the number of elements which are reserved, but not yet allocated.
+    size_t GetReserved() const { return reserved_; }
+
 private:
     friend class MinfsChecker;
     friend class AllocatorPromise;
@@ -215,6 +236,16 @@ private:
     // Allocate an element and return the newly allocated index.
     size_t Allocate(WriteTxn* txn);
 
+    // Allocate the first free element at or after |goal|, if there is one, and return its index.
+    size_t AllocateNear(WriteTxn* txn, size_t goal);
+
+    // Allocate the first free element at or after |start|, wrapping around to the start of the
+    // map if there is none, and return its index.
+    size_t AllocateFrom(WriteTxn* txn, size_t start);
+
+    // Allocate up to |count| consecutive elements, as described by |AllocatorPromise::AllocateRun|.
+    size_t AllocateRun(WriteTxn* txn, size_t goal, size_t count, size_t* out_index);
+
     // Write back the allocation of the following items to disk.
     void Persist(WriteTxn* txn, size_t index, size_t count);
 
@@ -21,6 +21,9 @@ struct WriteRequest {
     size_t vmo_offset;
     size_t dev_offset;
     size_t length;
+    // File data, which is written straight to |dev_offset| rather than
+    // through the journal.
+    bool data;
 };
 
 // A transaction consisting of enqueued VMOs to be written
@@ -40,10 +43,25 @@ public:
     // Identify that a block should be written to disk at a later point in time.
     void Enqueue(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset, uint64_t nblocks);
 
+    // Identify that a block of file data should be written to disk at a later
+    // point in time. Unlike metadata, it is not journaled.
+    void EnqueueData(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset,
+                     uint64_t nblocks);
+
+    // Identify that the block |bno|, which held metadata, has been freed, so
+    // that replaying the journal must not write to it. Writing metadata to the
+    // block again cancels this.
+    void Revoke(blk_t bno);
+
     fbl::Vector<WriteRequest>& Requests() { return requests_; }
+    const fbl::Vector<blk_t>& Revoked() const { return revoked_; }
 
     size_t BlkCount() const;
 
+    // Returns the number of blocks of metadata enqueued, which are written to
+    // the journal.
+    size_t MetadataBlkCount() const;
+
 protected:
     // Activate the transaction, writing it out to disk.
     //
@@ -51,9 +69,20 @@ protected:
     // transactions should be all reading from a single in-memory buffer.
     zx_status_t Flush(zx_handle_t vmo, vmoid_t vmoid);
 
+    // Forget the enqueued requests, which have been written out to disk by
+    // other means.
+    void Clear() {
+        requests_.reset();
+        revoked_.reset();
+    }
+
 private:
+    void EnqueueRequest(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset,
+                        uint64_t nblocks, bool data);
+
     Bcache* bc_;
     fbl::Vector<WriteRequest> requests_;
+    fbl::Vector<blk_t> revoked_;
 };
 
 #else
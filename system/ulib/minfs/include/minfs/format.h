@@ -32,7 +32,11 @@ typedef uint32_t ino_t;
 
 constexpr uint64_t kMinfsMagic0         = (0x002153466e694d21ULL);
 constexpr uint64_t kMinfsMagic1         = (0x385000d3d3d3d304ULL);
-constexpr uint32_t kMinfsVersion        = 0x00000007;
+// Bumped only by changes which drivers of the previous revision could not
+// read. Directory indexes are not such a change: they are validated before
+// use, and a driver which does not know of them leaves them stale.
+// Revision 9 maps file data with extents; revision 0xa adds the journal.
+constexpr uint32_t kMinfsVersion        = 0x0000000a;
 
 constexpr ino_t    kMinfsRootIno        = 1;
 constexpr uint32_t kMinfsFlagClean      = 0x00000001; // Currently unused
@@ -42,18 +46,12 @@ constexpr uint32_t kMinfsBlockBits      = (kMinfsBlockSize * 8);
 constexpr uint32_t kMinfsInodeSize      = 256;
 constexpr uint32_t kMinfsInodesPerBlock = (kMinfsBlockSize / kMinfsInodeSize);
 
-constexpr uint32_t kMinfsDirect         = 16;
-constexpr uint32_t kMinfsIndirect       = 31;
-constexpr uint32_t kMinfsDoublyIndirect = 1;
+constexpr uint32_t kMinfsInlineExtents   = 16;
+constexpr uint32_t kMinfsExtentRefs      = 24;
+constexpr uint32_t kMinfsExtentsPerBlock = 682;
 
-constexpr uint32_t kMinfsDirectPerIndirect  = (kMinfsBlockSize / sizeof(blk_t));
-constexpr uint32_t kMinfsDirectPerDindirect = kMinfsDirectPerIndirect * kMinfsDirectPerIndirect;
 // not possible to have a block at or past this one
-// due to the limitations of the inode and indirect blocks
-// constexpr uint64_t kMinfsMaxFileBlock = (kMinfsDirect +
-//                                         (kMinfsIndirect * kMinfsDirectPerIndirect)
-//                                         + (kMinfsDoublyIndirect * kMinfsDirectPerIndirect
-//                                         * kMinfsDirectPerIndirect));
+// since file sizes are held in 32 bits
 // TODO(ZX-1523): Remove this artificial cap when MinFS can safely deal
 // with files larger than 4GB.
 constexpr uint64_t kMinfsMaxFileBlock = (std::numeric_limits<uint32_t>::max() / kMinfsBlockSize)
@@ -112,8 +110,8 @@ static_assert(sizeof(Superblock) <= kMinfsBlockSize,
 //   regions must be in that order and may not overlap
 // - the abm has an entry for every block on the volume, including
 //   the info block (0), the bitmaps, etc
-// - data blocks referenced from direct and indirect block tables
-//   in inodes are also relative to (0), but it is not legal for
+// - data blocks referenced from the extents and extent references
+//   of inodes are also relative to (0), but it is not legal for
 //   a block number of less than dat_block (start of data blocks)
 //   to be used
 // - inode numbers refer to the inode in block:
@@ -129,16 +127,107 @@ constexpr size_t kMinfsMinimumSlices = 7;
 
 constexpr uint64_t kMinfsDefaultInodeCount = 32768;
 
+// Journal
+//
+// The journal begins with an info block, and the rest of it is a ring of
+// entries. Each entry holds a batch of metadata blocks bound for elsewhere on
+// disk, and is laid out as:
+// - a JournalHeader, whose target_blocks continue, if need be, into further
+//   blocks holding nothing but block numbers
+// - blocks holding the numbers of the revoked_count blocks it revokes
+// - the block_count metadata blocks, in the order of target_blocks
+// - a JournalCommit, whose checksum covers all of the above
+// Entries are numbered in sequence, so that the end of the journal is the
+// first entry from the info block's start which is incomplete, or whose
+// sequence number is not the next one.
+//
+// Replaying an entry copies its metadata blocks to their targets, except for
+// those revoked by the same or a later entry. Data blocks which held metadata
+// are revoked when they are freed, so that they may be reused for file data,
+// which is written in place, without an old entry clobbering it.
+
 struct JournalInfo {
     uint64_t magic;
+    uint64_t start;         // offset of the first entry, from the block after this one
+    uint64_t sequence;      // sequence number of that entry
     uint64_t reserved0;
     uint64_t reserved1;
-    uint64_t reserved2;
-    uint64_t reserved3;
 };
 
 static_assert(sizeof(JournalInfo) <= kMinfsBlockSize, "Journal info size is too large");
 
+constexpr uint64_t kJournalEntryMagic  = (0x6d696e6a656e7472ULL);
+constexpr uint64_t kJournalCommitMagic = (0x6d696e6a636f6d6dULL);
+
+struct JournalHeader {
+    uint64_t magic;                 // kJournalEntryMagic
+    uint64_t sequence;
+    uint32_t block_count;           // metadata blocks held by the entry
+    uint32_t revoked_count;         // blocks revoked by the entry
+    uint64_t reserved;
+    blk_t target_blocks[kJournalEntryHeaderMaxBlocks];
+};
+
+static_assert(sizeof(JournalHeader) == kMinfsBlockSize, "minfs journal header size is wrong");
+
+struct JournalCommit {
+    uint64_t magic;                 // kJournalCommitMagic
+    uint64_t sequence;
+    uint32_t checksum;              // crc32 of the blocks of the entry before this one
+    uint32_t reserved;
+};
+
+static_assert(sizeof(JournalCommit) <= kMinfsBlockSize, "minfs journal commit size is wrong");
+
+// Extents
+//
+// The data blocks of a file (or directory) are mapped by extents, each of
+// which maps a run of consecutive blocks of the file to a run of consecutive
+// data blocks. Extents are kept sorted by the first block of the file they
+// map, and never overlap; blocks of the file which no extent maps are holes.
+//
+// With an extent_depth of 0, the extents are held in the inode itself, which
+// has room for kMinfsInlineExtents of them. With an extent_depth of 1, the
+// inode instead refers to up to kMinfsExtentRefs extent blocks, each holding
+// up to kMinfsExtentsPerBlock extents. Each reference records the first block
+// of the file its extent block may map; the first is always 0, and an extent
+// block maps nothing before the block recorded in the reference following it.
+// A file thus maps at most kMinfsExtentRefs * kMinfsExtentsPerBlock (16368)
+// extents, beyond which new blocks which need an extent of their own cannot be
+// mapped: writing them fails with ZX_ERR_NO_SPACE, however many blocks the
+// volume has free. New blocks are allocated next to the block before them
+// where possible, so files written in order seldom come near this, but a file
+// in which every block needs its own extent (every other block of a sparse
+// file, or any file on a badly fragmented volume) is limited to 16368 blocks,
+// 128MB. There is no further level of extent blocks to go past this.
+//
+// Extent blocks are data blocks, and count towards the block_count of the
+// inode referring to them.
+
+struct Extent {
+    blk_t start;                    // first block of the file mapped
+    blk_t bno;                      // data block it is mapped to
+    blk_t length;                   // number of blocks mapped
+};
+
+struct ExtentRef {
+    blk_t start;                    // first block of the file the extent block maps
+    blk_t bno;                      // the extent block
+};
+
+constexpr uint32_t kMinfsExtentMagic = 0x78744521;
+
+struct ExtentBlock {
+    uint32_t magic;                 // kMinfsExtentMagic
+    uint32_t count;                 // entries of extents in use
+    Extent extents[kMinfsExtentsPerBlock];
+};
+
+static_assert(sizeof(ExtentBlock) == kMinfsBlockSize,
+              "minfs extent block size is wrong");
+static_assert(kMinfsInlineExtents * sizeof(Extent) == kMinfsExtentRefs * sizeof(ExtentRef),
+              "minfs inline extents and extent references should fill the same space");
+
 struct Inode {
     uint32_t magic;
     uint32_t size;
@@ -151,10 +240,13 @@ struct Inode {
     uint32_t dirent_count;          // for directories
     ino_t last_inode;               // index to the previous unlinked inode
     ino_t next_inode;               // index to the next unlinked inode
-    uint32_t rsvd[3];
-    blk_t dnum[kMinfsDirect];    // direct blocks
-    blk_t inum[kMinfsIndirect];  // indirect blocks
-    blk_t dinum[kMinfsDoublyIndirect]; // doubly indirect blocks
+    ino_t dir_index;                // for directories: inode of the name index, if any
+    uint32_t extent_depth;          // 0: extents held inline, 1: in extent blocks
+    uint32_t extent_count;          // entries of extents / extent_refs in use
+    union {
+        Extent extents[kMinfsInlineExtents];
+        ExtentRef extent_refs[kMinfsExtentRefs];
+    };
 };
 
 static_assert(sizeof(Inode) == kMinfsInodeSize,
@@ -180,7 +272,7 @@ constexpr uint8_t kMinfsMaxNameSize       = 255;
 // The 'dirent->reclen' field may be larger after coalescing
 // entries.
 constexpr uint32_t kMinfsMaxDirentSize    = DirentSize(kMinfsMaxNameSize);
-constexpr uint32_t kMinfsMaxDirectorySize = (((1 << 20) - 1) & (~3));
+constexpr uint32_t kMinfsMaxDirectorySize = (((1 << 22) - 1) & (~3));
 
 static_assert(kMinfsMaxNameSize >= NAME_MAX,
               "MinFS names must be large enough to hold NAME_MAX characters");
@@ -205,6 +297,69 @@ static_assert(kMinfsMaxDirectorySize <= kMinfsReclenMask,
 //   record starts. If the MAX_DIR_SIZE is increased, this 'last' record will
 //   also increase in size.
 
+// Large directories are given a hashed index of their names, held in an inode
+// of its own which is referenced only by the directory's |dir_index|.
+//
+// The index is an extendible hash table.  Block 0 of the index holds a
+// DirIndexHeader, whose table maps the low |depth| bits of a name's hash to the
+// bucket holding it.  Every other block is a DirIndexBucket, whose entries
+// give the hash and the directory offset of each dirent whose hash shares the
+// low |depth| bits of the bucket.  A full bucket is split in two, doubling
+// the table if need be.
+//
+// The index is only trusted while its |seq_num| matches the directory's;
+// otherwise the directory is scanned linearly, as if it had no index, and the
+// index is rebuilt when the directory is next modified.
+constexpr uint64_t kMinfsDirIndexMagic        = (0x78646e4972694421ULL);
+// Directories are indexed once they hold this many entries.
+constexpr uint32_t kMinfsDirIndexMinEntries   = 256;
+constexpr uint32_t kMinfsDirIndexMaxDepth     = 10;
+constexpr uint32_t kMinfsDirIndexMaxBuckets   = (1 << kMinfsDirIndexMaxDepth);
+// Inserting one entry may split one bucket, which adds a block to the index,
+// and possibly an extent block to map it.
+constexpr uint32_t kMinfsDirIndexReserveBlocks = 2;
+
+struct DirIndexHeader {
+    uint64_t magic;
+    uint32_t seq_num;               // seq_num of the directory when last updated
+    uint32_t depth;                 // the table has (1 << depth) slots
+    uint32_t bucket_count;          // buckets are in blocks [1, bucket_count]
+    uint32_t entry_count;           // number of entries in all buckets
+    uint32_t last_off;              // offset of the directory's last dirent
+    uint32_t unmerged_count;        // dirents freed without merging a free dirent before them
+    blk_t buckets[(kMinfsBlockSize - 32) / sizeof(blk_t)];
+};
+
+static_assert(sizeof(DirIndexHeader) == kMinfsBlockSize,
+              "minfs directory index header size is wrong");
+static_assert(kMinfsDirIndexMaxBuckets <= sizeof(DirIndexHeader::buckets) / sizeof(blk_t),
+              "minfs directory index table is too small");
+
+struct DirIndexEntry {
+    uint32_t hash;
+    uint32_t off;                   // offset of the dirent in the directory
+};
+
+constexpr uint32_t kMinfsDirIndexBucketEntries = (kMinfsBlockSize - 8) / sizeof(DirIndexEntry);
+
+struct DirIndexBucket {
+    uint32_t depth;                 // number of low hash bits shared by the entries
+    uint32_t count;
+    DirIndexEntry entries[kMinfsDirIndexBucketEntries];
+};
+
+static_assert(sizeof(DirIndexBucket) == kMinfsBlockSize,
+              "minfs directory index bucket size is wrong");
+
+// FNV-1a hash of a name, as stored in the directory index.
+constexpr uint32_t DirIndexHash(const char* name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ static_cast<uint8_t>(name[i])) * 16777619u;
+    }
+    return hash;
+}
+
 // blocksize   8K    16K    32K
 // 16 dir =  128K   256K   512K
 // 32 ind =  512M  1024M  2048M
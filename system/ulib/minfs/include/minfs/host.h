@@ -51,6 +51,7 @@ int emu_fstat(int fd, struct stat* s);
 int emu_stat(const char* fn, struct stat* s);
 
 int emu_mkdir(const char* path, mode_t mode);
+int emu_unlink(const char* path);
 DIR* emu_opendir(const char* name);
 struct dirent* emu_readdir(DIR* dirp);
 void emu_rewinddir(DIR* dirp);
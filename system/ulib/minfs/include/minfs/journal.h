@@ -0,0 +1,121 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file describes the journal, through which minfs writes its metadata.
+
+#pragma once
+
+#ifdef __Fuchsia__
+#include <fbl/vector.h>
+#include <lib/fzl/owned-vmo-mapper.h>
+#endif
+
+#include <fbl/macros.h>
+#include <fbl/unique_ptr.h>
+
+#include <minfs/bcache.h>
+#include <minfs/format.h>
+
+namespace minfs {
+
+// Returns in |out_start| the first block of the journal of the filesystem on
+// |bc| described by |info|, which holds the journal info, and in |out_count|
+// the number of blocks of the journal, including that one.
+void GetJournalBlocks(const Bcache& bc, const Superblock& info, blk_t* out_start,
+                      blk_t* out_count);
+
+// Replays any entries of the journal of the filesystem on |bc| which may not yet
+// have been written to their targets, and empties the journal.
+//
+// Entries may hold any metadata, including the superblock, so this must be done
+// before any of the filesystem is read.
+zx_status_t ReplayJournal(Bcache* bc);
+
+// Returns in |out_entries| the number of entries of the journal of the filesystem
+// on |bc| described by |info| which are waiting to be replayed.
+zx_status_t CountJournalEntries(Bcache* bc, const Superblock& info, size_t* out_entries);
+
+#ifdef __Fuchsia__
+
+class TransactionLimits;
+class WritebackWork;
+
+// Writes batches of WritebackWork out through the journal.
+//
+// Each batch is committed as a single entry. Any file data in the batch is
+// written and flushed to disk first, so that no committed entry refers to data
+// which never reached the disk. The entry is then written and flushed, after
+// which the metadata is written to its targets. Those writes are only known to
+// have reached the disk after the next flush, so entries stay in the journal
+// until it fills up, when it is emptied by a checkpoint: a flush, followed by
+// an update of the journal info.
+class Journal {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(Journal);
+
+    // Creates a journal of the |count| blocks from |start|, which must have been
+    // replayed, able to hold entries as large as |limits| allows.
+    static zx_status_t Create(Bcache* bc, blk_t start, blk_t count,
+                              const TransactionLimits& limits, fbl::unique_ptr<Journal>* out);
+    ~Journal();
+
+    // Returns true if a single entry can hold |blocks| blocks of metadata, and
+    // revoke |revoked| blocks.
+    bool EntryFits(size_t blocks, size_t revoked) const;
+
+    // Writes out |works|, whose blocks have been copied to |buffer|, which is
+    // attached as |vmoid|, committing their metadata as a single entry.
+    //
+    // Once this has failed, the journal writes nothing more, and each later call
+    // fails as well.
+    zx_status_t Commit(const fbl::Vector<fbl::unique_ptr<WritebackWork>>& works,
+                       const fzl::OwnedVmoMapper& buffer, vmoid_t vmoid);
+
+    // Waits for every entry to reach its targets, then empties the journal.
+    zx_status_t Checkpoint();
+
+private:
+    Journal(Bcache* bc, blk_t start, blk_t count, blk_t header_blocks, blk_t revocation_blocks)
+        : bc_(bc), start_block_(start), capacity_(count - 1), header_blocks_(header_blocks),
+          revocation_blocks_(revocation_blocks) {}
+
+    // Returns a pointer to block |index| of |control_|.
+    void* ControlBlock(size_t index) const;
+
+    // Enqueues a write of |length| blocks of the VMO attached as |vmoid|, from
+    // block |vmo_offset|, to the journal at entry offset |*pos|, which is
+    // advanced past them.
+    void EnqueueEntryWrite(fbl::Vector<block_fifo_request_t>* requests, vmoid_t vmoid,
+                           uint64_t vmo_offset, uint64_t length, size_t* pos) const;
+
+    // Writes |info| to the journal info block.
+    zx_status_t WriteInfo(const JournalInfo& info);
+
+    // Records the failure of a write to the journal, with |status|.
+    zx_status_t Fail(zx_status_t status);
+
+    Bcache* const bc_;
+    const blk_t start_block_;
+    // The number of blocks of the ring of entries, following the info block.
+    const size_t capacity_;
+    // The number of blocks of targets and revocations an entry may have.
+    const blk_t header_blocks_;
+    const blk_t revocation_blocks_;
+
+    // Holds the journal info, followed by the header, revocation and commit
+    // blocks of the entry being written.
+    fzl::OwnedVmoMapper control_;
+    vmoid_t control_vmoid_ = VMOID_INVALID;
+
+    // The entries still in the journal, which run for |length_| blocks from
+    // the offset |start_|, and the sequence number of the next.
+    size_t start_ = 0;
+    size_t length_ = 0;
+    uint64_t sequence_ = 0;
+    bool failed_ = false;
+};
+
+#endif // __Fuchsia__
+
+} // namespace minfs
@@ -28,9 +28,14 @@ struct MountOptions {
     bool readonly;
     bool metrics;
     bool verbose;
+    // Write metadata through the journal.
+    bool journal = false;
 
     // Number of slices to preallocate for data when the filesystem is created.
     uint32_t fvm_data_slices = 1;
+
+    // Number of threads dispatching requests to the mounted filesystem.
+    uint32_t dispatch_threads = 1;
 };
 
 // Format the partition backed by |bc| as MinFS.
@@ -12,8 +12,8 @@ namespace minfs {
 // Calculates and returns the maximum number of block bitmap blocks, based on |info_|.
 blk_t GetBlockBitmapBlocks(const Superblock& info);
 
-// Calculates the required number of blocks into |num_req_blocks| for a write at the given |offset|
-// and |length|.
+// Calculates the required number of data blocks into |num_req_blocks| for a write at the given
+// |offset| and |length|, not counting any extent blocks needed to map them.
 zx_status_t GetRequiredBlockCount(size_t offset, size_t length, uint32_t* num_req_blocks);
 
 // Calculates and tracks the number of Minfs metadata / data blocks that can be modified within one
@@ -24,17 +24,13 @@ public:
     TransactionLimits(const Superblock& info);
 
     // Returns the maximum number of metadata blocks that we expect to be modified in the data
-    // section within one transaction. For data vnodes, based on a max write size of 64kb, this is
-    // currently expected to be 3 indirect blocks (would be 4 with the introduction of more doubly
-    // indirect blocks). For directories, with a max dirent size of 268b, this is expected to be 5
-    // blocks.
+    // section within one transaction. For directories, with a max dirent size of 268b, this is
+    // expected to be 2 blocks of dirents + |kMaxExtentBlocks| extent blocks = 6 blocks.
     blk_t GetMaximumMetaDataBlocks() const { return max_meta_data_blocks_; }
 
-    // Returns the maximum number of data blocks (including indirects) that we expect to be
+    // Returns the maximum number of data blocks (including extent blocks) that we expect to be
     // modified within one transaction. Based on a max write size of 64kb, this is currently
-    // expected to be 9 direct blocks + 3 indirect blocks = 11 total blocks. With the addition of
-    // more doubly indirect blocks, this would increase to 4 indirect blocks for a total of 12
-    // blocks.
+    // expected to be 9 data blocks + |kMaxExtentBlocks| extent blocks = 13 total blocks.
     blk_t GetMaximumDataBlocks() const { return max_data_blocks_; }
 
     // Returns the maximum number of data blocks that can be included in a journal entry,
@@ -44,6 +40,14 @@ public:
     // Returns the total number of blocks required for the maximum size journal entry.
     blk_t GetMaximumEntryBlocks() const { return max_entry_blocks_; }
 
+    // Returns the number of header blocks needed to list the targets of the maximum size journal
+    // entry.
+    blk_t GetMaximumEntryHeaderBlocks() const { return max_entry_header_blocks_; }
+
+    // Returns the number of blocks needed to list the blocks revoked by the maximum size journal
+    // entry.
+    blk_t GetMaximumEntryRevocationBlocks() const { return max_entry_revocation_blocks_; }
+
     // Returns the minimum number of blocks required to create a journal guaranteed large enough to
     // hold at least a single journal entry of maximum size.
     blk_t GetMinimumJournalBlocks() const { return min_journal_blocks_; }
@@ -67,6 +71,17 @@ public:
     // (In the case of Create, the parent directory and the child inode will be modified.)
     static constexpr blk_t kMaxInodeTableBlocks = 2;
 
+    // Maximum number of directory index blocks that can be modified within one transaction.
+    // (In the case of Rename, the index of the source directory loses an entry, rewriting its
+    // header and one bucket, and that of the destination gains one, rewriting its header and
+    // splitting one bucket in two.)
+    static constexpr blk_t kMaxDirIndexBlocks = 5;
+
+    // Maximum number of extent blocks that can be modified within one transaction.
+    // (The blocks of one write are mapped by at most two full extent blocks, each of which may be
+    // split in two, or have extents moved to one of its neighbours.)
+    static constexpr blk_t kMaxExtentBlocks = 4;
+
     // The largest amount of data that Write() should able to process at once. This is currently
     // constrainted by external factors to (1 << 13), but with the switch to FIDL we expect
     // incoming requests to be NO MORE than (1 << 16). Even so, we should update Write() to handle
@@ -93,6 +108,8 @@ private:
     blk_t max_data_blocks_;
     blk_t max_entry_data_blocks_;
     blk_t max_entry_blocks_;
+    blk_t max_entry_header_blocks_;
+    blk_t max_entry_revocation_blocks_;
     blk_t min_journal_blocks_;
     blk_t rec_journal_blocks_;
 };
@@ -26,6 +26,10 @@
 #include <minfs/block-txn.h>
 #include <minfs/format.h>
 
+#ifdef __Fuchsia__
+#include <minfs/journal.h>
+#endif
+
 #include <utility>
 
 namespace minfs {
@@ -55,6 +59,14 @@ public:
     // consumed.
     size_t Complete(zx_handle_t vmo, vmoid_t vmoid);
 
+    // Signals the completion of the enqueued work, which has been written out
+    // through the journal with |status|, and resets the WritebackWork to its
+    // initial state.
+    //
+    // Returns the number of blocks of the writeback buffer that have been
+    // consumed.
+    size_t Complete(zx_status_t status);
+
     // Adds a closure to the WritebackWork, such that it will be signalled
     // when the WritebackWork is flushed to disk.
     // If no closure is set, nothing will get signalled.
@@ -103,6 +115,33 @@ public:
         return block_promise_->Allocate(work_.get());
     }
 
+    size_t AllocateBlockNear(size_t goal) {
+        ZX_DEBUG_ASSERT(block_promise_ != nullptr);
+        return block_promise_->AllocateNear(work_.get(), goal);
+    }
+
+    size_t AllocateBlockRun(size_t goal, size_t count, size_t* out_start) {
+        ZX_DEBUG_ASSERT(block_promise_ != nullptr);
+        return block_promise_->AllocateRun(work_.get(), goal, count, out_start);
+    }
+
+    // Moves |count| of the blocks reserved for the transaction to |*out|, so that they stay
+    // reserved once it has been committed.
+    void GiveBlocks(size_t count, fbl::unique_ptr<AllocatorPromise>* out) {
+        ZX_DEBUG_ASSERT(block_promise_ != nullptr);
+        block_promise_->Give(count, out);
+    }
+
+    // Moves |count| of the blocks reserved by |promise| to the transaction.
+    void TakeBlocks(AllocatorPromise* promise, size_t count) {
+        promise->Give(count, &block_promise_);
+    }
+
+    // Returns the number of blocks still reserved for the transaction.
+    size_t BlocksReserved() const {
+        return block_promise_ == nullptr ? 0 : block_promise_->Reserved();
+    }
+
     void SetWork(fbl::unique_ptr<WritebackWork> work) {
         work_ = std::move(work);
     }
@@ -130,7 +169,12 @@ private:
 class WritebackBuffer {
 public:
     // Calls constructor, return an error if anything goes wrong.
+    //
+    // If |journal| is not null, work is written out through it, in batches of
+    // as much as fits in one journal entry. Otherwise, it is written in place,
+    // one unit at a time.
     static zx_status_t Create(Bcache* bc, fzl::OwnedVmoMapper mapper,
+                              fbl::unique_ptr<Journal> journal,
                               fbl::unique_ptr<WritebackBuffer>* out);
     ~WritebackBuffer();
 
@@ -145,7 +189,7 @@ public:
     void Enqueue(fbl::unique_ptr<WritebackWork> work) __TA_EXCLUDES(writeback_lock_);
 
 private:
-    WritebackBuffer(Bcache* bc, fzl::OwnedVmoMapper mapper);
+    WritebackBuffer(Bcache* bc, fzl::OwnedVmoMapper mapper, fbl::unique_ptr<Journal> journal);
 
     // Blocks until |blocks| blocks of data are free for the caller.
     // Returns |ZX_OK| with the lock still held in this case.
@@ -184,6 +228,8 @@ private:
     // writeback buffer.
     thrd_t writeback_thrd_;
     Bcache* bc_;
+    // Only accessed by the "writeback" thread, once it has been created.
+    fbl::unique_ptr<Journal> journal_;
     fbl::Mutex writeback_lock_;
 
     // Ensures that if multiple producers are waiting for space to write their
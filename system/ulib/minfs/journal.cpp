@@ -0,0 +1,611 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+#include <fs/trace.h>
+#include <lib/cksum.h>
+
+#ifdef __Fuchsia__
+#include <lib/fzl/owned-vmo-mapper.h>
+#endif
+
+#include <minfs/journal.h>
+#include <minfs/writeback.h>
+
+#include "minfs-private.h"
+
+#include <utility>
+
+namespace minfs {
+namespace {
+
+// Header blocks beyond the first, and revocation blocks, hold nothing but block numbers.
+constexpr size_t kBlockNumbersPerBlock = kMinfsBlockSize / sizeof(blk_t);
+
+// Returns the number of header blocks of an entry holding |blocks| blocks of metadata.
+size_t HeaderBlocks(size_t blocks) {
+    if (blocks <= kJournalEntryHeaderMaxBlocks) {
+        return 1;
+    }
+    return 1 + fbl::round_up(blocks - kJournalEntryHeaderMaxBlocks, kBlockNumbersPerBlock) /
+               kBlockNumbersPerBlock;
+}
+
+// Returns the number of revocation blocks of an entry revoking |revoked| blocks.
+size_t RevocationBlocks(size_t revoked) {
+    return fbl::round_up(revoked, kBlockNumbersPerBlock) / kBlockNumbersPerBlock;
+}
+
+// Returns the total number of blocks of an entry holding |blocks| blocks of metadata and
+// revoking |revoked| blocks.
+size_t EntryBlocks(size_t blocks, size_t revoked) {
+    return HeaderBlocks(blocks) + RevocationBlocks(revoked) + blocks + 1;
+}
+
+// An entry read back from the journal.
+struct JournalEntry {
+    uint64_t sequence;
+    // The offset of its first block of metadata.
+    size_t pos;
+    fbl::Vector<blk_t> targets;
+    fbl::Vector<blk_t> revoked;
+};
+
+class JournalReader {
+public:
+    JournalReader(Bcache* bc, blk_t start, size_t capacity)
+        : bc_(bc), start_(start), capacity_(capacity) {}
+
+    // Reads the block at entry offset |pos| into |data|.
+    zx_status_t Read(size_t pos, void* data) {
+        return bc_->Readblk(static_cast<blk_t>(start_ + 1 + pos % capacity_), data);
+    }
+
+    // Reads the entry at |pos|, if it is complete, numbered |sequence|, and no more than
+    // |avail| blocks long, into |out|, and its length into |out_blocks|. Returns
+    // ZX_ERR_NOT_FOUND if it is not.
+    zx_status_t ReadEntry(size_t pos, uint64_t sequence, size_t avail, JournalEntry* out,
+                          size_t* out_blocks);
+
+private:
+    Bcache* const bc_;
+    const blk_t start_;
+    const size_t capacity_;
+};
+
+zx_status_t JournalReader::ReadEntry(size_t pos, uint64_t sequence, size_t avail,
+                                     JournalEntry* out, size_t* out_blocks) {
+    uint8_t data[kMinfsBlockSize];
+    zx_status_t status;
+    if ((status = Read(pos, data)) != ZX_OK) {
+        return status;
+    }
+    const JournalHeader* header = reinterpret_cast<const JournalHeader*>(data);
+    if (header->magic != kJournalEntryMagic || header->sequence != sequence) {
+        return ZX_ERR_NOT_FOUND;
+    }
+    const size_t blocks = header->block_count;
+    const size_t revoked = header->revoked_count;
+    const size_t header_blocks = HeaderBlocks(blocks);
+    const size_t revocation_blocks = RevocationBlocks(revoked);
+    const size_t entry_blocks = EntryBlocks(blocks, revoked);
+    if (entry_blocks > avail) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    uint32_t checksum = crc32(0, data, kMinfsBlockSize);
+    size_t listed = fbl::min(blocks, static_cast<size_t>(kJournalEntryHeaderMaxBlocks));
+    for (size_t i = 0; i < listed; i++) {
+        out->targets.push_back(header->target_blocks[i]);
+    }
+    const blk_t* numbers = reinterpret_cast<const blk_t*>(data);
+    size_t block = 1;
+    for (; block < header_blocks; block++) {
+        if ((status = Read(pos + block, data)) != ZX_OK) {
+            return status;
+        }
+        checksum = crc32(checksum, data, kMinfsBlockSize);
+        size_t count = fbl::min(blocks - listed, kBlockNumbersPerBlock);
+        for (size_t i = 0; i < count; i++) {
+            out->targets.push_back(numbers[i]);
+        }
+        listed += count;
+    }
+    listed = 0;
+    for (; block < header_blocks + revocation_blocks; block++) {
+        if ((status = Read(pos + block, data)) != ZX_OK) {
+            return status;
+        }
+        checksum = crc32(checksum, data, kMinfsBlockSize);
+        size_t count = fbl::min(revoked - listed, kBlockNumbersPerBlock);
+        for (size_t i = 0; i < count; i++) {
+            out->revoked.push_back(numbers[i]);
+        }
+        listed += count;
+    }
+    for (; block < entry_blocks - 1; block++) {
+        if ((status = Read(pos + block, data)) != ZX_OK) {
+            return status;
+        }
+        checksum = crc32(checksum, data, kMinfsBlockSize);
+    }
+
+    if ((status = Read(pos + block, data)) != ZX_OK) {
+        return status;
+    }
+    const JournalCommit* commit = reinterpret_cast<const JournalCommit*>(data);
+    if (commit->magic != kJournalCommitMagic || commit->sequence != sequence ||
+        commit->checksum != checksum) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    out->sequence = sequence;
+    out->pos = pos + header_blocks + revocation_blocks;
+    *out_blocks = entry_blocks;
+    return ZX_OK;
+}
+
+// Reads the journal info of the filesystem on |bc| described by |info| into |out_info|, and
+// the entries from its start into |entries|. Returns in |out_end| the offset following them.
+zx_status_t ScanJournal(Bcache* bc, const Superblock& info, JournalInfo* out_info,
+                        fbl::Vector<JournalEntry>* entries, size_t* out_end) {
+    blk_t start;
+    blk_t count;
+    GetJournalBlocks(*bc, info, &start, &count);
+    if (count < 2) {
+        FS_TRACE_ERROR("minfs: journal too small\n");
+        return ZX_ERR_BAD_STATE;
+    }
+    const size_t capacity = count - 1;
+
+    uint8_t data[kMinfsBlockSize];
+    zx_status_t status;
+    if ((status = bc->Readblk(start, data)) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: could not read journal block\n");
+        return status;
+    }
+    memcpy(out_info, data, sizeof(JournalInfo));
+    if (out_info->magic != kJournalMagic) {
+        FS_TRACE_ERROR("minfs: invalid journal magic\n");
+        return ZX_ERR_BAD_STATE;
+    }
+    if (out_info->start >= capacity) {
+        FS_TRACE_ERROR("minfs: journal start %" PRIu64 " out of range\n", out_info->start);
+        return ZX_ERR_BAD_STATE;
+    }
+
+    JournalReader reader(bc, start, capacity);
+    size_t pos = out_info->start;
+    size_t used = 0;
+    uint64_t sequence = out_info->sequence;
+    while (true) {
+        JournalEntry entry;
+        size_t entry_blocks;
+        status = reader.ReadEntry(pos, sequence, capacity - used, &entry, &entry_blocks);
+        if (status == ZX_ERR_NOT_FOUND) {
+            break;
+        } else if (status != ZX_OK) {
+            return status;
+        }
+        for (size_t i = 0; i < entry.targets.size(); i++) {
+            blk_t target = entry.targets[i];
+            if ((target >= start && target < start + count) ||
+                target >= info.dat_block + info.block_count) {
+                FS_TRACE_ERROR("minfs: journal entry %" PRIu64 " targets invalid block %u\n",
+                               sequence, target);
+                return ZX_ERR_BAD_STATE;
+            }
+        }
+        entries->push_back(std::move(entry));
+        pos = (pos + entry_blocks) % capacity;
+        used += entry_blocks;
+        sequence++;
+    }
+
+    *out_end = pos;
+    return ZX_OK;
+}
+
+// Returns true if |bno| is revoked by any of |entries| from |index| on.
+bool IsRevoked(const fbl::Vector<JournalEntry>& entries, size_t index, blk_t bno) {
+    for (size_t i = index; i < entries.size(); i++) {
+        const fbl::Vector<blk_t>& revoked = entries[i].revoked;
+        for (size_t j = 0; j < revoked.size(); j++) {
+            if (revoked[j] == bno) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+#ifdef __Fuchsia__
+// Enqueues a write of |length| blocks of the VMO attached as |vmoid|, from block
+// |vmo_offset|, to block |dev_offset|.
+void EnqueueWrite(Bcache* bc, fbl::Vector<block_fifo_request_t>* requests, vmoid_t vmoid,
+                  uint64_t vmo_offset, uint64_t dev_offset, uint64_t length) {
+    const uint32_t kDiskBlocksPerMinfsBlock = kMinfsBlockSize / bc->DeviceBlockSize();
+    block_fifo_request_t request;
+    request.group = bc->BlockGroupID();
+    request.vmoid = vmoid;
+    request.opcode = BLOCKIO_WRITE;
+    request.vmo_offset = vmo_offset * kDiskBlocksPerMinfsBlock;
+    request.dev_offset = dev_offset * kDiskBlocksPerMinfsBlock;
+    uint64_t disk_length = length * kDiskBlocksPerMinfsBlock;
+    ZX_ASSERT_MSG(disk_length < UINT32_MAX, "Too many blocks");
+    request.length = static_cast<uint32_t>(disk_length);
+    requests->push_back(request);
+}
+#endif
+
+} // namespace anonymous
+
+void GetJournalBlocks(const Bcache& bc, const Superblock& info, blk_t* out_start,
+                      blk_t* out_count) {
+#ifdef __Fuchsia__
+    *out_start = info.journal_start_block;
+    if (info.flags & kMinfsFlagFVM) {
+        const size_t kBlocksPerSlice = info.slice_size / kMinfsBlockSize;
+        *out_count = static_cast<blk_t>(info.journal_slices * kBlocksPerSlice);
+    } else {
+        *out_count = info.dat_block - info.journal_start_block;
+    }
+#else
+    BlockOffsets offsets(bc, info);
+    *out_start = offsets.JournalStartBlock();
+    *out_count = offsets.JournalBlockCount();
+#endif
+}
+
+zx_status_t ReplayJournal(Bcache* bc) {
+    TRACE_DURATION("minfs", "ReplayJournal");
+    uint8_t data[kMinfsBlockSize];
+    zx_status_t status;
+    if ((status = bc->Readblk(0, data)) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: could not read info block\n");
+        return status;
+    }
+    Superblock info;
+    memcpy(&info, data, sizeof(info));
+    if (info.magic0 != kMinfsMagic0 || info.magic1 != kMinfsMagic1 ||
+        info.version != kMinfsVersion) {
+        // Leave it to the checks of the superblock to reject.
+        return ZX_OK;
+    }
+
+    JournalInfo journal_info;
+    fbl::Vector<JournalEntry> entries;
+    size_t end;
+    if ((status = ScanJournal(bc, info, &journal_info, &entries, &end)) != ZX_OK) {
+        return status;
+    }
+    if (entries.is_empty()) {
+        return ZX_OK;
+    }
+
+    blk_t start;
+    blk_t count;
+    GetJournalBlocks(*bc, info, &start, &count);
+    JournalReader reader(bc, start, count - 1);
+    size_t blocks = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const JournalEntry& entry = entries[i];
+        for (size_t j = 0; j < entry.targets.size(); j++) {
+            if (IsRevoked(entries, i, entry.targets[j])) {
+                continue;
+            }
+            if ((status = reader.Read(entry.pos + j, data)) != ZX_OK ||
+                (status = bc->Writeblk(entry.targets[j], data)) != ZX_OK) {
+                FS_TRACE_ERROR("minfs: could not replay journal entry %" PRIu64 ": %d\n",
+                               entry.sequence, status);
+                return status;
+            }
+            blocks++;
+        }
+    }
+
+    // Only forget the entries once their blocks have reached the disk.
+    if ((status = bc->Sync()) != ZX_OK) {
+        return status;
+    }
+    journal_info.start = end;
+    journal_info.sequence += entries.size();
+    memset(data, 0, sizeof(data));
+    memcpy(data, &journal_info, sizeof(journal_info));
+    if ((status = bc->Writeblk(start, data)) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: could not write journal block\n");
+        return status;
+    }
+    if ((status = bc->Sync()) != ZX_OK) {
+        return status;
+    }
+
+    FS_TRACE_INFO("minfs: replayed %zu journal entries, writing %zu blocks\n", entries.size(),
+                  blocks);
+    return ZX_OK;
+}
+
+zx_status_t CountJournalEntries(Bcache* bc, const Superblock& info, size_t* out_entries) {
+    JournalInfo journal_info;
+    fbl::Vector<JournalEntry> entries;
+    size_t end;
+    zx_status_t status = ScanJournal(bc, info, &journal_info, &entries, &end);
+    if (status != ZX_OK) {
+        return status;
+    }
+    *out_entries = entries.size();
+    return ZX_OK;
+}
+
+#ifdef __Fuchsia__
+
+zx_status_t Journal::Create(Bcache* bc, blk_t start, blk_t count,
+                            const TransactionLimits& limits, fbl::unique_ptr<Journal>* out) {
+    if (count < limits.GetMinimumJournalBlocks()) {
+        FS_TRACE_ERROR("minfs: journal too small\n");
+        return ZX_ERR_BAD_STATE;
+    }
+    fbl::unique_ptr<Journal> journal(new Journal(bc, start, count,
+                                                 limits.GetMaximumEntryHeaderBlocks(),
+                                                 limits.GetMaximumEntryRevocationBlocks()));
+
+    // The journal info, and the header, revocation and commit blocks of an entry.
+    const size_t control_blocks = 1 + journal->header_blocks_ + journal->revocation_blocks_ + 1;
+    zx_status_t status;
+    if ((status = journal->control_.CreateAndMap(control_blocks * kMinfsBlockSize,
+                                                 "minfs-journal")) != ZX_OK) {
+        return status;
+    }
+    if ((status = bc->AttachVmo(journal->control_.vmo(), &journal->control_vmoid_)) != ZX_OK) {
+        return status;
+    }
+
+    // Carry on from where replay left the journal.
+    if ((status = bc->Readblk(start, journal->ControlBlock(0))) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: could not read journal block\n");
+        return status;
+    }
+    const JournalInfo* info = static_cast<const JournalInfo*>(journal->ControlBlock(0));
+    if (info->magic != kJournalMagic || info->start >= journal->capacity_) {
+        FS_TRACE_ERROR("minfs: invalid journal info\n");
+        return ZX_ERR_BAD_STATE;
+    }
+    journal->start_ = info->start;
+    journal->sequence_ = info->sequence;
+
+    *out = std::move(journal);
+    return ZX_OK;
+}
+
+Journal::~Journal() {
+    if (control_vmoid_ != VMOID_INVALID) {
+        block_fifo_request_t request;
+        request.group = bc_->BlockGroupID();
+        request.vmoid = control_vmoid_;
+        request.opcode = BLOCKIO_CLOSE_VMO;
+        bc_->Transaction(&request, 1);
+    }
+}
+
+bool Journal::EntryFits(size_t blocks, size_t revoked) const {
+    return HeaderBlocks(blocks) <= header_blocks_ &&
+           RevocationBlocks(revoked) <= revocation_blocks_ &&
+           EntryBlocks(blocks, revoked) <= capacity_;
+}
+
+zx_status_t Journal::Commit(const fbl::Vector<fbl::unique_ptr<WritebackWork>>& works,
+                            const fzl::OwnedVmoMapper& buffer, vmoid_t vmoid) {
+    TRACE_DURATION("minfs", "Journal::Commit", "works", works.size());
+    if (failed_) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    // File data is written in place straight away, while metadata goes to the journal
+    // first. Metadata written to a block cancels its revocation earlier in the batch.
+    fbl::Vector<block_fifo_request_t> data_writes;
+    fbl::Vector<block_fifo_request_t> writes;
+    fbl::Vector<WriteRequest> metadata;
+    fbl::Vector<blk_t> targets;
+    fbl::Vector<blk_t> revoked;
+    for (size_t i = 0; i < works.size(); i++) {
+        auto& requests = works[i]->Requests();
+        for (size_t j = 0; j < requests.size(); j++) {
+            const WriteRequest& request = requests[j];
+            if (request.data) {
+                EnqueueWrite(bc_, &data_writes, vmoid, request.vmo_offset, request.dev_offset,
+                             request.length);
+                continue;
+            }
+            for (size_t n = 0; n < request.length; n++) {
+                blk_t target = static_cast<blk_t>(request.dev_offset + n);
+                for (size_t r = 0; r < revoked.size();) {
+                    if (revoked[r] == target) {
+                        revoked.erase(r);
+                    } else {
+                        r++;
+                    }
+                }
+                targets.push_back(target);
+            }
+            metadata.push_back(request);
+        }
+        const fbl::Vector<blk_t>& work_revoked = works[i]->Revoked();
+        for (size_t j = 0; j < work_revoked.size(); j++) {
+            revoked.push_back(work_revoked[j]);
+        }
+    }
+
+    size_t entry_blocks = 0;
+    if (!targets.is_empty() || !revoked.is_empty()) {
+        ZX_ASSERT(EntryFits(targets.size(), revoked.size()));
+        const size_t header_blocks = HeaderBlocks(targets.size());
+        const size_t revocation_blocks = RevocationBlocks(revoked.size());
+        entry_blocks = EntryBlocks(targets.size(), revoked.size());
+
+        zx_status_t status;
+        if (length_ + entry_blocks > capacity_ && (status = Checkpoint()) != ZX_OK) {
+            return status;
+        }
+
+        // The header, revocation and commit blocks are laid out in |control_| just as
+        // they are in the entry, apart from the gaps left by any unused blocks.
+        const size_t kHeaderIndex = 1;
+        const size_t kRevocationIndex = kHeaderIndex + header_blocks_;
+        const size_t kCommitIndex = kRevocationIndex + revocation_blocks_;
+        memset(ControlBlock(kHeaderIndex), 0, (kCommitIndex + 1 - kHeaderIndex) * kMinfsBlockSize);
+
+        JournalHeader* header = static_cast<JournalHeader*>(ControlBlock(kHeaderIndex));
+        header->magic = kJournalEntryMagic;
+        header->sequence = sequence_;
+        header->block_count = static_cast<uint32_t>(targets.size());
+        header->revoked_count = static_cast<uint32_t>(revoked.size());
+        for (size_t i = 0; i < targets.size(); i++) {
+            if (i < kJournalEntryHeaderMaxBlocks) {
+                header->target_blocks[i] = targets[i];
+                continue;
+            }
+            size_t n = i - kJournalEntryHeaderMaxBlocks;
+            blk_t* numbers = static_cast<blk_t*>(
+                ControlBlock(kHeaderIndex + 1 + n / kBlockNumbersPerBlock));
+            numbers[n % kBlockNumbersPerBlock] = targets[i];
+        }
+        for (size_t i = 0; i < revoked.size(); i++) {
+            blk_t* numbers = static_cast<blk_t*>(
+                ControlBlock(kRevocationIndex + i / kBlockNumbersPerBlock));
+            numbers[i % kBlockNumbersPerBlock] = revoked[i];
+        }
+
+        uint32_t checksum = crc32(0, static_cast<const uint8_t*>(ControlBlock(kHeaderIndex)),
+                                  header_blocks * kMinfsBlockSize);
+        if (revocation_blocks > 0) {
+            checksum = crc32(checksum,
+                             static_cast<const uint8_t*>(ControlBlock(kRevocationIndex)),
+                             revocation_blocks * kMinfsBlockSize);
+        }
+        for (size_t i = 0; i < metadata.size(); i++) {
+            const uint8_t* data = static_cast<const uint8_t*>(buffer.start()) +
+                                  metadata[i].vmo_offset * kMinfsBlockSize;
+            checksum = crc32(checksum, data, metadata[i].length * kMinfsBlockSize);
+        }
+        JournalCommit* commit = static_cast<JournalCommit*>(ControlBlock(kCommitIndex));
+        commit->magic = kJournalCommitMagic;
+        commit->sequence = sequence_;
+        commit->checksum = checksum;
+
+        size_t pos = (start_ + length_) % capacity_;
+        EnqueueEntryWrite(&writes, control_vmoid_, kHeaderIndex, header_blocks, &pos);
+        if (revocation_blocks > 0) {
+            EnqueueEntryWrite(&writes, control_vmoid_, kRevocationIndex, revocation_blocks,
+                              &pos);
+        }
+        for (size_t i = 0; i < metadata.size(); i++) {
+            EnqueueEntryWrite(&writes, vmoid, metadata[i].vmo_offset, metadata[i].length, &pos);
+        }
+        EnqueueEntryWrite(&writes, control_vmoid_, kCommitIndex, 1, &pos);
+    }
+
+    // The checksum covers everything in the entry but the commit block, so the entry can be
+    // written in a single transaction: if the commit block reaches the disk before the rest of
+    // it, replay finds the checksum wrong and ignores the entry. The file data the metadata
+    // refers to is not covered, so when there is an entry the data has to reach the disk
+    // first, which takes a flush of its own.
+    zx_status_t status;
+    if (!data_writes.is_empty()) {
+        TRACE_DURATION("minfs", "Journal::Commit::DataFlush", "requests", data_writes.size());
+        if ((status = bc_->Transaction(data_writes.get(), data_writes.size())) != ZX_OK ||
+            (entry_blocks > 0 && (status = bc_->Sync()) != ZX_OK)) {
+            return Fail(status);
+        }
+    }
+    if (!writes.is_empty() || !data_writes.is_empty()) {
+        TRACE_DURATION("minfs", "Journal::Commit::Flush", "blocks", entry_blocks);
+        if ((!writes.is_empty() &&
+             (status = bc_->Transaction(writes.get(), writes.size())) != ZX_OK) ||
+            (status = bc_->Sync()) != ZX_OK) {
+            return Fail(status);
+        }
+    }
+    if (entry_blocks > 0) {
+        length_ += entry_blocks;
+        sequence_++;
+    }
+
+    writes.reset();
+    for (size_t i = 0; i < metadata.size(); i++) {
+        EnqueueWrite(bc_, &writes, vmoid, metadata[i].vmo_offset, metadata[i].dev_offset,
+                     metadata[i].length);
+    }
+    if (!writes.is_empty() && (status = bc_->Transaction(writes.get(), writes.size())) != ZX_OK) {
+        return Fail(status);
+    }
+    return ZX_OK;
+}
+
+zx_status_t Journal::Checkpoint() {
+    if (failed_) {
+        return ZX_ERR_BAD_STATE;
+    }
+    if (length_ == 0) {
+        return ZX_OK;
+    }
+    TRACE_DURATION("minfs", "Journal::Checkpoint");
+
+    // The metadata of each entry has been written in place, but may not have reached the
+    // disk until this flush.
+    zx_status_t status;
+    if ((status = bc_->Sync()) != ZX_OK) {
+        return Fail(status);
+    }
+    JournalInfo info;
+    memset(&info, 0, sizeof(info));
+    info.magic = kJournalMagic;
+    info.start = (start_ + length_) % capacity_;
+    info.sequence = sequence_;
+    if ((status = WriteInfo(info)) != ZX_OK || (status = bc_->Sync()) != ZX_OK) {
+        return Fail(status);
+    }
+    start_ = info.start;
+    length_ = 0;
+    return ZX_OK;
+}
+
+void* Journal::ControlBlock(size_t index) const {
+    return static_cast<uint8_t*>(control_.start()) + index * kMinfsBlockSize;
+}
+
+void Journal::EnqueueEntryWrite(fbl::Vector<block_fifo_request_t>* requests, vmoid_t vmoid,
+                                uint64_t vmo_offset, uint64_t length, size_t* pos) const {
+    while (length > 0) {
+        // Entries wrap around from the end of the journal to its start.
+        uint64_t run = fbl::min(length, static_cast<uint64_t>(capacity_ - *pos));
+        EnqueueWrite(bc_, requests, vmoid, vmo_offset, start_block_ + 1 + *pos, run);
+        vmo_offset += run;
+        length -= run;
+        *pos = (*pos + run) % capacity_;
+    }
+}
+
+zx_status_t Journal::WriteInfo(const JournalInfo& info) {
+    memset(ControlBlock(0), 0, kMinfsBlockSize);
+    memcpy(ControlBlock(0), &info, sizeof(info));
+    fbl::Vector<block_fifo_request_t> requests;
+    EnqueueWrite(bc_, &requests, control_vmoid_, 0, start_block_, 1);
+    return bc_->Transaction(requests.get(), requests.size());
+}
+
+zx_status_t Journal::Fail(zx_status_t status) {
+    FS_TRACE_ERROR("minfs: journal write failed: %d; no more metadata will be written\n",
+                   status);
+    failed_ = true;
+    return status;
+}
+
+#endif // __Fuchsia__
+
+} // namespace minfs
@@ -10,12 +10,14 @@
 #include <inttypes.h>
 
 #ifdef __Fuchsia__
+#include <bitmap/rle-bitmap.h>
 #include <fbl/auto_lock.h>
 #include <fs/managed-vfs.h>
 #include <fs/remote.h>
 #include <fs/watcher.h>
 #include <fuchsia/io/c/fidl.h>
 #include <fuchsia/minfs/c/fidl.h>
+#include <lib/async/cpp/task.h>
 #include <lib/fzl/resizeable-vmo-mapper.h>
 #include <lib/sync/completion.h>
 #include <lib/zx/vmo.h>
@@ -28,6 +30,7 @@
 #include <fbl/macros.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 #include <fs/block-txn.h>
 #include <fs/locking.h>
 #include <fs/ticker.h>
@@ -38,6 +41,8 @@
 #include <minfs/allocator.h>
 #include <minfs/format.h>
 #include <minfs/inode-manager.h>
+#include <minfs/journal.h>
+#include <minfs/minfs.h>
 #include <minfs/superblock.h>
 #include <minfs/transaction-limits.h>
 #include <minfs/writeback.h>
@@ -81,6 +86,16 @@ constexpr uint32_t kMxFsSyncCtime = (1 << 1);
 
 constexpr uint32_t kMinfsBlockCacheSize = 64;
 
+// The number of blocks of file data a vnode may hold dirty, written to its VMO but not to disk,
+// before it writes them back of its own accord. This is also the most it writes back at once.
+constexpr blk_t kMinfsMaxDirtyBlocks = 128;
+
+#ifdef __Fuchsia__
+// Dirty blocks are written back at most this long after they are written, even if nothing syncs
+// them and the vnode holds fewer than |kMinfsMaxDirtyBlocks|.
+constexpr zx_duration_t kMinfsDirtyExpire = ZX_SEC(5);
+#endif
+
 // Used by fsck
 class MinfsChecker;
 class VnodeMinfs;
@@ -92,7 +107,7 @@ using SyncCallback = fs::Vnode::SyncCallback;
 // sparse files.
 class BlockOffsets {
 public:
-    BlockOffsets(const Bcache& bc, const SuperblockManager& sb);
+    BlockOffsets(const Bcache& bc, const Superblock& info);
 
     blk_t IbmStartBlock() const { return ibm_start_block_; }
     blk_t IbmBlockCount() const { return ibm_block_count_; }
@@ -140,7 +155,7 @@ public:
     ~Minfs();
 
     static zx_status_t Create(fbl::unique_ptr<Bcache> bc, const Superblock* info,
-                              fbl::unique_ptr<Minfs>* out);
+                              const MountOptions& options, fbl::unique_ptr<Minfs>* out);
 
     // instantiate a vnode from an inode
     // the inode must exist in the file system
@@ -153,13 +168,31 @@ public:
     void VnodeInsert(VnodeMinfs* vn) FS_TA_EXCLUDES(hash_lock_);
     fbl::RefPtr<VnodeMinfs> VnodeLookup(uint32_t ino) FS_TA_EXCLUDES(hash_lock_);
     void VnodeRelease(VnodeMinfs* vn) FS_TA_EXCLUDES(hash_lock_);
+#ifdef __Fuchsia__
+    // Keeps a reference to |vn|, which has just been given dirty blocks, until they are
+    // written back by the next sync, or at the latest |kMinfsDirtyExpire| from now.
+    void VnodeMarkDirty(VnodeMinfs* vn) FS_TA_EXCLUDES(hash_lock_);
+#endif
+
+    // Allocate a new data block, preferably the first free one at or after |goal|
+    // if it is nonzero.
+    void BlockNew(Transaction* state, blk_t goal, blk_t* out_bno);
 
-    // Allocate a new data block.
-    void BlockNew(Transaction* state, blk_t* out_bno);
+    // Returns the number of data blocks which are reserved, such as for the dirty blocks of
+    // files, but not yet allocated.
+    size_t BlocksReserved() const { return block_allocator_->GetReserved(); }
+
+    // Allocate up to |count| consecutive data blocks, starting at |goal| if it is nonzero and
+    // free. Returns the number allocated, which is at least one, and the first in |out_bno|.
+    blk_t BlocksNew(Transaction* state, blk_t goal, blk_t count, blk_t* out_bno);
 
     // Free a data block.
     void BlockFree(WriteTxn* txn, blk_t bno);
 
+    // Free a data block which held metadata, revoking it from the journal, so
+    // that it may be reused for file data.
+    void MetadataBlockFree(WriteTxn* txn, blk_t bno);
+
     // Queries the underlying FVM, if it exists.
     zx_status_t FVMQuery(fvm_info_t* info) const;
 
@@ -220,9 +253,8 @@ public:
     fs::Ticker StartTicker() { return fs::Ticker(collecting_metrics_); }
 
     // Update aggregate information about VMO initialization.
-    void UpdateInitMetrics(uint32_t dnum_count, uint32_t inum_count,
-                           uint32_t dinum_count, uint64_t user_data_size,
-                           const fs::Duration& duration);
+    void UpdateInitMetrics(uint32_t extent_count, uint32_t extent_block_count,
+                           uint64_t user_data_size, const fs::Duration& duration);
     // Update aggregate information about looking up vnodes by name.
     void UpdateLookupMetrics(bool success, const fs::Duration& duration);
     // Update aggregate information about looking up vnodes by inode.
@@ -289,6 +321,15 @@ private:
     // Enqueues an update to the super block.
     void WriteInfo(WriteTxn* txn);
 
+#ifdef __Fuchsia__
+    // Writes back the dirty blocks of the vnodes kept by |VnodeMarkDirty|, and releases those
+    // left clean.
+    void FlushDirtyVnodes() FS_TA_EXCLUDES(hash_lock_);
+
+    // Forgets the dirty blocks of the vnodes kept by |VnodeMarkDirty|, and releases them.
+    void DropDirtyVnodes() FS_TA_EXCLUDES(hash_lock_);
+#endif
+
     // Creates an unique identifier for this instance. This is to be called only during
     // "construction".
     static zx_status_t CreateFsId(uint64_t* out);
@@ -312,6 +353,15 @@ private:
     bool collecting_metrics_ = false;
 #ifdef __Fuchsia__
     fbl::Closure on_unmount_{};
+    // Vnodes which have had dirty blocks since they were last written back, whether or not
+    // anything else refers to them. The last reference to a vnode may be dropped by the
+    // writeback thread, so these are only touched while holding |hash_lock_|.
+    fbl::Vector<fbl::RefPtr<VnodeMinfs>> dirty_vnodes_ FS_TA_GUARDED(hash_lock_);
+    // Writes back |dirty_vnodes_| once the first of them has been dirty for |kMinfsDirtyExpire|.
+    async::TaskClosureMethod<Minfs, &Minfs::FlushDirtyVnodes> flush_dirty_task_{this};
+    // Reads may be dispatched concurrently, so the metrics they update are
+    // only touched while holding this lock.
+    fbl::Mutex read_metrics_lock_;
     fuchsia_minfs_Metrics metrics_ = {};
     fbl::unique_ptr<WritebackBuffer> writeback_;
     uint64_t fs_id_ = 0;
@@ -359,6 +409,8 @@ public:
     static zx_status_t Recreate(Minfs* fs, ino_t ino, fbl::RefPtr<VnodeMinfs>* out);
 
     bool IsDirectory() const { return inode_.magic == kMinfsMagicDir; }
+    // Whether the blocks of the vnode are metadata, written through the journal.
+    bool IsMetadata() const { return IsDirectory() || is_dir_index_; }
     bool IsUnlinked() const { return inode_.link_count == 0; }
     zx_status_t CanUnlink() const;
 
@@ -394,6 +446,11 @@ private:
     friend zx_status_t Minfs::InoFree(VnodeMinfs* vn, WritebackWork* wb);
     friend void Minfs::AddUnlinked(WritebackWork* wb, VnodeMinfs* vn);
     friend void Minfs::RemoveUnlinked(WritebackWork* wb, VnodeMinfs* vn);
+#ifdef __Fuchsia__
+    friend void Minfs::VnodeMarkDirty(VnodeMinfs* vn);
+    friend void Minfs::FlushDirtyVnodes();
+    friend void Minfs::DropDirtyVnodes();
+#endif
 
     VnodeMinfs(Minfs* fs);
 
@@ -464,6 +521,43 @@ private:
 
     zx_status_t UnlinkChild(Transaction* state, fbl::RefPtr<VnodeMinfs> child,
                             Dirent* de, DirectoryOffset* offs);
+
+    // Directory index functions. Those which maintain the index are defined in dir-index.cpp.
+    //
+    // Like |ForEachDirent|, but only calls |func| on the dirent named |args->name|, which is
+    // found with the directory's index if it has an up-to-date one.
+    //
+    // A dirent found through the index has no previous dirent recorded in |args->offs|, so
+    // unlinking it does not coalesce it with a free record before it. Such records are merged
+    // when the index is next rebuilt, which |PrepareDirIndex| does once there are many of them.
+    zx_status_t FindDirent(DirArgs* args, const DirentCallback func);
+    // Like |ForEachDirent| with |DirentCallbackFindSpace|, but tries the last dirent first if
+    // the directory is indexed, rather than scanning for a free record.
+    zx_status_t FindDirentSpace(DirArgs* args);
+
+    // Brings the index up to date before the directory is modified, building it if the
+    // directory has grown large enough to need one and rebuilding it if it is stale, or if
+    // unlinks through it have left many free records unmerged. Commits
+    // transactions of its own, so must be called without one open.
+    void PrepareDirIndex();
+    // Blocks to reserve, on top of those for the directory itself, to add a dirent.
+    blk_t DirIndexReserveBlocks() const;
+    // Record changes to the directory in the index, if it has one. The index is written out
+    // by |DirIndexSync|, which should follow each bump of |inode_.seq_num|.
+    void DirIndexInsert(Transaction* state, fbl::StringPiece name, size_t off);
+    void DirIndexRemove(Transaction* state, fbl::StringPiece name, size_t off);
+    void DirIndexSetLast(size_t off);
+    void DirIndexUnmerged();
+    void DirIndexSync(Transaction* state);
+    // Frees the directory's index inode, if it has one.
+    void DropDirIndex(WritebackWork* wb);
+
+    zx_status_t LoadDirIndex();
+    zx_status_t BuildDirIndex();
+    // Replaces the run of free dirents at |off|, |len| bytes long, with a single free dirent.
+    zx_status_t MergeFreeDirents(size_t off, size_t len, bool last);
+    zx_status_t ReadDirIndexBucket(blk_t bucket, DirIndexBucket* out);
+    zx_status_t SplitDirIndexBucket(Transaction* state, uint32_t slot, DirIndexBucket* bucket);
     // Remove the link to a vnode (referring to inodes exclusively).
     // Has no impact on direntries (or parent inode).
     void RemoveInodeLink(WritebackWork* wb);
@@ -493,140 +587,72 @@ private:
 #endif  // MINFS_PARANOID_MODE && __Fuchsia__
     }
 
-    enum class BlockOp {
-        kRead,
-        kWrite,
-        kDelete,
-    };
-
-    struct BlockOpArgs {
-        BlockOpArgs(blk_t start, blk_t count, blk_t* bnos)
-            : start(start), count(count), bnos(bnos) {
-                // Initialize output array to 0 in case the indirect block(s) containing these bnos
-                // do not exist
-                if (bnos) {
-                    memset(bnos, 0, sizeof(blk_t) * count);
-                }
-            }
-
-        blk_t start;
-        blk_t count;
-        blk_t* bnos;
-    };
-
-    class DirectArgs {
-    public:
-        DirectArgs(BlockOp op, blk_t* array, blk_t count, blk_t* bnos)
-            : op_(op), array_(array), count_(count), bnos_(bnos), dirty_(false) {}
-
-        BlockOp GetOp() const { return op_; }
-        blk_t GetBno(blk_t index) const { return array_[index]; }
-        void SetBno(blk_t index, blk_t value) {
-            ZX_DEBUG_ASSERT(index < GetCount());
-
-            if (bnos_ != nullptr) {
-                bnos_[index] = value ? value : array_[index];
-            }
-
-            if (array_[index] != value) {
-                array_[index] = value;
-                dirty_ = true;
-            }
-        }
-
-        blk_t GetCount() const { return count_; }
-
-        bool IsDirty() const { return dirty_; }
-    protected:
-        const BlockOp op_; // determines what operation to perform on blocks
-        blk_t* const array_; // array containing blocks to be operated on
-        const blk_t count_; // number of direct blocks to operate on
-        blk_t* const bnos_; // array of |count| bnos returned to the user
-        bool dirty_; // true if blocks have successfully been op'd
-    };
-
-    class IndirectArgs : public DirectArgs {
-    public:
-        IndirectArgs(BlockOp op, blk_t* array, blk_t count, blk_t* bnos, blk_t bindex,
-                     blk_t ib_vmo_offset)
-            : DirectArgs(op, array, count, bnos), bindex_(bindex), ib_vmo_offset_(ib_vmo_offset) {}
-
-        void SetDirty() { dirty_ = true; }
-
-        void SetBno(blk_t index, blk_t value) {
-            ZX_DEBUG_ASSERT(index < GetCount());
-            array_[index] = value;
-            SetDirty();
-        }
-
-        // Number of indirect blocks we need to iterate through to touch all |count| direct blocks.
-        blk_t GetCount() const {
-            return (bindex_ + count_ + kMinfsDirectPerIndirect - 1) / kMinfsDirectPerIndirect;
-        }
-
-        blk_t GetOffset() const { return ib_vmo_offset_; }
-
-        // Generate parameters for direct blocks in indirect block |ibindex|, which are contained
-        // in |barray|
-        DirectArgs GetDirect(blk_t* barray, unsigned ibindex) const;
-
-    protected:
-        const blk_t bindex_; // relative index of the first direct block within the first indirect
-                            // block
-        const blk_t ib_vmo_offset_; // index of the first indirect block
-    };
-
-    class DindirectArgs : public IndirectArgs {
-    public:
-        DindirectArgs(BlockOp op, blk_t* array, blk_t count, blk_t* bnos, blk_t bindex,
-                      blk_t ib_vmo_offset, blk_t ibindex, blk_t dib_vmo_offset)
-            : IndirectArgs(op, array, count, bnos, bindex, ib_vmo_offset),
-              ibindex_(ibindex), dib_vmo_offset_(dib_vmo_offset) {}
-
-        // Number of doubly indirect blocks we need to iterate through to touch all |count| direct
-        // blocks.
-        blk_t GetCount() const {
-            return (ibindex_ + count_ + kMinfsDirectPerDindirect - 1) / kMinfsDirectPerDindirect;
-        }
-
-        blk_t GetOffset() const { return dib_vmo_offset_; }
-
-        // Generate parameters for indirect blocks in doubly indirect block |dibindex|, which are
-        // contained in |iarray|
-        IndirectArgs GetIndirect(blk_t* iarray, unsigned dibindex) const;
-
-    protected:
-        const blk_t ibindex_; // relative index of the first indirect block within the first
-                             // doubly indirect block
-        const blk_t dib_vmo_offset_; // index of the first doubly indirect block
-    };
-
-    // Allocate an indirect or doubly indirect block at |offset| within the indirect vmo and clear
-    // the in-memory block array
-    // Assumes that vmo_indirect_ has already been initialized
-    void AllocateIndirect(Transaction* state, blk_t index, IndirectArgs* args);
-
-    // Perform operation |op| on blocks as specified by |params|
-    // The BlockOp methods should not be called directly
-    // All BlockOp methods assume that vmo_indirect_ has been grown to the required size
-    zx_status_t ApplyOperation(Transaction* state, BlockOp op, BlockOpArgs* params);
-    zx_status_t BlockOpDirect(Transaction* state, DirectArgs* params);
-    zx_status_t BlockOpIndirect(Transaction* state, IndirectArgs* params);
-    zx_status_t BlockOpDindirect(Transaction* state, DindirectArgs* params);
+    // Extent map functions, defined in extents.cpp.
+    //
+    // Creates the storage for the vnode's extent blocks, if it has not been already.
+    zx_status_t InitExtentBlocks();
+    // Reads in the vnode's extent blocks, if it has any which have not been read in yet.
+    zx_status_t LoadExtentBlocks();
+    // Looks up the data block to which block |n| of the vnode is mapped, which is 0 for
+    // a hole.
+    zx_status_t ExtentLookup(blk_t n, blk_t* out_bno);
+    // Maps up to |blocks| blocks of the vnode from block |n|, which must all be holes, to a run
+    // of newly allocated data blocks, preferably following the block before them. Returns the
+    // first data block in |out_bno|, and the number of blocks mapped, at least one, in
+    // |out_count|.
+    zx_status_t ExtentMap(Transaction* state, blk_t n, blk_t blocks, blk_t* out_bno,
+                          blk_t* out_count);
+    // Blocks to reserve, on top of |count| new data blocks, for the extent blocks which
+    // mapping them may add.
+    blk_t ExtentReserveBlocks(blk_t count) const;
+
+    // The extent block referred to by |inode_.extent_refs[ref]|, which must be loaded.
+    ExtentBlock* GetExtentBlock(uint32_t ref);
+    void WriteExtentBlock(WritebackWork* wb, uint32_t ref);
+    // Moves the later half of the extents of the extent block referred to by
+    // |inode_.extent_refs[ref]| into a new extent block, referred to from the entry after it.
+    // If block |n| follows all of them, the new extent block starts out empty at |n| instead,
+    // so that a file written from start to end fills its extent blocks.
+    zx_status_t SplitExtentBlock(Transaction* state, uint32_t ref, blk_t n);
+    // Makes room to map block |n| in the full extent block referred to by
+    // |inode_.extent_refs[ref]|, once there are no more references for a split, by moving
+    // extents, or the bounds between them, to the extent block either side of it. Returns
+    // ZX_ERR_NO_SPACE if both are full too.
+    zx_status_t RebalanceExtentBlocks(Transaction* state, uint32_t ref, blk_t n);
+    // Moves the extents of the vnode from its inode into a new extent block.
+    zx_status_t SpillExtents(Transaction* state);
+    // Frees |inode_.extent_refs[ref]|, whose extent block must be empty.
+    void FreeExtentBlock(WritebackWork* wb, uint32_t ref);
 
     // Get the disk block 'bno' corresponding to the 'n' block
     // If 'txn' is non-null, new blocks are allocated for all un-allocated bnos.
-    // This can be extended to retrieve multiple contiguous blocks in one call
     zx_status_t BlockGet(Transaction* state, blk_t n, blk_t* bno);
     // Deletes all blocks (relative to a file) from "start" (inclusive) to the end
     // of the file. Does not update mtime/atime.
-    // This can be extended to return indices of deleted bnos, or to delete a specific number of
-    // bnos
-    zx_status_t BlocksShrink(Transaction* state, blk_t start);
+    zx_status_t BlocksShrink(WritebackWork* wb, blk_t start);
 
     // Update the vnode's inode and write it to disk.
     void InodeSync(WritebackWork* wb, uint32_t flags);
 
+#ifdef __Fuchsia__
+    // Delayed allocation, for the data of files.
+    //
+    // Writes to a file only update its VMO, marking the blocks they touch dirty, and reserve
+    // a block for each dirty block which is a hole. Dirty blocks are written back together,
+    // which allocates the holes among them in runs.
+    //
+    // Reserves blocks for the holes of the file in [start, end) which are not yet dirty.
+    zx_status_t ReserveDirtyBlocks(blk_t start, blk_t end);
+    // Writes back the dirty blocks of the file, allocating data blocks for those which are holes.
+    zx_status_t FlushDirtyBlocks();
+    // Forgets the dirty blocks of the file from block |start| on, which are about to be
+    // truncated or purged, giving back the blocks reserved for them.
+    void DropDirtyBlocks(blk_t start);
+    // Returns the number of the blocks of the file in [start, end) which are holes, and not
+    // marked dirty unless |dirty| is set.
+    zx_status_t CountHoles(blk_t start, blk_t end, bool dirty, blk_t* out_count);
+#endif
+
     // Deletes this Vnode from disk, freeing the inode and blocks.
     //
     // Must only be called on Vnodes which
@@ -639,23 +665,6 @@ private:
     void Sync(SyncCallback closure) final;
     zx_status_t AttachRemote(fs::MountChannel h) final;
     zx_status_t InitVmo();
-    zx_status_t InitIndirectVmo();
-
-    // Loads indirect blocks up to and including the doubly indirect block at |index|.
-    zx_status_t LoadIndirectWithinDoublyIndirect(uint32_t index);
-
-    // Initializes the indirect VMO, grows it to |size| bytes, and reads |count| indirect
-    // blocks from |iarray| into the indirect VMO, starting at block offset |offset|.
-    zx_status_t LoadIndirectBlocks(blk_t* iarray, uint32_t count, uint32_t offset,
-                                   uint64_t size);
-
-    // Reads the block at |offset| in memory.
-    // Assumes that vmo_indirect_ has already been initialized
-    void ReadIndirectVmoBlock(uint32_t offset, uint32_t** entry);
-
-    // Clears the block at |offset| in memory.
-    // Assumes that vmo_indirect_ has already been initialized
-    void ClearIndirectVmoBlock(uint32_t offset);
 
     // Use the watcher container to implement a directory watcher
     void Notify(fbl::StringPiece name, unsigned event) final;
@@ -666,12 +675,6 @@ private:
     zx::channel DetachRemote() final;
     zx_handle_t GetRemote() const final;
     void SetRemote(zx::channel remote) final;
-#else  // !__Fuchsia__
-    // Reads the block at |bno| on disk.
-    void ReadIndirectBlock(blk_t bno, uint32_t* entry);
-
-    // Clears the block at |bno| on disk.
-    void ClearIndirectBlock(blk_t bno);
 #endif
 
 #ifdef __Fuchsia__
@@ -682,19 +685,32 @@ private:
     zx::vmo vmo_{};
     uint64_t vmo_size_ = 0;
 
-    // vmo_indirect_ contains all indirect and doubly indirect blocks in the following order:
-    // First kMinfsIndirect blocks                                - initial set of indirect blocks
-    // Next kMinfsDoublyIndirect blocks                           - doubly indirect blocks
-    // Next kMinfsDoublyIndirect * kMinfsDirectPerIndirect blocks - indirect blocks pointed to
-    //                                                              by doubly indirect blocks
-    fbl::unique_ptr<fzl::ResizeableVmoMapper> vmo_indirect_;
+    // vmo_extents_ holds the extent blocks of the vnode, once they have been read in. Each
+    // stays in the same block of the VMO, recorded in |extent_slots_|, for as long as it is
+    // in use, so that writes of it which have already been enqueued remain valid.
+    fbl::unique_ptr<fzl::ResizeableVmoMapper> vmo_extents_;
 
     vmoid_t vmoid_{};
-    vmoid_t vmoid_indirect_{};
+    vmoid_t vmoid_extents_{};
+
+    // The blocks of the file which are dirty in |vmo_|, and the blocks reserved for those of
+    // them which are holes.
+    bitmap::RleBitmap dirty_blocks_;
+    fbl::unique_ptr<AllocatorPromise> dirty_promise_;
+    // Whether the vnode is in the |dirty_vnodes_| of |fs_|, which guards this.
+    bool dirty_listed_ = false;
+    // The number of the blocks in |dirty_promise_| which are reserved for the extent blocks
+    // that mapping the holes may need, rather than for the holes themselves.
+    blk_t dirty_extent_blocks_ = 0;
 
     fs::RemoteContainer remoter_{};
     fs::WatcherContainer watcher_{};
+#else
+    // The extent blocks of the vnode, once they have been read in, kept as in vmo_extents_.
+    fbl::unique_ptr<ExtentBlock[]> extent_blocks_;
 #endif
+    // For each of |inode_.extent_refs|, the block of vmo_extents_ holding its extent block.
+    uint8_t extent_slots_[kMinfsExtentRefs] = {};
 
     ino_t ino_{};
     Inode inode_{};
@@ -704,39 +720,30 @@ private:
     // VnodeMinfs's own refcount, since there may still be filesystem
     // work to do after the last file descriptor has been closed.
     uint32_t fd_count_{};
-};
-
-// Return the block offset in vmo_indirect_ of indirect blocks pointed to by the doubly indirect
-// block at dindex
-constexpr uint32_t GetVmoOffsetForIndirect(uint32_t dibindex) {
-    return kMinfsIndirect + kMinfsDoublyIndirect + (dibindex * kMinfsDirectPerIndirect);
-}
 
-// Return the required vmo size (in bytes) to store indirect blocks pointed to by doubly indirect
-// block dibindex
-constexpr size_t GetVmoSizeForIndirect(uint32_t dibindex) {
-    return GetVmoOffsetForIndirect(dibindex + 1) * kMinfsBlockSize;
-}
-
-// Return the block offset of doubly indirect blocks in vmo_indirect_
-constexpr uint32_t GetVmoOffsetForDoublyIndirect(uint32_t dibindex) {
-    ZX_DEBUG_ASSERT(dibindex < kMinfsDoublyIndirect);
-    return kMinfsIndirect + dibindex;
-}
-
-// Return the required vmo size (in bytes) to store doubly indirect blocks in vmo_indirect_
-constexpr size_t GetVmoSizeForDoublyIndirect() {
-    return (kMinfsIndirect + kMinfsDoublyIndirect) * kMinfsBlockSize;
-}
+    // For directories with an index: the index's inode, and a copy of its header, which is
+    // only kept while it is up to date with the directory.
+    fbl::RefPtr<VnodeMinfs> dir_index_vn_;
+    fbl::unique_ptr<DirIndexHeader> dir_index_;
+    // Set if the index could not be built or kept up to date, so that it is not tried again.
+    bool dir_index_failed_ = false;
+    // Set for the file holding the index of a directory. Its blocks are metadata, which goes
+    // through the journal like the blocks of directories.
+    bool is_dir_index_ = false;
+};
 
 // write the inode data of this vnode to disk (default does not update time values)
 void SyncVnode(fbl::RefPtr<VnodeMinfs> vn, uint32_t flags);
 void DumpInfo(const Superblock* info);
 void DumpInode(const Inode* inode, ino_t ino);
 void InitializeDirectory(void* bdata, ino_t ino_self, ino_t ino_parent);
+// Checks that |de|, of which |bytes_read| bytes were read from offset |off| of a directory,
+// is a well-formed dirent.
+zx_status_t ValidateDirent(Dirent* de, size_t bytes_read, size_t off);
 
 // Given an input bcache, initialize the filesystem and return a reference to the
 // root node.
-zx_status_t Mount(fbl::unique_ptr<minfs::Bcache> bc, fbl::RefPtr<VnodeMinfs>* root_out);
+zx_status_t Mount(fbl::unique_ptr<minfs::Bcache> bc, const MountOptions& options,
+                  fbl::RefPtr<VnodeMinfs>* root_out);
 
 } // namespace minfs
@@ -245,7 +245,7 @@ zx_status_t CheckSuperblock(const Superblock* info, Bcache* bc) {
 }
 
 #ifndef __Fuchsia__
-BlockOffsets::BlockOffsets(const Bcache& bc, const SuperblockManager& sb) {
+BlockOffsets::BlockOffsets(const Bcache& bc, const Superblock& info) {
     if (bc.extent_lengths_.size() > 0) {
         ZX_ASSERT(bc.extent_lengths_.size() == kExtentCount);
         ibm_block_count_ = bc.extent_lengths_[1] / kMinfsBlockSize;
@@ -260,17 +260,17 @@ BlockOffsets::BlockOffsets(const Bcache& bc, const SuperblockManager& sb) {
         journal_start_block_ = ino_start_block_ + ino_block_count_;
         dat_start_block_ = journal_start_block_ + journal_block_count_;
     } else {
-        ibm_start_block_ = sb.Info().ibm_block;
-        abm_start_block_ = sb.Info().abm_block;
-        ino_start_block_ = sb.Info().ino_block;
-        journal_start_block_ = sb.Info().journal_start_block;
-        dat_start_block_ = sb.Info().dat_block;
+        ibm_start_block_ = info.ibm_block;
+        abm_start_block_ = info.abm_block;
+        ino_start_block_ = info.ino_block;
+        journal_start_block_ = info.journal_start_block;
+        dat_start_block_ = info.dat_block;
 
         ibm_block_count_ = abm_start_block_ - ibm_start_block_;
         abm_block_count_ = ino_start_block_ - abm_start_block_;
         ino_block_count_ = dat_start_block_ - ino_start_block_;
         journal_block_count_ = dat_start_block_ - journal_start_block_;
-        dat_block_count_ = sb.Info().block_count;
+        dat_block_count_ = info.block_count;
     }
 }
 #endif
@@ -306,7 +306,8 @@ zx_status_t Minfs::BeginTransaction(size_t reserve_inodes, size_t reserve_blocks
 void Minfs::CommitTransaction(fbl::unique_ptr<Transaction> state) {
     // On enqueue, unreserve any remaining reserved blocks/inodes tracked by work.
 #ifdef __Fuchsia__
-    ZX_DEBUG_ASSERT(state->GetWork()->BlkCount() <= limits_.GetMaximumEntryDataBlocks());
+    // Only metadata goes into the journal entry; file data is written in place.
+    ZX_DEBUG_ASSERT(state->GetWork()->MetadataBlkCount() <= limits_.GetMaximumEntryDataBlocks());
     writeback_->Enqueue(state->RemoveWork());
 #else
     state->GetWork()->Complete();
@@ -315,6 +316,7 @@ void Minfs::CommitTransaction(fbl::unique_ptr<Transaction> state) {
 
 #ifdef __Fuchsia__
 void Minfs::Sync(SyncCallback closure) {
+    FlushDirtyVnodes();
     fbl::unique_ptr<Transaction> state;
     ZX_ASSERT(BeginTransaction(0, 0, &state) == ZX_OK);
     state->GetWork()->SetClosure(std::move(closure));
@@ -338,6 +340,9 @@ Minfs::Minfs(fbl::unique_ptr<Bcache> bc, fbl::unique_ptr<SuperblockManager> sb,
 #endif
 
 Minfs::~Minfs() {
+#ifdef __Fuchsia__
+    DropDirtyVnodes();
+#endif
     vnode_hash_.clear();
 }
 
@@ -355,107 +360,14 @@ zx_status_t Minfs::FVMQuery(fvm_info_t* info) const {
 zx_status_t Minfs::InoFree(VnodeMinfs* vn, WritebackWork* wb) {
     TRACE_DURATION("minfs", "Minfs::InoFree", "ino", vn->ino_);
 
-    inodes_->Free(wb, vn->ino_);
-    uint32_t block_count = vn->inode_.block_count;
-
-    // release all direct blocks
-    for (unsigned n = 0; n < kMinfsDirect; n++) {
-        if (vn->inode_.dnum[n] == 0) {
-            continue;
-        }
-        ValidateBno(vn->inode_.dnum[n]);
-        block_count--;
-        block_allocator_->Free(wb, vn->inode_.dnum[n]);
-    }
-
-    // release all indirect blocks
-    for (unsigned n = 0; n < kMinfsIndirect; n++) {
-        if (vn->inode_.inum[n] == 0) {
-            continue;
-        }
-
-#ifdef __Fuchsia__
-        zx_status_t status;
-        if ((status = vn->InitIndirectVmo()) != ZX_OK) {
-            return status;
-        }
-
-        uint32_t* entry;
-        vn->ReadIndirectVmoBlock(n, &entry);
-#else
-        uint32_t entry[kMinfsBlockSize];
-        vn->ReadIndirectBlock(vn->inode_.inum[n], entry);
-#endif
-
-        // release the direct blocks pointed at by the entries in the indirect block
-        for (unsigned m = 0; m < kMinfsDirectPerIndirect; m++) {
-            if (entry[m] == 0) {
-                continue;
-            }
-            block_count--;
-            block_allocator_->Free(wb, entry[m]);
-        }
-        // release the direct block itself
-        block_count--;
-        block_allocator_->Free(wb, vn->inode_.inum[n]);
-    }
-
-    // release doubly indirect blocks
-    for (unsigned n = 0; n < kMinfsDoublyIndirect; n++) {
-        if (vn->inode_.dinum[n] == 0) {
-            continue;
-        }
-#ifdef __Fuchsia__
-        zx_status_t status;
-        if ((status = vn->InitIndirectVmo()) != ZX_OK) {
-            return status;
-        }
-
-        uint32_t* dentry;
-        vn->ReadIndirectVmoBlock(GetVmoOffsetForDoublyIndirect(n), &dentry);
-#else
-        uint32_t dentry[kMinfsBlockSize];
-        vn->ReadIndirectBlock(vn->inode_.dinum[n], dentry);
-#endif
-        // release indirect blocks
-        for (unsigned m = 0; m < kMinfsDirectPerIndirect; m++) {
-            if (dentry[m] == 0) {
-                continue;
-            }
-
-#ifdef __Fuchsia__
-            if ((status = vn->LoadIndirectWithinDoublyIndirect(n)) != ZX_OK) {
-                return status;
-            }
-
-            uint32_t* entry;
-            vn->ReadIndirectVmoBlock(GetVmoOffsetForIndirect(n) + m, &entry);
-
-#else
-            uint32_t entry[kMinfsBlockSize];
-            vn->ReadIndirectBlock(dentry[m], entry);
-#endif
-
-            // release direct blocks
-            for (unsigned k = 0; k < kMinfsDirectPerIndirect; k++) {
-                if (entry[k] == 0) {
-                    continue;
-                }
-
-                block_count--;
-                block_allocator_->Free(wb, entry[k]);
-            }
-
-            block_count--;
-            block_allocator_->Free(wb, dentry[m]);
-        }
-
-        // release the doubly indirect block itself
-        block_count--;
-        block_allocator_->Free(wb, vn->inode_.dinum[n]);
+    // Release the data blocks of the inode, along with any extent blocks mapping them.
+    zx_status_t status;
+    if ((status = vn->BlocksShrink(wb, 0)) != ZX_OK) {
+        return status;
     }
+    inodes_->Free(wb, vn->ino_);
 
-    ZX_DEBUG_ASSERT(block_count == 0);
+    ZX_DEBUG_ASSERT(vn->inode_.block_count == 0);
     ZX_DEBUG_ASSERT(vn->IsUnlinked());
     return ZX_OK;
 }
@@ -667,6 +579,63 @@ void Minfs::VnodeRelease(VnodeMinfs* vn) {
     vnode_hash_.erase(*vn);
 }
 
+#ifdef __Fuchsia__
+void Minfs::VnodeMarkDirty(VnodeMinfs* vn) {
+    {
+        fbl::AutoLock lock(&hash_lock_);
+        if (vn->dirty_listed_) {
+            return;
+        }
+        vn->dirty_listed_ = true;
+        dirty_vnodes_.push_back(fbl::WrapRefPtr(vn));
+    }
+    if (dispatcher() != nullptr && !flush_dirty_task_.is_pending()) {
+        flush_dirty_task_.PostDelayed(dispatcher(), zx::duration(kMinfsDirtyExpire));
+    }
+}
+
+void Minfs::FlushDirtyVnodes() {
+    fbl::Vector<fbl::RefPtr<VnodeMinfs>> vnodes;
+    {
+        fbl::AutoLock lock(&hash_lock_);
+        vnodes.swap(dirty_vnodes_);
+        for (const fbl::RefPtr<VnodeMinfs>& vn : vnodes) {
+            vn->dirty_listed_ = false;
+        }
+    }
+    // Releasing the vnodes once they are clean lets them go as usual, while the rest go straight
+    // back to |dirty_vnodes_|, to be tried again.
+    for (const fbl::RefPtr<VnodeMinfs>& vn : vnodes) {
+        zx_status_t status;
+        if ((status = vn->FlushDirtyBlocks()) != ZX_OK) {
+            FS_TRACE_ERROR("minfs: ino#%u: failed to write back dirty blocks: %d\n", vn->ino_,
+                           status);
+        }
+        if (vn->dirty_blocks_.num_bits() > 0) {
+            VnodeMarkDirty(vn.get());
+        }
+    }
+}
+
+void Minfs::DropDirtyVnodes() {
+    fbl::Vector<fbl::RefPtr<VnodeMinfs>> vnodes;
+    {
+        fbl::AutoLock lock(&hash_lock_);
+        vnodes.swap(dirty_vnodes_);
+        for (const fbl::RefPtr<VnodeMinfs>& vn : vnodes) {
+            vn->dirty_listed_ = false;
+        }
+    }
+    for (const fbl::RefPtr<VnodeMinfs>& vn : vnodes) {
+        if (vn->dirty_blocks_.num_bits() > 0) {
+            FS_TRACE_ERROR("minfs: ino#%u: dropping %zu dirty blocks\n", vn->ino_,
+                           vn->dirty_blocks_.num_bits());
+            vn->DropDirtyBlocks(0);
+        }
+    }
+}
+#endif
+
 zx_status_t Minfs::VnodeGet(fbl::RefPtr<VnodeMinfs>* out, ino_t ino) {
     TRACE_DURATION("minfs", "Minfs::VnodeGet", "ino", ino);
     if ((ino < 1) || (ino >= Info().inode_count)) {
@@ -695,15 +664,29 @@ zx_status_t Minfs::VnodeGet(fbl::RefPtr<VnodeMinfs>* out, ino_t ino) {
 }
 
 // Allocate a new data block from the block bitmap.
-void Minfs::BlockNew(Transaction* state, blk_t* out_bno) {
-    size_t allocated_bno = state->AllocateBlock();
+void Minfs::BlockNew(Transaction* state, blk_t goal, blk_t* out_bno) {
+    size_t allocated_bno = (goal != 0) ? state->AllocateBlockNear(goal) : state->AllocateBlock();
     *out_bno = static_cast<blk_t>(allocated_bno);
 }
 
+blk_t Minfs::BlocksNew(Transaction* state, blk_t goal, blk_t count, blk_t* out_bno) {
+    size_t allocated_bno;
+    size_t allocated = state->AllocateBlockRun(goal, count, &allocated_bno);
+    *out_bno = static_cast<blk_t>(allocated_bno);
+    return static_cast<blk_t>(allocated);
+}
+
 void Minfs::BlockFree(WriteTxn* txn, blk_t bno) {
     block_allocator_->Free(txn, bno);
 }
 
+void Minfs::MetadataBlockFree(WriteTxn* txn, blk_t bno) {
+    BlockFree(txn, bno);
+#ifdef __Fuchsia__
+    txn->Revoke(bno + Info().dat_block);
+#endif
+}
+
 void InitializeDirectory(void* bdata, ino_t ino_self, ino_t ino_parent) {
 #define DE0_SIZE DirentSize(1)
 
@@ -726,7 +709,7 @@ void InitializeDirectory(void* bdata, ino_t ino_self, ino_t ino_parent) {
 }
 
 zx_status_t Minfs::Create(fbl::unique_ptr<Bcache> bc, const Superblock* info,
-                          fbl::unique_ptr<Minfs>* out) {
+                          const MountOptions& options, fbl::unique_ptr<Minfs>* out) {
 #ifndef __Fuchsia__
     if (bc->extent_lengths_.size() != 0 && bc->extent_lengths_.size() != kExtentCount) {
         FS_TRACE_ERROR("minfs: invalid number of extents\n");
@@ -747,7 +730,7 @@ zx_status_t Minfs::Create(fbl::unique_ptr<Bcache> bc, const Superblock* info,
     const blk_t ibm_start_block = sb->Info().ibm_block;
     const blk_t ino_start_block = sb->Info().ino_block;
 #else
-    BlockOffsets offsets(*bc, *sb);
+    BlockOffsets offsets(*bc, sb->Info());
     const blk_t abm_start_block = offsets.AbmStartBlock();
     const blk_t ibm_start_block = offsets.IbmStartBlock();
     const blk_t ino_start_block = offsets.InoStartBlock();
@@ -805,8 +788,22 @@ zx_status_t Minfs::Create(fbl::unique_ptr<Bcache> bc, const Superblock* info,
         return status;
     }
 
+    fbl::unique_ptr<Journal> journal;
+    if (options.journal) {
+        blk_t journal_start;
+        blk_t journal_blocks;
+        GetJournalBlocks(*bc, sb->Info(), &journal_start, &journal_blocks);
+        status = Journal::Create(bc.get(), journal_start, journal_blocks,
+                                 TransactionLimits(sb->Info()), &journal);
+        if (status != ZX_OK) {
+            FS_TRACE_ERROR("minfs: failed to create journal: %d\n", status);
+            return status;
+        }
+    }
+
     fbl::unique_ptr<WritebackBuffer> writeback;
-    status = WritebackBuffer::Create(bc.get(), std::move(mapper), &writeback);
+    status = WritebackBuffer::Create(bc.get(), std::move(mapper), std::move(journal),
+                                     &writeback);
     if (status != ZX_OK) {
         return status;
     }
@@ -834,10 +831,16 @@ zx_status_t Minfs::Create(fbl::unique_ptr<Bcache> bc, const Superblock* info,
     return ZX_OK;
 }
 
-zx_status_t Mount(fbl::unique_ptr<minfs::Bcache> bc, fbl::RefPtr<VnodeMinfs>* root_out) {
+zx_status_t Mount(fbl::unique_ptr<minfs::Bcache> bc, const MountOptions& options,
+                  fbl::RefPtr<VnodeMinfs>* root_out) {
     TRACE_DURATION("minfs", "minfs_mount");
     zx_status_t status;
 
+    if ((status = ReplayJournal(bc.get())) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: could not replay journal\n");
+        return status;
+    }
+
     char blk[kMinfsBlockSize];
     if ((status = bc->Readblk(0, &blk)) != ZX_OK) {
         FS_TRACE_ERROR("minfs: could not read info block\n");
@@ -846,7 +849,7 @@ zx_status_t Mount(fbl::unique_ptr<minfs::Bcache> bc, fbl::RefPtr<VnodeMinfs>* ro
     const Superblock* info = reinterpret_cast<Superblock*>(blk);
 
     fbl::unique_ptr<Minfs> fs;
-    if ((status = Minfs::Create(std::move(bc), info, &fs)) != ZX_OK) {
+    if ((status = Minfs::Create(std::move(bc), info, options, &fs)) != ZX_OK) {
         FS_TRACE_ERROR("minfs: mount failed\n");
         return status;
     }
@@ -870,7 +873,7 @@ zx_status_t MountAndServe(const MountOptions* options, async_dispatcher_t* dispa
     TRACE_DURATION("minfs", "MountAndServe");
 
     fbl::RefPtr<VnodeMinfs> vn;
-    zx_status_t status = Mount(std::move(bc), &vn);
+    zx_status_t status = Mount(std::move(bc), *options, &vn);
     if (status != ZX_OK) {
         return status;
     }
@@ -887,6 +890,9 @@ void Minfs::Shutdown(fs::Vfs::ShutdownCallback cb) {
     ManagedVfs::Shutdown([this, cb = std::move(cb)](zx_status_t status) mutable {
         Sync([this, cb = std::move(cb)](zx_status_t) mutable {
             async::PostTask(dispatcher(), [this, cb = std::move(cb)]() mutable {
+                // Nothing is left dirty after the sync, and nothing can write now.
+                flush_dirty_task_.Cancel();
+
                 // Ensure writeback buffer completes before auxiliary structures
                 // are deleted.
                 writeback_ = nullptr;
@@ -1132,7 +1138,10 @@ zx_status_t Mkfs(const MountOptions& options, fbl::unique_ptr<Bcache> bc) {
     ino[kMinfsRootIno].block_count = 1;
     ino[kMinfsRootIno].link_count = 2;
     ino[kMinfsRootIno].dirent_count = 2;
-    ino[kMinfsRootIno].dnum[0] = 1;
+    ino[kMinfsRootIno].extent_count = 1;
+    ino[kMinfsRootIno].extents[0].start = 0;
+    ino[kMinfsRootIno].extents[0].bno = 1;
+    ino[kMinfsRootIno].extents[0].length = 1;
     bc->Writeblk(info.ino_block, blk);
 
     memset(blk, 0, sizeof(blk));
@@ -1213,16 +1222,16 @@ zx_status_t SparseFsck(fbl::unique_fd fd, off_t start, off_t end,
 }
 #endif
 
-void Minfs::UpdateInitMetrics(uint32_t dnum_count, uint32_t inum_count, uint32_t dinum_count,
+void Minfs::UpdateInitMetrics(uint32_t extent_count, uint32_t extent_block_count,
                               uint64_t user_data_size, const fs::Duration& duration) {
 #ifdef FS_WITH_METRICS
     if (collecting_metrics_) {
+        fbl::AutoLock lock(&read_metrics_lock_);
         metrics_.initialized_vmos++;
         metrics_.init_user_data_size += user_data_size;
         metrics_.init_user_data_ticks += duration.get();
-        metrics_.init_dnum_count += dnum_count;
-        metrics_.init_inum_count += inum_count;
-        metrics_.init_dinum_count += dinum_count;
+        metrics_.init_extent_count += extent_count;
+        metrics_.init_extent_block_count += extent_block_count;
     }
 #endif
 }
@@ -1250,6 +1259,7 @@ void Minfs::UpdateCreateMetrics(bool success, const fs::Duration& duration) {
 void Minfs::UpdateReadMetrics(uint64_t size, const fs::Duration& duration) {
 #ifdef FS_WITH_METRICS
     if (collecting_metrics_) {
+        fbl::AutoLock lock(&read_metrics_lock_);
         metrics_.read_calls++;
         metrics_.read_size += size;
         metrics_.read_ticks += duration.get();
@@ -45,24 +45,6 @@ zx_time_t GetTimeUTC() {
     return time;
 }
 
-zx_status_t ValidateDirent(Dirent* de, size_t bytes_read, size_t off) {
-    uint32_t reclen = static_cast<uint32_t>(MinfsReclen(de, off));
-    if ((bytes_read < MINFS_DIRENT_SIZE) || (reclen < MINFS_DIRENT_SIZE)) {
-        FS_TRACE_ERROR("vn_dir: Could not read dirent at offset: %zd\n", off);
-        return ZX_ERR_IO;
-    } else if ((off + reclen > kMinfsMaxDirectorySize) || (reclen & 3)) {
-        FS_TRACE_ERROR("vn_dir: bad reclen %u > %u\n", reclen, kMinfsMaxDirectorySize);
-        return ZX_ERR_IO;
-    } else if (de->ino != 0) {
-        if ((de->namelen == 0) ||
-            (de->namelen > (reclen - MINFS_DIRENT_SIZE))) {
-            FS_TRACE_ERROR("vn_dir: bad namelen %u / %u\n", de->namelen, reclen);
-            return ZX_ERR_IO;
-        }
-    }
-    return ZX_OK;
-}
-
 // Updates offset information to move to the next direntry in the directory.
 zx_status_t NextDirent(Dirent* de, DirectoryOffset* offs) {
     offs->off_prev = offs->off;
@@ -112,6 +94,24 @@ private:
 
 } // namespace anonymous
 
+zx_status_t ValidateDirent(Dirent* de, size_t bytes_read, size_t off) {
+    uint32_t reclen = static_cast<uint32_t>(MinfsReclen(de, off));
+    if ((bytes_read < MINFS_DIRENT_SIZE) || (reclen < MINFS_DIRENT_SIZE)) {
+        FS_TRACE_ERROR("vn_dir: Could not read dirent at offset: %zd\n", off);
+        return ZX_ERR_IO;
+    } else if ((off + reclen > kMinfsMaxDirectorySize) || (reclen & 3)) {
+        FS_TRACE_ERROR("vn_dir: bad reclen %u > %u\n", reclen, kMinfsMaxDirectorySize);
+        return ZX_ERR_IO;
+    } else if (de->ino != 0) {
+        if ((de->namelen == 0) ||
+            (de->namelen > (reclen - MINFS_DIRENT_SIZE))) {
+            FS_TRACE_ERROR("vn_dir: bad namelen %u / %u\n", de->namelen, reclen);
+            return ZX_ERR_IO;
+        }
+    }
+    return ZX_OK;
+}
+
 void VnodeMinfs::SetIno(ino_t ino) {
     ZX_DEBUG_ASSERT(ino_ == 0);
     ino_ = ino;
@@ -133,116 +133,7 @@ void VnodeMinfs::InodeSync(WritebackWork* wb, uint32_t flags) {
     fs_->InodeUpdate(wb, ino_, &inode_);
 }
 
-// Delete all blocks (relative to a file) from "start" (inclusive) to the end of
-// the file. Does not update mtime/atime.
-zx_status_t VnodeMinfs::BlocksShrink(Transaction* state, blk_t start) {
-    ZX_DEBUG_ASSERT(state != nullptr);
-    BlockOpArgs op_args(start, static_cast<blk_t>(kMinfsMaxFileBlock - start), nullptr);
-    zx_status_t status;
-    if ((status = ApplyOperation(state, BlockOp::kDelete, &op_args)) != ZX_OK) {
-        return status;
-    }
-
 #ifdef __Fuchsia__
-    // Arbitrary minimum size for indirect vmo
-    size_t size = (kMinfsIndirect + kMinfsDoublyIndirect) * kMinfsBlockSize;
-    // Number of blocks before dindirect blocks start
-    blk_t pre_dindirect = kMinfsDirect + kMinfsDirectPerIndirect * kMinfsIndirect;
-    if (start > pre_dindirect) {
-        blk_t distart = start - pre_dindirect; //first bno relative to dindirect blocks
-        blk_t last_dindirect = distart / (kMinfsDirectPerDindirect); // index of last dindirect
-
-        // Calculate new size for indirect vmo
-        if (distart % kMinfsDirectPerDindirect) {
-            size = GetVmoSizeForIndirect(last_dindirect);
-        } else if (last_dindirect) {
-            size = GetVmoSizeForIndirect(last_dindirect - 1);
-        }
-    }
-
-    // Shrink the indirect vmo if necessary
-    if (vmo_indirect_ != nullptr && vmo_indirect_->size() > size) {
-        if ((status = vmo_indirect_->Shrink(size)) != ZX_OK) {
-            return status;
-        }
-    }
-#endif
-    return ZX_OK;
-}
-
-#ifdef __Fuchsia__
-zx_status_t VnodeMinfs::LoadIndirectBlocks(blk_t* iarray, uint32_t count, uint32_t offset,
-                                           uint64_t size) {
-    zx_status_t status;
-    if ((status = InitIndirectVmo()) != ZX_OK) {
-        return status;
-    }
-
-    if (vmo_indirect_->size() < size) {
-        zx_status_t status;
-        if ((status = vmo_indirect_->Grow(size)) != ZX_OK) {
-            return status;
-        }
-    }
-
-    fs::ReadTxn txn(fs_->bc_.get());
-
-    for (uint32_t i = 0; i < count; i++) {
-        blk_t ibno;
-        if ((ibno = iarray[i]) != 0) {
-            fs_->ValidateBno(ibno);
-            txn.Enqueue(vmoid_indirect_, offset + i, ibno + fs_->Info().dat_block, 1);
-        }
-    }
-
-    return txn.Transact();
-}
-
-zx_status_t VnodeMinfs::LoadIndirectWithinDoublyIndirect(uint32_t dindex) {
-    uint32_t* dientry;
-
-    size_t size = GetVmoSizeForIndirect(dindex);
-    if (vmo_indirect_->size() >= size) {
-        // We've already loaded this indirect (within dind) block.
-        return ZX_OK;
-    }
-
-    ReadIndirectVmoBlock(GetVmoOffsetForDoublyIndirect(dindex), &dientry);
-    return LoadIndirectBlocks(dientry, kMinfsDirectPerIndirect,
-                              GetVmoOffsetForIndirect(dindex), size);
-}
-
-zx_status_t VnodeMinfs::InitIndirectVmo() {
-    if (vmo_indirect_ != nullptr) {
-        return ZX_OK;
-    }
-
-    vmo_indirect_ = fzl::ResizeableVmoMapper::Create(
-            kMinfsBlockSize * (kMinfsIndirect + kMinfsDoublyIndirect), "minfs-indirect");
-
-    zx_status_t status;
-    if ((status = fs_->bc_->AttachVmo(vmo_indirect_->vmo(), &vmoid_indirect_)) != ZX_OK) {
-        vmo_indirect_ = nullptr;
-        return status;
-    }
-
-    // Load initial set of indirect blocks
-    if ((status = LoadIndirectBlocks(inode_.inum, kMinfsIndirect, 0, 0)) != ZX_OK) {
-        vmo_indirect_ = nullptr;
-        return status;
-    }
-
-    // Load doubly indirect blocks
-    if ((status = LoadIndirectBlocks(inode_.dinum, kMinfsDoublyIndirect,
-                                     GetVmoOffsetForDoublyIndirect(0),
-                                     GetVmoSizeForDoublyIndirect()) != ZX_OK)) {
-        vmo_indirect_ = nullptr;
-        return status;
-    }
-
-    return ZX_OK;
-}
-
 // Since we cannot yet register the filesystem as a paging service (and cleanly
 // fault on pages when they are actually needed), we currently read an entire
 // file to a VMO when a file's data block are accessed.
@@ -270,92 +161,41 @@ zx_status_t VnodeMinfs::InitVmo() {
         return status;
     }
     fs::ReadTxn txn(fs_->bc_.get());
-    uint32_t dnum_count = 0;
-    uint32_t inum_count = 0;
-    uint32_t dinum_count = 0;
+    uint32_t extent_count = 0;
+    uint32_t extent_block_count = 0;
     fs::Ticker ticker(fs_->StartTicker());
     auto get_metrics = fbl::MakeAutoCall([&]() {
-        fs_->UpdateInitMetrics(dnum_count, inum_count, dinum_count, vmo_size,
-                               ticker.End());
+        fs_->UpdateInitMetrics(extent_count, extent_block_count, vmo_size, ticker.End());
     });
 
-    // Initialize all direct blocks
-    blk_t bno;
-    for (uint32_t d = 0; d < kMinfsDirect; d++) {
-        if ((bno = inode_.dnum[d]) != 0) {
-            fs_->ValidateBno(bno);
-            dnum_count++;
-            txn.Enqueue(vmoid_, d, bno + fs_->Info().dat_block, 1);
+    const Extent* extents = inode_.extents;
+    uint32_t count = inode_.extent_count;
+    if (inode_.extent_depth != 0) {
+        if ((status = LoadExtentBlocks()) != ZX_OK) {
+            vmo_.reset();
+            return status;
         }
+        extent_block_count = inode_.extent_count;
     }
 
-    // Initialize all indirect blocks
-    for (uint32_t i = 0; i < kMinfsIndirect; i++) {
-        blk_t ibno;
-        if ((ibno = inode_.inum[i]) != 0) {
-            fs_->ValidateBno(ibno);
-            inum_count++;
-
-            // Only initialize the indirect vmo if it is being used.
-            if ((status = InitIndirectVmo()) != ZX_OK) {
-                vmo_.reset();
-                return status;
-            }
-
-            uint32_t* ientry;
-            ReadIndirectVmoBlock(i, &ientry);
-
-            for (uint32_t j = 0; j < kMinfsDirectPerIndirect; j++) {
-                if ((bno = ientry[j]) != 0) {
-                    fs_->ValidateBno(bno);
-                    uint32_t n = kMinfsDirect + i * kMinfsDirectPerIndirect + j;
-                    txn.Enqueue(vmoid_, n, bno + fs_->Info().dat_block, 1);
-                }
-            }
+    // Read in each extent as a single run of blocks.
+    const blk_t vmo_blocks = static_cast<blk_t>(vmo_size / kMinfsBlockSize);
+    for (uint32_t ref = 0; ref < fbl::max(extent_block_count, 1u); ref++) {
+        if (extent_block_count != 0) {
+            const ExtentBlock* block = GetExtentBlock(ref);
+            extents = block->extents;
+            count = block->count;
         }
-    }
-
-    // Initialize all doubly indirect blocks
-    for (uint32_t i = 0; i < kMinfsDoublyIndirect; i++) {
-        blk_t dibno;
-
-        if ((dibno = inode_.dinum[i]) != 0) {
-            fs_->ValidateBno(dibno);
-            dinum_count++;
-
-            // Only initialize the doubly indirect vmo if it is being used.
-            if ((status = InitIndirectVmo()) != ZX_OK) {
-                vmo_.reset();
-                return status;
-            }
-
-            uint32_t* dientry;
-            ReadIndirectVmoBlock(GetVmoOffsetForDoublyIndirect(i), &dientry);
-
-            for (uint32_t j = 0; j < kMinfsDirectPerIndirect; j++) {
-                blk_t ibno;
-                if ((ibno = dientry[j]) != 0) {
-                    fs_->ValidateBno(ibno);
-
-                    // Only initialize the indirect vmo if it is being used.
-                    if ((status = LoadIndirectWithinDoublyIndirect(i)) != ZX_OK) {
-                        vmo_.reset();
-                        return status;
-                    }
-
-                    uint32_t* ientry;
-                    ReadIndirectVmoBlock(GetVmoOffsetForIndirect(i) + j, &ientry);
-
-                    for (uint32_t k = 0; k < kMinfsDirectPerIndirect; k++) {
-                        if ((bno = ientry[k]) != 0) {
-                            fs_->ValidateBno(bno);
-                            uint32_t n = kMinfsDirect + kMinfsIndirect * kMinfsDirectPerIndirect
-                                         + j * kMinfsDirectPerIndirect + k;
-                            txn.Enqueue(vmoid_, n, bno + fs_->Info().dat_block, 1);
-                        }
-                    }
-                }
+        for (uint32_t i = 0; i < count; i++) {
+            const Extent& extent = extents[i];
+            if (extent.start >= vmo_blocks) {
+                break;
             }
+            blk_t length = fbl::min(extent.length, vmo_blocks - extent.start);
+            fs_->ValidateBno(extent.bno);
+            fs_->ValidateBno(extent.bno + length - 1);
+            extent_count++;
+            txn.Enqueue(vmoid_, extent.start, extent.bno + fs_->Info().dat_block, length);
         }
     }
 
@@ -365,351 +205,18 @@ zx_status_t VnodeMinfs::InitVmo() {
 }
 #endif
 
-void VnodeMinfs::AllocateIndirect(Transaction* state, blk_t index, IndirectArgs* args) {
-    ZX_DEBUG_ASSERT(state != nullptr);
-
-    // *bno must not be already allocated
-    ZX_DEBUG_ASSERT(args->GetBno(index) == 0);
-
-    // allocate new indirect block
-    blk_t bno;
-    fs_->BlockNew(state, &bno);
-
-#ifdef __Fuchsia__
-    ClearIndirectVmoBlock(args->GetOffset() + index);
-#else
-    ClearIndirectBlock(bno);
-#endif
-
-    args->SetBno(index, bno);
-    inode_.block_count++;
-}
-
-zx_status_t VnodeMinfs::BlockOpDirect(Transaction* state, DirectArgs* params) {
-    for (unsigned i = 0; i < params->GetCount(); i++) {
-        blk_t bno = params->GetBno(i);
-        switch (params->GetOp()) {
-            case BlockOp::kDelete: {
-                // If we found a valid block, delete it.
-                if (bno) {
-                    fs_->ValidateBno(bno);
-                    fs_->BlockFree(state->GetWork(), bno);
-                    params->SetBno(i, 0);
-                    inode_.block_count--;
-                }
-                break;
-            }
-            case BlockOp::kWrite: {
-                ZX_DEBUG_ASSERT(state != nullptr);
-                if (bno == 0) {
-                    fs_->BlockNew(state, &bno);
-                    inode_.block_count++;
-                }
-
-                fs_->ValidateBno(bno);
-            }
-            __FALLTHROUGH;
-            case BlockOp::kRead: {
-                params->SetBno(i, bno);
-                break;
-            }
-            default: {
-                return ZX_ERR_NOT_SUPPORTED;
-            }
-        }
-    }
-
-    return ZX_OK;
-}
-
-zx_status_t VnodeMinfs::BlockOpIndirect(Transaction* state, IndirectArgs* params) {
-    // we should have initialized vmo before calling this method
-    zx_status_t status;
-
-#ifdef __Fuchsia__
-    if (params->GetOp() == BlockOp::kRead || params->GetOp() == BlockOp::kWrite) {
-        ValidateVmoSize(vmo_indirect_->vmo().get(), params->GetOffset() + params->GetCount());
-    }
-#endif
-
-    for (unsigned i = 0; i < params->GetCount(); i++) {
-        bool dirty = false;
-        if (params->GetBno(i) == 0) {
-            switch (params->GetOp()) {
-            case BlockOp::kDelete:
-                continue;
-            case BlockOp::kRead:
-                return ZX_OK;
-            case BlockOp::kWrite:
-                AllocateIndirect(state, i, params);
-                break;
-            default:
-                return ZX_ERR_NOT_SUPPORTED;
-            }
-
-        }
-
-#ifdef __Fuchsia__
-        blk_t* entry;
-        ReadIndirectVmoBlock(params->GetOffset() + i, &entry);
-#else
-        blk_t entry[kMinfsBlockSize];
-        ReadIndirectBlock(params->GetBno(i), entry);
-#endif
-
-        DirectArgs direct_params = params->GetDirect(entry, i);
-        if ((status = BlockOpDirect(state, &direct_params)) != ZX_OK) {
-            return status;
-        }
-
-        // only update the indirect block if an entry was deleted
-        if (dirty || direct_params.IsDirty()) {
-#ifdef __Fuchsia__
-            state->GetWork()->Enqueue(vmo_indirect_->vmo().get(), params->GetOffset() + i,
-                        params->GetBno(i) + fs_->Info().dat_block, 1);
-#else
-            fs_->bc_->Writeblk(params->GetBno(i) + fs_->Info().dat_block, entry);
-#endif
-            params->SetDirty();
-        }
-
-        // We can delete the current indirect block if all direct blocks within it are deleted
-        if (params->GetOp() == BlockOp::kDelete && direct_params.GetCount() == kMinfsDirectPerIndirect) {
-            // release the direct block itself
-            fs_->BlockFree(state->GetWork(), params->GetBno(i));
-            params->SetBno(i, 0);
-            inode_.block_count--;
-        }
-    }
-
-    return ZX_OK;
-
-}
-
-zx_status_t VnodeMinfs::BlockOpDindirect(Transaction* state, DindirectArgs* params) {
+zx_status_t VnodeMinfs::BlockGet(Transaction* state, blk_t n, blk_t* bno) {
     zx_status_t status;
-
-#ifdef __Fuchsia__
-    if (params->GetOp() == BlockOp::kRead || params->GetOp() == BlockOp::kWrite) {
-        ValidateVmoSize(vmo_indirect_->vmo().get(), params->GetOffset() + params->GetCount());
+    if ((status = ExtentLookup(n, bno)) != ZX_OK) {
+        return status;
     }
-#endif
-
-    // operate on doubly indirect blocks
-    for (unsigned i = 0; i < params->GetCount(); i++) {
-        bool dirty = false;
-        if (params->GetBno(i) == 0) {
-            switch (params->GetOp()) {
-            case BlockOp::kDelete:
-                continue;
-            case BlockOp::kRead:
-                return ZX_OK;
-            case BlockOp::kWrite:
-                AllocateIndirect(state, i, params);
-                break;
-            default:
-                return ZX_ERR_NOT_SUPPORTED;
-            }
-        }
-
-#ifdef __Fuchsia__
-        uint32_t* dientry;
-        ReadIndirectVmoBlock(GetVmoOffsetForDoublyIndirect(i), &dientry);
-#else
-        uint32_t dientry[kMinfsBlockSize];
-        ReadIndirectBlock(params->GetBno(i), dientry);
-#endif
-
-        // operate on blocks pointed at by the entries in the indirect block
-        IndirectArgs indirect_params = params->GetIndirect(dientry, i);
-        if ((status = BlockOpIndirect(state, &indirect_params)) != ZX_OK) {
-            return status;
-        }
-
-        // only update the indirect block if an entry was deleted
-        if (dirty || indirect_params.IsDirty()) {
-#ifdef __Fuchsia__
-            state->GetWork()->Enqueue(vmo_indirect_->vmo().get(), params->GetOffset() + i,
-                                      params->GetBno(i) + fs_->Info().dat_block, 1);
-#else
-            fs_->bc_->Writeblk(params->GetBno(i) + fs_->Info().dat_block, dientry);
-#endif
-            params->SetDirty();
-        }
-
-        // We can delete the current doubly indirect block if all indirect blocks within it
-        // (and direct blocks within those) are deleted
-        if (params->GetOp() == BlockOp::kDelete &&
-            indirect_params.GetCount() == kMinfsDirectPerDindirect) {
-            // release the doubly indirect block itself
-            fs_->BlockFree(state->GetWork(), params->GetBno(i));
-            params->SetBno(i, 0);
-            inode_.block_count--;
-        }
+    if (*bno == 0 && state != nullptr) {
+        blk_t mapped;
+        return ExtentMap(state, n, 1, bno, &mapped);
     }
-
     return ZX_OK;
 }
 
-#ifdef __Fuchsia__
-void VnodeMinfs::ReadIndirectVmoBlock(uint32_t offset, uint32_t** entry) {
-    ZX_DEBUG_ASSERT(vmo_indirect_ != nullptr);
-    uintptr_t addr = reinterpret_cast<uintptr_t>(vmo_indirect_->start());
-    ValidateVmoSize(vmo_indirect_->vmo().get(), offset);
-    *entry = reinterpret_cast<uint32_t*>(addr + kMinfsBlockSize * offset);
-}
-
-void VnodeMinfs::ClearIndirectVmoBlock(uint32_t offset) {
-    ZX_DEBUG_ASSERT(vmo_indirect_ != nullptr);
-    uintptr_t addr = reinterpret_cast<uintptr_t>(vmo_indirect_->start());
-    ValidateVmoSize(vmo_indirect_->vmo().get(), offset);
-    memset(reinterpret_cast<void*>(addr + kMinfsBlockSize * offset), 0, kMinfsBlockSize);
-}
-#else
-void VnodeMinfs::ReadIndirectBlock(blk_t bno, uint32_t* entry) {
-    fs_->bc_->Readblk(bno + fs_->Info().dat_block, entry);
-}
-
-void VnodeMinfs::ClearIndirectBlock(blk_t bno) {
-    uint32_t data[kMinfsBlockSize];
-    memset(data, 0, kMinfsBlockSize);
-    fs_->bc_->Writeblk(bno + fs_->Info().dat_block, data);
-}
-#endif
-
-zx_status_t VnodeMinfs::ApplyOperation(Transaction* state, BlockOp op, BlockOpArgs* op_args) {
-    blk_t start = op_args->start;
-    blk_t found = 0;
-    bool dirty = false;
-    if (found < op_args->count && start < kMinfsDirect) {
-        // array starting with first direct block
-        blk_t* array = &inode_.dnum[start];
-        // number of direct blocks to process
-        blk_t count = fbl::min(op_args->count - found, kMinfsDirect - start);
-        // if bnos exist, adjust past found (should be 0)
-        blk_t* bnos = op_args->bnos == nullptr ? nullptr : &op_args->bnos[found];
-
-        DirectArgs direct_params(op, array, count, bnos);
-        zx_status_t status;
-        if ((status = BlockOpDirect(state, &direct_params)) != ZX_OK) {
-            return status;
-        }
-
-        found += count;
-        dirty |= direct_params.IsDirty();
-    }
-
-    // for indirect blocks, adjust past the direct blocks
-    if (start < kMinfsDirect) {
-        start = 0;
-    } else {
-        start -= kMinfsDirect;
-    }
-
-    if (found < op_args->count && start < kMinfsIndirect * kMinfsDirectPerIndirect) {
-        // index of indirect block, and offset of that block within indirect vmo
-        blk_t ibindex = start / kMinfsDirectPerIndirect;
-        // index of direct block within indirect block
-        blk_t bindex = start % kMinfsDirectPerIndirect;
-
-        // array starting with first indirect block
-        blk_t* array = &inode_.inum[ibindex];
-        // number of direct blocks to process within indirect blocks
-        blk_t count = fbl::min(op_args->count - found,
-                               kMinfsIndirect * kMinfsDirectPerIndirect - start);
-        // if bnos exist, adjust past found
-        blk_t* bnos = op_args->bnos == nullptr ? nullptr : &op_args->bnos[found];
-
-        IndirectArgs indirect_params(op, array, count, bnos, bindex, ibindex);
-        zx_status_t status;
-        if ((status = BlockOpIndirect(state, &indirect_params)) != ZX_OK) {
-            return status;
-        }
-
-        found += count;
-        dirty |= indirect_params.IsDirty();
-    }
-
-    // for doubly indirect blocks, adjust past the indirect blocks
-    if (start < kMinfsIndirect * kMinfsDirectPerIndirect) {
-        start = 0;
-    } else {
-        start -= kMinfsIndirect * kMinfsDirectPerIndirect;
-    }
-
-    if (found < op_args->count &&
-        start < kMinfsDoublyIndirect * kMinfsDirectPerIndirect * kMinfsDirectPerIndirect) {
-        // index of doubly indirect block
-        uint32_t dibindex = start / (kMinfsDirectPerIndirect * kMinfsDirectPerIndirect);
-        ZX_DEBUG_ASSERT(dibindex < kMinfsDoublyIndirect);
-        start -= (dibindex * kMinfsDirectPerIndirect * kMinfsDirectPerIndirect);
-
-        // array starting with first doubly indirect block
-        blk_t* array = &inode_.dinum[dibindex];
-        // number of direct blocks to process within doubly indirect blocks
-        blk_t count = fbl::min(op_args->count - found,
-                kMinfsDoublyIndirect * kMinfsDirectPerIndirect * kMinfsDirectPerIndirect - start);
-        // if bnos exist, adjust past found
-        blk_t* bnos = op_args->bnos == nullptr ? nullptr : &op_args->bnos[found];
-        // index of direct block within indirect block
-        blk_t bindex = start % kMinfsDirectPerIndirect;
-        // offset of indirect block within indirect vmo
-        blk_t ib_vmo_offset = GetVmoOffsetForIndirect(dibindex);
-        // index of indirect block within doubly indirect block
-        blk_t ibindex = start / kMinfsDirectPerIndirect;
-        // offset of doubly indirect block within indirect vmo
-        blk_t dib_vmo_offset = GetVmoOffsetForDoublyIndirect(dibindex);
-
-        DindirectArgs dindirect_params(op, array, count, bnos, bindex, ib_vmo_offset, ibindex,
-                                       dib_vmo_offset);
-        zx_status_t status;
-        if ((status = BlockOpDindirect(state, &dindirect_params)) != ZX_OK) {
-            return status;
-        }
-
-        found += count;
-        dirty |= dindirect_params.IsDirty();
-    }
-
-    if (dirty) {
-        ZX_DEBUG_ASSERT(state != nullptr);
-        InodeSync(state->GetWork(), kMxFsSyncDefault);
-    }
-
-    // Return out of range if we were not able to process all blocks
-    return found == op_args->count ? ZX_OK : ZX_ERR_OUT_OF_RANGE;
-}
-
-zx_status_t VnodeMinfs::BlockGet(Transaction* state, blk_t n, blk_t* bno) {
-#ifdef __Fuchsia__
-    if (n >= kMinfsDirect) {
-        zx_status_t status;
-        // If the vmo_indirect_ vmo has not been created, make it now.
-        if ((status = InitIndirectVmo()) != ZX_OK) {
-            return status;
-        }
-
-        // Number of blocks prior to dindirect blocks
-        blk_t pre_dindirect = kMinfsDirect + kMinfsDirectPerIndirect * kMinfsIndirect;
-        if (n >= pre_dindirect) {
-            // Index of last doubly indirect block
-            blk_t dibindex = (n - pre_dindirect) / kMinfsDirectPerDindirect;
-            ZX_DEBUG_ASSERT(dibindex < kMinfsDoublyIndirect);
-            uint64_t vmo_size = GetVmoSizeForIndirect(dibindex);
-            // Grow VMO if we need more space to fit doubly indirect blocks
-            if (vmo_indirect_->size() < vmo_size) {
-                if ((status = vmo_indirect_->Grow(vmo_size)) != ZX_OK) {
-                    return status;
-                }
-            }
-        }
-    }
-#endif
-
-    BlockOpArgs op_args(n, 1, bno);
-    return ApplyOperation(state, state ? BlockOp::kWrite : BlockOp::kRead, &op_args);
-}
-
 zx_status_t VnodeMinfs::ReadExactInternal(void* data, size_t len, size_t off) {
     size_t actual;
     zx_status_t status = ReadInternal(data, len, off, &actual);
@@ -805,6 +312,9 @@ zx_status_t VnodeMinfs::UnlinkChild(Transaction* state,
             coalesced_size += MinfsReclen(&de_prev, off_prev);
             off = off_prev;
         }
+    } else if (off != 0) {
+        // Found through the index, so whether the dirent before it is free is not known.
+        DirIndexUnmerged();
     }
 
     if (!(de->reclen & kMinfsReclenLast) && (coalesced_size >= kMinfsReclenMask)) {
@@ -819,6 +329,10 @@ zx_status_t VnodeMinfs::UnlinkChild(Transaction* state,
     if ((status = WriteExactInternal(state, de, MINFS_DIRENT_SIZE, off)) != ZX_OK) {
         return status;
     }
+    DirIndexRemove(state, fbl::StringPiece(de->name, de->namelen), offs->off);
+    if (de->reclen & kMinfsReclenLast) {
+        DirIndexSetLast(off);
+    }
 
     if (de->reclen & kMinfsReclenLast) {
         // Truncating the directory merely removed unused space; if it fails,
@@ -851,6 +365,9 @@ void VnodeMinfs::RemoveInodeLink(WritebackWork* wb) {
     }
 
     if (IsUnlinked()) {
+        // Nothing more can be added to an unlinked directory, so its index
+        // can go straight away.
+        DropDirIndex(wb);
         if (fd_count_ == 0) {
             Purge(wb);
         } else {
@@ -1038,6 +555,10 @@ zx_status_t VnodeMinfs::AppendDirent(DirArgs* args) {
                                      args->offs.off)) != ZX_OK) {
         return status;
     }
+    DirIndexInsert(args->state, args->name, args->offs.off);
+    if (de->reclen & kMinfsReclenLast) {
+        DirIndexSetLast(args->offs.off);
+    }
 
     if (args->type == kMinfsTypeDir) {
         // Child directory has '..' which will point to parent directory
@@ -1046,6 +567,7 @@ zx_status_t VnodeMinfs::AppendDirent(DirArgs* args) {
 
     inode_.dirent_count++;
     inode_.seq_num++;
+    DirIndexSync(args->state);
     InodeSync(args->state->GetWork(), kMxFsSyncMtime);
     args->state->GetWork()->PinVnode(fbl::WrapRefPtr(this));
     return ZX_OK;
@@ -1083,6 +605,7 @@ zx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func)
             break;
         case kDirIteratorSaveSync:
             inode_.seq_num++;
+            DirIndexSync(args->state);
             InodeSync(args->state->GetWork(), kMxFsSyncMtime);
             args->state->GetWork()->PinVnode(fbl::WrapRefPtr(this));
             return ZX_OK;
@@ -1095,8 +618,85 @@ zx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func)
     return ZX_ERR_NOT_FOUND;
 }
 
+zx_status_t VnodeMinfs::FindDirent(DirArgs* args, const DirentCallback func) {
+    if (LoadDirIndex() != ZX_OK) {
+        return ForEachDirent(args, func);
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<DirIndexBucket> bucket(new (&ac) DirIndexBucket);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    const uint32_t hash = DirIndexHash(args->name.data(), args->name.length());
+    const blk_t b = dir_index_->buckets[hash & ((1u << dir_index_->depth) - 1)];
+    zx_status_t status;
+    if ((status = ReadDirIndexBucket(b, bucket.get())) != ZX_OK) {
+        return status;
+    }
+
+    char data[kMinfsMaxDirentSize];
+    Dirent* de = (Dirent*) data;
+    for (uint32_t i = 0; i < bucket->count; i++) {
+        if (bucket->entries[i].hash != hash) {
+            continue;
+        }
+        args->offs.off = bucket->entries[i].off;
+        args->offs.off_prev = args->offs.off;
+        FS_TRACE_DEBUG("Reading indexed dirent at offset %zd\n", args->offs.off);
+        size_t r;
+        if ((status = ReadInternal(data, kMinfsMaxDirentSize, args->offs.off, &r)) != ZX_OK) {
+            return status;
+        } else if ((status = ValidateDirent(de, r, args->offs.off)) != ZX_OK) {
+            return status;
+        } else if ((de->ino == 0) || fbl::StringPiece(de->name, de->namelen) != args->name) {
+            continue;
+        }
+
+        switch ((status = func(fbl::RefPtr<VnodeMinfs>(this), de, args))) {
+        case kDirIteratorNext:
+            break;
+        case kDirIteratorSaveSync:
+            inode_.seq_num++;
+            DirIndexSync(args->state);
+            InodeSync(args->state->GetWork(), kMxFsSyncMtime);
+            args->state->GetWork()->PinVnode(fbl::WrapRefPtr(this));
+            return ZX_OK;
+        case kDirIteratorDone:
+        default:
+            return status;
+        }
+    }
+
+    return ZX_ERR_NOT_FOUND;
+}
+
+zx_status_t VnodeMinfs::FindDirentSpace(DirArgs* args) {
+    if (LoadDirIndex() == ZX_OK) {
+        // New dirents go at the end of an indexed directory for as long as
+        // there is room there, rather than into the first gap that fits.
+        char data[kMinfsMaxDirentSize];
+        Dirent* de = (Dirent*) data;
+        args->offs.off = dir_index_->last_off;
+        args->offs.off_prev = args->offs.off;
+        size_t r;
+        if ((ReadInternal(data, kMinfsMaxDirentSize, args->offs.off, &r) == ZX_OK) &&
+            (ValidateDirent(de, r, args->offs.off) == ZX_OK) &&
+            (de->reclen & kMinfsReclenLast) &&
+            (DirentCallbackFindSpace(fbl::RefPtr<VnodeMinfs>(this), de, args) ==
+             kDirIteratorDone)) {
+            return ZX_OK;
+        }
+    }
+    return ForEachDirent(args, DirentCallbackFindSpace);
+}
+
 void VnodeMinfs::fbl_recycle() {
     ZX_DEBUG_ASSERT(fd_count_ == 0);
+#ifdef __Fuchsia__
+    // Minfs keeps a reference to vnodes with dirty blocks until they are written back.
+    ZX_DEBUG_ASSERT(dirty_blocks_.num_bits() == 0);
+#endif
     if (!IsUnlinked()) {
         // If this node has not been purged already, remove it from the
         // hash map. If it has been purged; it will already be absent
@@ -1119,9 +719,9 @@ VnodeMinfs::~VnodeMinfs() {
         request[request_count].opcode = BLOCKIO_CLOSE_VMO;
         request_count++;
     }
-    if (vmo_indirect_ != nullptr) {
+    if (vmo_extents_ != nullptr) {
         request[request_count].group = fs_->bc_->BlockGroupID();
-        request[request_count].vmoid = vmoid_indirect_;
+        request[request_count].vmoid = vmoid_extents_;
         request[request_count].opcode = BLOCKIO_CLOSE_VMO;
         request_count++;
     }
@@ -1159,16 +759,10 @@ void VnodeMinfs::Purge(WritebackWork* wb) {
     ZX_DEBUG_ASSERT(fd_count_ == 0);
     ZX_DEBUG_ASSERT(IsUnlinked());
     fs_->VnodeRelease(this);
-#ifdef __Fuchsia__
-    // TODO(smklein): Only init indirect vmo if it's needed
-    if (InitIndirectVmo() == ZX_OK) {
-        fs_->InoFree(this, wb);
-    } else {
-        FS_TRACE_ERROR("minfs: Failed to Init Indirect VMO while purging %u\n", ino_);
+    zx_status_t status;
+    if ((status = fs_->InoFree(this, wb)) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: Failed to free blocks while purging %u: %d\n", ino_, status);
     }
-#else
-    fs_->InoFree(this, wb);
-#endif
 }
 
 zx_status_t VnodeMinfs::Close() {
@@ -1176,12 +770,21 @@ zx_status_t VnodeMinfs::Close() {
     fd_count_--;
 
     if (fd_count_ == 0 && IsUnlinked()) {
+#ifdef __Fuchsia__
+        DropDirtyBlocks(0);
+#endif
         fbl::unique_ptr<Transaction> state;
         ZX_ASSERT(fs_->BeginTransaction(0, 0, &state) == ZX_OK);
         fs_->RemoveUnlinked(state->GetWork(), this);
         Purge(state->GetWork());
         fs_->CommitTransaction(std::move(state));
     }
+#ifdef __Fuchsia__
+    else if (fd_count_ == 0) {
+        // Nothing else will write back the file's dirty blocks once it has no fds open.
+        return FlushDirtyBlocks();
+    }
+#endif
     return ZX_OK;
 }
 
@@ -1285,6 +888,36 @@ zx_status_t VnodeMinfs::Write(const void* data, size_t len, size_t offset,
     if (status != ZX_OK) {
         return status;
     }
+#ifdef __Fuchsia__
+    // Only the VMO is written for now. The blocks written are allocated once they are written
+    // back, along with any other dirty blocks of the file by then, so that they can be allocated
+    // and written in long runs.
+    if (reserve_blocks > 0) {
+        blk_t start = static_cast<blk_t>(offset / kMinfsBlockSize);
+        if ((status = ReserveDirtyBlocks(start, start + reserve_blocks)) != ZX_OK) {
+            return status;
+        }
+    }
+    status = WriteInternal(nullptr, data, len, offset, out_actual);
+    if (dirty_blocks_.num_bits() > 0) {
+        fs_->VnodeMarkDirty(this);
+    }
+    if (status != ZX_OK) {
+        return status;
+    }
+    if (*out_actual != 0) {
+        // Successful writes update mtime, which is written back with the dirty blocks.
+        inode_.modify_time = GetTimeUTC();
+        if (dirty_blocks_.num_bits() >= kMinfsMaxDirtyBlocks &&
+            (status = FlushDirtyBlocks()) != ZX_OK) {
+            // The blocks stay dirty, to be written back later.
+            FS_TRACE_ERROR("minfs: ino#%u: failed to write back dirty blocks: %d\n", ino_,
+                           status);
+        }
+    }
+    return ZX_OK;
+#else
+    reserve_blocks += ExtentReserveBlocks(reserve_blocks);
     fbl::unique_ptr<Transaction> state;
     if ((status = fs_->BeginTransaction(0, reserve_blocks, &state)) != ZX_OK) {
         return status;
@@ -1300,6 +933,7 @@ zx_status_t VnodeMinfs::Write(const void* data, size_t len, size_t offset,
         fs_->CommitTransaction(std::move(state));
     }
     return ZX_OK;
+#endif
 }
 
 zx_status_t VnodeMinfs::Append(const void* data, size_t len, size_t* out_end,
@@ -1310,6 +944,9 @@ zx_status_t VnodeMinfs::Append(const void* data, size_t len, size_t* out_end,
 }
 
 // Internal write. Usable on directories.
+//
+// On Fuchsia, if |state| is null, the blocks written are only marked dirty, to be allocated and
+// written back by |FlushDirtyBlocks|.
 zx_status_t VnodeMinfs::WriteInternal(Transaction* state, const void* data,
                                       size_t len, size_t off, size_t* actual) {
     if (len == 0) {
@@ -1355,13 +992,26 @@ zx_status_t VnodeMinfs::WriteInternal(Transaction* state, const void* data,
             break;
         }
 
-        // Update this block on-disk
-        blk_t bno;
-        if ((status = BlockGet(state, n, &bno))) {
-            break;
+        if (state == nullptr) {
+            ZX_DEBUG_ASSERT(!IsDirectory());
+            if ((status = dirty_blocks_.Set(n, n + 1)) != ZX_OK) {
+                break;
+            }
+        } else {
+            // Update this block on-disk
+            blk_t bno;
+            if ((status = BlockGet(state, n, &bno))) {
+                break;
+            }
+            ZX_DEBUG_ASSERT(bno != 0);
+            // The blocks of directories and their indexes are metadata, which goes through
+            // the journal.
+            if (IsMetadata()) {
+                state->GetWork()->Enqueue(vmo_.get(), n, bno + fs_->Info().dat_block, 1);
+            } else {
+                state->GetWork()->EnqueueData(vmo_.get(), n, bno + fs_->Info().dat_block, 1);
+            }
         }
-        ZX_DEBUG_ASSERT(bno != 0);
-        state->GetWork()->Enqueue(vmo_.get(), n, bno + fs_->Info().dat_block, 1);
 #else
         blk_t bno;
         if ((status = BlockGet(state, n, &bno))) {
@@ -1407,6 +1057,166 @@ zx_status_t VnodeMinfs::WriteInternal(Transaction* state, const void* data,
     return ZX_OK;
 }
 
+#ifdef __Fuchsia__
+zx_status_t VnodeMinfs::CountHoles(blk_t start, blk_t end, bool dirty, blk_t* out_count) {
+    blk_t holes = 0;
+    for (blk_t n = start; n < end; n++) {
+        blk_t bno;
+        zx_status_t status;
+        if ((status = ExtentLookup(n, &bno)) != ZX_OK) {
+            return status;
+        }
+        if (bno == 0 && dirty_blocks_.Get(n, n + 1) == dirty) {
+            holes++;
+        }
+    }
+    *out_count = holes;
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::ReserveDirtyBlocks(blk_t start, blk_t end) {
+    blk_t holes;
+    zx_status_t status;
+    if ((status = CountHoles(start, end, false, &holes)) != ZX_OK || holes == 0) {
+        return status;
+    }
+
+    // Reserve the extent blocks which mapping the holes may need as well, so that writing them
+    // back can't run out of space once the write has succeeded. While the extents fit in the
+    // inode, that is the one block which all the dirty holes of the file may spill them into.
+    blk_t extent_blocks = ExtentReserveBlocks(holes);
+    if (inode_.extent_depth == 0) {
+        blk_t dirty_holes = 0;
+        if (dirty_promise_ != nullptr) {
+            dirty_holes = static_cast<blk_t>(dirty_promise_->Reserved()) - dirty_extent_blocks_;
+        }
+        blk_t needed = ExtentReserveBlocks(dirty_holes + holes);
+        extent_blocks = (needed > dirty_extent_blocks_) ? needed - dirty_extent_blocks_ : 0;
+    }
+
+    fbl::unique_ptr<Transaction> state;
+    if ((status = fs_->BeginTransaction(0, holes + extent_blocks, &state)) != ZX_OK) {
+        return status;
+    }
+    state->GiveBlocks(holes + extent_blocks, &dirty_promise_);
+    dirty_extent_blocks_ += extent_blocks;
+
+    // Reserving the blocks may have grown the volume, which must be recorded.
+    if (state->GetWork()->BlkCount() > 0) {
+        fs_->CommitTransaction(std::move(state));
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::FlushDirtyBlocks() {
+    if (dirty_blocks_.num_bits() == 0) {
+        return ZX_OK;
+    }
+    TRACE_DURATION("minfs", "VnodeMinfs::FlushDirtyBlocks", "ino", ino_,
+                   "blocks", dirty_blocks_.num_bits());
+
+    zx_status_t status = ZX_OK;
+    while (dirty_blocks_.num_ranges() > 0 && status == ZX_OK) {
+        // Write back the first run of dirty blocks, or as much of it as one transaction holds.
+        const bitmap::RleBitmapElement& range = *dirty_blocks_.begin();
+        blk_t start = static_cast<blk_t>(range.start());
+        blk_t end = start + static_cast<blk_t>(fbl::min(range.bitlen,
+                                                        static_cast<size_t>(kMinfsMaxDirtyBlocks)));
+        blk_t holes;
+        if ((status = CountHoles(start, end, true, &holes)) != ZX_OK) {
+            return status;
+        }
+
+        // The extent blocks were reserved along with the holes, though the extents spilling out
+        // of the inode part way through may need more.
+        blk_t extent_blocks = ExtentReserveBlocks(holes);
+        blk_t taken = fbl::min(extent_blocks, dirty_extent_blocks_);
+        fbl::unique_ptr<Transaction> state;
+        if ((status = fs_->BeginTransaction(0, extent_blocks - taken, &state)) != ZX_OK) {
+            return status;
+        }
+        if (holes + taken > 0) {
+            state->TakeBlocks(dirty_promise_.get(), holes + taken);
+            dirty_extent_blocks_ -= taken;
+        }
+
+        blk_t n = start;
+        while (n < end) {
+            blk_t bno;
+            if ((status = ExtentLookup(n, &bno)) != ZX_OK) {
+                break;
+            }
+            blk_t count = 1;
+            if (bno == 0) {
+                // Map the holes which follow this one along with it, so that they are allocated
+                // as a single run.
+                blk_t run = 1;
+                blk_t next_bno = 0;
+                while (n + run < end && (status = ExtentLookup(n + run, &next_bno)) == ZX_OK &&
+                       next_bno == 0) {
+                    run++;
+                }
+                if (status != ZX_OK ||
+                    (status = ExtentMap(state.get(), n, run, &bno, &count)) != ZX_OK) {
+                    break;
+                }
+                holes -= count;
+            }
+            // Adjacent requests are merged, so each run of consecutive data blocks is written
+            // with a single request.
+            state->GetWork()->EnqueueData(vmo_.get(), n, bno + fs_->Info().dat_block, count);
+            n += count;
+        }
+
+        // The blocks reserved for holes which could not be mapped stay with them, and those
+        // reserved for extent blocks which were not needed go back to the rest of the file's.
+        size_t unused = state->BlocksReserved();
+        if (unused > 0) {
+            ZX_DEBUG_ASSERT(unused >= holes);
+            state->GiveBlocks(unused, &dirty_promise_);
+            dirty_extent_blocks_ += static_cast<blk_t>(unused) - holes;
+        }
+        ZX_ASSERT(dirty_blocks_.Clear(start, n) == ZX_OK);
+        if (state->GetWork()->BlkCount() > 0) {
+            InodeSync(state->GetWork(), kMxFsSyncDefault);
+            state->GetWork()->PinVnode(fbl::WrapRefPtr(this));
+            fs_->CommitTransaction(std::move(state));
+        }
+    }
+
+    if (dirty_blocks_.num_bits() == 0) {
+        // Give back anything still reserved, for holes of writes which did not complete.
+        dirty_promise_.reset();
+        dirty_extent_blocks_ = 0;
+    }
+    return status;
+}
+
+void VnodeMinfs::DropDirtyBlocks(blk_t start) {
+    if (dirty_blocks_.num_bits() == 0) {
+        return;
+    }
+    blk_t holes = 0;
+    for (const bitmap::RleBitmapElement& range : dirty_blocks_) {
+        if (range.end() <= start) {
+            continue;
+        }
+        blk_t count;
+        blk_t from = static_cast<blk_t>(fbl::max(range.start(), static_cast<size_t>(start)));
+        if (CountHoles(from, static_cast<blk_t>(range.end()), true, &count) == ZX_OK) {
+            holes += count;
+        }
+    }
+    ZX_ASSERT(dirty_blocks_.Clear(start, kMinfsMaxFileBlock) == ZX_OK);
+    if (dirty_blocks_.num_bits() == 0) {
+        dirty_promise_.reset();
+        dirty_extent_blocks_ = 0;
+    } else if (holes > 0) {
+        dirty_promise_->Cancel(holes);
+    }
+}
+#endif
+
 zx_status_t VnodeMinfs::Lookup(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece name) {
     TRACE_DURATION("minfs", "VnodeMinfs::Lookup", "name", name);
     ZX_DEBUG_ASSERT(fs::vfs_valid_name(name));
@@ -1428,7 +1238,7 @@ zx_status_t VnodeMinfs::LookupInternal(fbl::RefPtr<fs::Vnode>* out, fbl::StringP
     auto get_metrics = fbl::MakeAutoCall([&ticker, &success, this]() {
         fs_->UpdateLookupMetrics(success, ticker.End());
     });
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) < 0) {
+    if ((status = FindDirent(&args, DirentCallbackFind)) < 0) {
         return status;
     }
     fbl::RefPtr<VnodeMinfs> vn;
@@ -1613,11 +1423,13 @@ zx_status_t VnodeMinfs::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece nam
         return ZX_ERR_BAD_STATE;
     }
 
+    PrepareDirIndex();
+
     DirArgs args = DirArgs();
     args.name = name;
     // ensure file does not exist
     zx_status_t status;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
+    if ((status = FindDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
         return ZX_ERR_ALREADY_EXISTS;
     }
 
@@ -1628,7 +1440,7 @@ zx_status_t VnodeMinfs::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece nam
     // before updating any other metadata.
     args.type = type;
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(name.length())));
-    status = ForEachDirent(&args, DirentCallbackFindSpace);
+    status = FindDirentSpace(&args);
     if (status == ZX_ERR_NOT_FOUND) {
         return ZX_ERR_NO_SPACE;
     } else if (status != ZX_OK) {
@@ -1641,10 +1453,12 @@ zx_status_t VnodeMinfs::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece nam
     if ((status = GetRequiredBlockCount(inode_.size, args.reclen, &reserve_blocks)) != ZX_OK) {
         return status;
     }
+    reserve_blocks += ExtentReserveBlocks(reserve_blocks);
 
     // Reserve 1 additional block for the new directory's initial . and .. entries.
     reserve_blocks += 1;
     ZX_DEBUG_ASSERT(reserve_blocks <= fs_->Limits().GetMaximumMetaDataBlocks());
+    reserve_blocks += DirIndexReserveBlocks();
 
     // In addition to reserve_blocks, reserve 1 inode for the vnode to be created.
     fbl::unique_ptr<Transaction> state;
@@ -1701,7 +1515,10 @@ zx_status_t VnodeMinfs::QueryFilesystem(fuchsia_io_FilesystemInfo* info) {
     info->fs_type = VFS_TYPE_MINFS;
     info->fs_id = fs_->GetFsId();
     info->total_bytes = fs_->Info().block_count * fs_->Info().block_size;
-    info->used_bytes = fs_->Info().alloc_block_count * fs_->Info().block_size;
+    // Blocks reserved for dirty data are as good as used, since they will be once it is
+    // written back.
+    info->used_bytes = (fs_->Info().alloc_block_count + fs_->BlocksReserved()) *
+                       fs_->Info().block_size;
     info->total_nodes = fs_->Info().inode_count;
     info->used_nodes = fs_->Info().alloc_inode_count;
 
@@ -1744,6 +1561,8 @@ zx_status_t VnodeMinfs::Unlink(fbl::StringPiece name, bool must_be_dir) {
     if (!IsDirectory()) {
         return ZX_ERR_NOT_SUPPORTED;
     }
+    PrepareDirIndex();
+
     zx_status_t status;
     fbl::unique_ptr<Transaction> state;
     ZX_ASSERT(fs_->BeginTransaction(0, 0, &state) == ZX_OK);
@@ -1751,7 +1570,7 @@ zx_status_t VnodeMinfs::Unlink(fbl::StringPiece name, bool must_be_dir) {
     args.name = name;
     args.type = must_be_dir ? kMinfsTypeDir : 0;
     args.state = state.get();
-    status = ForEachDirent(&args, DirentCallbackUnlink);
+    status = FindDirent(&args, DirentCallbackUnlink);
     if (status == ZX_OK) {
         state->GetWork()->PinVnode(fbl::WrapRefPtr(this));
         fs_->CommitTransaction(std::move(state));
@@ -1804,7 +1623,10 @@ zx_status_t VnodeMinfs::TruncateInternal(Transaction* state, size_t len) {
         // [start_bno, EOF) blocks should be deleted entirely.
         blk_t start_bno = static_cast<blk_t>((len % kMinfsBlockSize == 0) ?
                                              trunc_bno : trunc_bno + 1);
-        if ((r = BlocksShrink(state, start_bno)) < 0) {
+#ifdef __Fuchsia__
+        DropDirtyBlocks(start_bno);
+#endif
+        if ((r = BlocksShrink(state->GetWork(), start_bno)) < 0) {
             return r;
         }
 
@@ -1830,7 +1652,11 @@ zx_status_t VnodeMinfs::TruncateInternal(Transaction* state, size_t len) {
                                rel_bno, r);
                 return ZX_ERR_IO;
             }
-            if (bno != 0) {
+            bool dirty = false;
+#ifdef __Fuchsia__
+            dirty = dirty_blocks_.Get(rel_bno, rel_bno + 1);
+#endif
+            if (bno != 0 || dirty) {
                 size_t adjust = len % kMinfsBlockSize;
 #ifdef __Fuchsia__
                 if ((r = vmo_.read(bdata, len - adjust, adjust)) != ZX_OK) {
@@ -1843,7 +1669,16 @@ zx_status_t VnodeMinfs::TruncateInternal(Transaction* state, size_t len) {
                     FS_TRACE_ERROR("minfs: Truncate failed to write last block: %d\n", r);
                     return ZX_ERR_IO;
                 }
-                state->GetWork()->Enqueue(vmo_.get(), rel_bno, bno + fs_->Info().dat_block, 1);
+                // A dirty hole is written back along with the other dirty blocks.
+                if (bno == 0) {
+                    ZX_DEBUG_ASSERT(dirty);
+                } else if (IsMetadata()) {
+                    state->GetWork()->Enqueue(vmo_.get(), rel_bno,
+                                              bno + fs_->Info().dat_block, 1);
+                } else {
+                    state->GetWork()->EnqueueData(vmo_.get(), rel_bno,
+                                                  bno + fs_->Info().dat_block, 1);
+                }
 #else
                 if (fs_->bc_->Readblk(bno + fs_->Info().dat_block, bdata)) {
                     return ZX_ERR_IO;
@@ -1914,12 +1749,15 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    PrepareDirIndex();
+    newdir->PrepareDirIndex();
+
     zx_status_t status;
     fbl::RefPtr<VnodeMinfs> oldvn = nullptr;
     // acquire the 'oldname' node (it must exist)
     DirArgs args = DirArgs();
     args.name = oldname;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) < 0) {
+    if ((status = FindDirent(&args, DirentCallbackFind)) < 0) {
         return status;
     } else if ((status = fs_->VnodeGet(&oldvn, args.ino)) < 0) {
         return status;
@@ -1942,7 +1780,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
     args.type = oldvn->IsDirectory() ? kMinfsTypeDir : kMinfsTypeFile;
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(newname.length())));
 
-    status = newdir->ForEachDirent(&args, DirentCallbackFindSpace);
+    status = newdir->FindDirentSpace(&args);
     if (status == ZX_ERR_NOT_FOUND) {
         return ZX_ERR_NO_SPACE;
     } else if (status != ZX_OK) {
@@ -1958,6 +1796,9 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
         return status;
     }
 
+    reserved_blocks += newdir->ExtentReserveBlocks(reserved_blocks);
+    reserved_blocks += newdir->DirIndexReserveBlocks();
+
     fbl::unique_ptr<Transaction> state;
     if ((status = fs_->BeginTransaction(0, reserved_blocks, &state)) != ZX_OK) {
         return status;
@@ -1968,7 +1809,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
     args.state = state.get();
     args.name = newname;
     args.ino = oldvn->ino_;
-    status = newdir->ForEachDirent(&args, DirentCallbackAttemptRename);
+    status = newdir->FindDirent(&args, DirentCallbackAttemptRename);
     if (status == ZX_ERR_NOT_FOUND) {
         // if 'newname' does not exist, create it
         args.offs = append_offs;
@@ -1989,7 +1830,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
         auto vn = fbl::RefPtr<VnodeMinfs>::Downcast(vn_fs);
         args.name = "..";
         args.ino = newdir->ino_;
-        if ((status = vn->ForEachDirent(&args, DirentCallbackUpdateInode)) < 0) {
+        if ((status = vn->FindDirent(&args, DirentCallbackUpdateInode)) < 0) {
             return status;
         }
     }
@@ -2000,7 +1841,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
 
     // finally, remove oldname from its original position
     args.name = oldname;
-    if ((status = ForEachDirent(&args, DirentCallbackForceUnlink)) != ZX_OK) {
+    if ((status = FindDirent(&args, DirentCallbackForceUnlink)) != ZX_OK) {
         return status;
     }
     state->GetWork()->PinVnode(oldvn);
@@ -2026,11 +1867,13 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
         return ZX_ERR_NOT_FILE;
     }
 
+    PrepareDirIndex();
+
     // The destination should not exist
     DirArgs args = DirArgs();
     args.name = name;
     zx_status_t status;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
+    if ((status = FindDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
         return (status == ZX_OK) ? ZX_ERR_ALREADY_EXISTS : status;
     }
 
@@ -2038,7 +1881,7 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
     // before updating any other metadata.
     args.type = kMinfsTypeFile; // We can't hard link directories
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(name.length())));
-    status = ForEachDirent(&args, DirentCallbackFindSpace);
+    status = FindDirentSpace(&args);
     if (status == ZX_ERR_NOT_FOUND) {
         return ZX_ERR_NO_SPACE;
     } else if (status != ZX_OK) {
@@ -2051,6 +1894,8 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
         != ZX_OK) {
         return status;
     }
+    reserved_blocks += ExtentReserveBlocks(reserved_blocks);
+    reserved_blocks += DirIndexReserveBlocks();
 
     fbl::unique_ptr<Transaction> state;
     if ((status = fs_->BeginTransaction(0, reserved_blocks, &state)) != ZX_OK) {
@@ -2084,6 +1929,11 @@ zx_status_t VnodeMinfs::GetNodeInfo(uint32_t flags, fuchsia_io_NodeInfo* info) {
 
 void VnodeMinfs::Sync(SyncCallback closure) {
     TRACE_DURATION("minfs", "VnodeMinfs::Sync");
+    zx_status_t status = FlushDirtyBlocks();
+    if (status != ZX_OK) {
+        closure(status);
+        return;
+    }
     fs_->Sync([this, cb = std::move(closure)](zx_status_t status) {
         if (status != ZX_OK) {
             cb(status);
@@ -2108,46 +1958,4 @@ zx_status_t VnodeMinfs::AttachRemote(fs::MountChannel h) {
 }
 #endif
 
-VnodeMinfs::DirectArgs VnodeMinfs::IndirectArgs::GetDirect(blk_t* barray, unsigned ibindex) const {
-    // Determine the starting index for direct blocks within this indirect block
-    blk_t direct_start = ibindex == 0 ? bindex_ : 0;
-
-    // Determine how many direct blocks have already been op'd in indirect block context
-    blk_t found = 0;
-
-    if (ibindex) {
-        found = kMinfsDirectPerIndirect * ibindex - bindex_;
-    }
-
-    DirectArgs params(op_, // op
-                      &barray[direct_start], // array
-                      fbl::min(count_ - found, kMinfsDirectPerIndirect - direct_start), // count
-                      bnos_ == nullptr ? nullptr : &bnos_[found]); // bnos
-    return params;
-}
-
-VnodeMinfs::IndirectArgs VnodeMinfs::DindirectArgs::GetIndirect(blk_t* iarray,
-                                                                unsigned dibindex) const {
-    // Determine relative starting indices for indirect and direct blocks
-    uint32_t indirect_start = dibindex == 0 ? ibindex_ : 0;
-    uint32_t direct_start = (dibindex == 0 && indirect_start == ibindex_) ? bindex_ : 0;
-
-    // Determine how many direct blocks we have already op'd within doubly indirect
-    // context
-    blk_t found = 0;
-    if (dibindex) {
-        found = kMinfsDirectPerIndirect * kMinfsDirectPerIndirect * dibindex -
-                (ibindex_ * kMinfsDirectPerIndirect) + bindex_;
-    }
-
-    IndirectArgs params(op_, // op
-                        &iarray[indirect_start], // array
-                        fbl::min(count_ - found, kMinfsDirectPerDindirect - direct_start), // count
-                        bnos_ == nullptr ? nullptr : &bnos_[found], // bnos
-                        direct_start, // bindex
-                        ib_vmo_offset_ + dibindex + ibindex_ // ib_vmo_offset
-                        );
-    return params;
-}
-
 } // namespace minfs
@@ -32,9 +32,32 @@ namespace minfs {
 
 void WriteTxn::Enqueue(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset,
                        uint64_t nblocks) {
+    // Metadata written to a block revoked earlier in the transaction must be
+    // replayed after all.
+    for (size_t i = 0; i < revoked_.size();) {
+        if (revoked_[i] >= dev_offset && revoked_[i] < dev_offset + nblocks) {
+            revoked_.erase(i);
+        } else {
+            i++;
+        }
+    }
+    EnqueueRequest(vmo, vmo_offset, dev_offset, nblocks, false);
+}
+
+void WriteTxn::EnqueueData(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset,
+                           uint64_t nblocks) {
+    EnqueueRequest(vmo, vmo_offset, dev_offset, nblocks, true);
+}
+
+void WriteTxn::Revoke(blk_t bno) {
+    revoked_.push_back(bno);
+}
+
+void WriteTxn::EnqueueRequest(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset,
+                              uint64_t nblocks, bool data) {
     ValidateVmoSize(vmo, static_cast<blk_t>(vmo_offset));
     for (size_t i = 0; i < requests_.size(); i++) {
-        if (requests_[i].vmo != vmo) {
+        if (requests_[i].vmo != vmo || requests_[i].data != data) {
             continue;
         }
 
@@ -59,6 +82,7 @@ void WriteTxn::Enqueue(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset
     request.vmo_offset = vmo_offset;
     request.dev_offset = dev_offset;
     request.length = nblocks;
+    request.data = data;
     requests_.push_back(std::move(request));
 }
 
@@ -85,7 +109,7 @@ zx_status_t WriteTxn::Flush(zx_handle_t vmo, vmoid_t vmoid) {
     // Actually send the operations to the underlying block device.
     zx_status_t status = bc_->Transaction(blk_reqs, requests_.size());
 
-    requests_.reset();
+    Clear();
     return status;
 }
 
@@ -97,6 +121,16 @@ size_t WriteTxn::BlkCount() const {
     return blocks_needed;
 }
 
+size_t WriteTxn::MetadataBlkCount() const {
+    size_t blocks = 0;
+    for (size_t i = 0; i < requests_.size(); i++) {
+        if (!requests_[i].data) {
+            blocks += requests_[i].length;
+        }
+    }
+    return blocks;
+}
+
 #endif  // __Fuchsia__
 
 WritebackWork::WritebackWork(Bcache* bc) : WriteTxn(bc),
@@ -128,6 +162,16 @@ size_t WritebackWork::Complete(zx_handle_t vmo, vmoid_t vmoid) {
     return blk_count;
 }
 
+size_t WritebackWork::Complete(zx_status_t status) {
+    size_t blk_count = BlkCount();
+    Clear();
+    if (closure_) {
+        closure_(status);
+    }
+    Reset();
+    return blk_count;
+}
+
 void WritebackWork::SetClosure(SyncCallback closure) {
     ZX_DEBUG_ASSERT(!closure_);
     closure_ = std::move(closure);
@@ -155,8 +199,10 @@ void WritebackWork::PinVnode(fbl::RefPtr<VnodeMinfs> vn) {
 #ifdef __Fuchsia__
 
 zx_status_t WritebackBuffer::Create(Bcache* bc, fzl::OwnedVmoMapper mapper,
+                                    fbl::unique_ptr<Journal> journal,
                                     fbl::unique_ptr<WritebackBuffer>* out) {
-    fbl::unique_ptr<WritebackBuffer> wb(new WritebackBuffer(bc, std::move(mapper)));
+    fbl::unique_ptr<WritebackBuffer> wb(new WritebackBuffer(bc, std::move(mapper),
+                                                            std::move(journal)));
     if (wb->mapper_.size() % kMinfsBlockSize != 0) {
         return ZX_ERR_INVALID_ARGS;
     } else if (cnd_init(&wb->consumer_cvar_) != thrd_success) {
@@ -177,8 +223,9 @@ zx_status_t WritebackBuffer::Create(Bcache* bc, fzl::OwnedVmoMapper mapper,
     return ZX_OK;
 }
 
-WritebackBuffer::WritebackBuffer(Bcache* bc, fzl::OwnedVmoMapper mapper) :
-    bc_(bc), unmounting_(false), mapper_(std::move(mapper)),
+WritebackBuffer::WritebackBuffer(Bcache* bc, fzl::OwnedVmoMapper mapper,
+                                 fbl::unique_ptr<Journal> journal) :
+    bc_(bc), journal_(std::move(journal)), unmounting_(false), mapper_(std::move(mapper)),
     cap_(mapper_.size() / kMinfsBlockSize) {}
 
 WritebackBuffer::~WritebackBuffer() {
@@ -191,6 +238,12 @@ WritebackBuffer::~WritebackBuffer() {
     int r;
     thrd_join(writeback_thrd_, &r);
 
+    // Leave the journal empty, so that nothing needs to be replayed at the
+    // next mount.
+    if (journal_ != nullptr) {
+        journal_->Checkpoint();
+    }
+
     if (buffer_vmoid_ != VMOID_INVALID) {
         block_fifo_request_t request;
         request.group = bc_->BlockGroupID();
@@ -272,6 +325,7 @@ void WritebackBuffer::CopyToBufferLocked(WriteTxn* txn) {
             request.vmo_offset = 0;
             request.dev_offset = dev_offset;
             request.length = wb_len;
+            request.data = reqs[i].data;
             i++;
             reqs.insert(i, request);
         }
@@ -286,14 +340,14 @@ void WritebackBuffer::Enqueue(fbl::unique_ptr<WritebackWork> work) {
     {
         TRACE_DURATION("minfs", "Allocating Writeback space");
         size_t blocks = work->BlkCount();
-        // TODO(smklein): Experimentally, all filesystem operations cause between
-        // 0 and 10 blocks to be updated, though the writeback buffer has space
-        // for thousands of blocks.
+        // TODO(smklein): Experimentally, most filesystem operations cause between
+        // 0 and 10 blocks to be updated, and file data is written back in runs
+        // of at most |kMinfsMaxDirtyBlocks|, though the writeback buffer has
+        // space for thousands of blocks.
         //
-        // Hypothetically, an operation (most likely, an enormous write) could
-        // cause a single operation to exceed the size of the writeback buffer,
-        // but this is currently impossible as our writes are broken into 8KB
-        // chunks.
+        // Hypothetically, an operation could cause a single operation to exceed
+        // the size of the writeback buffer, but this is currently impossible as
+        // writeback of file data is broken into chunks of that size.
         //
         // Regardless, there should either (1) exist a fallback mechanism for these
         // extremely large operations, or (2) the worst-case operation should be
@@ -318,8 +372,23 @@ int WritebackBuffer::WritebackThread(void* arg) {
     b->writeback_lock_.Acquire();
     while (true) {
         while (!b->work_queue_.is_empty()) {
-            auto work = b->work_queue_.pop();
-            TRACE_DURATION("minfs", "WritebackBuffer::WritebackThread");
+            // Take as much of the queued work as fits in one journal entry, so
+            // that it is all committed with a single flush.
+            fbl::Vector<fbl::unique_ptr<WritebackWork>> batch;
+            size_t metadata_blocks = 0;
+            size_t revoked_blocks = 0;
+            do {
+                WritebackWork& next = b->work_queue_.front();
+                metadata_blocks += next.MetadataBlkCount();
+                revoked_blocks += next.Revoked().size();
+                if (!batch.is_empty() &&
+                    (b->journal_ == nullptr ||
+                     !b->journal_->EntryFits(metadata_blocks, revoked_blocks))) {
+                    break;
+                }
+                batch.push_back(b->work_queue_.pop());
+            } while (!b->work_queue_.is_empty());
+            TRACE_DURATION("minfs", "WritebackBuffer::WritebackThread", "works", batch.size());
 
             // Stay unlocked while processing a unit of work
             b->writeback_lock_.Release();
@@ -327,9 +396,20 @@ int WritebackBuffer::WritebackThread(void* arg) {
             // TODO(smklein): We could add additional validation that the blocks
             // in "work" are contiguous and in the range of [start_, len_) (including
             // wraparound).
-            size_t blks_consumed = work->Complete(b->mapper_.vmo().get(), b->buffer_vmoid_);
-            TRACE_FLOW_END("minfs", "writeback", reinterpret_cast<trace_flow_id_t>(work.get()));
-            work = nullptr;
+            size_t blks_consumed = 0;
+            if (b->journal_ != nullptr) {
+                zx_status_t status = b->journal_->Commit(batch, b->mapper_, b->buffer_vmoid_);
+                for (size_t i = 0; i < batch.size(); i++) {
+                    blks_consumed += batch[i]->Complete(status);
+                }
+            } else {
+                blks_consumed = batch[0]->Complete(b->mapper_.vmo().get(), b->buffer_vmoid_);
+            }
+            for (size_t i = 0; i < batch.size(); i++) {
+                TRACE_FLOW_END("minfs", "writeback",
+                               reinterpret_cast<trace_flow_id_t>(batch[i].get()));
+            }
+            batch.reset();
 
             // Relock before checking the state of the queue
             b->writeback_lock_.Acquire();
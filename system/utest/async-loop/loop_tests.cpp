@@ -95,6 +95,46 @@ protected:
     }
 };
 
+class DrainingWait : public TestWait {
+public:
+    static constexpr uint32_t kBatchSize = 4u;
+
+    DrainingWait(zx_handle_t object)
+        : TestWait(object, ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED) {
+        for (uint32_t i = 0; i < kBatchSize; i++) {
+            msgs_[i] = {&bytes_[i], nullptr, sizeof(uint32_t), 0u};
+        }
+    }
+
+    uint32_t message_count = 0u;
+    uint32_t last_message = 0u;
+    zx_status_t drain_status = ZX_ERR_INTERNAL;
+
+protected:
+    void Handle(async_dispatcher_t* dispatcher, zx_status_t status,
+                const zx_packet_signal_t* signal) override {
+        TestWait::Handle(dispatcher, status, signal);
+        if (status != ZX_OK)
+            return;
+        drain_status = async_loop_drain_channel(object, msgs_, kBatchSize,
+                                                &DrainingWait::HandleMessage, this);
+        if (drain_status == ZX_OK) {
+            Begin(dispatcher);
+        }
+    }
+
+private:
+    static zx_status_t HandleMessage(void* data, zx_channel_msg_t* msg) {
+        auto self = static_cast<DrainingWait*>(data);
+        self->message_count++;
+        self->last_message = *static_cast<uint32_t*>(msg->bytes);
+        return ZX_OK;
+    }
+
+    uint32_t bytes_[kBatchSize];
+    zx_channel_msg_t msgs_[kBatchSize];
+};
+
 class SelfCancelingWait : public TestWait {
 public:
     SelfCancelingWait(zx_handle_t object, zx_signals_t trigger)
@@ -618,6 +658,52 @@ bool wait_unwaitable_handle_test() {
     END_TEST;
 }
 
+bool wait_drain_channel_test() {
+    BEGIN_TEST;
+
+    async::Loop loop(&kAsyncLoopConfigNoAttachToThread);
+    zx_handle_t channel[2];
+    ASSERT_EQ(ZX_OK, zx_channel_create(0u, &channel[0], &channel[1]), "create channel");
+
+    DrainingWait wait(channel[1]);
+    EXPECT_EQ(ZX_OK, wait.Begin(loop.dispatcher()), "wait");
+
+    // A backlog spanning several batches is drained by a single dispatch.
+    for (uint32_t i = 1; i <= 10u; i++) {
+        EXPECT_EQ(ZX_OK, zx_channel_write(channel[0], 0u, &i, sizeof(i), nullptr, 0u), "write");
+    }
+    EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+    EXPECT_EQ(1u, wait.run_count, "run count");
+    EXPECT_EQ(ZX_OK, wait.drain_status, "drain status");
+    EXPECT_EQ(10u, wait.message_count, "message count");
+    EXPECT_EQ(10u, wait.last_message, "last message");
+
+    // A larger one is left to the next dispatch once a drain has read its share.
+    const uint32_t more = ASYNC_LOOP_DRAIN_MAX_BATCHES * DrainingWait::kBatchSize + 1u;
+    for (uint32_t i = 11u; i <= 10u + more; i++) {
+        EXPECT_EQ(ZX_OK, zx_channel_write(channel[0], 0u, &i, sizeof(i), nullptr, 0u), "write");
+    }
+    EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+    EXPECT_EQ(3u, wait.run_count, "run count");
+    EXPECT_EQ(ZX_OK, wait.drain_status, "drain status");
+    EXPECT_EQ(10u + more, wait.message_count, "message count");
+    EXPECT_EQ(10u + more, wait.last_message, "last message");
+
+    // Messages written before the peer closes are still delivered.
+    uint32_t last = 11u + more;
+    EXPECT_EQ(ZX_OK, zx_channel_write(channel[0], 0u, &last, sizeof(last), nullptr, 0u), "write");
+    EXPECT_EQ(ZX_OK, zx_handle_close(channel[0]), "close");
+    EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+    EXPECT_EQ(4u, wait.run_count, "run count");
+    EXPECT_EQ(ZX_ERR_PEER_CLOSED, wait.drain_status, "drain status");
+    EXPECT_EQ(11u + more, wait.message_count, "message count");
+    EXPECT_EQ(11u + more, wait.last_message, "last message");
+
+    EXPECT_EQ(ZX_OK, zx_handle_close(channel[1]), "close");
+
+    END_TEST;
+}
+
 bool wait_shutdown_test() {
     BEGIN_TEST;
 
@@ -1378,6 +1464,7 @@ RUN_TEST(quit_test)
 RUN_TEST(time_test)
 RUN_TEST(wait_test)
 RUN_TEST(wait_unwaitable_handle_test)
+RUN_TEST(wait_drain_channel_test)
 RUN_TEST(wait_shutdown_test)
 RUN_TEST(task_test)
 RUN_TEST(task_shutdown_test)
@@ -5,7 +5,9 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <blobfs/format.h>
 #include <digest/digest.h>
@@ -19,8 +21,11 @@
 #include <fs-management/mount.h>
 #include <fs-test-utils/fixture.h>
 #include <fs-test-utils/perftest.h>
+#include <lib/fdio/spawn.h>
+#include <lib/zx/process.h>
 #include <perftest/perftest.h>
 #include <unittest/unittest.h>
+#include <zircon/syscalls/object.h>
 
 #include <utility>
 
@@ -34,6 +39,10 @@ using fs_test_utils::PerformanceTestOptions;
 using fs_test_utils::TestCaseInfo;
 using fs_test_utils::TestInfo;
 
+// Makes this binary exit as soon as it starts, so that launching it measures
+// little besides loading it.
+constexpr char kExitImmediatelyFlag[] = "--exit-immediately";
+
 // Supported read orders for this benchmark.
 enum class ReadOrder {
     // Blobs are read in the order they were written
@@ -310,6 +319,53 @@ private:
     BlobfsInfo info_;
 };
 
+// Measure the time taken to launch a large binary stored in blobfs and wait
+// for it to exit.  The binary is a copy of this one.  Blobfs drops a blob from
+// memory as soon as nothing is using it, so every launch starts cold, reading
+// in whatever the binary touches from disk.
+bool LaunchTest(const fbl::String& binary_path, perftest::RepeatState* state, Fixture* fixture) {
+    BEGIN_HELPER;
+
+    fbl::unique_fd src(open(binary_path.c_str(), O_RDONLY));
+    ASSERT_TRUE(src, strerror(errno));
+    struct stat st;
+    ASSERT_EQ(fstat(src.get(), &st), 0, strerror(errno));
+    const size_t size = st.st_size;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<char[]> data(new (&ac) char[size]);
+    ASSERT_TRUE(ac.check());
+    ASSERT_EQ(StreamAll(read, src.get(), data.get(), size), 0, strerror(errno));
+
+    const size_t size_merkle = MerkleTree::GetTreeLength(size);
+    fbl::unique_ptr<char[]> merkle(new (&ac) char[size_merkle]);
+    ASSERT_TRUE(ac.check());
+    Digest digest;
+    ASSERT_EQ(MerkleTree::Create(data.get(), size, merkle.get(), size_merkle, &digest), ZX_OK);
+    char name[Digest::kLength * 2 + 1];
+    ASSERT_EQ(digest.ToString(name, sizeof(name)), ZX_OK);
+    fbl::String path = fbl::StringPrintf("%s/%s", fixture->fs_path().c_str(), name);
+
+    fbl::unique_fd fd(open(path.c_str(), O_CREAT | O_RDWR));
+    ASSERT_TRUE(fd, strerror(errno));
+    ASSERT_EQ(ftruncate(fd.get(), size), 0, strerror(errno));
+    ASSERT_EQ(StreamAll(write, fd.get(), data.get(), size), 0, strerror(errno));
+    ASSERT_EQ(close(fd.release()), 0);
+
+    const char* argv[] = {path.c_str(), kExitImmediatelyFlag, nullptr};
+    while (state->KeepRunning()) {
+        zx::process process;
+        ASSERT_EQ(fdio_spawn(ZX_HANDLE_INVALID, FDIO_SPAWN_CLONE_ALL, path.c_str(), argv,
+                             process.reset_and_get_address()),
+                  ZX_OK);
+        ASSERT_EQ(process.wait_one(ZX_PROCESS_TERMINATED, zx::time::infinite(), nullptr), ZX_OK);
+        zx_info_process_t info;
+        ASSERT_EQ(process.get_info(ZX_INFO_PROCESS, &info, sizeof(info), nullptr, nullptr),
+                  ZX_OK);
+        ASSERT_EQ(info.return_code, 0);
+    }
+    END_HELPER;
+}
+
 bool RunBenchmark(int argc, char** argv) {
     FixtureOptions f_opts = FixtureOptions::Default(DISK_FORMAT_BLOBFS);
     PerformanceTestOptions p_opts;
@@ -386,12 +442,28 @@ bool RunBenchmark(int argc, char** argv) {
         }
     }
 
+    TestCaseInfo launch_testcase;
+    launch_testcase.teardown = true;
+    launch_testcase.sample_count = kSampleCount;
+    TestInfo launch_test;
+    launch_test.name = fbl::StringPrintf("%s/LaunchCold", disk_format_string_[f_opts.fs_type]);
+    fbl::String binary_path(argv[0]);
+    launch_test.test_fn = [binary_path](perftest::RepeatState* state,
+                                        fs_test_utils::Fixture* fixture) {
+        return LaunchTest(binary_path, state, fixture);
+    };
+    launch_testcase.tests.push_back(std::move(launch_test));
+    testcases.push_back(std::move(launch_testcase));
+
     return fs_test_utils::RunTestCases(f_opts, p_opts, testcases);
 }
 
 } // namespace
 
 int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], kExitImmediatelyFlag) == 0) {
+        return 0;
+    }
     return fs_test_utils::RunWithMemFs(
         [argc, argv]() { return RunBenchmark(argc, argv) ? 0 : -1; });
 }
@@ -4,6 +4,8 @@
 
 #include <zircon/assert.h>
 #include <zircon/compiler.h>
+#include <zircon/limits.h>
+#include <zircon/process.h>
 #include <zircon/rights.h>
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/object.h>
@@ -11,6 +13,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <threads.h>
 #include <unistd.h>
 
@@ -1048,6 +1051,202 @@ static bool channel_write_takes_all_handles(void) {
     END_TEST;
 }
 
+static bool channel_write_read_many(void) {
+    BEGIN_TEST;
+
+    zx_handle_t channel[2];
+    ASSERT_EQ(zx_channel_create(0, &channel[0], &channel[1]), ZX_OK, "");
+
+    zx_handle_t event;
+    ASSERT_EQ(zx_event_create(0u, &event), ZX_OK, "");
+
+    uint32_t data[3] = {1u, 2u, 3u};
+    zx_channel_msg_t out[3] = {
+        {&data[0], NULL, sizeof(uint32_t), 0u},
+        {&data[1], &event, sizeof(uint32_t), 1u},
+        {&data[2], NULL, sizeof(uint32_t), 0u},
+    };
+    ASSERT_EQ(zx_channel_write_many(channel[0], 0u, out, 3u), ZX_OK, "");
+
+    // Read the first two in one batch: the third is left for the next call.
+    uint32_t recv_data[3] = {0u, 0u, 0u};
+    zx_handle_t recv_handles[2] = {ZX_HANDLE_INVALID, ZX_HANDLE_INVALID};
+    zx_channel_msg_t in[2] = {
+        {&recv_data[0], &recv_handles[0], sizeof(uint32_t), 1u},
+        {&recv_data[1], &recv_handles[1], sizeof(uint32_t), 1u},
+    };
+    uint32_t actual = 0u;
+    ASSERT_EQ(zx_channel_read_many(channel[1], 0u, in, 2u, &actual), ZX_OK, "");
+    EXPECT_EQ(actual, 2u, "");
+    EXPECT_EQ(recv_data[0], 1u, "");
+    EXPECT_EQ(in[0].num_bytes, sizeof(uint32_t), "");
+    EXPECT_EQ(in[0].num_handles, 0u, "");
+    EXPECT_EQ(recv_data[1], 2u, "");
+    EXPECT_EQ(in[1].num_handles, 1u, "");
+    EXPECT_EQ(zx_handle_close(recv_handles[1]), ZX_OK, "");
+
+    in[0].num_handles = 1u;
+    in[1].num_handles = 1u;
+    ASSERT_EQ(zx_channel_read_many(channel[1], 0u, in, 2u, &actual), ZX_OK, "");
+    EXPECT_EQ(actual, 1u, "");
+    EXPECT_EQ(recv_data[0], 3u, "");
+
+    EXPECT_EQ(zx_channel_read_many(channel[1], 0u, in, 2u, &actual), ZX_ERR_SHOULD_WAIT, "");
+    EXPECT_EQ(zx_object_wait_one(channel[1], ZX_CHANNEL_READABLE, 0u, NULL),
+              ZX_ERR_TIMED_OUT, "");
+
+    EXPECT_EQ(zx_handle_close(channel[0]), ZX_OK, "");
+    EXPECT_EQ(zx_channel_read_many(channel[1], 0u, in, 2u, &actual), ZX_ERR_PEER_CLOSED, "");
+    EXPECT_EQ(zx_handle_close(channel[1]), ZX_OK, "");
+
+    END_TEST;
+}
+
+static bool channel_read_many_buffer_too_small(void) {
+    BEGIN_TEST;
+
+    zx_handle_t channel[2];
+    ASSERT_EQ(zx_channel_create(0, &channel[0], &channel[1]), ZX_OK, "");
+
+    char small[1] = {1};
+    char large[8] = {2};
+    zx_channel_msg_t out[2] = {
+        {small, NULL, sizeof(small), 0u},
+        {large, NULL, sizeof(large), 0u},
+    };
+    ASSERT_EQ(zx_channel_write_many(channel[0], 0u, out, 2u), ZX_OK, "");
+
+    // The first message fits but the second does not, so the batch stops short.
+    char buf[2][4];
+    zx_channel_msg_t in[2] = {
+        {buf[0], NULL, sizeof(buf[0]), 0u},
+        {buf[1], NULL, sizeof(buf[1]), 0u},
+    };
+    uint32_t actual = 0u;
+    ASSERT_EQ(zx_channel_read_many(channel[1], 0u, in, 2u, &actual), ZX_OK, "");
+    EXPECT_EQ(actual, 1u, "");
+    EXPECT_EQ(in[0].num_bytes, sizeof(small), "");
+    EXPECT_EQ(in[1].num_bytes, sizeof(buf[1]), "unfilled entry was changed");
+
+    // Now the first message does not fit, and its size is reported.
+    in[0].num_bytes = sizeof(buf[0]);
+    EXPECT_EQ(zx_channel_read_many(channel[1], 0u, in, 2u, &actual),
+              ZX_ERR_BUFFER_TOO_SMALL, "");
+    EXPECT_EQ(actual, 0u, "");
+    EXPECT_EQ(in[0].num_bytes, sizeof(large), "");
+
+    // It was not consumed.
+    uint32_t actual_bytes;
+    EXPECT_EQ(zx_channel_read(channel[1], 0u, large, NULL, sizeof(large), 0u,
+                              &actual_bytes, NULL), ZX_OK, "");
+    EXPECT_EQ(actual_bytes, sizeof(large), "");
+
+    EXPECT_EQ(zx_channel_read_many(channel[1], 0u, in, 0u, &actual), ZX_ERR_INVALID_ARGS, "");
+    EXPECT_EQ(zx_channel_write_many(channel[0], 0u, in, 0u), ZX_ERR_INVALID_ARGS, "");
+    EXPECT_EQ(zx_channel_read_many(channel[1], 0u, in, ZX_CHANNEL_MAX_BATCH_MSGS + 1, &actual),
+              ZX_ERR_OUT_OF_RANGE, "");
+
+    EXPECT_EQ(zx_handle_close(channel[0]), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(channel[1]), ZX_OK, "");
+
+    END_TEST;
+}
+
+// A batch that fails is not written at all, and all of its handles are consumed.
+static bool channel_write_many_takes_all_handles(void) {
+    BEGIN_TEST;
+
+    zx_handle_t channel[2];
+    ASSERT_EQ(zx_channel_create(0, &channel[0], &channel[1]), ZX_OK, "");
+
+    zx_handle_t events[2];
+    ASSERT_EQ(zx_event_create(0u, &events[0]), ZX_OK, "");
+    ASSERT_EQ(zx_event_create(0u, &events[1]), ZX_OK, "");
+
+    char bytes[1] = {5};
+    zx_channel_msg_t out[3] = {
+        {bytes, &events[0], sizeof(bytes), 1u},
+        {bytes, &channel[0], sizeof(bytes), 1u},
+        {bytes, &events[1], sizeof(bytes), 1u},
+    };
+    EXPECT_EQ(zx_channel_write_many(channel[0], 0u, out, 3u), ZX_ERR_NOT_SUPPORTED, "");
+
+    EXPECT_EQ(zx_handle_close(events[0]), ZX_ERR_BAD_HANDLE, "handle not closed");
+    EXPECT_EQ(zx_handle_close(events[1]), ZX_ERR_BAD_HANDLE, "handle not closed");
+    EXPECT_EQ(zx_handle_close(channel[0]), ZX_ERR_BAD_HANDLE, "handle not closed");
+
+    EXPECT_EQ(zx_channel_read(channel[1], 0u, NULL, NULL, 0u, 0u, NULL, NULL),
+              ZX_ERR_PEER_CLOSED, "partial batch was written");
+    EXPECT_EQ(zx_handle_close(channel[1]), ZX_OK, "");
+
+    END_TEST;
+}
+
+static bool map_pages(size_t size, uint8_t** out) {
+    BEGIN_HELPER;
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(size, 0u, &vmo), ZX_OK, "");
+    zx_vaddr_t addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, 0u, vmo, 0u,
+                          size, &addr), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK, "");
+    *out = (uint8_t*)addr;
+    END_HELPER;
+}
+
+// Large messages written with ZX_CHANNEL_WRITE_DONATE_PAGES read back the same
+// whether or not the reader's buffer lines up with the writer's.
+static bool channel_donate_pages(void) {
+    BEGIN_TEST;
+
+    const size_t kBufferSize = 8 * ZX_PAGE_SIZE;
+    const uint32_t kMsgSize = 5 * ZX_PAGE_SIZE;
+    uint8_t* send;
+    uint8_t* recv;
+    ASSERT_TRUE(map_pages(kBufferSize, &send), "");
+    ASSERT_TRUE(map_pages(kBufferSize, &recv), "");
+    for (size_t i = 0; i < kBufferSize; i++) {
+        send[i] = (uint8_t)(i * 7);
+    }
+
+    zx_handle_t channel[2];
+    ASSERT_EQ(zx_channel_create(0, &channel[0], &channel[1]), ZX_OK, "");
+
+    // |offset| is where the reader's buffer starts; 100 matches the writer.
+    static const size_t kOffsets[] = {100u, 200u};
+    for (size_t i = 0; i < countof(kOffsets); i++) {
+        memset(recv, 0, kBufferSize);
+        ASSERT_EQ(zx_channel_write(channel[0], ZX_CHANNEL_WRITE_DONATE_PAGES, send + 100,
+                                   kMsgSize, NULL, 0u), ZX_OK, "");
+        uint32_t actual_bytes;
+        ASSERT_EQ(zx_channel_read(channel[1], ZX_CHANNEL_READ_REMAP_PAGES, recv + kOffsets[i],
+                                  NULL, kMsgSize, 0u, &actual_bytes, NULL), ZX_OK, "");
+        EXPECT_EQ(actual_bytes, kMsgSize, "");
+        EXPECT_EQ(memcmp(send + 100, recv + kOffsets[i], kMsgSize), 0, "");
+
+        // Writes by the reader stay with the reader.
+        memset(recv + kOffsets[i], 0xff, kMsgSize);
+        EXPECT_EQ(send[100 + ZX_PAGE_SIZE], (uint8_t)((100 + ZX_PAGE_SIZE) * 7), "");
+    }
+
+    // Readers that did not ask for pages get a copy.
+    ASSERT_EQ(zx_channel_write(channel[0], ZX_CHANNEL_WRITE_DONATE_PAGES, send + 100,
+                               kMsgSize, NULL, 0u), ZX_OK, "");
+    ASSERT_EQ(zx_channel_read(channel[1], 0u, recv + 100, NULL, kMsgSize, 0u, NULL, NULL),
+              ZX_OK, "");
+    EXPECT_EQ(memcmp(send + 100, recv + 100, kMsgSize), 0, "");
+
+    EXPECT_EQ(zx_channel_write(channel[0], 2u, send, kMsgSize, NULL, 0u),
+              ZX_ERR_INVALID_ARGS, "");
+
+    EXPECT_EQ(zx_handle_close(channel[0]), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(channel[1]), ZX_OK, "");
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), (zx_vaddr_t)send, kBufferSize), ZX_OK, "");
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), (zx_vaddr_t)recv, kBufferSize), ZX_OK, "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(channel_tests)
 RUN_TEST(channel_test)
 RUN_TEST(channel_read_error_test)
@@ -1066,6 +1265,10 @@ RUN_TEST(channel_disallow_write_to_self)
 RUN_TEST(channel_read_etc)
 RUN_TEST(channel_write_different_sizes)
 RUN_TEST(channel_write_takes_all_handles)
+RUN_TEST(channel_write_read_many)
+RUN_TEST(channel_read_many_buffer_too_small)
+RUN_TEST(channel_write_many_takes_all_handles)
+RUN_TEST(channel_donate_pages)
 END_TEST_CASE(channel_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -2,8 +2,12 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <string.h>
+
 #include <fbl/algorithm.h>
+#include <fbl/auto_call.h>
 #include <fbl/function.h>
+#include <lib/zx/vmar.h>
 #include <unittest/unittest.h>
 
 #include "test_thread.h"
@@ -479,6 +483,154 @@ bool vmar_remap_test() {
     END_TEST;
 }
 
+// Tests that reading a copy-on-write clone of a paged vmo asks the pager for
+// the pages, and that writing to the clone leaves the paged vmo alone.
+bool clone_read_test() {
+    BEGIN_TEST;
+
+    UserPager pager;
+
+    ASSERT_TRUE(pager.Init());
+
+    PagedVmo* vmo;
+    ASSERT_TRUE(pager.CreateVmo(1, &vmo));
+
+    zx::vmo clone;
+    ASSERT_EQ(vmo->vmo().clone(ZX_VMO_CLONE_COPY_ON_WRITE, 0, ZX_PAGE_SIZE, &clone), ZX_OK);
+    zx_vaddr_t addr;
+    ASSERT_EQ(zx::vmar::root_self()->map(0, clone, 0, ZX_PAGE_SIZE,
+                                         ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, &addr),
+              ZX_OK);
+    auto unmap = fbl::MakeAutoCall([addr]() {
+        zx::vmar::root_self()->unmap(addr, ZX_PAGE_SIZE);
+    });
+
+    uint64_t expected[ZX_PAGE_SIZE / sizeof(uint64_t)];
+    vmo->GenerateBufferContents(expected, 1, 0);
+
+    TestThread t([addr, &expected]() -> bool {
+        return memcmp(reinterpret_cast<void*>(addr), expected, ZX_PAGE_SIZE) == 0;
+    });
+
+    ASSERT_TRUE(t.Start());
+
+    ASSERT_TRUE(pager.WaitForPageRead(vmo, 0, 1, ZX_TIME_INFINITE));
+
+    ASSERT_TRUE(pager.SupplyPages(vmo, 0, 1));
+
+    ASSERT_TRUE(t.Wait());
+
+    *reinterpret_cast<volatile uint64_t*>(addr) = 0;
+
+    ASSERT_TRUE(vmo->CheckVmar(0, 1));
+    ASSERT_FALSE(pager.WaitForPageRead(vmo, 0, 1, 0));
+
+    END_TEST;
+}
+
+// Tests that zx_vmo_read of a copy-on-write clone of a paged vmo waits for
+// the pager to supply the pages.
+bool clone_vmo_read_test() {
+    BEGIN_TEST;
+
+    UserPager pager;
+
+    ASSERT_TRUE(pager.Init());
+
+    PagedVmo* vmo;
+    ASSERT_TRUE(pager.CreateVmo(1, &vmo));
+
+    zx::vmo clone;
+    ASSERT_EQ(vmo->vmo().clone(ZX_VMO_CLONE_COPY_ON_WRITE, 0, ZX_PAGE_SIZE, &clone), ZX_OK);
+
+    uint64_t expected[ZX_PAGE_SIZE / sizeof(uint64_t)];
+    vmo->GenerateBufferContents(expected, 1, 0);
+
+    TestThread t([&clone, &expected]() -> bool {
+        uint64_t data[ZX_PAGE_SIZE / sizeof(uint64_t)];
+        return clone.read(data, 0, ZX_PAGE_SIZE) == ZX_OK &&
+               memcmp(data, expected, ZX_PAGE_SIZE) == 0;
+    });
+
+    ASSERT_TRUE(t.Start());
+
+    ASSERT_TRUE(pager.WaitForPageRead(vmo, 0, 1, ZX_TIME_INFINITE));
+
+    ASSERT_TRUE(pager.SupplyPages(vmo, 0, 1));
+
+    ASSERT_TRUE(t.Wait());
+
+    END_TEST;
+}
+
+// Tests that failing a page request fails the zx_vmo_read waiting for it, and
+// that the next access asks the pager again.
+bool fail_vmo_read_test() {
+    BEGIN_TEST;
+
+    UserPager pager;
+
+    ASSERT_TRUE(pager.Init());
+
+    PagedVmo* vmo;
+    ASSERT_TRUE(pager.CreateVmo(1, &vmo));
+
+    TestThread t([vmo]() -> bool {
+        uint64_t data[ZX_PAGE_SIZE / sizeof(uint64_t)];
+        return vmo->vmo().read(data, 0, ZX_PAGE_SIZE) == ZX_ERR_IO_DATA_INTEGRITY;
+    });
+
+    ASSERT_TRUE(t.Start());
+
+    ASSERT_TRUE(pager.WaitForPageRead(vmo, 0, 1, ZX_TIME_INFINITE));
+
+    ASSERT_TRUE(pager.FailPages(vmo, 0, 1, ZX_ERR_IO_DATA_INTEGRITY));
+
+    ASSERT_TRUE(t.Wait());
+
+    TestThread t2([vmo]() -> bool {
+        return vmo->CheckVmar(0, 1);
+    });
+
+    ASSERT_TRUE(t2.Start());
+
+    ASSERT_TRUE(pager.WaitForPageRead(vmo, 0, 1, ZX_TIME_INFINITE));
+
+    ASSERT_TRUE(pager.SupplyPages(vmo, 0, 1));
+
+    ASSERT_TRUE(t2.Wait());
+
+    END_TEST;
+}
+
+// Tests that failing a page request crashes the thread which faulted on it.
+bool fail_fault_test() {
+    BEGIN_TEST;
+
+    UserPager pager;
+
+    ASSERT_TRUE(pager.Init());
+
+    PagedVmo* vmo;
+    ASSERT_TRUE(pager.CreateVmo(1, &vmo));
+
+    TestThread t([vmo]() -> bool {
+        return vmo->CheckVmar(0, 1);
+    });
+
+    ASSERT_TRUE(t.Start());
+
+    ASSERT_TRUE(pager.WaitForPageRead(vmo, 0, 1, ZX_TIME_INFINITE));
+
+    ASSERT_TRUE(pager.FailPages(vmo, 0, 1));
+
+    ASSERT_TRUE(t.WaitForCrash(vmo->GetBaseAddr()));
+
+    ASSERT_FALSE(pager.FailPages(vmo, 0, 1, ZX_ERR_NO_MEMORY));
+
+    END_TEST;
+}
+
 // Checks that a thread blocked on accessing a paged vmo can be safely killed.
 bool thread_kill_test() {
     BEGIN_TEST;
@@ -627,6 +779,10 @@ RUN_TEST(successive_vmo_test);
 RUN_TEST(multiple_concurrent_vmo_test);
 RUN_TEST(vmar_unmap_test);
 RUN_TEST(vmar_remap_test);
+RUN_TEST(clone_read_test);
+RUN_TEST(clone_vmo_read_test);
+RUN_TEST(fail_vmo_read_test);
+RUN_TEST(fail_fault_test);
 END_TEST_CASE(pager_read_tests)
 
 // Tests focused on lifecycle of pager and paged vmos
@@ -231,4 +231,11 @@ bool UserPager::SupplyPages(PagedVmo* paged_vmo, uint64_t dest_offset,
     return true;
 }
 
+bool UserPager::FailPages(PagedVmo* paged_vmo, uint64_t page_offset, uint64_t page_count,
+                          zx_status_t error_status) {
+    return zx_pager_op_range(pager_, ZX_PAGER_OP_FAIL, paged_vmo->vmo_.get(),
+                             page_offset * ZX_PAGE_SIZE, page_count * ZX_PAGE_SIZE,
+                             error_status) == ZX_OK;
+}
+
 } // namespace pager_tests
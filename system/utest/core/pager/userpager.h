@@ -29,6 +29,7 @@ public:
 
     uint64_t GetKey() const { return base_val_; }
     uintptr_t GetBaseAddr() const { return base_addr_; }
+    const zx::vmo& vmo() const { return vmo_; }
 
 private:
     PagedVmo(zx::vmo vmo, uint64_t size, uint64_t* base, uint64_t base_addr, uint64_t base_val)
@@ -80,6 +81,10 @@ public:
     bool SupplyPages(PagedVmo* vmo, uint64_t page_offset, uint64_t page_count,
                      zx::vmo src, uint64_t src_page_offset = 0);
 
+    // Fails any requests for the specified pages with |error_status|.
+    bool FailPages(PagedVmo* vmo, uint64_t page_offset, uint64_t page_count,
+                   zx_status_t error_status = ZX_ERR_IO);
+
     // Checks if there is a requets for the range [page_offset, length). Will
     // wait until |deadline|.
     bool WaitForPageRead(PagedVmo* vmo, uint64_t page_offset,
@@ -527,6 +527,73 @@ static bool cancel_event_key_once_after() {
 static bool cancel_event_key_repeat_after() {
     return cancel_event_after(ZX_WAIT_ASYNC_REPEATING);
 }
+static bool create_invalid_option_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t port;
+    EXPECT_EQ(zx_port_create(1u << 2, &port), ZX_ERR_INVALID_ARGS);
+
+    END_TEST;
+}
+
+struct per_cpu_context {
+    zx_handle_t port;
+    uint64_t key;
+};
+
+static constexpr uint32_t kPerCpuPackets = 200u;
+
+static int per_cpu_queue_thread(void* arg) {
+    auto ctx = reinterpret_cast<per_cpu_context*>(arg);
+    const zx_port_packet_t in = { ctx->key, ZX_PKT_TYPE_USER, 0, { {} } };
+    for (uint32_t ix = 0; ix != kPerCpuPackets; ++ix) {
+        auto st = zx_port_queue(ctx->port, &in);
+        if (st != ZX_OK)
+            return st;
+    }
+    return 0;
+}
+
+static bool per_cpu_queue_test(void) {
+    BEGIN_TEST;
+
+    // Packets queued from several threads, and so likely from several cpus,
+    // must all be dequeued from any one thread.
+    zx_handle_t port;
+    ASSERT_EQ(zx_port_create(ZX_PORT_PER_CPU, &port), ZX_OK);
+
+    thrd_t threads[4];
+    per_cpu_context ctx[4];
+    for (size_t ix = 0; ix != fbl::count_of(threads); ++ix) {
+        ctx[ix] = { port, ix };
+        ASSERT_EQ(thrd_create(&threads[ix], per_cpu_queue_thread, &ctx[ix]), thrd_success);
+    }
+
+    uint32_t received[4] = {};
+    for (uint32_t ix = 0; ix != kPerCpuPackets * fbl::count_of(threads); ++ix) {
+        zx_port_packet_t out = {};
+        ASSERT_EQ(zx_port_wait(port, ZX_TIME_INFINITE, &out), ZX_OK);
+        ASSERT_LT(out.key, fbl::count_of(received));
+        ++received[out.key];
+    }
+
+    for (size_t ix = 0; ix != fbl::count_of(threads); ++ix) {
+        int res;
+        EXPECT_EQ(thrd_join(threads[ix], &res), thrd_success);
+        EXPECT_EQ(res, 0);
+        EXPECT_EQ(received[ix], kPerCpuPackets);
+    }
+
+    zx_port_packet_t out = {};
+    EXPECT_EQ(zx_port_wait(port, 0, &out), ZX_ERR_TIMED_OUT);
+
+    // Closing the port with packets still queued frees them.
+    const zx_port_packet_t in = { 7ull, ZX_PKT_TYPE_USER, 0, { {} } };
+    EXPECT_EQ(zx_port_queue(port, &in), ZX_OK);
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+
+    END_TEST;
+}
 
 struct test_context {
     zx_handle_t port;
@@ -546,13 +613,13 @@ static int port_reader_thread(void* arg) {
     return 0;
 }
 
-static bool threads_event(uint32_t wait_mode) {
+static bool threads_event(uint32_t wait_mode, uint32_t port_options) {
     BEGIN_TEST;
 
     zx_handle_t port;
     zx_handle_t ev;
 
-    EXPECT_EQ(zx_port_create(0, &port), ZX_OK);
+    EXPECT_EQ(zx_port_create(port_options, &port), ZX_OK);
     EXPECT_EQ(zx_event_create(0u, &ev), ZX_OK);
 
     thrd_t threads[3];
@@ -584,11 +651,19 @@ static bool threads_event(uint32_t wait_mode) {
 }
 
 static bool threads_event_once() {
-    return threads_event(ZX_WAIT_ASYNC_ONCE);
+    return threads_event(ZX_WAIT_ASYNC_ONCE, 0u);
 }
 
 static bool threads_event_repeat() {
-    return threads_event(ZX_WAIT_ASYNC_REPEATING);
+    return threads_event(ZX_WAIT_ASYNC_REPEATING, 0u);
+}
+
+static bool threads_event_once_per_cpu() {
+    return threads_event(ZX_WAIT_ASYNC_ONCE, ZX_PORT_PER_CPU);
+}
+
+static bool threads_event_repeat_per_cpu() {
+    return threads_event(ZX_WAIT_ASYNC_REPEATING, ZX_PORT_PER_CPU);
 }
 
 
@@ -681,6 +756,8 @@ BEGIN_TEST_CASE(port_tests)
 RUN_TEST(basic_test)
 RUN_TEST(queue_and_close_test)
 RUN_TEST(queue_too_many)
+RUN_TEST(create_invalid_option_test)
+RUN_TEST(per_cpu_queue_test)
 RUN_TEST(async_wait_channel_test)
 RUN_TEST(async_wait_event_test_single)
 RUN_TEST(async_wait_event_test_repeat)
@@ -699,6 +776,8 @@ RUN_TEST(cancel_event_key_once_after)
 RUN_TEST(cancel_event_key_repeat_after)
 RUN_TEST(threads_event_once)
 RUN_TEST(threads_event_repeat)
+RUN_TEST(threads_event_once_per_cpu)
+RUN_TEST(threads_event_repeat_per_cpu)
 RUN_TEST_LARGE(cancel_stress)
 END_TEST_CASE(port_tests)
 
@@ -2,16 +2,20 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <threads.h>
+#include <unistd.h>
 
 #include <fbl/function.h>
 #include <fbl/string.h>
 #include <fbl/string_buffer.h>
 #include <fbl/string_printf.h>
 #include <fbl/unique_fd.h>
+#include <fbl/vector.h>
 #include <fs-management/mount.h>
 #include <fs-test-utils/fixture.h>
 #include <fs-test-utils/perftest.h>
@@ -70,6 +74,159 @@ bool ReadBigFile(ssize_t data_size, perftest::RepeatState* state, Fixture* fixtu
     END_HELPER;
 }
 
+// Each concurrent reader reads a file of its own of this size, this much at a time.
+constexpr size_t kReaderFileSize = 256 * (1 << 10);
+constexpr size_t kReaderReadSize = 16 * (1 << 10);
+
+fbl::String GetReaderFilePath(const Fixture& fixture, int reader) {
+    return fbl::StringPrintf("%s/reader-%d.txt", fixture.fs_path().c_str(), reader);
+}
+
+struct ReaderArgs {
+    int fd;
+    bool success;
+};
+
+int ReadReaderFile(void* arg) {
+    auto args = static_cast<ReaderArgs*>(arg);
+    uint8_t data[kReaderReadSize];
+    args->success = false;
+    for (size_t off = 0; off < kReaderFileSize; off += sizeof(data)) {
+        if (pread(args->fd, data, sizeof(data), off) != static_cast<ssize_t>(sizeof(data))) {
+            return -1;
+        }
+    }
+    args->success = true;
+    return 0;
+}
+
+// Reads |readers| different files at once, one from each of as many threads,
+// to show how well the filesystem serves independent requests in parallel.
+bool ReadConcurrently(int readers, perftest::RepeatState* state, Fixture* fixture) {
+    BEGIN_HELPER;
+
+    fbl::Vector<fbl::unique_fd> fds;
+    uint8_t data[kReaderReadSize];
+    memset(data, static_cast<uint8_t>(rand_r(fixture->mutable_seed()) % (1 << 8)), sizeof(data));
+    for (int i = 0; i < readers; ++i) {
+        fbl::unique_fd fd(open(GetReaderFilePath(*fixture, i).c_str(),
+                               O_CREAT | O_TRUNC | O_RDWR));
+        ASSERT_TRUE(fd);
+        for (size_t off = 0; off < kReaderFileSize; off += sizeof(data)) {
+            ASSERT_EQ(write(fd.get(), data, sizeof(data)), static_cast<ssize_t>(sizeof(data)));
+        }
+        fds.push_back(std::move(fd));
+    }
+
+    fbl::Vector<ReaderArgs> args;
+    fbl::Vector<thrd_t> threads;
+    for (const fbl::unique_fd& fd : fds) {
+        args.push_back({fd.get(), false});
+        threads.push_back(thrd_t());
+    }
+
+    state->DeclareStep("read");
+    while (state->KeepRunning()) {
+        for (int i = 0; i < readers; ++i) {
+            ASSERT_EQ(thrd_create(&threads[i], ReadReaderFile, &args[i]), thrd_success);
+        }
+        for (int i = 0; i < readers; ++i) {
+            ASSERT_EQ(thrd_join(threads[i], nullptr), thrd_success);
+            ASSERT_TRUE(args[i].success);
+        }
+    }
+
+    END_HELPER;
+}
+
+fbl::String GetAppendFilePath(const Fixture& fixture, size_t append_size) {
+    return fbl::StringPrintf("%s/append-%zu.txt", fixture.fs_path().c_str(), append_size);
+}
+
+// Appends |append_size| bytes to a file at each step, as a log does, so that
+// most steps only add to a block which the last has already written to.
+bool AppendSmallWrites(size_t append_size, perftest::RepeatState* state, Fixture* fixture) {
+    BEGIN_HELPER;
+
+    fbl::unique_fd fd(open(GetAppendFilePath(*fixture, append_size).c_str(),
+                           O_CREAT | O_TRUNC | O_WRONLY | O_APPEND));
+    ASSERT_TRUE(fd);
+    uint8_t data[append_size];
+    memset(data, static_cast<uint8_t>(rand_r(fixture->mutable_seed()) % (1 << 8)), append_size);
+
+    state->DeclareStep("append");
+    while (state->KeepRunning()) {
+        ASSERT_EQ(write(fd.get(), data, append_size), static_cast<ssize_t>(append_size));
+    }
+    ASSERT_EQ(fsync(fd.get()), 0);
+
+    END_HELPER;
+}
+
+// The large directory tests work in a directory of this many entries, most of
+// which are links to one file, since there may not be an inode for each.
+constexpr int kLargeDirectoryEntries = 100000;
+// Roughly how much space each entry takes, counting the directory's index.
+constexpr size_t kLargeDirectoryEntrySize = 32;
+
+fbl::String GetLargeDirectoryPath(const Fixture& fixture) {
+    return fbl::StringPrintf("%s/large", fixture.fs_path().c_str());
+}
+
+// Fills the large directory with |entries| links, unless an earlier test
+// already has.
+bool FillLargeDirectory(int entries, Fixture* fixture) {
+    BEGIN_HELPER;
+
+    fbl::String dir = GetLargeDirectoryPath(*fixture);
+    if (mkdir(dir.c_str(), 0666) == 0) {
+        fbl::String target = fbl::StringPrintf("%s/target", dir.c_str());
+        fbl::unique_fd fd(open(target.c_str(), O_CREAT | O_RDWR));
+        ASSERT_TRUE(fd);
+        for (int i = 0; i < entries; ++i) {
+            fbl::String path = fbl::StringPrintf("%s/%d", dir.c_str(), i);
+            ASSERT_EQ(link(target.c_str(), path.c_str()), 0, path.c_str());
+        }
+    } else {
+        ASSERT_EQ(errno, EEXIST);
+    }
+
+    END_HELPER;
+}
+
+// Creates a new file in the large directory at each step.
+bool CreateInLargeDirectory(int entries, perftest::RepeatState* state, Fixture* fixture) {
+    BEGIN_HELPER;
+    ASSERT_TRUE(FillLargeDirectory(entries, fixture));
+
+    fbl::String dir = GetLargeDirectoryPath(*fixture);
+    state->DeclareStep("create");
+    for (int i = 0; state->KeepRunning(); ++i) {
+        fbl::String path = fbl::StringPrintf("%s/new-%d", dir.c_str(), i);
+        fbl::unique_fd fd(open(path.c_str(), O_CREAT | O_EXCL | O_RDWR));
+        ASSERT_TRUE(fd, path.c_str());
+    }
+
+    END_HELPER;
+}
+
+// Looks up an entry of the large directory, chosen at random, at each step.
+bool LookupInLargeDirectory(int entries, perftest::RepeatState* state, Fixture* fixture) {
+    BEGIN_HELPER;
+    ASSERT_TRUE(FillLargeDirectory(entries, fixture));
+
+    fbl::String dir = GetLargeDirectoryPath(*fixture);
+    state->DeclareStep("lookup");
+    while (state->KeepRunning()) {
+        int entry = rand_r(fixture->mutable_seed()) % entries;
+        fbl::String path = fbl::StringPrintf("%s/%d", dir.c_str(), entry);
+        struct stat buf;
+        ASSERT_EQ(stat(path.c_str(), &buf), 0, path.c_str());
+    }
+
+    END_HELPER;
+}
+
 constexpr char kBaseComponent[] = "/aaa";
 
 constexpr size_t kComponentLength = fbl::constexpr_strlen(kBaseComponent);
@@ -240,6 +397,80 @@ bool RunBenchmark(int argc, char** argv) {
         testcases.push_back(std::move(testcase));
     }
 
+    // Concurrent read tests.
+    const int concurrent_reader_counts[] = {
+        1,
+        2,
+        4,
+        8,
+    };
+
+    TestCaseInfo concurrent_testcase;
+    concurrent_testcase.name = fbl::StringPrintf("%s/ConcurrentRead/%zuKbytes",
+                                                 disk_format_string_[f_opts.fs_type],
+                                                 kReaderFileSize / (1 << 10));
+    concurrent_testcase.teardown = true;
+    for (int readers : concurrent_reader_counts) {
+        TestInfo read_test;
+        read_test.name = fbl::StringPrintf("%s/%d-Readers", concurrent_testcase.name.c_str(),
+                                           readers);
+        read_test.test_fn = [readers](perftest::RepeatState* state, Fixture* fixture) {
+            return ReadConcurrently(readers, state, fixture);
+        };
+        read_test.required_disk_space = readers * kReaderFileSize;
+        concurrent_testcase.tests.push_back(std::move(read_test));
+    }
+    testcases.push_back(std::move(concurrent_testcase));
+
+    // Small append tests.
+    const size_t append_sizes[] = {
+        64,
+        512,
+        4096,
+    };
+
+    TestCaseInfo append_testcase;
+    append_testcase.name = fbl::StringPrintf("%s/SmallAppend",
+                                             disk_format_string_[f_opts.fs_type]);
+    append_testcase.sample_count = 4096;
+    append_testcase.teardown = true;
+    for (size_t append_size : append_sizes) {
+        TestInfo append_test;
+        append_test.name = fbl::StringPrintf("%s/%zuBytes", append_testcase.name.c_str(),
+                                             append_size);
+        append_test.test_fn = [append_size](perftest::RepeatState* state, Fixture* fixture) {
+            return AppendSmallWrites(append_size, state, fixture);
+        };
+        append_test.required_disk_space = append_testcase.sample_count * append_size;
+        append_testcase.tests.push_back(std::move(append_test));
+    }
+    testcases.push_back(std::move(append_testcase));
+
+    // Large directory tests. In unittest mode, a small directory will do.
+    int entries = p_opts.is_unittest ? 1000 : kLargeDirectoryEntries;
+    TestCaseInfo large_dir_testcase;
+    large_dir_testcase.name = fbl::StringPrintf("%s/LargeDirectory/%d-Entries",
+                                                disk_format_string_[f_opts.fs_type], entries);
+    large_dir_testcase.sample_count = 1000;
+    large_dir_testcase.teardown = false;
+
+    TestInfo lookup_test;
+    lookup_test.name = fbl::StringPrintf("%s/Lookup", large_dir_testcase.name.c_str());
+    lookup_test.test_fn = [entries](perftest::RepeatState* state, Fixture* fixture) {
+        return LookupInLargeDirectory(entries, state, fixture);
+    };
+    lookup_test.required_disk_space = entries * kLargeDirectoryEntrySize;
+    large_dir_testcase.tests.push_back(std::move(lookup_test));
+
+    TestInfo create_test;
+    create_test.name = fbl::StringPrintf("%s/Create", large_dir_testcase.name.c_str());
+    create_test.test_fn = [entries](perftest::RepeatState* state, Fixture* fixture) {
+        return CreateInLargeDirectory(entries, state, fixture);
+    };
+    create_test.required_disk_space = entries * kLargeDirectoryEntrySize;
+    large_dir_testcase.tests.push_back(std::move(create_test));
+    testcases.push_back(std::move(large_dir_testcase));
+
     return fs_test_utils::RunTestCases(f_opts, p_opts, testcases);
 }
 } // namespace fs_bench
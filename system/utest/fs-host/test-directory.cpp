@@ -4,7 +4,15 @@
 
 #include "util.h"
 
+#include <unistd.h>
+
 #include <fbl/algorithm.h>
+#include <fbl/unique_fd.h>
+#include <fbl/unique_ptr.h>
+#include <minfs/bcache.h>
+#include <minfs/format.h>
+
+#include <utility>
 
 bool check_dir_contents(const char* dirname, expected_dirent_t* edirents, size_t len) {
     BEGIN_HELPER;
@@ -120,8 +128,121 @@ bool TestDirectoryReaddirLarge(void) {
     END_TEST;
 }
 
+// Enough entries for a directory to be indexed, and for its first bucket to be split.
+constexpr size_t kIndexedEntries = minfs::kMinfsDirIndexBucketEntries * 2;
+
+bool CreateFiles(const char* dirname, size_t first, size_t count) {
+    BEGIN_HELPER;
+    for (size_t i = first; i < first + count; i++) {
+        char path[100];
+        snprintf(path, sizeof(path), "%s/file-%05zu", dirname, i);
+        int fd = emu_open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+        ASSERT_GT(fd, 0);
+        ASSERT_EQ(emu_close(fd), 0);
+    }
+    END_HELPER;
+}
+
+// Checks that every |step|th file from |first| to |end| exists, or that none do.
+bool CheckFiles(const char* dirname, size_t first, size_t end, size_t step, bool exist) {
+    BEGIN_HELPER;
+    for (size_t i = first; i < end; i += step) {
+        char path[100];
+        snprintf(path, sizeof(path), "%s/file-%05zu", dirname, i);
+        struct stat s;
+        if (exist) {
+            ASSERT_EQ(emu_stat(path, &s), 0);
+        } else {
+            ASSERT_LT(emu_stat(path, &s), 0);
+        }
+    }
+    END_HELPER;
+}
+
+bool UnlinkFiles(const char* dirname, size_t first, size_t end, size_t step) {
+    BEGIN_HELPER;
+    for (size_t i = first; i < end; i += step) {
+        char path[100];
+        snprintf(path, sizeof(path), "%s/file-%05zu", dirname, i);
+        ASSERT_EQ(emu_unlink(path), 0);
+    }
+    END_HELPER;
+}
+
+bool TestDirectoryIndex(void) {
+    BEGIN_TEST;
+
+    // The index is built once the directory is large enough, and its buckets split as the
+    // directory grows further; fsck checks that it holds every entry.
+    ASSERT_EQ(emu_mkdir("::index", 0755), 0);
+    ASSERT_TRUE(CreateFiles("::index", 0, kIndexedEntries));
+    ASSERT_TRUE(CheckFiles("::index", 0, kIndexedEntries, 1, true));
+    ASSERT_EQ(run_fsck(), 0);
+
+    // Unlinks through the index leave runs of free dirents, which are merged as the index
+    // is rebuilt.
+    ASSERT_TRUE(UnlinkFiles("::index", 0, kIndexedEntries, 2));
+    ASSERT_TRUE(CheckFiles("::index", 0, kIndexedEntries, 2, false));
+    ASSERT_TRUE(CheckFiles("::index", 1, kIndexedEntries, 2, true));
+    ASSERT_EQ(run_fsck(), 0);
+    ASSERT_TRUE(UnlinkFiles("::index", 1, kIndexedEntries, 2));
+    ASSERT_TRUE(CheckFiles("::index", 0, kIndexedEntries, 1, false));
+    ASSERT_EQ(run_fsck(), 0);
+
+    ASSERT_TRUE(CreateFiles("::index", kIndexedEntries, kIndexedEntries));
+    ASSERT_TRUE(CheckFiles("::index", kIndexedEntries, kIndexedEntries * 2, 1, true));
+    ASSERT_EQ(run_fsck(), 0);
+    END_TEST;
+}
+
+bool TestDirectoryIndexStale(void) {
+    BEGIN_TEST;
+
+    ASSERT_EQ(emu_mkdir("::stale", 0755), 0);
+    ASSERT_TRUE(CreateFiles("::stale", 0, kIndexedEntries));
+    struct stat s;
+    ASSERT_EQ(emu_stat("::stale", &s), 0);
+    const minfs::ino_t ino = static_cast<minfs::ino_t>(s.st_ino);
+
+    // Change the directory behind the index's back, as a driver which does not know of
+    // indexes would, and mount the image again.
+    {
+        fbl::unique_fd fd(open(MOUNT_PATH, O_RDWR));
+        ASSERT_TRUE(fd);
+        ASSERT_EQ(fstat(fd.get(), &s), 0);
+        fbl::unique_ptr<minfs::Bcache> bc;
+        ASSERT_EQ(minfs::Bcache::Create(&bc, std::move(fd),
+                                        static_cast<uint32_t>(s.st_size /
+                                                              minfs::kMinfsBlockSize)), ZX_OK);
+        uint8_t data[minfs::kMinfsBlockSize];
+        ASSERT_EQ(bc->Readblk(0, data), ZX_OK);
+        minfs::Superblock info;
+        memcpy(&info, data, sizeof(info));
+        const minfs::blk_t bno = info.ino_block + ino / minfs::kMinfsInodesPerBlock;
+        ASSERT_EQ(bc->Readblk(bno, data), ZX_OK);
+        minfs::Inode* inode = reinterpret_cast<minfs::Inode*>(data) +
+                              ino % minfs::kMinfsInodesPerBlock;
+        ASSERT_NE(inode->dir_index, 0u);
+        inode->seq_num++;
+        ASSERT_EQ(bc->Writeblk(bno, data), ZX_OK);
+    }
+    ASSERT_EQ(emu_mount(MOUNT_PATH), 0);
+
+    // Names are still found, by scanning the directory, and the next change rebuilds the
+    // index.
+    ASSERT_EQ(run_fsck(), 0);
+    ASSERT_TRUE(CheckFiles("::stale", 0, kIndexedEntries, 1, true));
+    ASSERT_TRUE(UnlinkFiles("::stale", 0, kIndexedEntries, 3));
+    ASSERT_TRUE(CheckFiles("::stale", 0, kIndexedEntries, 3, false));
+    ASSERT_TRUE(CheckFiles("::stale", 1, kIndexedEntries, 3, true));
+    ASSERT_EQ(run_fsck(), 0);
+    END_TEST;
+}
+
 RUN_MINFS_TESTS(directory_tests,
     RUN_TEST_LARGE(TestDirectoryLarge)
     RUN_TEST_MEDIUM(TestDirectoryReaddir)
     RUN_TEST_MEDIUM(TestDirectoryReaddirLarge)
+    RUN_TEST_LARGE(TestDirectoryIndex)
+    RUN_TEST_MEDIUM(TestDirectoryIndexStale)
 )
@@ -0,0 +1,168 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Tests the extents which map the blocks of a file, by writing every other block, so that
+// each block written needs an extent of its own.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <minfs/format.h>
+
+#include "util.h"
+
+namespace {
+
+// Fills |buf| with the contents written to block |n| of a file.
+void FillBlock(uint8_t* buf, size_t n) {
+    memset(buf, static_cast<int>(n * 7 + 1), minfs::kMinfsBlockSize);
+    memcpy(buf, &n, sizeof(n));
+}
+
+ssize_t WriteBlock(int fd, size_t n) {
+    uint8_t buf[minfs::kMinfsBlockSize];
+    FillBlock(buf, n);
+    return emu_pwrite(fd, buf, sizeof(buf), n * minfs::kMinfsBlockSize);
+}
+
+bool CheckBlock(int fd, size_t n) {
+    BEGIN_HELPER;
+    uint8_t expected[minfs::kMinfsBlockSize];
+    uint8_t buf[minfs::kMinfsBlockSize];
+    FillBlock(expected, n);
+    ASSERT_EQ(emu_pread(fd, buf, sizeof(buf), n * minfs::kMinfsBlockSize),
+              static_cast<ssize_t>(sizeof(buf)));
+    ASSERT_EQ(memcmp(buf, expected, sizeof(buf)), 0);
+    END_HELPER;
+}
+
+bool CheckHole(int fd, size_t n) {
+    BEGIN_HELPER;
+    uint8_t expected[minfs::kMinfsBlockSize];
+    uint8_t buf[minfs::kMinfsBlockSize];
+    memset(expected, 0, sizeof(expected));
+    ASSERT_EQ(emu_pread(fd, buf, sizeof(buf), n * minfs::kMinfsBlockSize),
+              static_cast<ssize_t>(sizeof(buf)));
+    ASSERT_EQ(memcmp(buf, expected, sizeof(buf)), 0);
+    END_HELPER;
+}
+
+// Writes every other block of |fd|, from block |first| on, needing |extents| extents.
+bool WriteExtents(int fd, size_t first, size_t extents) {
+    BEGIN_HELPER;
+    for (size_t i = 0; i < extents; i++) {
+        ASSERT_EQ(WriteBlock(fd, first + i * 2), static_cast<ssize_t>(minfs::kMinfsBlockSize));
+    }
+    END_HELPER;
+}
+
+// Checks what WriteExtents wrote, and the holes between; the file may end at the last block.
+bool CheckExtents(int fd, size_t first, size_t extents) {
+    BEGIN_HELPER;
+    for (size_t i = 0; i < extents; i++) {
+        ASSERT_TRUE(CheckBlock(fd, first + i * 2));
+        if (i + 1 < extents) {
+            ASSERT_TRUE(CheckHole(fd, first + i * 2 + 1));
+        }
+    }
+    END_HELPER;
+}
+
+bool TestExtentsSpillAndFoldBack(void) {
+    BEGIN_TEST;
+    constexpr size_t kExtents = minfs::kMinfsInlineExtents + 1;
+    int fd = emu_open("::spill", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0);
+
+    // One more extent than the inode holds moves them all out to an extent block.
+    ASSERT_TRUE(WriteExtents(fd, 0, kExtents));
+    ASSERT_TRUE(CheckExtents(fd, 0, kExtents));
+    ASSERT_EQ(emu_close(fd), 0);
+    ASSERT_EQ(run_fsck(), 0);
+
+    // Once they fit in the inode again, they move back into it.
+    fd = emu_open("::spill", O_RDWR, 0644);
+    ASSERT_GT(fd, 0);
+    ASSERT_EQ(emu_ftruncate(fd, (kExtents - 1) * 2 * minfs::kMinfsBlockSize), 0);
+    ASSERT_TRUE(CheckExtents(fd, 0, kExtents - 1));
+    ASSERT_EQ(emu_close(fd), 0);
+    ASSERT_EQ(run_fsck(), 0);
+    END_TEST;
+}
+
+bool TestExtentsSplit(void) {
+    BEGIN_TEST;
+    constexpr size_t kExtents = minfs::kMinfsExtentsPerBlock * 2 + 1;
+    int fd = emu_open("::split", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0);
+
+    // Writing from start to end splits off empty extent blocks at the end.
+    ASSERT_TRUE(WriteExtents(fd, 0, kExtents));
+
+    // Writing into the middle of a full extent block splits it in half.
+    ASSERT_TRUE(WriteExtents(fd, 1, 16));
+    for (size_t n = 0; n < 33; n++) {
+        ASSERT_TRUE(CheckBlock(fd, n));
+    }
+    ASSERT_TRUE(CheckExtents(fd, 34, kExtents - 17));
+    ASSERT_EQ(emu_close(fd), 0);
+    ASSERT_EQ(run_fsck(), 0);
+
+    // Truncating drops the extent blocks left empty.
+    fd = emu_open("::split", O_RDWR, 0644);
+    ASSERT_GT(fd, 0);
+    ASSERT_EQ(emu_ftruncate(fd, 64 * minfs::kMinfsBlockSize), 0);
+    ASSERT_TRUE(CheckExtents(fd, 34, 15));
+    ASSERT_EQ(emu_close(fd), 0);
+    ASSERT_EQ(run_fsck(), 0);
+    END_TEST;
+}
+
+bool TestExtentsFull(void) {
+    BEGIN_TEST;
+    constexpr size_t kExtents = minfs::kMinfsExtentRefs * minfs::kMinfsExtentsPerBlock;
+    int fd = emu_open("::full", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0);
+
+    // Every extent block fills up before the file runs out of extents. The write which
+    // needs one more fails with ENOSPC, though the volume has room, and changes nothing.
+    ASSERT_TRUE(WriteExtents(fd, 0, kExtents));
+    struct stat s;
+    ASSERT_EQ(emu_fstat(fd, &s), 0);
+    const off_t size = s.st_size;
+    ASSERT_LT(WriteBlock(fd, kExtents * 2), 0);
+    ASSERT_EQ(errno, ENOSPC);
+    ASSERT_EQ(emu_fstat(fd, &s), 0);
+    ASSERT_EQ(s.st_size, size);
+    ASSERT_TRUE(CheckExtents(fd, kExtents - 100, 100));
+    ASSERT_EQ(run_fsck(), 0);
+
+    // Other files are not limited by it.
+    int other = emu_open("::other", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(other, 0);
+    ASSERT_EQ(WriteBlock(other, 0), static_cast<ssize_t>(minfs::kMinfsBlockSize));
+    ASSERT_EQ(emu_close(other), 0);
+
+    // Once the last extent block has room again, the one before it can move extents over.
+    constexpr size_t kFreed = 100;
+    ASSERT_EQ(emu_ftruncate(fd, (kExtents - kFreed) * 2 * minfs::kMinfsBlockSize), 0);
+    const size_t hole = (kExtents - minfs::kMinfsExtentsPerBlock - 10) * 2 + 1;
+    ASSERT_EQ(WriteBlock(fd, hole), static_cast<ssize_t>(minfs::kMinfsBlockSize));
+    ASSERT_TRUE(CheckBlock(fd, hole));
+    ASSERT_TRUE(CheckExtents(fd, hole + 1, 100));
+    ASSERT_TRUE(CheckExtents(fd, 0, 100));
+    ASSERT_EQ(emu_close(fd), 0);
+    ASSERT_EQ(run_fsck(), 0);
+    END_TEST;
+}
+
+} // namespace
+
+RUN_MINFS_TESTS(extent_tests,
+    RUN_TEST_MEDIUM(TestExtentsSpillAndFoldBack)
+    RUN_TEST_MEDIUM(TestExtentsSplit)
+    RUN_TEST_LARGE(TestExtentsFull)
+)
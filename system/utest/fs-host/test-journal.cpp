@@ -0,0 +1,249 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Tests replay of the minfs journal, by writing entries to it by hand.
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fbl/unique_fd.h>
+#include <fbl/unique_ptr.h>
+#include <lib/cksum.h>
+#include <minfs/bcache.h>
+#include <minfs/format.h>
+#include <minfs/journal.h>
+#include <minfs/minfs.h>
+#include <unittest/unittest.h>
+
+#include <utility>
+
+namespace {
+
+using minfs::blk_t;
+
+constexpr size_t kImageBlocks = 8192;
+
+// An image of a fresh filesystem, and the journal within it.
+class JournalImage {
+public:
+    ~JournalImage() {
+        if (path_[0] != '\0') {
+            unlink(path_);
+        }
+    }
+
+    bool Init() {
+        BEGIN_HELPER;
+        strcpy(path_, "/tmp/minfs-journal-test.XXXXXX");
+        fbl::unique_fd fd(mkstemp(path_));
+        ASSERT_TRUE(fd);
+        ASSERT_EQ(ftruncate(fd.get(), kImageBlocks * minfs::kMinfsBlockSize), 0);
+        fbl::unique_ptr<minfs::Bcache> bc;
+        ASSERT_EQ(minfs::Bcache::Create(&bc, std::move(fd), kImageBlocks), ZX_OK);
+        ASSERT_EQ(minfs::Mkfs(std::move(bc)), ZX_OK);
+        ASSERT_TRUE(Reopen());
+
+        uint8_t data[minfs::kMinfsBlockSize];
+        ASSERT_EQ(bc_->Readblk(0, data), ZX_OK);
+        memcpy(&info_, data, sizeof(info_));
+        minfs::GetJournalBlocks(*bc_, info_, &start_, &count_);
+        ASSERT_GE(count_, 16u);
+        ASSERT_EQ(bc_->Readblk(start_, data), ZX_OK);
+        memcpy(&journal_info_, data, sizeof(journal_info_));
+        ASSERT_EQ(journal_info_.magic, minfs::kJournalMagic);
+        pos_ = journal_info_.start;
+        sequence_ = journal_info_.sequence;
+        END_HELPER;
+    }
+
+    // Opens the image again, as a remount would.
+    bool Reopen() {
+        BEGIN_HELPER;
+        bc_.reset();
+        fbl::unique_fd fd(open(path_, O_RDWR));
+        ASSERT_TRUE(fd);
+        ASSERT_EQ(minfs::Bcache::Create(&bc_, std::move(fd), kImageBlocks), ZX_OK);
+        END_HELPER;
+    }
+
+    // Writes the next entry, which holds |target| filled with |fill|, and revokes |revoked|
+    // if it is not zero. If |torn|, the commit block holds the wrong checksum.
+    bool WriteEntry(blk_t target, uint8_t fill, blk_t revoked, bool torn) {
+        BEGIN_HELPER;
+        uint8_t data[minfs::kMinfsBlockSize];
+        memset(data, 0, sizeof(data));
+        minfs::JournalHeader* header = reinterpret_cast<minfs::JournalHeader*>(data);
+        header->magic = minfs::kJournalEntryMagic;
+        header->sequence = sequence_;
+        header->block_count = target != 0 ? 1 : 0;
+        header->revoked_count = revoked != 0 ? 1 : 0;
+        header->target_blocks[0] = target;
+        uint32_t checksum = crc32(0, data, sizeof(data));
+        ASSERT_TRUE(WriteNext(data));
+
+        if (revoked != 0) {
+            memset(data, 0, sizeof(data));
+            memcpy(data, &revoked, sizeof(revoked));
+            checksum = crc32(checksum, data, sizeof(data));
+            ASSERT_TRUE(WriteNext(data));
+        }
+        if (target != 0) {
+            memset(data, fill, sizeof(data));
+            checksum = crc32(checksum, data, sizeof(data));
+            ASSERT_TRUE(WriteNext(data));
+        }
+
+        memset(data, 0, sizeof(data));
+        minfs::JournalCommit* commit = reinterpret_cast<minfs::JournalCommit*>(data);
+        commit->magic = minfs::kJournalCommitMagic;
+        commit->sequence = sequence_;
+        commit->checksum = torn ? ~checksum : checksum;
+        ASSERT_TRUE(WriteNext(data));
+        sequence_++;
+        END_HELPER;
+    }
+
+    // Returns true if every byte of |bno| is |fill|.
+    bool BlockIs(blk_t bno, uint8_t fill) {
+        uint8_t data[minfs::kMinfsBlockSize];
+        if (bc_->Readblk(bno, data) != ZX_OK) {
+            return false;
+        }
+        for (size_t i = 0; i < sizeof(data); i++) {
+            if (data[i] != fill) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Fill(blk_t bno, uint8_t fill) {
+        BEGIN_HELPER;
+        uint8_t data[minfs::kMinfsBlockSize];
+        memset(data, fill, sizeof(data));
+        ASSERT_EQ(bc_->Writeblk(bno, data), ZX_OK);
+        END_HELPER;
+    }
+
+    size_t Entries() {
+        size_t entries = SIZE_MAX;
+        if (minfs::CountJournalEntries(bc_.get(), info_, &entries) != ZX_OK) {
+            return SIZE_MAX;
+        }
+        return entries;
+    }
+
+    minfs::Bcache* bc() { return bc_.get(); }
+
+    // A data block, which the entries may target.
+    blk_t DataBlock(blk_t n) const { return info_.dat_block + 100 + n; }
+
+private:
+    bool WriteNext(const uint8_t* data) {
+        BEGIN_HELPER;
+        const size_t capacity = count_ - 1;
+        ASSERT_EQ(bc_->Writeblk(static_cast<blk_t>(start_ + 1 + pos_ % capacity), data), ZX_OK);
+        pos_ = (pos_ + 1) % capacity;
+        END_HELPER;
+    }
+
+    char path_[64] = {};
+    fbl::unique_ptr<minfs::Bcache> bc_;
+    minfs::Superblock info_;
+    minfs::JournalInfo journal_info_;
+    blk_t start_ = 0;
+    blk_t count_ = 0;
+    size_t pos_ = 0;
+    uint64_t sequence_ = 0;
+};
+
+bool TestJournalReplay() {
+    BEGIN_TEST;
+    JournalImage image;
+    ASSERT_TRUE(image.Init());
+    const blk_t target = image.DataBlock(0);
+    ASSERT_TRUE(image.Fill(target, 0x11));
+
+    ASSERT_TRUE(image.WriteEntry(target, 0x22, 0, false));
+    ASSERT_EQ(image.Entries(), 1u);
+    ASSERT_TRUE(image.Reopen());
+    ASSERT_EQ(minfs::ReplayJournal(image.bc()), ZX_OK);
+    ASSERT_TRUE(image.BlockIs(target, 0x22));
+    ASSERT_EQ(image.Entries(), 0u);
+
+    // Replaying again changes nothing.
+    ASSERT_TRUE(image.Fill(target, 0x33));
+    ASSERT_EQ(minfs::ReplayJournal(image.bc()), ZX_OK);
+    ASSERT_TRUE(image.BlockIs(target, 0x33));
+    END_TEST;
+}
+
+bool TestJournalReplayRevoked() {
+    BEGIN_TEST;
+    JournalImage image;
+    ASSERT_TRUE(image.Init());
+    const blk_t target = image.DataBlock(0);
+    const blk_t other = image.DataBlock(1);
+    ASSERT_TRUE(image.Fill(target, 0x11));
+    ASSERT_TRUE(image.Fill(other, 0x11));
+
+    // The block is written as metadata, then freed and reused for data by a later entry,
+    // whose revocation must stop the stale metadata from being replayed over the data.
+    ASSERT_TRUE(image.WriteEntry(target, 0x22, 0, false));
+    ASSERT_TRUE(image.WriteEntry(other, 0x33, target, false));
+    ASSERT_EQ(image.Entries(), 2u);
+    ASSERT_EQ(minfs::ReplayJournal(image.bc()), ZX_OK);
+    ASSERT_TRUE(image.BlockIs(target, 0x11));
+    ASSERT_TRUE(image.BlockIs(other, 0x33));
+    ASSERT_EQ(image.Entries(), 0u);
+    END_TEST;
+}
+
+bool TestJournalReplayRevokedThenRewritten() {
+    BEGIN_TEST;
+    JournalImage image;
+    ASSERT_TRUE(image.Init());
+    const blk_t target = image.DataBlock(0);
+    ASSERT_TRUE(image.Fill(target, 0x11));
+
+    // A revocation only covers the entries before it.
+    ASSERT_TRUE(image.WriteEntry(target, 0x22, 0, false));
+    ASSERT_TRUE(image.WriteEntry(0, 0, target, false));
+    ASSERT_TRUE(image.WriteEntry(target, 0x44, 0, false));
+    ASSERT_EQ(minfs::ReplayJournal(image.bc()), ZX_OK);
+    ASSERT_TRUE(image.BlockIs(target, 0x44));
+    END_TEST;
+}
+
+bool TestJournalReplayTorn() {
+    BEGIN_TEST;
+    JournalImage image;
+    ASSERT_TRUE(image.Init());
+    const blk_t target = image.DataBlock(0);
+    const blk_t other = image.DataBlock(1);
+    ASSERT_TRUE(image.Fill(target, 0x11));
+    ASSERT_TRUE(image.Fill(other, 0x11));
+
+    // An entry whose checksum does not match was never committed, so neither it nor any
+    // entry after it is replayed.
+    ASSERT_TRUE(image.WriteEntry(target, 0x22, 0, false));
+    ASSERT_TRUE(image.WriteEntry(other, 0x33, 0, true));
+    ASSERT_EQ(image.Entries(), 1u);
+    ASSERT_EQ(minfs::ReplayJournal(image.bc()), ZX_OK);
+    ASSERT_TRUE(image.BlockIs(target, 0x22));
+    ASSERT_TRUE(image.BlockIs(other, 0x11));
+    ASSERT_EQ(image.Entries(), 0u);
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(minfs_journal_tests)
+RUN_TEST(TestJournalReplay)
+RUN_TEST(TestJournalReplayRevoked)
+RUN_TEST(TestJournalReplayRevokedThenRewritten)
+RUN_TEST(TestJournalReplayTorn)
+END_TEST_CASE(minfs_journal_tests)
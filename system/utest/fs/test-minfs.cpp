@@ -8,6 +8,7 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -276,13 +277,13 @@ bool TestFullOperations() {
     ASSERT_TRUE(sml_fd);
 
     // Write to the "big" file, filling the partition
-    // and leaving at most kMinfsDirect + 1 blocks unused.
-    uint32_t free_blocks = minfs::kMinfsDirect + 1;
+    // and leaving at most kMinfsInlineExtents + 1 blocks unused.
+    uint32_t free_blocks = minfs::kMinfsInlineExtents + 1;
     uint32_t actual_blocks;
     ASSERT_TRUE(FillPartition(big_fd.get(), free_blocks, &actual_blocks));
 
     // Write enough data to the second file to take up all remaining blocks except for 1.
-    // This should strictly be writing to the direct block section of the file.
+    // The file is small enough that its extents always fit within its inode.
     char data[minfs::kMinfsBlockSize];
     memset(data, 0xaa, sizeof(data));
     for (unsigned i = 0; i < actual_blocks - 1; i++) {
@@ -293,15 +294,16 @@ bool TestFullOperations() {
     ASSERT_TRUE(GetUsedBlocks(&free_blocks));
     ASSERT_EQ(free_blocks, 1);
 
-    // We should now have exactly 1 free block remaining. Attempt to write into the indirect
-    // section of the file so we ensure that at least 2 blocks are required.
+    // We should now have exactly 1 free block remaining. Attempt a write which straddles two
+    // blocks past the end of the file so we ensure that at least 2 blocks are required.
     // This is expected to fail.
-    ASSERT_EQ(lseek(med_fd.get(), minfs::kMinfsBlockSize * minfs::kMinfsDirect, SEEK_SET),
-              minfs::kMinfsBlockSize * minfs::kMinfsDirect);
+    const off_t kStraddleOffset = minfs::kMinfsBlockSize * minfs::kMinfsInlineExtents +
+                                  minfs::kMinfsBlockSize / 2;
+    ASSERT_EQ(lseek(med_fd.get(), kStraddleOffset, SEEK_SET), kStraddleOffset);
     ASSERT_LT(write(med_fd.get(), data, sizeof(data)), 0);
 
     // Since the last operation failed, we should still have 1 free block remaining. Writing to the
-    // beginning of the second file should only require 1 (direct) block, and therefore pass.
+    // beginning of the second file should only require 1 block, and therefore pass.
     // Note: This fails without block reservation.
     ASSERT_EQ(write(sml_fd.get(), data, sizeof(data)), sizeof(data));
 
@@ -323,9 +325,9 @@ bool TestFullOperations() {
     sml_fd.reset(openat(mnt_fd.get(), sml_path, O_RDWR));
     ASSERT_TRUE(sml_fd);
 
-    // Make sure we now have at least kMinfsDirect + 1 blocks remaining.
+    // Make sure we now have at least kMinfsInlineExtents + 1 blocks remaining.
     ASSERT_TRUE(GetUsedBlocks(&free_blocks));
-    ASSERT_GE(free_blocks, minfs::kMinfsDirect + 1);
+    ASSERT_GE(free_blocks, minfs::kMinfsInlineExtents + 1);
 
     // We have some room now, so create a new directory.
     const char* dir_path = "directory";
@@ -333,8 +335,8 @@ bool TestFullOperations() {
     fbl::unique_fd dir_fd(openat(mnt_fd.get(), dir_path, O_RDONLY));
     ASSERT_TRUE(dir_fd);
 
-    // Fill the directory up to kMinfsDirect blocks full of direntries.
-    ASSERT_TRUE(FillDirectory(dir_fd.get(), minfs::kMinfsDirect));
+    // Fill the directory up to kMinfsInlineExtents blocks full of direntries.
+    ASSERT_TRUE(FillDirectory(dir_fd.get(), minfs::kMinfsInlineExtents));
 
     // Now re-fill the partition by writing as much as possible back to the original file.
     // Attempt to leave 1 block free.
@@ -345,11 +347,12 @@ bool TestFullOperations() {
     if (actual_blocks == 0) {
         // It is possible that, in our previous allocation of big_fd, we ended up leaving less than
         // |free_blocks| free. Since the file has grown potentially large, it is possible that
-        // allocating a single block will also allocate additional indirect blocks.
+        // allocating a single block will also allocate an additional extent block.
         // For example, in a case where we have 2 free blocks remaining and expect to allocate 1,
         // we may actually end up allocating 2 instead, leaving us with 0 free blocks.
-        // Since sml_fd is using less than kMinfsDirect blocks and thus is guaranteed to have a 1:1
-        // block usage ratio, we can remedy this situation by removing a single block from sml_fd.
+        // Since sml_fd is using less than kMinfsInlineExtents blocks and thus is guaranteed to have
+        // a 1:1 block usage ratio, we can remedy this situation by removing a single block from
+        // sml_fd.
         ASSERT_EQ(ftruncate(sml_fd.get(), 0), 0);
     }
 
@@ -365,10 +368,11 @@ bool TestFullOperations() {
     ASSERT_EQ(free_blocks, actual_blocks);
 
     // Now, attempt to add one more file to the directory we created. Since it will need to
-    // allocate 2 blocks (1 indirect + 1 direct) and there is only 1 remaining, it should fail.
+    // reserve 2 blocks (1 for the new dirent + 1 in case it is a directory) and there is only 1
+    // remaining, it should fail.
     uint64_t block_count;
     ASSERT_TRUE(GetFileBlocks(dir_fd.get(), &block_count));
-    ASSERT_EQ(block_count, minfs::kMinfsDirect);
+    ASSERT_EQ(block_count, minfs::kMinfsInlineExtents);
     fbl::unique_fd tmp_fd(openat(dir_fd.get(), "new_file", O_CREAT | O_RDWR));
     ASSERT_FALSE(tmp_fd);
 
@@ -431,6 +435,126 @@ bool TestFullOperations() {
     END_TEST;
 }
 
+// Test that running out of space for data which is not yet written back is reported by the
+// write which needs the space, rather than lost when the data is written back.
+bool TestDirtyWriteNoSpace() {
+    BEGIN_TEST;
+
+    const char* path = "::dirty";
+    fbl::unique_fd fd(open(path, O_CREAT | O_RDWR));
+    ASSERT_TRUE(fd);
+    uint32_t free_blocks;
+    ASSERT_TRUE(FillPartition(fd.get(), 4, &free_blocks));
+
+    // Nothing has been synced, so the blocks are still only reserved. The data is the same as
+    // FillPartition writes.
+    char data[minfs::kMinfsBlockSize];
+    memset(data, 0xaa, sizeof(data));
+    uint32_t written = 0;
+    while (write(fd.get(), data, sizeof(data)) == sizeof(data)) {
+        written++;
+        ASSERT_LE(written, free_blocks);
+    }
+    ASSERT_EQ(errno, ENOSPC);
+
+    // Everything which was written fits, and survives.
+    struct stat s;
+    ASSERT_EQ(fstat(fd.get(), &s), 0);
+    ASSERT_EQ(fsync(fd.get()), 0);
+    ASSERT_EQ(close(fd.release()), 0);
+    ASSERT_TRUE(check_remount());
+    fd.reset(open(path, O_RDWR));
+    ASSERT_TRUE(fd);
+    struct stat remounted;
+    ASSERT_EQ(fstat(fd.get(), &remounted), 0);
+    ASSERT_EQ(remounted.st_size, s.st_size);
+    char buf[minfs::kMinfsBlockSize];
+    ASSERT_EQ(pread(fd.get(), buf, sizeof(buf), s.st_size - sizeof(buf)), sizeof(buf));
+    ASSERT_EQ(memcmp(buf, data, sizeof(buf)), 0);
+
+    ASSERT_EQ(close(fd.release()), 0);
+    ASSERT_EQ(unlink(path), 0);
+    END_TEST;
+}
+
+// Test that syncing the filesystem through a directory writes back the dirty blocks of files
+// which are still open.
+bool TestDirtySyncDirectory() {
+    BEGIN_TEST;
+
+    if (use_real_disk) {
+        fprintf(stderr, "Ramdisk required; skipping test\n");
+        return true;
+    }
+
+    const char* path = "::dirty";
+    constexpr size_t kBlocks = 4;
+    fbl::unique_fd fd(open(path, O_CREAT | O_RDWR));
+    ASSERT_TRUE(fd);
+    char data[minfs::kMinfsBlockSize];
+    for (size_t i = 0; i < kBlocks; i++) {
+        memset(data, static_cast<int>(i + 1), sizeof(data));
+        ASSERT_EQ(write(fd.get(), data, sizeof(data)), sizeof(data));
+    }
+
+    fbl::unique_fd dir_fd(open(kMountPath, O_RDONLY | O_DIRECTORY));
+    ASSERT_TRUE(dir_fd);
+    ASSERT_EQ(fsync(dir_fd.get()), 0);
+
+    // Nothing written to the disk from here on reaches it, so the data must already have.
+    ASSERT_EQ(sleep_ramdisk(ramdisk_path, 0), 0);
+    ASSERT_EQ(close(fd.release()), 0);
+    ASSERT_EQ(close(dir_fd.release()), 0);
+    ASSERT_EQ(wake_ramdisk(ramdisk_path), 0);
+    ASSERT_TRUE(check_remount());
+
+    fd.reset(open(path, O_RDWR));
+    ASSERT_TRUE(fd);
+    char buf[minfs::kMinfsBlockSize];
+    for (size_t i = 0; i < kBlocks; i++) {
+        memset(data, static_cast<int>(i + 1), sizeof(data));
+        ASSERT_EQ(read(fd.get(), buf, sizeof(buf)), sizeof(buf));
+        ASSERT_EQ(memcmp(buf, data, sizeof(buf)), 0);
+    }
+    ASSERT_EQ(close(fd.release()), 0);
+    ASSERT_EQ(unlink(path), 0);
+    END_TEST;
+}
+
+// Test that truncating blocks which are not yet written back gives back the space reserved for
+// them.
+bool TestDirtyTruncate() {
+    BEGIN_TEST;
+
+    const char* path = "::dirty";
+    constexpr uint32_t kBlocks = 8;
+    fbl::unique_fd fd(open(path, O_CREAT | O_RDWR));
+    ASSERT_TRUE(fd);
+    uint32_t original_blocks;
+    ASSERT_TRUE(GetUsedBlocks(&original_blocks));
+
+    char data[minfs::kMinfsBlockSize];
+    memset(data, 0xcc, sizeof(data));
+    for (uint32_t i = 0; i < kBlocks; i++) {
+        ASSERT_EQ(write(fd.get(), data, sizeof(data)), sizeof(data));
+    }
+    uint32_t current_blocks;
+    ASSERT_TRUE(GetUsedBlocks(&current_blocks));
+    ASSERT_EQ(current_blocks, original_blocks - kBlocks);
+
+    ASSERT_EQ(ftruncate(fd.get(), 2 * minfs::kMinfsBlockSize), 0);
+    ASSERT_TRUE(GetUsedBlocks(&current_blocks));
+    ASSERT_EQ(current_blocks, original_blocks - 2);
+
+    ASSERT_EQ(ftruncate(fd.get(), 0), 0);
+    ASSERT_TRUE(GetUsedBlocks(&current_blocks));
+    ASSERT_EQ(current_blocks, original_blocks);
+
+    ASSERT_EQ(close(fd.release()), 0);
+    ASSERT_EQ(unlink(path), 0);
+    END_TEST;
+}
+
 bool TestUnlinkFail(void) {
     BEGIN_TEST;
 
@@ -515,6 +639,9 @@ bool TestUnlinkFail(void) {
 RUN_MINFS_TESTS_NORMAL(FsMinfsTests,
     RUN_TEST_LARGE(TestFullOperations)
     RUN_TEST_MEDIUM(TestUnlinkFail)
+    RUN_TEST_LARGE(TestDirtyWriteNoSpace)
+    RUN_TEST_MEDIUM(TestDirtySyncDirectory)
+    RUN_TEST_MEDIUM(TestDirtyTruncate)
 )
 
 RUN_MINFS_TESTS_FVM(FsMinfsFvmTests,
@@ -42,6 +42,7 @@ MODULE_HOST_LIBS := \
     system/ulib/unittest.hostlib \
     system/ulib/pretty.hostlib \
     system/ulib/minfs.hostlib \
+    third_party/ulib/cksum.hostlib \
     system/ulib/fbl.hostlib \
     system/ulib/fs.hostlib \
     system/ulib/digest.hostlib \
@@ -0,0 +1,79 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <fbl/atomic.h>
+#include <fbl/string_printf.h>
+#include <fbl/vector.h>
+#include <lib/zx/event.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+
+namespace {
+
+struct LookupArgs {
+    zx::event event;
+    fbl::atomic<bool>* stop;
+};
+
+// Resolves a handle over and over until told to stop.
+int LookupThread(void* arg) {
+    auto* args = static_cast<LookupArgs*>(arg);
+    while (!args->stop->load()) {
+        zx_info_handle_basic_t info;
+        ZX_ASSERT(args->event.get_info(ZX_INFO_HANDLE_BASIC, &info, sizeof(info),
+                                       nullptr, nullptr) == ZX_OK);
+    }
+    return 0;
+}
+
+// Measure the time taken to resolve a handle to its object while |threads|
+// other threads in the same process do the same.  Each thread uses its own
+// handle, so that any slowdown as |threads| grows comes from looking handles
+// up in the process's handle table rather than from sharing an object.
+//
+// ZX_INFO_HANDLE_BASIC is used because it does little besides the lookup.
+bool HandleLookupTest(perftest::RepeatState* state, uint32_t threads) {
+    fbl::atomic<bool> stop(false);
+    fbl::Vector<LookupArgs> args;
+    args.reserve(threads);
+    for (uint32_t i = 0; i < threads; i++) {
+        args.push_back(LookupArgs{zx::event(), &stop});
+        ZX_ASSERT(zx::event::create(0, &args[i].event) == ZX_OK);
+    }
+    fbl::Vector<thrd_t> lookup_threads;
+    for (uint32_t i = 0; i < threads; i++) {
+        thrd_t thread;
+        ZX_ASSERT(thrd_create(&thread, LookupThread, &args[i]) == thrd_success);
+        lookup_threads.push_back(thread);
+    }
+
+    zx::event event;
+    ZX_ASSERT(zx::event::create(0, &event) == ZX_OK);
+    while (state->KeepRunning()) {
+        zx_info_handle_basic_t info;
+        ZX_ASSERT(event.get_info(ZX_INFO_HANDLE_BASIC, &info, sizeof(info),
+                                 nullptr, nullptr) == ZX_OK);
+    }
+
+    stop.store(true);
+    for (auto& thread : lookup_threads) {
+        ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    static const uint32_t kThreadCounts[] = {0, 1, 3, 7};
+    for (auto threads : kThreadCounts) {
+        auto name = fbl::StringPrintf("HandleLookup/%uthreads", threads);
+        perftest::RegisterTest(name.c_str(), HandleLookupTest, threads);
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
@@ -4,6 +4,10 @@
 
 #include <threads.h>
 
+#include <fbl/atomic.h>
+#include <fbl/string_printf.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 #include <perftest/perftest.h>
 
 namespace {
@@ -24,8 +28,79 @@ bool MutexLockUnlockTest(perftest::RepeatState* state) {
     return true;
 }
 
+struct ContentionArgs {
+    mtx_t* mutex;
+    fbl::atomic<bool>* stop;
+};
+
+// Locks and unlocks a mutex in a loop until told to stop.
+int ContentionThread(void* arg) {
+    auto* args = static_cast<ContentionArgs*>(arg);
+    while (!args->stop->load()) {
+        ZX_ASSERT(mtx_lock(args->mutex) == thrd_success);
+        ZX_ASSERT(mtx_unlock(args->mutex) == thrd_success);
+    }
+    return 0;
+}
+
+// Measure the time taken to lock and unlock a C11 mutex while |threads|
+// threads in total, including this one, do the same on |mutexes| distinct
+// mutexes. Threads sharing a mutex contend on it and so block on its futex.
+//
+// All of a process's futexes are handled by the kernel in one table, so as
+// long as the table does not serialize unrelated futexes, the time taken
+// should depend on how many threads share each mutex, not on how many
+// mutexes there are.
+bool MutexContentionTest(perftest::RepeatState* state, uint32_t mutexes, uint32_t threads) {
+    fbl::unique_ptr<mtx_t[]> mutex_array(new mtx_t[mutexes]);
+    for (uint32_t i = 0; i < mutexes; i++) {
+        ZX_ASSERT(mtx_init(&mutex_array[i], mtx_plain) == thrd_success);
+    }
+
+    fbl::atomic<bool> stop(false);
+    fbl::Vector<ContentionArgs> args;
+    args.reserve(threads);
+    fbl::Vector<thrd_t> contention_threads;
+    // This thread uses the first mutex.
+    for (uint32_t i = 1; i < threads; i++) {
+        args.push_back(ContentionArgs{&mutex_array[i % mutexes], &stop});
+    }
+    for (auto& arg : args) {
+        thrd_t thread;
+        ZX_ASSERT(thrd_create(&thread, ContentionThread, &arg) == thrd_success);
+        contention_threads.push_back(thread);
+    }
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(mtx_lock(&mutex_array[0]) == thrd_success);
+        ZX_ASSERT(mtx_unlock(&mutex_array[0]) == thrd_success);
+    }
+
+    stop.store(true);
+    for (auto& thread : contention_threads) {
+        ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+    }
+    for (uint32_t i = 0; i < mutexes; i++) {
+        mtx_destroy(&mutex_array[i]);
+    }
+    return true;
+}
+
 void RegisterTests() {
     perftest::RegisterTest("MutexLockUnlock", MutexLockUnlockTest);
+
+    auto register_contention_test = [](uint32_t mutexes, uint32_t threads) {
+        auto name = fbl::StringPrintf("MutexContention/%umutexes/%uthreads", mutexes, threads);
+        perftest::RegisterTest(name.c_str(), MutexContentionTest, mutexes, threads);
+    };
+    // All threads on one mutex, and pairs of threads on a mutex each.
+    static const uint32_t kThreadCounts[] = {2, 4, 8, 16};
+    for (auto threads : kThreadCounts) {
+        register_contention_test(1, threads);
+        if (threads > 2) {
+            register_contention_test(threads / 2, threads);
+        }
+    }
 }
 PERFTEST_CTOR(RegisterTests);
 
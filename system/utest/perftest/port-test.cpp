@@ -0,0 +1,84 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <fbl/atomic.h>
+#include <fbl/string_printf.h>
+#include <fbl/vector.h>
+#include <lib/zx/port.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+namespace {
+
+struct PortArgs {
+    const zx::port* port;
+    fbl::atomic<bool>* stop;
+};
+
+// Queues a packet and waits for one in a loop until told to stop, like a
+// thread of a pool serving a single port.
+int QueueWaitThread(void* arg) {
+    auto* args = static_cast<PortArgs*>(arg);
+    const zx_port_packet_t packet = {1u, ZX_PKT_TYPE_USER, ZX_OK, {}};
+    while (!args->stop->load()) {
+        ZX_ASSERT(args->port->queue(&packet) == ZX_OK);
+        zx_port_packet_t out;
+        ZX_ASSERT(args->port->wait(zx::time::infinite(), &out) == ZX_OK);
+    }
+    return 0;
+}
+
+// Measure the time taken to queue a packet on a port and take one off it
+// while |threads| other threads do the same on the same port.
+//
+// With |options| set to ZX_PORT_PER_CPU the port queues packets per cpu, so
+// this should not get slower as |threads| grows until the cpus run out.
+bool PortQueueWaitTest(perftest::RepeatState* state, uint32_t threads, uint32_t options) {
+    zx::port port;
+    ZX_ASSERT(zx::port::create(options, &port) == ZX_OK);
+
+    fbl::atomic<bool> stop(false);
+    PortArgs args = {&port, &stop};
+    fbl::Vector<thrd_t> port_threads;
+    for (uint32_t i = 0; i < threads; i++) {
+        thrd_t thread;
+        ZX_ASSERT(thrd_create(&thread, QueueWaitThread, &args) == thrd_success);
+        port_threads.push_back(thread);
+    }
+
+    const zx_port_packet_t packet = {1u, ZX_PKT_TYPE_USER, ZX_OK, {}};
+    while (state->KeepRunning()) {
+        ZX_ASSERT(port.queue(&packet) == ZX_OK);
+        zx_port_packet_t out;
+        ZX_ASSERT(port.wait(zx::time::infinite(), &out) == ZX_OK);
+    }
+
+    // A thread can be left waiting after another took the packet it queued,
+    // so queue one more packet for each thread.
+    stop.store(true);
+    for (uint32_t i = 0; i < threads; i++) {
+        ZX_ASSERT(port.queue(&packet) == ZX_OK);
+    }
+    for (auto& thread : port_threads) {
+        ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    static const uint32_t kThreadCounts[] = {0, 1, 3, 7};
+    for (auto threads : kThreadCounts) {
+        auto name = fbl::StringPrintf("Port/QueueWait/%uthreads", threads);
+        perftest::RegisterTest(name.c_str(), PortQueueWaitTest, threads, 0u);
+        name = fbl::StringPrintf("Port/QueueWait/PerCpu/%uthreads", threads);
+        perftest::RegisterTest(name.c_str(), PortQueueWaitTest, threads, ZX_PORT_PER_CPU);
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
@@ -0,0 +1,94 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <fbl/atomic.h>
+#include <fbl/string_printf.h>
+#include <fbl/vector.h>
+#include <lib/zx/event.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+// Spins until told to stop, to keep a CPU busy in the background.
+int SpinnerThread(void* arg) {
+    auto* stop = static_cast<fbl::atomic<bool>*>(arg);
+    while (!stop->load()) {
+    }
+    return 0;
+}
+
+struct PingPong {
+    zx::event ping;
+    zx::event pong;
+    fbl::atomic<bool> stop{false};
+};
+
+// Waits for a ping and answers with a pong until told to stop.
+int PongThread(void* arg) {
+    auto* pp = static_cast<PingPong*>(arg);
+    for (;;) {
+        ZX_ASSERT(pp->ping.wait_one(ZX_EVENT_SIGNALED, zx::time::infinite(),
+                                    nullptr) == ZX_OK);
+        ZX_ASSERT(pp->ping.signal(ZX_EVENT_SIGNALED, 0) == ZX_OK);
+        if (pp->stop.load()) {
+            return 0;
+        }
+        ZX_ASSERT(pp->pong.signal(0, ZX_EVENT_SIGNALED) == ZX_OK);
+    }
+}
+
+// Measure the round trip time of waking up a blocked thread and being
+// woken up by it in turn, while |spinners| CPU bound threads compete for
+// the CPUs.
+//
+// This is a proxy for the scheduling latency seen by latency sensitive
+// services running alongside batch work, and is useful for comparing
+// the priority and fair schedulers (see kernel.scheduler).
+bool SchedWakeupLatencyTest(perftest::RepeatState* state, uint32_t spinners) {
+    fbl::atomic<bool> stop_spinning(false);
+    fbl::Vector<thrd_t> spinner_threads;
+    for (uint32_t i = 0; i < spinners; i++) {
+        thrd_t thread;
+        ZX_ASSERT(thrd_create(&thread, SpinnerThread, &stop_spinning) == thrd_success);
+        spinner_threads.push_back(thread);
+    }
+
+    PingPong pp;
+    ZX_ASSERT(zx::event::create(0, &pp.ping) == ZX_OK);
+    ZX_ASSERT(zx::event::create(0, &pp.pong) == ZX_OK);
+    thrd_t pong_thread;
+    ZX_ASSERT(thrd_create(&pong_thread, PongThread, &pp) == thrd_success);
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(pp.ping.signal(0, ZX_EVENT_SIGNALED) == ZX_OK);
+        ZX_ASSERT(pp.pong.wait_one(ZX_EVENT_SIGNALED, zx::time::infinite(),
+                                   nullptr) == ZX_OK);
+        ZX_ASSERT(pp.pong.signal(ZX_EVENT_SIGNALED, 0) == ZX_OK);
+    }
+
+    pp.stop.store(true);
+    ZX_ASSERT(pp.ping.signal(0, ZX_EVENT_SIGNALED) == ZX_OK);
+    ZX_ASSERT(thrd_join(pong_thread, nullptr) == thrd_success);
+
+    stop_spinning.store(true);
+    for (auto& thread : spinner_threads) {
+        ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    static const uint32_t kSpinnerCounts[] = {0, 1, 4, 16};
+    for (auto spinners : kSpinnerCounts) {
+        auto name = fbl::StringPrintf("Sched/WakeupLatency/%uspinners", spinners);
+        perftest::RegisterTest(name.c_str(), SchedWakeupLatencyTest, spinners);
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
@@ -0,0 +1,86 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <limits.h>
+#include <threads.h>
+
+#include <fbl/atomic.h>
+#include <fbl/string_printf.h>
+#include <fbl/vector.h>
+#include <lib/zx/vmar.h>
+#include <lib/zx/vmo.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+constexpr size_t kMappingCount = 256;
+constexpr size_t kMappingSize = 4 * PAGE_SIZE;
+
+// Spins until told to stop, keeping this process's address space active on
+// another CPU so that TLB shootdowns for it have to be sent there.
+int SpinnerThread(void* arg) {
+    auto* stop = static_cast<fbl::atomic<bool>*>(arg);
+    while (!stop->load()) {
+    }
+    return 0;
+}
+
+// Measure the time taken to destroy a VMAR holding |kMappingCount| small
+// mappings, each of which has been faulted in, while |spinners| other threads
+// of this process keep running.  This is a proxy for tearing down the address
+// space of a large process, where each mapping used to need its own TLB
+// shootdown.
+bool VmarDestroyTest(perftest::RepeatState* state, uint32_t spinners) {
+    fbl::atomic<bool> stop(false);
+    fbl::Vector<thrd_t> spinner_threads;
+    for (uint32_t i = 0; i < spinners; i++) {
+        thrd_t thread;
+        ZX_ASSERT(thrd_create(&thread, SpinnerThread, &stop) == thrd_success);
+        spinner_threads.push_back(thread);
+    }
+
+    zx::vmo vmo;
+    ZX_ASSERT(zx::vmo::create(kMappingSize, 0, &vmo) == ZX_OK);
+    ZX_ASSERT(vmo.op_range(ZX_VMO_OP_COMMIT, 0, kMappingSize, nullptr, 0) == ZX_OK);
+
+    state->DeclareStep("setup");
+    state->DeclareStep("destroy");
+    while (state->KeepRunning()) {
+        zx::vmar vmar;
+        uintptr_t vmar_addr;
+        ZX_ASSERT(zx::vmar::root_self()->allocate(
+                      0, kMappingCount * kMappingSize,
+                      ZX_VM_CAN_MAP_READ | ZX_VM_CAN_MAP_SPECIFIC, &vmar, &vmar_addr) == ZX_OK);
+        for (size_t i = 0; i < kMappingCount; i++) {
+            uintptr_t addr;
+            ZX_ASSERT(vmar.map(i * kMappingSize, vmo, 0, kMappingSize,
+                               ZX_VM_PERM_READ | ZX_VM_SPECIFIC, &addr) == ZX_OK);
+            for (size_t offset = 0; offset < kMappingSize; offset += PAGE_SIZE) {
+                (void)*reinterpret_cast<volatile uint8_t*>(addr + offset);
+            }
+        }
+        state->NextStep();
+
+        ZX_ASSERT(vmar.destroy() == ZX_OK);
+    }
+
+    stop.store(true);
+    for (auto& thread : spinner_threads) {
+        ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    static const uint32_t kSpinnerCounts[] = {0, 3};
+    for (auto spinners : kSpinnerCounts) {
+        auto name = fbl::StringPrintf("Vmar/Destroy256Mappings/%uspinners", spinners);
+        perftest::RegisterTest(name.c_str(), VmarDestroyTest, spinners);
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
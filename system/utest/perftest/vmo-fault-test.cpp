@@ -0,0 +1,53 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <limits.h>
+
+#include <lib/zx/vmar.h>
+#include <lib/zx/vmo.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+#include <utility>
+
+namespace {
+
+constexpr size_t kMappingSize = 64 * 1024 * 1024;
+
+// Measure the time taken to map |kMappingSize| bytes of memory that the VMO
+// already has and read one byte from each page of it, then unmap it again.
+// This is dominated by page faults, which kernel.vm.fault-around reduces.
+//
+// If |clone| is true the mapping is of a copy-on-write clone of the
+// committed VMO, so that the pages come from the clone's parent.
+bool VmoFaultInTest(perftest::RepeatState* state, bool clone) {
+    zx::vmo vmo;
+    ZX_ASSERT(zx::vmo::create(kMappingSize, 0, &vmo) == ZX_OK);
+    ZX_ASSERT(vmo.op_range(ZX_VMO_OP_COMMIT, 0, kMappingSize, nullptr, 0) == ZX_OK);
+    if (clone) {
+        zx::vmo child;
+        ZX_ASSERT(vmo.clone(ZX_VMO_CLONE_COPY_ON_WRITE, 0, kMappingSize, &child) == ZX_OK);
+        vmo = std::move(child);
+    }
+
+    while (state->KeepRunning()) {
+        uintptr_t addr;
+        ZX_ASSERT(zx::vmar::root_self()->map(0, vmo, 0, kMappingSize, ZX_VM_PERM_READ,
+                                             &addr) == ZX_OK);
+        for (size_t offset = 0; offset < kMappingSize; offset += PAGE_SIZE) {
+            (void)*reinterpret_cast<volatile uint8_t*>(addr + offset);
+        }
+        ZX_ASSERT(zx::vmar::root_self()->unmap(addr, kMappingSize) == ZX_OK);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    perftest::RegisterTest("Vmo/FaultIn64MiB/Committed", VmoFaultInTest, false);
+    perftest::RegisterTest("Vmo/FaultIn64MiB/Clone", VmoFaultInTest, true);
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace